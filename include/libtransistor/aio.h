@@ -0,0 +1,128 @@
+/**
+ * @file libtransistor/aio.h
+ * @brief Asynchronous file I/O
+ *
+ * Reads and writes on any file descriptor can be handed to a small pool of
+ * I/O worker threads, so that the thread submitting them can keep going while
+ * they wait on IPC. Completions are delivered through a \ref waiter_t: a
+ * request's callback runs on whichever thread calls \ref waiter_wait next,
+ * never on a worker.
+ *
+ * ```
+ * waiter_t *waiter = waiter_create();
+ * trn_aio_t *aio;
+ * trn_aio_create(&aio, waiter, TRN_AIO_DEFAULT_WORKERS);
+ *
+ * trn_aio_request_t req = {
+ *   .fd = fd, .opcode = TRN_AIO_READ,
+ *   .buf = buf, .size = sizeof(buf), .offset = 0,
+ *   .callback = on_read, .data = state,
+ * };
+ * trn_aio_submit(aio, &req);
+ * ...
+ * waiter_wait(waiter, timeout); // calls on_read(&req, state) once it's done
+ * ```
+ *
+ * Requests may complete in any order. Reads on the same file that are queued
+ * at the same time and cover adjacent ranges are merged into a single read,
+ * so a reader that keeps several consecutive chunks in flight pays for one
+ * round-trip to the backend rather than one per chunk.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include<libtransistor/types.h>
+#include<libtransistor/fd.h>
+#include<libtransistor/waiter.h>
+
+/**
+ * @brief Number of workers that suits most uses
+ */
+#define TRN_AIO_DEFAULT_WORKERS 2
+
+/**
+ * @brief Largest read that adjacent requests are merged into
+ */
+#define TRN_AIO_MAX_BATCH_SIZE (256 * 1024)
+
+typedef struct trn_aio_t trn_aio_t;
+typedef struct trn_aio_request_t trn_aio_request_t;
+
+typedef enum {
+	TRN_AIO_READ,
+	TRN_AIO_WRITE,
+} trn_aio_opcode_t;
+
+/**
+ * @brief An asynchronous read or write
+ *
+ * The caller fills in everything up to `data`, and must keep the request and
+ * its buffer alive until the callback has run. The file is held open from
+ * submission until completion, even if the fd is closed in the meantime.
+ */
+struct trn_aio_request_t {
+	int fd;
+	trn_aio_opcode_t opcode;
+	void *buf;
+	size_t size;
+	off_t offset;
+	void (*callback)(trn_aio_request_t *request, void *data); ///< Called from \ref waiter_wait once the request is done
+	void *data; ///< Userdata passed to callback
+
+	result_t result; ///< Set before the callback runs
+	size_t transferred; ///< Bytes read or written, set before the callback runs
+
+	// private
+	trn_file_t *file;
+	trn_aio_request_t *next;
+};
+
+/**
+ * @brief Asynchronous I/O statistics
+ */
+typedef struct {
+	uint64_t submitted; ///< Requests submitted
+	uint64_t completed; ///< Requests whose callbacks have run
+	uint64_t backend_calls; ///< Reads and writes issued to backends
+	uint64_t merged; ///< Requests that were served as part of another request's read
+} trn_aio_stats_t;
+
+/**
+ * @brief Create an asynchronous I/O context
+ *
+ * Workers are started when the first request is submitted.
+ *
+ * @param out Output for the new context
+ * @param waiter Waiter that completions are delivered through
+ * @param workers Number of I/O worker threads
+ */
+result_t trn_aio_create(trn_aio_t **out, waiter_t *waiter, int workers);
+
+/**
+ * @brief Queue a request
+ *
+ * Returns without waiting for the request to run. If this fails, the request
+ * was not queued and its callback won't be called.
+ */
+result_t trn_aio_submit(trn_aio_t *aio, trn_aio_request_t *request);
+
+/**
+ * @brief Get asynchronous I/O statistics
+ */
+void trn_aio_get_stats(trn_aio_t *aio, trn_aio_stats_t *stats);
+
+/**
+ * @brief Destroy an asynchronous I/O context
+ *
+ * Waits for every submitted request to finish and calls the callbacks of any
+ * that haven't been delivered yet. Must not be called from a callback.
+ */
+void trn_aio_destroy(trn_aio_t *aio);
+
+#ifdef __cplusplus
+}
+#endif
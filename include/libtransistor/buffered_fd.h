@@ -0,0 +1,66 @@
+/**
+ * @file libtransistor/buffered_fd.h
+ * @brief Write coalescing for stream file descriptors
+ *
+ * Wraps a file descriptor whose every write costs an IPC, like a socket, a
+ * twili pipe or usb_serial, and holds small writes back so they go out
+ * together. What's held is written out
+ *
+ * - once the buffer fills,
+ * - once the oldest byte in it has waited `max_delay_us`,
+ * - once a write that ends a line has been followed by `newline_idle_us`
+ *   without any more, so a burst of lines goes out as soon as it's over,
+ * - before anything is read from the file,
+ * - on `fsync` or \ref trn_buffered_fd_flush_all,
+ * - and when the file is closed.
+ *
+ * The timing is kept by a background thread waiting in a \ref waiter_t. If
+ * it fails to write something out, the next write or `fsync` reports it.
+ *
+ * ```
+ * trn_buffered_fd_config_t config = TRN_BUFFERED_FD_CONFIG_DEFAULT;
+ * int buffered = trn_buffered_fd_create(socket_fd, &config);
+ * dup2(buffered, STDOUT_FILENO);
+ * close(buffered);
+ * ```
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include<libtransistor/types.h>
+
+typedef struct {
+	size_t buffer_size; ///< Most bytes held back; writes this big go straight through
+	uint32_t max_delay_us;
+	uint32_t newline_idle_us;
+} trn_buffered_fd_config_t;
+
+#define TRN_BUFFERED_FD_CONFIG_DEFAULT { \
+		.buffer_size = 0x1000, \
+		.max_delay_us = 20000, \
+		.newline_idle_us = 2000, \
+	}
+
+/**
+ * @brief Makes a file descriptor that buffers writes to fd's file
+ *
+ * The new descriptor holds a reference to the file of its own, so fd can be
+ * closed. Reads, `poll` and `fcntl` go to the file underneath, but socket
+ * calls don't take the new descriptor for a socket.
+ *
+ * @return The new file descriptor, or a negative errno
+ */
+int trn_buffered_fd_create(int fd, const trn_buffered_fd_config_t *config);
+
+/**
+ * @brief Writes out what every buffered file descriptor is holding
+ */
+void trn_buffered_fd_flush_all();
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,39 @@
+/**
+ * @file libtransistor/cpp/aio.hpp
+ * @brief Asynchronous file I/O (C++ bindings)
+ */
+
+#pragma once
+
+#include<libtransistor/cpp/types.hpp>
+#include<libtransistor/cpp/waiter.hpp>
+#include<libtransistor/aio.h>
+
+#include<future>
+
+namespace trn {
+
+/**
+ * @brief Asynchronous I/O context whose requests complete futures
+ *
+ * Futures are completed from \ref Waiter::Wait, like any other completion
+ * delivered through the waiter, so the thread that runs the waiter must not
+ * block on one of them.
+ */
+class AIO {
+ public:
+	AIO(Waiter &waiter, int workers = TRN_AIO_DEFAULT_WORKERS);
+	AIO(const AIO &) = delete;
+	AIO &operator=(const AIO &) = delete;
+	~AIO();
+
+	/* futures resolve to the number of bytes transferred */
+	std::future<Result<size_t>> Read(int fd, void *buf, size_t size, off_t offset);
+	std::future<Result<size_t>> Write(int fd, const void *buf, size_t size, off_t offset);
+
+	trn_aio_t *aio;
+ private:
+	std::future<Result<size_t>> Submit(trn_aio_opcode_t opcode, int fd, void *buf, size_t size, off_t offset);
+};
+
+}
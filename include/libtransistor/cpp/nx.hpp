@@ -14,6 +14,7 @@
 #include<libtransistor/cpp/ipcserver.hpp>
 #include<libtransistor/cpp/svc.hpp>
 #include<libtransistor/cpp/waiter.hpp>
+#include<libtransistor/cpp/aio.hpp>
 
 // services
 #include<libtransistor/cpp/ipc/hid.hpp>
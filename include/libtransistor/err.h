@@ -117,6 +117,8 @@ void trn_lookup_result(result_t code, trn_result_description_t *out);
 #define LIBTRANSISTOR_ERR_FS_READ_ONLY LIBTRANSISTOR_RESULT(8010)
 #define LIBTRANSISTOR_ERR_FS_ACCESS_DENIED LIBTRANSISTOR_RESULT(8011)
 #define LIBTRANSISTOR_ERR_FS_IO_ERROR LIBTRANSISTOR_RESULT(8012)
+#define LIBTRANSISTOR_ERR_FS_NO_SPACE LIBTRANSISTOR_RESULT(8013)
+#define LIBTRANSISTOR_ERR_FS_DIRECTORY_NOT_EMPTY LIBTRANSISTOR_RESULT(8014)
 
 // AM
 #define LIBTRANSISTOR_ERR_AM_WORKAROUND_ACTIVE LIBTRANSISTOR_RESULT(9001)
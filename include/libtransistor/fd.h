@@ -16,7 +16,82 @@ extern "C" {
 #include <sys/types.h>
 #include <stdint.h>
 
+#if __has_include(<sys/uio.h>)
+#include <sys/uio.h>
+#else
+struct iovec {
+	void *iov_base;
+	size_t iov_len;
+};
+
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt);
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt);
+#endif
+
+#if __has_include(<sys/mman.h>)
+#include <sys/mman.h>
+#else
+#define PROT_NONE 0
+#define PROT_READ 1
+#define PROT_WRITE 2
+#define PROT_EXEC 4
+
+#define MAP_SHARED 0x01
+#define MAP_PRIVATE 0x02
+#define MAP_FIXED 0x10
+#define MAP_ANONYMOUS 0x20
+#define MAP_ANON MAP_ANONYMOUS
+
+#define MAP_FAILED ((void*) -1)
+
+void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset);
+int munmap(void *addr, size_t length);
+#endif
+
+#if __has_include(<sys/sendfile.h>)
+#include <sys/sendfile.h>
+#else
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count);
+ssize_t copy_file_range(int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len, unsigned int flags);
+#endif
+
+#if __has_include(<sys/epoll.h>)
+#include <sys/epoll.h>
+#else
+#define EPOLLIN 0x001
+#define EPOLLPRI 0x002
+#define EPOLLOUT 0x004
+#define EPOLLERR 0x008
+#define EPOLLHUP 0x010
+#define EPOLLONESHOT (1u << 30)
+#define EPOLLET (1u << 31)
+
+#define EPOLL_CTL_ADD 1
+#define EPOLL_CTL_DEL 2
+#define EPOLL_CTL_MOD 3
+
+#define EPOLL_CLOEXEC 02000000
+
+typedef union epoll_data {
+	void *ptr;
+	int fd;
+	uint32_t u32;
+	uint64_t u64;
+} epoll_data_t;
+
+struct epoll_event {
+	uint32_t events;
+	epoll_data_t data;
+};
+
+int epoll_create(int size);
+int epoll_create1(int flags);
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event);
+int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout);
+#endif
+
 typedef struct trn_file_t trn_file_t;
+struct stat;
 
 /**
  * @struct trn_fops_t
@@ -26,10 +101,21 @@ typedef struct {
 	result_t (*seek) (void *data, off_t offset, int whence, off_t *out);
 	result_t (*read) (void *data, void *buf, size_t size, size_t *bytes_read);
 	result_t (*write) (void *data, const void *buf, size_t size, size_t *bytes_written);
-	//result_t (*flush) (void *data);
+	result_t (*flush) (void *data); ///< Optional. Writes out whatever is buffered, for fsync
 	
 	// Release data, and file_operations if it was allocated.
 	result_t (*release) (trn_file_t *file);
+
+	result_t (*pread) (void *data, void *buf, size_t size, off_t offset, size_t *bytes_read); ///< Optional. Leaves the position alone, and may run concurrently with anything
+	result_t (*pwrite) (void *data, const void *buf, size_t size, off_t offset, size_t *bytes_written); ///< Optional, like pread
+	result_t (*readv) (void *data, const struct iovec *iov, int iovcnt, size_t *bytes_read); ///< Optional
+	result_t (*writev) (void *data, const struct iovec *iov, int iovcnt, size_t *bytes_written); ///< Optional
+	result_t (*truncate) (void *data, off_t length); ///< Optional, for ftruncate
+	result_t (*stat) (void *data, struct stat *st); ///< Optional, for fstat, with st zeroed beforehand
+	result_t (*mmap) (void *data, off_t offset, size_t length, const void **addr); ///< Optional. Points addr at the range if it sits in memory as-is, for as long as that memory lives
+	result_t (*peek) (void *data, off_t offset, const void **addr, size_t *length); ///< Optional. Like mmap, for sendfile, but may shorten length. addr has to stay good while the file is open, whatever else runs
+	result_t (*poll) (void *data, short events, short *revents, handle_t *handle); ///< Optional. Sets revents without blocking, and maybe handle to an event to wait on
+	result_t (*fcntl) (void *data, int cmd, int arg, int *out); ///< Optional. F_GETFL and F_SETFL, in newlib's flags
 } trn_file_ops_t;
 
 /**
@@ -39,6 +125,7 @@ struct trn_file_t {
 	_Atomic(int) refcount;
 	trn_file_ops_t *ops;
 	void *data;
+	uint64_t id; ///< Never reused, unlike the fd and the allocation, so it tells whether an fd still means the same file
 };
 
 /**
@@ -63,6 +150,11 @@ void fd_file_put(trn_file_t *file);
 
 /**
 * @brief Close the file descriptor
+*
+*        If that released the file, and releasing it failed, the fd is still
+*        closed, but the error is returned.
+*
+* @return 0, or a negative errno
 */
 int fd_close(int fd);
 
@@ -0,0 +1,139 @@
+/**
+ * @file libtransistor/fs/dcache.h
+ * @brief Directory entry cache for the virtual filesystem
+ *
+ * Path resolution in the virtual filesystem looks up every path segment
+ * through the backend's `lookup` operation. For fspfs this is an IPC round-trip
+ * per segment, and for squashfs it is a directory scan. The dentry cache
+ * remembers the inodes (and failed lookups) that were resolved, keyed on
+ * their parent dentry and their name, so that repeated opens of the same
+ * paths don't have to hit the backend again.
+ *
+ * Cached inodes are owned by the cache. Dentries are reference counted: a
+ * dentry handed out by \ref trn_dcache_lookup must be returned with
+ * \ref trn_dcache_put. Each cached dentry also holds a reference on its
+ * parent, so a dentry can only be evicted once nothing is cached under it.
+ * Unreferenced dentries are evicted in least-recently-used order once the
+ * cache is full.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include<libtransistor/types.h>
+#include<libtransistor/fs/inode.h>
+
+#include<stdint.h>
+
+#define TRN_DCACHE_DEFAULT_LIMIT 512
+
+typedef struct trn_dentry_t trn_dentry_t;
+
+/**
+ * @brief Cached directory entry
+ *
+ * A NULL parent refers to the filesystem root.
+ */
+struct trn_dentry_t {
+	trn_dentry_t *parent;
+	trn_dentry_t *hash_next;
+	trn_dentry_t *lru_prev;
+	trn_dentry_t *lru_next;
+	int refcount;
+	bool hashed;
+	bool negative;
+	uint32_t hash;
+	trn_inode_t inode;
+	size_t name_len;
+	char name[];
+};
+
+/**
+ * @brief Dentry cache statistics
+ */
+typedef struct {
+	uint64_t hits; ///< Lookups satisfied by a cached inode
+	uint64_t negative_hits; ///< Lookups satisfied by a cached failed lookup
+	uint64_t misses; ///< Lookups that had to go to the backend
+	uint64_t evictions; ///< Unreferenced dentries dropped to make room
+	uint64_t invalidations; ///< Dentries dropped because of create/rename/unlink
+	size_t entries; ///< Dentries currently in the cache
+} trn_dcache_stats_t;
+
+/**
+ * @brief Look up a child of a cached directory
+ *
+ * If (parent, name) is not cached, this calls `lookup` on parent_inode and
+ * caches the result. On success, the returned dentry is referenced and must be
+ * released with \ref trn_dcache_put.
+ *
+ * @param parent Parent dentry, or NULL if parent_inode is the filesystem root
+ * @param parent_inode Inode belonging to parent
+ * @param name Name of the child, not necessarily NUL-terminated
+ * @param name_len Length of name
+ * @param out Output for the referenced child dentry
+ */
+result_t trn_dcache_lookup(trn_dentry_t *parent, trn_inode_t *parent_inode, const char *name, size_t name_len, trn_dentry_t **out);
+
+/**
+ * @brief Take an additional reference on a dentry
+ */
+void trn_dcache_get(trn_dentry_t *dentry);
+
+/**
+ * @brief Release a reference on a dentry. NULL is ignored.
+ */
+void trn_dcache_put(trn_dentry_t *dentry);
+
+/**
+ * @brief Drop a cached failed lookup of (parent, name), if there is one
+ *
+ * This should be called after creating a file or directory.
+ */
+void trn_dcache_invalidate_name(trn_dentry_t *parent, const char *name, size_t name_len);
+
+/**
+ * @brief Make a dentry and everything cached under it unreachable
+ *
+ * This should be called after the entry has been removed or renamed. Dentries
+ * that are still referenced stay alive until they are released, but will not be
+ * returned by future lookups.
+ */
+void trn_dcache_invalidate(trn_dentry_t *dentry);
+
+/**
+ * @brief Drop all cached failed lookups
+ */
+void trn_dcache_invalidate_negative();
+
+/**
+ * @brief Drop every dentry from the cache
+ *
+ * Referenced dentries are released once their last reference is put.
+ */
+void trn_dcache_flush();
+
+/**
+ * @brief Set the maximum number of dentries kept in the cache
+ *
+ * The default is \ref TRN_DCACHE_DEFAULT_LIMIT. A limit of zero disables
+ * caching. Lowering the limit evicts unreferenced dentries immediately.
+ */
+void trn_dcache_set_limit(size_t max_entries);
+
+/**
+ * @brief Get dentry cache statistics
+ */
+void trn_dcache_get_stats(trn_dcache_stats_t *out);
+
+/**
+ * @brief Reset the dentry cache statistics counters
+ */
+void trn_dcache_reset_stats();
+
+#ifdef __cplusplus
+}
+#endif
@@ -87,6 +87,19 @@ result_t trn_fs_mount(const char *name, trn_inode_t root);
 result_t trn_fs_realpath(const char *path, char **resolved_path);
 result_t trn_fs_open(int *fd, const char *path, int flags);
 result_t trn_fs_opendir(trn_dir_t *dir, const char *path);
+
+/**
+ * @brief Read several entries from a directory at once
+ *
+ * Uses the directory's `next_batch` operation if it has one, and falls back to
+ * calling `next` repeatedly otherwise.
+ *
+ * @param dir Directory to read from
+ * @param dirents Output for the entries
+ * @param count Maximum number of entries to read
+ * @param read Output for the number of entries read. Zero at the end of the directory.
+ */
+result_t trn_fs_readdir_batch(trn_dir_t *dir, trn_dirent_t *dirents, size_t count, size_t *read);
 result_t trn_fs_mkdir(const char *path);
 result_t trn_fs_rename(const char *oldpath, const char *newpath);
 result_t trn_fs_unlink(const char *path);
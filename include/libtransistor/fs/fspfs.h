@@ -38,6 +38,55 @@ extern "C" {
  */
 result_t trn_fspfs_create(trn_inode_t *out, ifilesystem_t fs);
 
+/**
+ * @brief Default size of the memory budget shared by all fspfs file caches
+ */
+#define TRN_FSPFS_DEFAULT_CACHE_BUDGET (4 * 1024 * 1024)
+
+/**
+ * @brief fspfs file cache statistics
+ */
+typedef struct {
+	uint64_t read_ipcs; ///< IFile reads issued, including read-ahead
+	uint64_t write_ipcs; ///< IFile writes issued, including write-back
+	uint64_t cached_read_bytes; ///< Bytes read without going to fsp-srv
+	uint64_t buffered_write_bytes; ///< Bytes that were written into a write-back buffer
+	size_t bytes_in_use; ///< Memory currently held by file caches
+} trn_fspfs_cache_stats_t;
+
+/**
+ * @brief Set the memory budget shared by all fspfs file caches
+ *
+ * Open fspfs files keep a read-ahead window and a write-back buffer. Reads that
+ * look sequential are served from a window that doubles up to a maximum size
+ * as long as the access pattern stays sequential, and small writes are
+ * coalesced until the file is flushed, closed, truncated, or written
+ * somewhere non-contiguous. Accesses larger than the buffers go straight to
+ * fsp-srv. Caches belong to an open file, so data written through one file
+ * descriptor isn't visible through another until it has been flushed.
+ *
+ * Buffers are only allocated while they fit within the budget; files that
+ * can't get one fall back to uncached I/O. Lowering the budget doesn't take
+ * memory back from files that already have buffers. A budget of zero disables
+ * caching for files that don't have buffers yet.
+ */
+void trn_fspfs_set_cache_budget(size_t bytes);
+
+/**
+ * @brief Get the memory budget shared by all fspfs file caches
+ */
+size_t trn_fspfs_get_cache_budget();
+
+/**
+ * @brief Get fspfs file cache statistics
+ */
+void trn_fspfs_get_cache_stats(trn_fspfs_cache_stats_t *out);
+
+/**
+ * @brief Reset the fspfs file cache statistics counters
+ */
+void trn_fspfs_reset_cache_stats();
+
 #ifdef __cplusplus
 }
 #endif
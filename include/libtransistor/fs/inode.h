@@ -13,6 +13,7 @@ extern "C" {
 #include<stdlib.h>
 
 struct trn_inode_ops_t;
+struct stat;
 
 typedef struct {
 	void *data;
@@ -28,6 +29,9 @@ typedef struct {
 	result_t (*rewind)(void *dir);
 	result_t (*next)(void *dir, trn_dirent_t *dirent);
 	void (*close)(void *dir);
+	// Optional. Reads up to count entries. Reading zero entries means the end
+	// of the directory was reached.
+	result_t (*next_batch)(void *dir, trn_dirent_t *dirents, size_t count, size_t *read);
 } trn_dir_ops_t;
 
 typedef struct {
@@ -51,6 +55,10 @@ typedef struct trn_inode_ops_t {
 	 */
 	result_t (*open_as_file)(void *inode, int mode, int *fd);
 	result_t (*open_as_dir)(void *inode, trn_dir_t *out);
+
+	// Optional. st is zeroed beforehand. If missing, only st_mode is filled in,
+	// using is_dir.
+	result_t (*stat)(void *inode, struct stat *st);
 } trn_inode_ops_t;
 
 #ifdef __cplusplus
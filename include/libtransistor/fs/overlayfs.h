@@ -0,0 +1,101 @@
+/**
+ * @file libtransistor/fs/overlayfs.h
+ * @brief Filesystem stacking a writable layer over a read-only one
+ *
+ * An overlay shows the contents of an upper, writable filesystem on top of a
+ * lower, read-only one. A typical use is shipping defaults in the embedded
+ * squashfs image and letting users override them on the SD card:
+ *
+ * ```
+ * trn_inode_t overlay;
+ * trn_overlayfs_create(&overlay, sdcard_config_dir, "/config", squashfs_config_dir);
+ * trn_fs_mount("/config", overlay);
+ * ```
+ *
+ * Files and directories in the upper layer hide those with the same name in
+ * the lower one, and directories that exist in both layers have their
+ * contents merged. Nothing is ever written to the lower layer:
+ *
+ * - Opening a lower file for writing first copies it up to the upper layer,
+ *   creating its parent directories there as needed.
+ * - Removing something that exists in the lower layer leaves a whiteout in
+ *   the upper layer, an empty file named `.wh.<name>`, which hides it.
+ * - A directory created where a lower one was removed is marked opaque with
+ *   an empty `.wh..wh..opq` file, so that the lower contents stay hidden.
+ *
+ * Names starting with `.wh.` can't be used. Renaming a directory that exists
+ * in the lower layer isn't supported.
+ *
+ * Every lookup of a name that isn't in the upper layer would normally cost an
+ * upper lookup, and for lower files a whiteout lookup on top of that. Those
+ * misses are remembered in a negative cache, so that once a name has been
+ * looked up, finding that it hasn't been overridden doesn't touch the upper
+ * layer at all. The overlay keeps the cache up to date with its own changes,
+ * but changes made to the upper layer behind its back aren't noticed until
+ * the cache is flushed.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include<libtransistor/types.h>
+#include<libtransistor/fs/inode.h>
+
+/**
+ * @brief Default number of names remembered as missing from the upper layer
+ */
+#define TRN_OVERLAYFS_DEFAULT_NEGATIVE_CACHE_SIZE 1024
+
+/**
+ * @brief Overlay statistics
+ */
+typedef struct {
+	uint64_t upper_lookups; ///< Lookups that went to the upper layer
+	uint64_t negative_hits; ///< Upper lookups avoided by the negative cache
+	uint64_t copy_ups; ///< Files and directories copied up to the upper layer
+	size_t negative_entries; ///< Names currently in the negative cache
+} trn_overlayfs_stats_t;
+
+/**
+ * @brief Create an overlay filesystem
+ *
+ * Ownership of both inodes is transferred to the overlay.
+ *
+ * @param out Output for the root inode of the overlay. This function will initialize the trn_inode_t struct.
+ * @param upper Writable directory that changes go to
+ * @param upper_path Path of upper within its own filesystem, which renames need. Empty if upper is the root.
+ * @param lower Read-only directory underneath
+ */
+result_t trn_overlayfs_create(trn_inode_t *out, trn_inode_t upper, const char *upper_path, trn_inode_t lower);
+
+/**
+ * @brief Set how many names the negative cache remembers
+ *
+ * The least recently used names are dropped first. Zero disables the cache.
+ *
+ * @param inode Any inode of the overlay
+ */
+void trn_overlayfs_set_negative_cache_size(trn_inode_t *inode, size_t entries);
+
+/**
+ * @brief Forget every name the negative cache remembers
+ *
+ * Call this after changing the upper layer without going through the overlay.
+ *
+ * @param inode Any inode of the overlay
+ */
+void trn_overlayfs_flush_negative_cache(trn_inode_t *inode);
+
+/**
+ * @brief Get overlay statistics
+ *
+ * @param inode Any inode of the overlay
+ */
+void trn_overlayfs_get_stats(trn_inode_t *inode, trn_overlayfs_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
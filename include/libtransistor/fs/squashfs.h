@@ -15,6 +15,165 @@ extern "C" {
 typedef struct sqfs sqfs;
 result_t trn_sqfs_open_root(trn_inode_t *out, sqfs *fs);
 
+/**
+ * @brief Block caches kept by a squashfs filesystem
+ */
+typedef enum {
+	TRN_SQFS_CACHE_METADATA, ///< Metadata blocks (inodes, directories, block lists)
+	TRN_SQFS_CACHE_DATA, ///< Decompressed file data blocks
+	TRN_SQFS_CACHE_FRAGMENT, ///< Decompressed fragment blocks
+} trn_sqfs_cache_t;
+
+/**
+ * @brief squashfs block cache statistics
+ */
+typedef struct {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	size_t blocks; ///< Capacity of the cache, in blocks
+} trn_sqfs_cache_stats_t;
+
+/**
+ * @brief Resize one of a squashfs filesystem's block caches
+ *
+ * Each cache is hashed, and evicts in segmented-LRU order: blocks that have
+ * been hit more than once are protected from blocks that were only used once,
+ * so a streaming read doesn't push out hot metadata. Resizing drops everything
+ * in the cache.
+ *
+ * @param fs Filesystem to configure
+ * @param cache Which cache to resize
+ * @param blocks New capacity, at least 1
+ */
+result_t trn_sqfs_set_cache_size(sqfs *fs, trn_sqfs_cache_t cache, size_t blocks);
+
+/**
+ * @brief Get statistics for one of a squashfs filesystem's block caches
+ */
+result_t trn_sqfs_get_cache_stats(sqfs *fs, trn_sqfs_cache_t cache, trn_sqfs_cache_stats_t *out);
+
+/**
+ * @brief Reset the statistics of all of a squashfs filesystem's block caches
+ */
+void trn_sqfs_reset_cache_stats(sqfs *fs);
+
+#define TRN_SQFS_DEFAULT_INODE_CACHE_SIZE 256
+
+/**
+ * @brief squashfs inode cache statistics
+ */
+typedef struct {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	size_t cached; ///< Inodes in the cache, including ones that are in use
+	size_t unused; ///< Cached inodes that nothing holds a reference to
+} trn_sqfs_inode_cache_stats_t;
+
+/**
+ * @brief Set how many unused inodes a squashfs filesystem keeps decoded
+ *
+ * Inodes looked up through the filesystem are shared and reference counted,
+ * so an inode that is looked up again while something still holds it costs
+ * nothing. Once released, up to `inodes` of them stay cached, and the least
+ * recently released is dropped first. The default is
+ * \ref TRN_SQFS_DEFAULT_INODE_CACHE_SIZE.
+ *
+ * @param fs Filesystem to configure
+ * @param inodes Unused inodes to keep. Zero frees inodes as soon as they're released.
+ */
+result_t trn_sqfs_set_inode_cache_size(sqfs *fs, size_t inodes);
+
+/**
+ * @brief Get inode cache statistics for a squashfs filesystem
+ */
+void trn_sqfs_get_inode_cache_stats(sqfs *fs, trn_sqfs_inode_cache_stats_t *out);
+
+/**
+ * @brief Reset the inode cache statistics of a squashfs filesystem
+ */
+void trn_sqfs_reset_inode_cache_stats(sqfs *fs);
+
+#define TRN_SQFS_DEFAULT_LOOKUP_INDEX_BYTES (2 * 1024 * 1024)
+#define TRN_SQFS_DEFAULT_LOOKUP_INDEX_DIR_SIZE (8 * 1024)
+
+/**
+ * @brief squashfs lookup index statistics
+ */
+typedef struct {
+	uint64_t hits; ///< Lookups answered from an index
+	uint64_t misses; ///< Lookups that walked the directory
+	uint64_t builds; ///< Indexes built
+	uint64_t evictions; ///< Indexes dropped to make room for others
+	size_t directories; ///< Directories currently indexed
+	size_t bytes; ///< Memory used by the current indexes
+} trn_sqfs_lookup_index_stats_t;
+
+/**
+ * @brief Configure name lookup indexes for large squashfs directories
+ *
+ * Looking a name up in a squashfs directory walks its entries. The first time
+ * a name is looked up in a directory whose listing takes at least
+ * `min_dir_size` bytes in the image, the directory is walked once to build a
+ * hash index of its names, and later lookups in it don't touch the image.
+ * Indexes are dropped in least-recently-used order to stay within `max_bytes`.
+ * The defaults are \ref TRN_SQFS_DEFAULT_LOOKUP_INDEX_BYTES, and
+ * \ref TRN_SQFS_DEFAULT_LOOKUP_INDEX_DIR_SIZE, which is one metadata block:
+ * smaller directories are cheap to walk.
+ *
+ * @param fs Filesystem to configure
+ * @param max_bytes Memory to allow for all of the filesystem's indexes. Zero disables indexing.
+ * @param min_dir_size Smallest directory listing, in bytes, that is worth indexing
+ */
+result_t trn_sqfs_set_lookup_index(sqfs *fs, size_t max_bytes, size_t min_dir_size);
+
+/**
+ * @brief Get lookup index statistics for a squashfs filesystem
+ */
+void trn_sqfs_get_lookup_index_stats(sqfs *fs, trn_sqfs_lookup_index_stats_t *out);
+
+/**
+ * @brief Reset the lookup index statistics of a squashfs filesystem
+ */
+void trn_sqfs_reset_lookup_index_stats(sqfs *fs);
+
+#define TRN_SQFS_READAHEAD_MAX 16
+#define TRN_SQFS_DEFAULT_READAHEAD 4
+
+/**
+ * @brief squashfs read-ahead statistics
+ */
+typedef struct {
+	uint64_t issued; ///< Blocks queued for background decompression
+	uint64_t hits; ///< Blocks that were already decompressed when the reader got to them
+	uint64_t waits; ///< Blocks the reader had to wait for, or decompress itself
+	uint64_t discarded; ///< Blocks dropped because the reader seeked away or closed the file
+} trn_sqfs_readahead_stats_t;
+
+/**
+ * @brief Configure read-ahead for squashfs files
+ *
+ * When a squashfs file is read sequentially, up to `blocks` data blocks past
+ * the end of each read are decompressed on a worker thread, so that the reader
+ * can get on with processing what it has. The default is
+ * \ref TRN_SQFS_DEFAULT_READAHEAD blocks.
+ *
+ * @param blocks How many blocks to read ahead, up to \ref TRN_SQFS_READAHEAD_MAX. Zero disables read-ahead.
+ * @param worker_core Processor to run the worker thread on, or -2 for the default. This only has an effect before the worker is started, on the first sequential read.
+ */
+result_t trn_sqfs_set_readahead(size_t blocks, int32_t worker_core);
+
+/**
+ * @brief Get read-ahead statistics for all squashfs files
+ */
+void trn_sqfs_get_readahead_stats(trn_sqfs_readahead_stats_t *out);
+
+/**
+ * @brief Reset the squashfs read-ahead statistics
+ */
+void trn_sqfs_reset_readahead_stats();
+
 #ifdef __cplusplus
 }
 #endif
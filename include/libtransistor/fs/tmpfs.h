@@ -0,0 +1,61 @@
+/**
+ * @file libtransistor/fs/tmpfs.h
+ * @brief RAM-backed filesystem
+ *
+ * tmpfs keeps files and directories in memory, which makes it a good place for
+ * scratch files that don't need to survive the process: creating, writing and
+ * deleting them never leaves the process. File contents are stored in
+ * separately allocated pages, so growing a file never copies what's already
+ * there, and pages that were never written to don't take up any memory.
+ *
+ * A tmpfs doesn't get mounted by default. To get one at /tmp:
+ *
+ * ```
+ * trn_inode_t tmp;
+ * trn_tmpfs_create(&tmp, 16 * 1024 * 1024);
+ * trn_fs_mount("/tmp", tmp);
+ * ```
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include<libtransistor/types.h>
+#include<libtransistor/fs/inode.h>
+
+/**
+ * @brief Size of the pages file contents are stored in
+ */
+#define TRN_TMPFS_PAGE_SIZE 0x1000
+
+/**
+ * @brief Create an empty tmpfs
+ *
+ * File contents are limited to max_bytes, counted in whole pages. Writes that
+ * would need more than that fail with LIBTRANSISTOR_ERR_FS_NO_SPACE. Directory
+ * entries and file metadata don't count towards the limit.
+ *
+ * The filesystem is freed once its root and everything opened from it have
+ * been released.
+ *
+ * @param out Output for the root inode of the new filesystem. This function will initialize the trn_inode_t struct.
+ * @param max_bytes Limit on the memory used for file contents.
+ */
+result_t trn_tmpfs_create(trn_inode_t *out, size_t max_bytes);
+
+/**
+ * @brief Get the memory used for file contents
+ *
+ * Pages belonging to files that were removed while still open are counted
+ * until the files are closed.
+ *
+ * @param inode Any inode of the filesystem
+ */
+size_t trn_tmpfs_get_used_bytes(trn_inode_t *inode);
+
+#ifdef __cplusplus
+}
+#endif
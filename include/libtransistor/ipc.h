@@ -325,6 +325,39 @@ result_t ipc_send(ipc_object_t object, ipc_request_t *rq, ipc_response_fmt_t *rs
  */
 result_t ipc_send_multi(ipc_multi_session_t *multi, ipc_request_t *rq, ipc_response_fmt_t *rs);
 
+/**
+ * @brief Size of the buffer an asynchronous request is sent from, and its response lands in
+ */
+#define IPC_ASYNC_BUFFER_SIZE 0x1000
+
+/**
+ * @struct ipc_async_request_t
+ * @brief A request in flight on a session of a multi session
+ */
+typedef struct {
+	ipc_multi_session_node_t *node;
+	revent_h event;
+	uint32_t *buffer;
+} ipc_async_request_t;
+
+/**
+ * @brief Sends a request described by `rq` to `multi` without waiting for the response
+ *
+ * The request holds on to a session of its own until \ref ipc_wait_multi_async
+ * is called on it, so several can be in flight at once, and be worked on by
+ * the server at the same time.
+ *
+ * @param buffer Page aligned buffer of \ref IPC_ASYNC_BUFFER_SIZE bytes, which must stay untouched until the request has been waited on
+ */
+result_t ipc_send_multi_async(ipc_multi_session_t *multi, ipc_request_t *rq, uint32_t *buffer, ipc_async_request_t *request);
+
+/**
+ * @brief Waits for the response to a request sent with \ref ipc_send_multi_async, and unpacks it
+ *
+ * Must be called exactly once for every request that was sent.
+ */
+result_t ipc_wait_multi_async(ipc_async_request_t *request, ipc_response_fmt_t *rs);
+
 /**
 * @brief Converts `session` to a domain object and initializes `domain`.
 *  `domain` is only initialized if RESULT_OK is returned.
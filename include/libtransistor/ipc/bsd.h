@@ -11,14 +11,29 @@ extern "C" {
 
 #include<libtransistor/types.h>
 #include<libtransistor/loader_config.h>
+#include<libtransistor/fd.h>
+#include<libtransistor/ipc/bsd_config.h>
 #include<sys/types.h>
 #include<sys/socket.h>
 #include<netinet/in.h>
 #include<netdb.h>
 #include<poll.h>
 
-extern result_t bsd_result;
-extern int      bsd_errno;
+/**
+ * @brief Result of the calling thread's last failed bsd_* call
+ *
+ * Like errno, each thread has its own, so sockets can be used from several
+ * threads at once.
+ */
+#define bsd_result (*bsd_result_location())
+
+/**
+ * @brief errno from the calling thread's last failed bsd_* call, if bsd_result is LIBTRANSISTOR_ERR_BSD_ERRNO_SET
+ */
+#define bsd_errno (*bsd_errno_location())
+
+result_t *bsd_result_location();
+int *bsd_errno_location();
 
 struct addrinfo_fixed {
 	struct addrinfo ai;
@@ -29,6 +44,28 @@ struct addrinfo_fixed {
 result_t bsd_init();
 result_t bsd_init_ex(bool require_override, loader_config_socket_service_t service);
 
+/**
+ * @brief Initializes bsd with the given buffer configuration
+ *
+ * \ref bsd_init and \ref bsd_init_ex use \ref _trn_runconf_bsd_config and
+ * \ref _trn_runconf_bsd_transfer_mem_size. If bsd is already initialized,
+ * this only takes another reference, and config is only checked.
+ *
+ * @param transfer_mem_size Transfer memory to give bsd, a multiple of the page size, or zero for \ref bsd_config_transfer_mem_size
+ * @return LIBTRANSISTOR_ERR_INVALID_ARGUMENT if config doesn't make sense
+ */
+result_t bsd_init_config(bool require_override, loader_config_socket_service_t service, const bsd_config_t *config, size_t transfer_mem_size);
+
+/**
+ * @brief How much transfer memory config needs: all its buffers at their largest, page aligned, sb_efficiency times over
+ */
+size_t bsd_config_transfer_mem_size(const bsd_config_t *config);
+
+/**
+ * @brief The configuration bsd was initialized with
+ */
+const bsd_config_t *bsd_get_config();
+
 const char *bsd_get_socket_service_name();
 handle_t bsd_get_socket_service_handle();
 loader_config_socket_service_t bsd_get_socket_service();
@@ -42,16 +79,103 @@ int bsd_bind(int socket, const struct sockaddr *address, socklen_t address_len);
 int bsd_connect(int socket, const struct sockaddr *address, socklen_t address_len);
 int bsd_getsockname(int socket, struct sockaddr *address, socklen_t *address_len);
 int bsd_listen(int socket, int backlog);
+
+/**
+ * @brief bsd's O_NONBLOCK, which isn't newlib's
+ */
+#define BSD_O_NONBLOCK 0x800
+
+/**
+ * @brief Gets (F_GETFL) or sets (F_SETFL) a socket's flags, in bsd's encoding
+ */
+int bsd_fcntl(int socket, int cmd, int arg);
 int bsd_setsockopt(int socket, int level, int option_name, const void *option_value, socklen_t option_len);
 int bsd_shutdown(int socket, int how);
+/**
+ * @struct bsd_datagram_t
+ * @brief One datagram for \ref bsd_sendmmsg or \ref bsd_recvmmsg
+ */
+typedef struct {
+	void *buf;
+	size_t len;
+	struct sockaddr *addr; ///< Where to send it, or where to put where it came from, or NULL
+	socklen_t addr_len; ///< Size of addr, and of what was put there on receive
+	int result; ///< Bytes sent or received, or -1 if it wasn't
+	int error; ///< errno, if result is -1
+	result_t ipc_result; ///< What bsd_result would have been, if result is -1
+} bsd_datagram_t;
+
+/**
+ * @brief Sends a batch of datagrams
+ *
+ * Up to 8 go out at a time, each on its own session, so the round trips
+ * overlap instead of adding up, and datagrams may go out of order. Stops
+ * sending more after one fails, but the ones already on their way by then
+ * may still go out, so the entries that were sent are moved to the front,
+ * buffers and all, like \ref bsd_recvmmsg does. The rest are the ones to
+ * send again.
+ *
+ * @return How many were sent, or -1 if none were
+ */
+int bsd_sendmmsg(int socket, bsd_datagram_t *msgs, int count, int flags);
+
+/**
+ * @brief Receives a batch of datagrams
+ *
+ * Waits for the first one, as flags say, and then takes as many more as are
+ * already waiting, like Linux's recvmmsg with MSG_WAITFORONE. Datagrams are
+ * received side by side, so the entries that got one are moved to the front,
+ * buffers and all.
+ *
+ * @return How many were received, or -1 if none were
+ */
+int bsd_recvmmsg(int socket, bsd_datagram_t *msgs, int count, int flags);
+
 int bsd_select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *errorfds, struct timeval *timeout);
 int bsd_poll(struct pollfd *fds, int nfds, int timeout);
+
+/**
+ * @brief Resolves a name through sfdnsres, or the DNS cache
+ *
+ * Chains that come out of the cache are shared with every other caller that
+ * looked the same name up, so they mustn't be modified, only freed with
+ * \ref bsd_freeaddrinfo.
+ *
+ * @return 0, an EAI_* code if the name didn't resolve, or -1 if sfdnsres couldn't be asked
+ */
 int bsd_getaddrinfo(const char *node, const char *service, const struct addrinfo *hints, struct addrinfo **res);
 int bsd_getaddrinfo_fixed(const char *node, const char *service, const struct addrinfo *hints, struct addrinfo_fixed *res, int num_addrinfos);
 void bsd_freeaddrinfo(struct addrinfo *res);
+
+/**
+ * @brief Forgets every cached lookup
+ *
+ * Chains that are still in use stay valid until they're freed.
+ */
+void bsd_dns_cache_flush();
 int bsd_close(int socket);
 void bsd_finalize();
 
+/**
+ * @brief Wraps a bsd socket in a file descriptor, which owns it from then on
+ */
+int socket_from_bsd(int bsd_fd);
+
+/**
+ * @brief Returns the bsd socket behind a file, or -1 if it isn't a socket
+ */
+int socket_get_bsd(trn_file_t *file);
+
+/**
+ * @brief \ref bsd_sendmmsg on a socket file descriptor, setting errno
+ */
+int socket_sendmmsg(int fd, bsd_datagram_t *msgs, int count, int flags);
+
+/**
+ * @brief \ref bsd_recvmmsg on a socket file descriptor, setting errno
+ */
+int socket_recvmmsg(int fd, bsd_datagram_t *msgs, int count, int flags);
+
 result_t bsd_ai_pack(const struct addrinfo *ai, uint8_t *buf, size_t size);
 result_t bsd_ai_unpack(struct addrinfo *ai, const uint8_t *buf, size_t size, int limit);
 
@@ -0,0 +1,75 @@
+/**
+ * @file libtransistor/ipc/bsd_config.h
+ * @brief Configuration for BSD Sockets
+ *
+ * Kept apart from libtransistor/ipc/bsd.h so that
+ * libtransistor/runtime_config.h can use it on its own.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include<stdint.h>
+
+/**
+ * @brief Socket buffer configuration, handed to bsd when it's initialized
+ *
+ * Sizes are in bytes. TCP buffers start out at `tcp_*_buf_size`, and are
+ * grown automatically up to `tcp_*_buf_max_size`, or kept as they are if
+ * that's zero. Bigger TCP buffers mean bigger windows, and more throughput
+ * for bulk transfers, at the cost of more transfer memory.
+ */
+typedef struct {
+	uint32_t version; ///< Must be 1
+	uint32_t tcp_tx_buf_size;
+	uint32_t tcp_rx_buf_size;
+	uint32_t tcp_tx_buf_max_size;
+	uint32_t tcp_rx_buf_max_size;
+	uint32_t udp_tx_buf_size;
+	uint32_t udp_rx_buf_size;
+	uint32_t sb_efficiency; ///< How many of each buffer the transfer memory has room for, 1 to 8
+} bsd_config_t;
+
+/**
+ * @brief The configuration bsd has always been initialized with
+ */
+#define BSD_CONFIG_DEFAULT { \
+		.version = 1, \
+		.tcp_tx_buf_size = 0x8000, \
+		.tcp_rx_buf_size = 0x10000, \
+		.tcp_tx_buf_max_size = 0x40000, \
+		.tcp_rx_buf_max_size = 0x40000, \
+		.udp_tx_buf_size = 0x2400, \
+		.udp_rx_buf_size = 0xA500, \
+		.sb_efficiency = 4, \
+	}
+
+/**
+ * @brief DNS cache configuration, taken when bsd is first initialized
+ *
+ * Lookups are kept in one arena of `entries` slots of `entry_size` bytes,
+ * each holding a lookup's name, service, hints and addrinfo chain; lookups
+ * that don't fit in a slot aren't cached. Names that didn't resolve are
+ * remembered for `negative_ttl_ms`. sfdnsres doesn't say how long records
+ * live for, so these TTLs apply to every lookup.
+ */
+typedef struct {
+	uint32_t entries; ///< Zero turns the cache off
+	uint32_t entry_size;
+	uint32_t ttl_ms; ///< Zero doesn't cache lookups that worked
+	uint32_t negative_ttl_ms; ///< Zero doesn't cache lookups that didn't
+} bsd_dns_cache_config_t;
+
+#define BSD_DNS_CACHE_CONFIG_DEFAULT { \
+		.entries = 16, \
+		.entry_size = 0x200, \
+		.ttl_ms = 60000, \
+		.negative_ttl_ms = 10000, \
+	}
+
+#ifdef __cplusplus
+}
+#endif
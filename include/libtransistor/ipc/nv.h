@@ -11,8 +11,20 @@ extern "C" {
 
 #include<libtransistor/types.h>
 
-extern result_t nv_result;
-extern int nv_errno;
+/**
+ * @brief Result of the calling thread's last failed nv_* call
+ *
+ * Like errno, each thread has its own.
+ */
+#define nv_result (*nv_result_location())
+
+/**
+ * @brief Error code from the calling thread's last failed nv_* call
+ */
+#define nv_errno (*nv_errno_location())
+
+result_t *nv_result_location();
+int *nv_errno_location();
 
 /**
 * @brief Initialize NV service
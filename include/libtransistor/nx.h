@@ -65,6 +65,7 @@ extern "C" {
 #include<libtransistor/hid.h>
 #include<libtransistor/audio.h>
 #include<libtransistor/waiter.h>
+#include<libtransistor/aio.h>
 #include<libtransistor/ipcserver.h>
 #include<libtransistor/usb_serial.h>
 #include<libtransistor/ipcserver.h>
@@ -14,6 +14,8 @@ extern "C" {
 #endif
 
 #include<libtransistor/types.h>
+#include<libtransistor/ipc/bsd_config.h>
+#include<libtransistor/buffered_fd.h>
 
 typedef enum {
 	_TRN_RUNCONF_STDIO_OVERRIDE_NONE, ///< Determine stdout via HBABI
@@ -26,6 +28,14 @@ extern runconf_stdio_override_t _trn_runconf_stdio_override;
 extern const char *_trn_runconf_stdio_override_sockets_host;
 extern const char *_trn_runconf_stdio_override_sockets_port;
 
+/**
+ * @brief Buffering for stdio that goes over sockets, twili or usb_serial
+ *
+ * See \ref trn_buffered_fd_create. A buffer_size of zero, the default, leaves
+ * stdio unbuffered; \ref TRN_BUFFERED_FD_CONFIG_DEFAULT suits chatty logging.
+ */
+extern trn_buffered_fd_config_t _trn_runconf_stdio_buffering;
+
 typedef enum {
 	_TRN_RUNCONF_HEAP_MODE_DEFAULT, ///< Use heap from HBABI, or default to HEAP_MODE_NORMAL.
 	_TRN_RUNCONF_HEAP_MODE_NORMAL, ///< Force using svcSetHeapSize, even if HBABI specifies otherwise.
@@ -43,6 +53,53 @@ typedef enum {
 
 extern runconf_target_version_inference_t _trn_runconf_target_version_inference;
 
+/**
+ * @brief Block cache sizes for the embedded squashfs image
+ *
+ * See \ref trn_sqfs_set_cache_size. These are applied when the image is
+ * mounted at startup.
+ */
+extern size_t _trn_runconf_squashfs_md_cache_blocks;
+extern size_t _trn_runconf_squashfs_data_cache_blocks;
+extern size_t _trn_runconf_squashfs_frag_cache_blocks;
+
+/**
+ * @brief Unused inodes to keep decoded for the embedded squashfs image
+ *
+ * See \ref trn_sqfs_set_inode_cache_size.
+ */
+extern size_t _trn_runconf_squashfs_inode_cache_size;
+
+/**
+ * @brief Memory for name lookup indexes on the embedded squashfs image
+ *
+ * See \ref trn_sqfs_set_lookup_index. Zero disables the indexes.
+ */
+extern size_t _trn_runconf_squashfs_lookup_index_bytes;
+
+/**
+ * @brief Socket buffer configuration for bsd
+ *
+ * See \ref bsd_config_t. Defaults to \ref BSD_CONFIG_DEFAULT.
+ */
+extern bsd_config_t _trn_runconf_bsd_config;
+
+/**
+ * @brief Transfer memory to give bsd
+ *
+ * Zero, the default, sizes it for \ref _trn_runconf_bsd_config, with
+ * \ref bsd_config_transfer_mem_size. For \ref BSD_CONFIG_DEFAULT that comes
+ * to 0x234000 bytes, a little more than the fixed 0x200000 bsd used to get.
+ */
+extern size_t _trn_runconf_bsd_transfer_mem_size;
+
+/**
+ * @brief DNS cache in front of \ref bsd_getaddrinfo
+ *
+ * See \ref bsd_dns_cache_config_t. Defaults to \ref BSD_DNS_CACHE_CONFIG_DEFAULT.
+ */
+extern bsd_dns_cache_config_t _trn_runconf_bsd_dns_cache_config;
+
 #ifdef __cplusplus
 }
 #endif
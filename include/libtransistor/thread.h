@@ -21,6 +21,12 @@ typedef struct {
 	void *arg;
 	struct _reent reent;
 	void *pthread;
+
+	// what bsd_result, bsd_errno, nv_result and nv_errno are for this thread
+	result_t bsd_last_result;
+	int bsd_last_errno;
+	result_t nv_last_result;
+	int nv_last_errno;
 } trn_thread_t;
 
 /**
@@ -0,0 +1,356 @@
+#include<libtransistor/aio.h>
+
+#include<libtransistor/types.h>
+#include<libtransistor/err.h>
+#include<libtransistor/fd.h>
+#include<libtransistor/mutex.h>
+#include<libtransistor/condvar.h>
+#include<libtransistor/thread.h>
+#include<libtransistor/waiter.h>
+
+#include<stdlib.h>
+#include<string.h>
+#include<unistd.h>
+
+// most requests a worker will merge into one read
+#define AIO_MAX_BATCH_REQUESTS 64
+#define AIO_WORKER_STACK_SIZE 0x10000
+
+/*
+ * Requests wait in a FIFO queue for one of the workers. A worker takes the
+ * request at the head, along with any queued reads of the same file that
+ * extend it on either side, does them in one backend call, and moves them all
+ * to the done list. It then signals the waiter, whose thread runs the
+ * callbacks for everything on the done list.
+ *
+ * Workers may run requests for the same file at the same time, which is fine
+ * since pread and pwrite may run concurrently with anything.
+ *
+ * Files are referenced from submission until just before their callback runs,
+ * so closing an fd with requests in flight is safe.
+ */
+
+struct trn_aio_t {
+	trn_mutex_t lock;
+	trn_condvar_t work_cond;
+	waiter_t *waiter;
+	wait_record_t *record;
+
+	trn_aio_request_t *queue_head GUARDED_BY(lock);
+	trn_aio_request_t *queue_tail GUARDED_BY(lock);
+	trn_aio_request_t *done_head GUARDED_BY(lock);
+	trn_aio_request_t *done_tail GUARDED_BY(lock);
+	trn_aio_stats_t stats GUARDED_BY(lock);
+
+	bool started GUARDED_BY(lock);
+	bool stopping GUARDED_BY(lock);
+	int max_workers;
+	int num_workers GUARDED_BY(lock);
+	trn_thread_t *workers;
+};
+
+static int compare_offsets(const void *va, const void *vb) {
+	const trn_aio_request_t *a = *(const trn_aio_request_t**) va;
+	const trn_aio_request_t *b = *(const trn_aio_request_t**) vb;
+	return (a->offset > b->offset) - (a->offset < b->offset);
+}
+
+// Takes the request at the head of the queue. If it's a read, queued reads of
+// the same file that continue it in either direction are taken too, until the
+// merged read would get too big.
+static size_t aio_take(trn_aio_t *aio, trn_aio_request_t **batch) REQUIRES(aio->lock) {
+	trn_aio_request_t *head = aio->queue_head;
+	aio->queue_head = head->next;
+	if(aio->queue_head == NULL) {
+		aio->queue_tail = NULL;
+	}
+	batch[0] = head;
+	if(head->opcode != TRN_AIO_READ || head->file->ops->pread == NULL) {
+		return 1;
+	}
+
+	size_t count = 1;
+	off_t start = head->offset;
+	off_t end = head->offset + head->size;
+	bool grew = true;
+	while(grew && count < AIO_MAX_BATCH_REQUESTS) {
+		grew = false;
+		trn_aio_request_t **link = &aio->queue_head;
+		trn_aio_request_t *prev = NULL;
+		while(*link != NULL && count < AIO_MAX_BATCH_REQUESTS) {
+			trn_aio_request_t *req = *link;
+			bool adjacent = req->offset + (off_t) req->size == start || req->offset == end;
+			if(req->file == head->file && req->opcode == TRN_AIO_READ && adjacent &&
+			   (size_t) (end - start) + req->size <= TRN_AIO_MAX_BATCH_SIZE) {
+				*link = req->next;
+				if(aio->queue_tail == req) {
+					aio->queue_tail = prev;
+				}
+				if(req->offset == end) {
+					end += req->size;
+				} else {
+					start = req->offset;
+				}
+				batch[count++] = req;
+				grew = true;
+			} else {
+				prev = req;
+				link = &req->next;
+			}
+		}
+	}
+	return count;
+}
+
+// Does a single request. Files without positional I/O get it emulated the
+// same way pread and pwrite do, by saving and restoring the head.
+static void aio_run_one(trn_aio_request_t *req) {
+	trn_file_ops_t *ops = req->file->ops;
+	void *data = req->file->data;
+	off_t pos, ignored;
+	result_t r;
+
+	req->transferred = 0;
+	if(req->opcode == TRN_AIO_READ && ops->pread != NULL) {
+		r = ops->pread(data, req->buf, req->size, req->offset, &req->transferred);
+	} else if(req->opcode == TRN_AIO_WRITE && ops->pwrite != NULL) {
+		r = ops->pwrite(data, req->buf, req->size, req->offset, &req->transferred);
+	} else if(ops->seek != NULL && (req->opcode == TRN_AIO_READ ? ops->read != NULL : ops->write != NULL)) {
+		if((r = ops->seek(data, 0, SEEK_CUR, &pos)) == RESULT_OK &&
+		   (r = ops->seek(data, req->offset, SEEK_SET, &ignored)) == RESULT_OK) {
+			if(req->opcode == TRN_AIO_READ) {
+				r = ops->read(data, req->buf, req->size, &req->transferred);
+			} else {
+				r = ops->write(data, req->buf, req->size, &req->transferred);
+			}
+			ops->seek(data, pos, SEEK_SET, &ignored);
+		}
+	} else {
+		r = LIBTRANSISTOR_ERR_UNIMPLEMENTED;
+	}
+	req->result = r;
+}
+
+// Does a batch from aio_take, returning how many backend calls it took.
+static size_t aio_run(trn_aio_request_t **batch, size_t count) {
+	if(count == 1) {
+		aio_run_one(batch[0]);
+		return 1;
+	}
+
+	qsort(batch, count, sizeof(*batch), compare_offsets);
+	off_t start = batch[0]->offset;
+	size_t total = 0;
+	bool contiguous = true;
+	for(size_t i = 0; i < count; i++) {
+		if(i > 0 && (uint8_t*) batch[i]->buf != (uint8_t*) batch[i - 1]->buf + batch[i - 1]->size) {
+			contiguous = false;
+		}
+		total += batch[i]->size;
+	}
+
+	// buffers that sit back to back in memory can be read into directly
+	uint8_t *dst = contiguous ? batch[0]->buf : malloc(total);
+	if(dst == NULL) {
+		for(size_t i = 0; i < count; i++) {
+			aio_run_one(batch[i]);
+		}
+		return count;
+	}
+
+	trn_file_t *file = batch[0]->file;
+	size_t got = 0;
+	result_t r = file->ops->pread(file->data, dst, total, start, &got);
+	for(size_t i = 0; i < count; i++) {
+		trn_aio_request_t *req = batch[i];
+		size_t skip = req->offset - start;
+		req->result = r;
+		req->transferred = 0;
+		if(r == RESULT_OK && got > skip) {
+			req->transferred = got - skip < req->size ? got - skip : req->size;
+			if(!contiguous) {
+				memcpy(req->buf, dst + skip, req->transferred);
+			}
+		}
+	}
+	if(!contiguous) {
+		free(dst);
+	}
+	return 1;
+}
+
+static void aio_worker(void *arg) {
+	trn_aio_t *aio = arg;
+	trn_aio_request_t *batch[AIO_MAX_BATCH_REQUESTS];
+
+	trn_mutex_lock(&aio->lock);
+	while(true) {
+		while(aio->queue_head == NULL && !aio->stopping) {
+			trn_condvar_wait(&aio->work_cond, &aio->lock, -1);
+		}
+		if(aio->queue_head == NULL) {
+			break;
+		}
+		size_t count = aio_take(aio, batch);
+		trn_mutex_unlock(&aio->lock);
+
+		size_t calls = aio_run(batch, count);
+
+		trn_mutex_lock(&aio->lock);
+		aio->stats.backend_calls += calls;
+		if(calls == 1) {
+			aio->stats.merged += count - 1;
+		}
+		for(size_t i = 0; i < count; i++) {
+			batch[i]->next = NULL;
+			if(aio->done_tail != NULL) {
+				aio->done_tail->next = batch[i];
+			} else {
+				aio->done_head = batch[i];
+			}
+			aio->done_tail = batch[i];
+		}
+		trn_mutex_unlock(&aio->lock);
+
+		waiter_signal(aio->waiter, aio->record);
+
+		trn_mutex_lock(&aio->lock);
+	}
+	trn_mutex_unlock(&aio->lock);
+}
+
+static bool aio_workers_start(trn_aio_t *aio) REQUIRES(aio->lock) {
+	if(!aio->started) {
+		aio->started = true;
+		for(int i = 0; i < aio->max_workers; i++) {
+			trn_thread_t *thread = &aio->workers[aio->num_workers];
+			if(trn_thread_create(thread, aio_worker, aio, -1, -2, AIO_WORKER_STACK_SIZE, NULL) != RESULT_OK) {
+				break;
+			}
+			if(trn_thread_start(thread) != RESULT_OK) {
+				trn_thread_destroy(thread);
+				break;
+			}
+			aio->num_workers++;
+		}
+	}
+	return aio->num_workers > 0;
+}
+
+// Runs the callbacks of everything that's finished, in the order it finished.
+static void aio_deliver(trn_aio_t *aio) {
+	trn_mutex_lock(&aio->lock);
+	trn_aio_request_t *req = aio->done_head;
+	aio->done_head = NULL;
+	aio->done_tail = NULL;
+	trn_mutex_unlock(&aio->lock);
+
+	uint64_t count = 0;
+	while(req != NULL) {
+		// the callback is free to resubmit the request
+		trn_aio_request_t *next = req->next;
+		fd_file_put(req->file);
+		req->file = NULL;
+		if(req->callback != NULL) {
+			req->callback(req, req->data);
+		}
+		count++;
+		req = next;
+	}
+
+	trn_mutex_lock(&aio->lock);
+	aio->stats.completed += count;
+	trn_mutex_unlock(&aio->lock);
+}
+
+static bool aio_signalled(void *data) {
+	trn_aio_t *aio = data;
+	// reset before looking at the done list, so that nothing added after
+	// we've looked goes unnoticed
+	waiter_reset_signal(aio->waiter, aio->record);
+	aio_deliver(aio);
+	return true;
+}
+
+result_t trn_aio_create(trn_aio_t **out, waiter_t *waiter, int workers) {
+	if(workers < 1) {
+		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+	}
+
+	trn_aio_t *aio = calloc(1, sizeof(*aio));
+	if(aio == NULL) {
+		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+	}
+	aio->workers = calloc(workers, sizeof(*aio->workers));
+	if(aio->workers == NULL) {
+		free(aio);
+		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+	}
+	trn_mutex_create(&aio->lock);
+	trn_condvar_create(&aio->work_cond);
+	aio->waiter = waiter;
+	aio->max_workers = workers;
+	aio->record = waiter_add_signal(waiter, aio_signalled, aio);
+	if(aio->record == NULL) {
+		free(aio->workers);
+		free(aio);
+		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+	}
+
+	*out = aio;
+	return RESULT_OK;
+}
+
+result_t trn_aio_submit(trn_aio_t *aio, trn_aio_request_t *request) {
+	trn_file_t *file = fd_file_get(request->fd);
+	if(file == NULL) {
+		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+	}
+
+	trn_mutex_lock(&aio->lock);
+	if(!aio_workers_start(aio)) {
+		trn_mutex_unlock(&aio->lock);
+		fd_file_put(file);
+		return LIBTRANSISTOR_ERR_UNSPECIFIED;
+	}
+	request->file = file;
+	request->next = NULL;
+	request->result = RESULT_OK;
+	request->transferred = 0;
+	if(aio->queue_tail != NULL) {
+		aio->queue_tail->next = request;
+	} else {
+		aio->queue_head = request;
+	}
+	aio->queue_tail = request;
+	aio->stats.submitted++;
+	trn_condvar_signal(&aio->work_cond, 1);
+	trn_mutex_unlock(&aio->lock);
+	return RESULT_OK;
+}
+
+void trn_aio_get_stats(trn_aio_t *aio, trn_aio_stats_t *stats) {
+	trn_mutex_lock(&aio->lock);
+	*stats = aio->stats;
+	trn_mutex_unlock(&aio->lock);
+}
+
+void trn_aio_destroy(trn_aio_t *aio) {
+	trn_mutex_lock(&aio->lock);
+	aio->stopping = true;
+	trn_condvar_signal(&aio->work_cond, -1);
+	int num_workers = aio->num_workers;
+	trn_mutex_unlock(&aio->lock);
+
+	// workers only exit once the queue is empty
+	for(int i = 0; i < num_workers; i++) {
+		trn_thread_join(&aio->workers[i], -1);
+		trn_thread_destroy(&aio->workers[i]);
+	}
+	waiter_cancel(aio->waiter, aio->record);
+	aio_deliver(aio);
+
+	trn_condvar_destroy(&aio->work_cond);
+	free(aio->workers);
+	free(aio);
+}
@@ -0,0 +1,458 @@
+#include<libtransistor/buffered_fd.h>
+
+#include<libtransistor/types.h>
+#include<libtransistor/svc.h>
+#include<libtransistor/err.h>
+#include<libtransistor/fd.h>
+#include<libtransistor/mutex.h>
+#include<libtransistor/condvar.h>
+#include<libtransistor/thread.h>
+#include<libtransistor/util.h>
+#include<libtransistor/waiter.h>
+#include<libtransistor/ipc/bsd.h>
+
+#include<errno.h>
+#include<poll.h>
+#include<stdlib.h>
+#include<string.h>
+
+#define BUFFERED_FLUSHER_STACK_SIZE 0x10000
+
+/*
+ * Every buffered file is on one list, which a single flusher thread goes over
+ * whenever one of them might be due. In between, it sleeps in waiter_wait
+ * until the earliest deadline, or until a writer signals its event because a
+ * file now has an earlier one than that, which happens about once per burst
+ * of output. The flusher runs for as long as there are buffered files.
+ *
+ * Writing out can block for a while, so the flusher does it without list_lock,
+ * which every writer needs to wake it. Files it's writing out are pinned, and
+ * closing one waits for that to be done before freeing it.
+ *
+ * Locks are taken in the order flusher_lock, list_lock, then a file's lock.
+ */
+
+typedef struct buffered_file_t buffered_file_t;
+struct buffered_file_t {
+	trn_mutex_t lock;
+	trn_file_t *file;
+	trn_buffered_fd_config_t config;
+
+	uint8_t *buffer GUARDED_BY(lock);
+	size_t length GUARDED_BY(lock);
+	uint64_t first_write GUARDED_BY(lock); // in ticks, of what's in the buffer
+	uint64_t last_write GUARDED_BY(lock);
+	bool ends_line GUARDED_BY(lock);
+	result_t error GUARDED_BY(lock); // from writing out in the background, for the next write to report
+
+	buffered_file_t *prev;
+	buffered_file_t *next;
+	int pins GUARDED_BY(list_lock);
+	buffered_file_t *flush_next; // in the flusher's list of pinned files to write out
+};
+
+static trn_mutex_t flusher_lock = TRN_MUTEX_STATIC_INITIALIZER;
+static bool flusher_running GUARDED_BY(flusher_lock);
+static trn_thread_t flusher_thread;
+static waiter_t *flusher_waiter;
+static wait_record_t *flusher_record;
+static wevent_h flusher_wevent;
+static revent_h flusher_revent;
+
+static trn_mutex_t list_lock = TRN_MUTEX_STATIC_INITIALIZER;
+static buffered_file_t *files GUARDED_BY(list_lock);
+static uint64_t flusher_wake_at GUARDED_BY(list_lock); // UINT64_MAX while nothing is due
+static bool flusher_stopping GUARDED_BY(list_lock);
+static trn_condvar_t unpinned_cond = TRN_CONDVAR_STATIC_INITIALIZER;
+
+static uint64_t us_to_ticks(uint32_t us) {
+	return (uint64_t) us * 192 / 10;
+}
+
+// When what's in the buffer should be written out, or UINT64_MAX if it's empty.
+static uint64_t buffered_due(buffered_file_t *f) REQUIRES(f->lock) {
+	if(f->length == 0) {
+		return UINT64_MAX;
+	}
+	uint64_t due = f->first_write + us_to_ticks(f->config.max_delay_us);
+	if(f->ends_line) {
+		uint64_t idle = f->last_write + us_to_ticks(f->config.newline_idle_us);
+		if(idle < due) {
+			due = idle;
+		}
+	}
+	return due;
+}
+
+static result_t buffered_write_through(buffered_file_t *f, const void *buf, size_t size) {
+	while(size > 0) {
+		size_t written = 0;
+		result_t r = f->file->ops->write(f->file->data, buf, size, &written);
+		if(r != RESULT_OK) {
+			return r;
+		}
+		if(written == 0) {
+			return LIBTRANSISTOR_ERR_UNSPECIFIED;
+		}
+		buf = (const uint8_t*) buf + written;
+		size-= written;
+	}
+	return RESULT_OK;
+}
+
+// Writes the buffer out. It's emptied even if that fails, since trying the
+// same stream again would most likely fail again. Returns the first error
+// that hasn't been reported yet.
+static result_t buffered_flush_locked(buffered_file_t *f) REQUIRES(f->lock) {
+	result_t r = f->error;
+	f->error = RESULT_OK;
+	if(f->length > 0) {
+		result_t wr = buffered_write_through(f, f->buffer, f->length);
+		f->length = 0;
+		if(r == RESULT_OK) {
+			r = wr;
+		}
+	}
+	return r;
+}
+
+static void flusher_pin(buffered_file_t *f, buffered_file_t **list) REQUIRES(list_lock) {
+	f->pins++;
+	f->flush_next = *list;
+	*list = f;
+}
+
+// Writes out and unpins each file on list.
+static void flusher_flush_pinned(buffered_file_t *list) EXCLUDES(list_lock) {
+	while(list != NULL) {
+		buffered_file_t *f = list;
+		list = f->flush_next;
+
+		trn_mutex_lock(&f->lock);
+		f->error = buffered_flush_locked(f);
+		trn_mutex_unlock(&f->lock);
+
+		trn_mutex_lock(&list_lock);
+		if(--f->pins == 0) {
+			trn_condvar_signal(&unpinned_cond, -1);
+		}
+		trn_mutex_unlock(&list_lock);
+	}
+}
+
+static bool flusher_signalled(void *data, handle_t handle) {
+	svcClearEvent(flusher_revent);
+	return true;
+}
+
+static void flusher_main(void *arg) {
+	trn_mutex_lock(&list_lock);
+	while(!flusher_stopping) {
+		uint64_t now = svcGetSystemTick();
+		uint64_t wake_at = UINT64_MAX;
+		buffered_file_t *due_files = NULL;
+		for(buffered_file_t *f = files; f != NULL; f = f->next) {
+			trn_mutex_lock(&f->lock);
+			uint64_t due = buffered_due(f);
+			trn_mutex_unlock(&f->lock);
+			if(due <= now) {
+				flusher_pin(f, &due_files);
+			} else if(due < wake_at) {
+				wake_at = due;
+			}
+		}
+		flusher_wake_at = wake_at;
+		trn_mutex_unlock(&list_lock);
+		flusher_flush_pinned(due_files);
+
+		uint64_t timeout = UINT64_MAX;
+		if(wake_at != UINT64_MAX) {
+			now = svcGetSystemTick();
+			timeout = wake_at > now ? (wake_at - now) * 10000 / 192 : 0;
+		}
+		waiter_wait(flusher_waiter, timeout);
+		trn_mutex_lock(&list_lock);
+	}
+	trn_mutex_unlock(&list_lock);
+}
+
+static result_t flusher_start() REQUIRES(flusher_lock) {
+	result_t r;
+
+	if(flusher_running) {
+		return RESULT_OK;
+	}
+	if((flusher_waiter = waiter_create()) == NULL) {
+		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+	}
+	if((r = svcCreateEvent(&flusher_wevent, &flusher_revent)) != RESULT_OK) {
+		goto fail_waiter;
+	}
+	if((flusher_record = waiter_add(flusher_waiter, flusher_revent, flusher_signalled, NULL)) == NULL) {
+		r = LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+		goto fail_event;
+	}
+	trn_mutex_lock(&list_lock);
+	flusher_stopping = false;
+	flusher_wake_at = UINT64_MAX;
+	trn_mutex_unlock(&list_lock);
+	if((r = trn_thread_create(&flusher_thread, flusher_main, NULL, -1, -2, BUFFERED_FLUSHER_STACK_SIZE, NULL)) != RESULT_OK) {
+		goto fail_record;
+	}
+	if((r = trn_thread_start(&flusher_thread)) != RESULT_OK) {
+		goto fail_thread;
+	}
+	flusher_running = true;
+	return RESULT_OK;
+
+fail_thread:
+	trn_thread_destroy(&flusher_thread);
+fail_record:
+	waiter_cancel(flusher_waiter, flusher_record);
+fail_event:
+	svcCloseHandle(flusher_wevent);
+	svcCloseHandle(flusher_revent);
+fail_waiter:
+	waiter_destroy(flusher_waiter);
+	return r;
+}
+
+static void flusher_stop() REQUIRES(flusher_lock) {
+	trn_mutex_lock(&list_lock);
+	flusher_stopping = true;
+	trn_mutex_unlock(&list_lock);
+	svcSignalEvent(flusher_wevent);
+	trn_thread_join(&flusher_thread, -1);
+	trn_thread_destroy(&flusher_thread);
+
+	waiter_cancel(flusher_waiter, flusher_record);
+	waiter_destroy(flusher_waiter);
+	svcCloseHandle(flusher_wevent);
+	svcCloseHandle(flusher_revent);
+	flusher_running = false;
+}
+
+// Makes sure the flusher looks at the buffers again by due.
+static void flusher_wake(uint64_t due) {
+	trn_mutex_lock(&list_lock);
+	if(due < flusher_wake_at) {
+		flusher_wake_at = due;
+		svcSignalEvent(flusher_wevent);
+	}
+	trn_mutex_unlock(&list_lock);
+}
+
+static result_t buffered_write(void *data, const void *buf, size_t size, size_t *bytes_written) {
+	buffered_file_t *f = data;
+	uint64_t due = UINT64_MAX;
+	result_t r;
+
+	trn_mutex_lock(&f->lock);
+	if((r = f->error) != RESULT_OK) {
+		f->error = RESULT_OK;
+		goto done;
+	}
+	if(size == 0) {
+		goto done;
+	}
+	if(f->length + size > f->config.buffer_size && (r = buffered_flush_locked(f)) != RESULT_OK) {
+		goto done;
+	}
+	if(size >= f->config.buffer_size) {
+		r = buffered_write_through(f, buf, size);
+		goto done;
+	}
+
+	uint64_t now = svcGetSystemTick();
+	if(f->length == 0) {
+		f->first_write = now;
+	}
+	memcpy(f->buffer + f->length, buf, size);
+	f->length+= size;
+	f->last_write = now;
+	f->ends_line = ((const char*) buf)[size - 1] == '\n';
+	if(f->length == f->config.buffer_size) {
+		r = buffered_flush_locked(f);
+	} else {
+		due = buffered_due(f);
+	}
+
+done:
+	trn_mutex_unlock(&f->lock);
+	if(r != RESULT_OK) {
+		return r;
+	}
+	if(due != UINT64_MAX) {
+		flusher_wake(due);
+	}
+	*bytes_written = size;
+	return RESULT_OK;
+}
+
+static result_t buffered_flush(void *data) {
+	buffered_file_t *f = data;
+
+	trn_mutex_lock(&f->lock);
+	result_t r = buffered_flush_locked(f);
+	trn_mutex_unlock(&f->lock);
+	if(r == RESULT_OK && f->file->ops->flush != NULL) {
+		r = f->file->ops->flush(f->file->data);
+	}
+	return r;
+}
+
+// Whatever was written should be out before waiting for an answer to it.
+static result_t buffered_read(void *data, void *buf, size_t size, size_t *bytes_read) {
+	buffered_file_t *f = data;
+
+	if(f->file->ops->read == NULL) {
+		return LIBTRANSISTOR_ERR_UNIMPLEMENTED;
+	}
+	trn_mutex_lock(&f->lock);
+	result_t r = buffered_flush_locked(f);
+	trn_mutex_unlock(&f->lock);
+	if(r != RESULT_OK) {
+		return r;
+	}
+	return f->file->ops->read(f->file->data, buf, size, bytes_read);
+}
+
+static result_t buffered_poll(void *data, short events, short *revents, handle_t *handle) {
+	buffered_file_t *f = data;
+
+	int bsd_fd = socket_get_bsd(f->file);
+	if(bsd_fd >= 0) {
+		struct pollfd pfd = {.fd = bsd_fd, .events = events};
+		if(bsd_poll(&pfd, 1, 0) < 0) {
+			return bsd_result;
+		}
+		*revents = pfd.revents;
+		return RESULT_OK;
+	}
+	if(f->file->ops->poll != NULL) {
+		return f->file->ops->poll(f->file->data, events, revents, handle);
+	}
+	*revents = events & (POLLIN | POLLOUT);
+	return RESULT_OK;
+}
+
+static result_t buffered_fcntl(void *data, int cmd, int arg, int *out) {
+	buffered_file_t *f = data;
+
+	if(f->file->ops->fcntl != NULL) {
+		return f->file->ops->fcntl(f->file->data, cmd, arg, out);
+	}
+	*out = 0;
+	return RESULT_OK;
+}
+
+static void buffered_destroy(buffered_file_t *f) {
+	trn_mutex_lock(&flusher_lock);
+	trn_mutex_lock(&list_lock);
+	if(f->prev != NULL) {
+		f->prev->next = f->next;
+	} else {
+		files = f->next;
+	}
+	if(f->next != NULL) {
+		f->next->prev = f->prev;
+	}
+	bool last = files == NULL;
+	while(f->pins > 0) {
+		trn_condvar_wait(&unpinned_cond, &list_lock, -1);
+	}
+	trn_mutex_unlock(&list_lock);
+	if(last) {
+		flusher_stop();
+	}
+	trn_mutex_unlock(&flusher_lock);
+
+	trn_mutex_lock(&f->lock);
+	buffered_flush_locked(f);
+	trn_mutex_unlock(&f->lock);
+	fd_file_put(f->file);
+	free(f->buffer);
+	free(f);
+}
+
+static result_t buffered_release(trn_file_t *file) {
+	buffered_destroy(file->data);
+	return RESULT_OK;
+}
+
+static trn_file_ops_t buffered_fops = {
+	.read = buffered_read,
+	.write = buffered_write,
+	.flush = buffered_flush,
+	.release = buffered_release,
+	.poll = buffered_poll,
+	.fcntl = buffered_fcntl,
+};
+
+int trn_buffered_fd_create(int fd, const trn_buffered_fd_config_t *config) {
+	buffered_file_t *f;
+	result_t r;
+	int ret;
+
+	if(config->buffer_size == 0) {
+		return -EINVAL;
+	}
+	trn_file_t *file = fd_file_get(fd);
+	if(file == NULL) {
+		return -EBADF;
+	}
+	if(file->ops->write == NULL) {
+		ret = -EINVAL;
+		goto fail_file;
+	}
+	if((f = malloc(sizeof(*f))) == NULL) {
+		ret = -ENOMEM;
+		goto fail_file;
+	}
+	memset(f, 0, sizeof(*f));
+	if((f->buffer = malloc(config->buffer_size)) == NULL) {
+		ret = -ENOMEM;
+		goto fail_alloc;
+	}
+	trn_mutex_create(&f->lock);
+	f->file = file;
+	f->config = *config;
+
+	trn_mutex_lock(&flusher_lock);
+	if((r = flusher_start()) != RESULT_OK) {
+		trn_mutex_unlock(&flusher_lock);
+		ret = -trn_result_to_errno(r);
+		goto fail_buffer;
+	}
+	trn_mutex_lock(&list_lock);
+	f->next = files;
+	if(files != NULL) {
+		files->prev = f;
+	}
+	files = f;
+	trn_mutex_unlock(&list_lock);
+	trn_mutex_unlock(&flusher_lock);
+
+	if((ret = fd_create_file(&buffered_fops, f)) < 0) {
+		buffered_destroy(f);
+	}
+	return ret;
+
+fail_buffer:
+	free(f->buffer);
+fail_alloc:
+	free(f);
+fail_file:
+	fd_file_put(file);
+	return ret;
+}
+
+void trn_buffered_fd_flush_all() {
+	trn_mutex_lock(&list_lock);
+	for(buffered_file_t *f = files; f != NULL; f = f->next) {
+		trn_mutex_lock(&f->lock);
+		f->error = buffered_flush_locked(f);
+		trn_mutex_unlock(&f->lock);
+	}
+	trn_mutex_unlock(&list_lock);
+}
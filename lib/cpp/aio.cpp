@@ -0,0 +1,62 @@
+#include<libtransistor/cpp/aio.hpp>
+
+#include<libtransistor/aio.h>
+#include<libtransistor/err.h>
+
+namespace trn {
+
+namespace {
+
+struct Request {
+	trn_aio_request_t request;
+	std::promise<Result<size_t>> promise;
+
+	static void Callback(trn_aio_request_t *request, void *data) {
+		Request *self = (Request*) data;
+		if(request->result == RESULT_OK) {
+			self->promise.set_value(request->transferred);
+		} else {
+			self->promise.set_value(tl::make_unexpected(ResultCode(request->result)));
+		}
+		delete self;
+	}
+};
+
+}
+
+AIO::AIO(Waiter &waiter, int workers) {
+	ResultCode::AssertOk(trn_aio_create(&aio, waiter.waiter, workers));
+}
+
+AIO::~AIO() {
+	trn_aio_destroy(aio);
+}
+
+std::future<Result<size_t>> AIO::Read(int fd, void *buf, size_t size, off_t offset) {
+	return Submit(TRN_AIO_READ, fd, buf, size, offset);
+}
+
+std::future<Result<size_t>> AIO::Write(int fd, const void *buf, size_t size, off_t offset) {
+	return Submit(TRN_AIO_WRITE, fd, const_cast<void*>(buf), size, offset);
+}
+
+std::future<Result<size_t>> AIO::Submit(trn_aio_opcode_t opcode, int fd, void *buf, size_t size, off_t offset) {
+	Request *req = new Request();
+	req->request.fd = fd;
+	req->request.opcode = opcode;
+	req->request.buf = buf;
+	req->request.size = size;
+	req->request.offset = offset;
+	req->request.callback = &Request::Callback;
+	req->request.data = req;
+
+	std::future<Result<size_t>> future = req->promise.get_future();
+	result_t r = trn_aio_submit(aio, &req->request);
+	if(r != RESULT_OK) {
+		req->promise.set_value(tl::make_unexpected(ResultCode(r)));
+		delete req;
+	}
+	return future;
+}
+
+}
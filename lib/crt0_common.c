@@ -9,13 +9,13 @@
 #include<libtransistor/ipc/fs.h>
 #include<libtransistor/ipc/fatal.h>
 #include<libtransistor/ipc/twili.h>
-#include<libtransistor/fs/blobfd.h>
 #include<libtransistor/fs/inode.h>
 #include<libtransistor/fs/squashfs.h>
 #include<libtransistor/fs/mountfs.h>
 #include<libtransistor/fs/fspfs.h>
 #include<libtransistor/fs/fs.h>
 #include<libtransistor/fd.h>
+#include<libtransistor/buffered_fd.h>
 #include<libtransistor/alloc_pages.h>
 #include<libtransistor/address_space.h>
 #include<libtransistor/usb_serial.h>
@@ -45,6 +45,17 @@ size_t _trn_runconf_heap_size __attribute__((weak)) = 0;
 
 runconf_target_version_inference_t _trn_runconf_target_version_inference __attribute__((weak)) = _TRN_RUNCONF_TARGET_VERSION_INFERENCE_BY_SET_SYS;
 
+size_t _trn_runconf_squashfs_md_cache_blocks __attribute__((weak)) = 32;
+size_t _trn_runconf_squashfs_data_cache_blocks __attribute__((weak)) = 2;
+size_t _trn_runconf_squashfs_frag_cache_blocks __attribute__((weak)) = 4;
+size_t _trn_runconf_squashfs_inode_cache_size __attribute__((weak)) = TRN_SQFS_DEFAULT_INODE_CACHE_SIZE;
+size_t _trn_runconf_squashfs_lookup_index_bytes __attribute__((weak)) = TRN_SQFS_DEFAULT_LOOKUP_INDEX_BYTES;
+
+bsd_config_t _trn_runconf_bsd_config __attribute__((weak)) = BSD_CONFIG_DEFAULT;
+size_t _trn_runconf_bsd_transfer_mem_size __attribute__((weak)) = 0;
+bsd_dns_cache_config_t _trn_runconf_bsd_dns_cache_config __attribute__((weak)) = BSD_DNS_CACHE_CONFIG_DEFAULT;
+trn_buffered_fd_config_t _trn_runconf_stdio_buffering __attribute__((weak)) = {.buffer_size = 0};
+
 int main(int argc, char **argv);
 
 // from util.c
@@ -75,6 +86,7 @@ static uint8_t tls_backup[0x200];
 static trn_thread_t main_thread;
 static trn_inode_t root_inode;
 
+static int buffer_stdio_fd(int fd);
 static result_t setup_socket_stdio(int s_stdout, int s_stdin, int s_stderr);
 static result_t setup_twili_stdio();
 static result_t setup_usb_stdio();
@@ -204,9 +216,11 @@ int _libtransistor_start(loader_config_entry_t *config, uint64_t thread_handle,
 			dbg_printf("connected to overridden host -> %d", sock_fd);
 			has_dbg_connection = true;
 			
+			// stdin is read straight from the socket; only output is buffered
+			dup2(sock_fd, STDIN_FILENO);
+			sock_fd = buffer_stdio_fd(sock_fd);
 			dup2(sock_fd, STDOUT_FILENO);
 			dup2(sock_fd, STDERR_FILENO);
-			dup2(sock_fd, STDIN_FILENO);
 			fd_close(sock_fd);
 		} else if(_trn_runconf_stdio_override == _TRN_RUNCONF_STDIO_OVERRIDE_TWILI) {
 			LIB_ASSERT_OK(fail_main, twili_init());
@@ -243,6 +257,8 @@ fail_main:
 			ld_decref_module(root_module);
 		}
 
+		// closing stdio only writes it out if nothing else holds on to it
+		trn_buffered_fd_flush_all();
 		close(STDOUT_FILENO);
 		close(STDERR_FILENO);
 		close(STDIN_FILENO);
@@ -302,6 +318,21 @@ noreturn void trn_dirty_exit(int ret) {
 	longjmp(exit_jmpbuf, DIRTY_EXIT);
 }
 
+// Puts an fd that's headed for stdio behind a buffer, if the application asked
+// for one. Returns the fd to use instead, which is fd itself if not.
+static int buffer_stdio_fd(int fd) {
+	if(_trn_runconf_stdio_buffering.buffer_size == 0) {
+		return fd;
+	}
+	int buffered = trn_buffered_fd_create(fd, &_trn_runconf_stdio_buffering);
+	if(buffered < 0) {
+		dbg_printf("failed to buffer stdio: %d", -buffered);
+		return fd;
+	}
+	close(fd);
+	return buffered;
+}
+
 static result_t setup_twili_fd(result_t (*func)(twili_pipe_t *out), int fd) {
 	result_t r;
 	twili_pipe_t pipe;
@@ -309,6 +340,9 @@ static result_t setup_twili_fd(result_t (*func)(twili_pipe_t *out), int fd) {
 		return r;
 	}
 	int pfd = twili_pipe_fd(&pipe);
+	if(fd != STDIN_FILENO) {
+		pfd = buffer_stdio_fd(pfd);
+	}
 	dup2(pfd, fd);
 	close(pfd);
 	return RESULT_OK;
@@ -334,6 +368,9 @@ static result_t setup_stdio_socket(const char *name, int socket_fd, int target_f
 	if (fd < 0) {
 		dbg_printf("Error creating socket: %d", errno);
 	} else {
+		if (target_fd != STDIN_FILENO) {
+			fd = buffer_stdio_fd(fd);
+		}
 		if (dup2(fd, target_fd) < 0) {
 			dbg_printf("Error setting up %s: %d", name, errno);
 		}
@@ -357,10 +394,11 @@ static result_t setup_usb_stdio() {
 	if(usb_fd < 0) {
 		return 1;
 	}
-	dup2(usb_fd, STDOUT_FILENO);
-	dup2(usb_fd, STDERR_FILENO);
 	dup2(usb_fd, STDIN_FILENO);
 	dbg_set_file(fd_file_get(usb_fd));
+	usb_fd = buffer_stdio_fd(usb_fd);
+	dup2(usb_fd, STDOUT_FILENO);
+	dup2(usb_fd, STDERR_FILENO);
 	fd_close(usb_fd);
 	return RESULT_OK;
 }
@@ -391,22 +429,30 @@ static result_t setup_bss_stdio() {
 }
 
 // filesystem stuff
-static blob_file sqfs_blob;
 static sqfs fs;
 
 static result_t setup_fs() {
 	size_t sqfs_size = ((uint8_t*) &_libtransistor_squashfs_image_end) - ((uint8_t*) &_libtransistor_squashfs_image); // TODO: not this
-	int sqfs_img_fd = blobfd_create(&sqfs_blob, &_libtransistor_squashfs_image, sqfs_size);
 	sqfs_err err = SQFS_OK;
 	ifilesystem_t sdcard_ifs;
 
-	err = sqfs_init(&fs, sqfs_img_fd, 0);
+	// the image is linked into the binary, so read it in place instead of going through a blobfd
+	err = sqfs_init_memory(&fs, &_libtransistor_squashfs_image, sqfs_size, 0);
 	if(err != SQFS_OK) {
 		printf("failed to open SquashFS image: %x\n", err);
-		goto fail_sqfs_image_fd;
+		goto fail;
 	}
 
 	result_t r;
+	// not fatal; we just keep the default sizes
+	if((r = trn_sqfs_set_cache_size(&fs, TRN_SQFS_CACHE_METADATA, _trn_runconf_squashfs_md_cache_blocks)) != RESULT_OK ||
+	   (r = trn_sqfs_set_cache_size(&fs, TRN_SQFS_CACHE_DATA, _trn_runconf_squashfs_data_cache_blocks)) != RESULT_OK ||
+	   (r = trn_sqfs_set_cache_size(&fs, TRN_SQFS_CACHE_FRAGMENT, _trn_runconf_squashfs_frag_cache_blocks)) != RESULT_OK) {
+		printf("failed to size SquashFS caches: %x\n", r);
+	}
+	trn_sqfs_set_inode_cache_size(&fs, _trn_runconf_squashfs_inode_cache_size);
+	trn_sqfs_set_lookup_index(&fs, _trn_runconf_squashfs_lookup_index_bytes, TRN_SQFS_DEFAULT_LOOKUP_INDEX_DIR_SIZE);
+
 	// Setup mountfs
 	if((r = trn_mountfs_create(&root_inode)) != RESULT_OK) {
 		printf("Failed to create mountfs: %x\n", r);
@@ -465,7 +511,6 @@ fail_mountfs:
 	root_inode.ops->release(root_inode.data);
 fail_sqfs:
 	sqfs_destroy(&fs);
-fail_sqfs_image_fd:
-	close(sqfs_img_fd);
+fail:
 	return true;
 }
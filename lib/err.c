@@ -146,6 +146,8 @@ static err_group_t err_g_fs = {
 		{ LIBTRANSISTOR_ERR_FS_READ_ONLY, "FS_READ_ONLY", EROFS },
 		{ LIBTRANSISTOR_ERR_FS_ACCESS_DENIED, "FS_ACCESS_DENIED", EACCES },
 		{ LIBTRANSISTOR_ERR_FS_IO_ERROR, "FS_IO_ERROR", EIO },
+		{ LIBTRANSISTOR_ERR_FS_NO_SPACE, "FS_NO_SPACE", ENOSPC },
+		{ LIBTRANSISTOR_ERR_FS_DIRECTORY_NOT_EMPTY, "FS_DIRECTORY_NOT_EMPTY", ENOTEMPTY },
 		{ 0, NULL, 0 },
 	}
 };
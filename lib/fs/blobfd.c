@@ -5,6 +5,7 @@
 #include<errno.h>
 #include<stdio.h>
 #include<string.h>
+#include<sys/stat.h>
 
 static result_t blobfd_seek(void *vfile, off_t offset, int whence, off_t *position) {
 	blob_file *file = vfile;
@@ -37,10 +38,81 @@ static result_t blobfd_read(void *vfile, void *buffer, size_t size, size_t *byte
 	return RESULT_OK;
 }
 
+static result_t blobfd_pread(void *vfile, void *buffer, size_t size, off_t offset, size_t *bytes_read) {
+	blob_file *file = vfile;
+	size_t sz = size;
+	if(offset < 0) {
+		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+	}
+	if((size_t) offset >= file->size) {
+		*bytes_read = 0;
+		return RESULT_OK;
+	}
+	if(offset + sz > file->size) {
+		sz = file->size - offset;
+	}
+	memcpy(buffer, file->data + offset, sz);
+	*bytes_read = sz;
+	return RESULT_OK;
+}
+
+static result_t blobfd_readv(void *vfile, const struct iovec *iov, int iovcnt, size_t *bytes_read) {
+	blob_file *file = vfile;
+	size_t total = 0;
+	for(int i = 0; i < iovcnt; i++) {
+		size_t sz;
+		blobfd_pread(file, iov[i].iov_base, iov[i].iov_len, file->head, &sz);
+		file->head+= sz;
+		total+= sz;
+		if(sz < iov[i].iov_len) {
+			break;
+		}
+	}
+	*bytes_read = total;
+	return RESULT_OK;
+}
+
 static result_t blobfd_write(void *vfile, const void *buffer, size_t size, size_t *bytes_written) {
 	return LIBTRANSISTOR_ERR_FS_READ_ONLY;
 }
 
+static result_t blobfd_pwrite(void *vfile, const void *buffer, size_t size, off_t offset, size_t *bytes_written) {
+	return LIBTRANSISTOR_ERR_FS_READ_ONLY;
+}
+
+static result_t blobfd_stat(void *vfile, struct stat *st) {
+	blob_file *file = vfile;
+	st->st_mode = S_IFREG | 0444;
+	st->st_nlink = 1;
+	st->st_size = file->size;
+	return RESULT_OK;
+}
+
+static result_t blobfd_mmap(void *vfile, off_t offset, size_t length, const void **addr) {
+	blob_file *file = vfile;
+	if(offset < 0 || (size_t) offset > file->size || length > file->size - offset) {
+		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+	}
+	*addr = (const uint8_t*) file->data + offset;
+	return RESULT_OK;
+}
+
+static result_t blobfd_peek(void *vfile, off_t offset, const void **addr, size_t *length) {
+	blob_file *file = vfile;
+	if(offset < 0) {
+		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+	}
+	if((size_t) offset >= file->size) {
+		*length = 0;
+		return RESULT_OK;
+	}
+	if(*length > file->size - offset) {
+		*length = file->size - offset;
+	}
+	*addr = (const uint8_t*) file->data + offset;
+	return RESULT_OK;
+}
+
 static result_t blobfd_release(trn_file_t *f) {
 	return RESULT_OK;
 }
@@ -49,7 +121,13 @@ static trn_file_ops_t blobfd_ops = {
 	.seek = blobfd_seek,
 	.read = blobfd_read,
 	.write = blobfd_write,
-	.release = blobfd_release
+	.release = blobfd_release,
+	.pread = blobfd_pread,
+	.pwrite = blobfd_pwrite,
+	.readv = blobfd_readv,
+	.stat = blobfd_stat,
+	.mmap = blobfd_mmap,
+	.peek = blobfd_peek,
 };
 
 int blobfd_create(blob_file *file, void *blob, size_t size) {
@@ -0,0 +1,357 @@
+#include<libtransistor/fs/dcache.h>
+
+#include<libtransistor/types.h>
+#include<libtransistor/fs/inode.h>
+#include<libtransistor/err.h>
+#include<libtransistor/mutex.h>
+
+#include<stdlib.h>
+#include<string.h>
+
+#define DCACHE_BUCKETS 256
+
+static trn_mutex_t dcache_mutex = TRN_MUTEX_STATIC_INITIALIZER;
+static trn_dentry_t *buckets[DCACHE_BUCKETS] GUARDED_BY(dcache_mutex);
+static trn_dentry_t *lru_head GUARDED_BY(dcache_mutex) = NULL; // most recently used
+static trn_dentry_t *lru_tail GUARDED_BY(dcache_mutex) = NULL; // next to be evicted
+static size_t dcache_limit GUARDED_BY(dcache_mutex) = TRN_DCACHE_DEFAULT_LIMIT;
+static trn_dcache_stats_t stats GUARDED_BY(dcache_mutex);
+
+// FNV-1a over the name, seeded with the parent pointer
+static uint32_t dcache_hash(trn_dentry_t *parent, const char *name, size_t name_len) {
+	uint32_t hash = 2166136261u ^ (uint32_t) (((uintptr_t) parent) >> 4);
+	for(size_t i = 0; i < name_len; i++) {
+		hash^= (uint8_t) name[i];
+		hash*= 16777619u;
+	}
+	return hash;
+}
+
+static trn_dentry_t *dcache_find(trn_dentry_t *parent, uint32_t hash, const char *name, size_t name_len) REQUIRES(dcache_mutex) {
+	for(trn_dentry_t *d = buckets[hash % DCACHE_BUCKETS]; d != NULL; d = d->hash_next) {
+		if(d->hash == hash && d->parent == parent && d->name_len == name_len && memcmp(d->name, name, name_len) == 0) {
+			return d;
+		}
+	}
+	return NULL;
+}
+
+static void lru_remove(trn_dentry_t *d) REQUIRES(dcache_mutex) {
+	if(d->lru_prev != NULL) {
+		d->lru_prev->lru_next = d->lru_next;
+	} else {
+		lru_head = d->lru_next;
+	}
+	if(d->lru_next != NULL) {
+		d->lru_next->lru_prev = d->lru_prev;
+	} else {
+		lru_tail = d->lru_prev;
+	}
+	d->lru_prev = NULL;
+	d->lru_next = NULL;
+}
+
+static void lru_push(trn_dentry_t *d) REQUIRES(dcache_mutex) {
+	d->lru_prev = NULL;
+	d->lru_next = lru_head;
+	if(lru_head != NULL) {
+		lru_head->lru_prev = d;
+	} else {
+		lru_tail = d;
+	}
+	lru_head = d;
+}
+
+static void dcache_hash_insert(trn_dentry_t *d) REQUIRES(dcache_mutex) {
+	trn_dentry_t **bucket = &buckets[d->hash % DCACHE_BUCKETS];
+	d->hash_next = *bucket;
+	*bucket = d;
+	d->hashed = true;
+	stats.entries++;
+}
+
+static void dcache_unhash(trn_dentry_t *d) REQUIRES(dcache_mutex) {
+	trn_dentry_t **link = &buckets[d->hash % DCACHE_BUCKETS];
+	while(*link != d) {
+		link = &(*link)->hash_next;
+	}
+	*link = d->hash_next;
+	d->hash_next = NULL;
+	d->hashed = false;
+	stats.entries--;
+}
+
+static void dcache_release_locked(trn_dentry_t *d, trn_dentry_t **dispose) REQUIRES(dcache_mutex);
+
+// drops a reference. unreferenced dentries go on the LRU list if they're still
+// reachable, or get disposed of otherwise.
+static void dcache_unref_locked(trn_dentry_t *d, trn_dentry_t **dispose) REQUIRES(dcache_mutex) {
+	if(d == NULL) {
+		return;
+	}
+	if(--d->refcount > 0) {
+		return;
+	}
+	if(d->hashed) {
+		lru_push(d);
+	} else {
+		dcache_release_locked(d, dispose);
+	}
+}
+
+// d must be unreferenced, unhashed, and not on the LRU list.
+static void dcache_release_locked(trn_dentry_t *d, trn_dentry_t **dispose) REQUIRES(dcache_mutex) {
+	trn_dentry_t *parent = d->parent;
+	d->lru_next = *dispose;
+	*dispose = d;
+	dcache_unref_locked(parent, dispose);
+}
+
+// releasing inodes can involve IPC, so we do it after dropping the lock
+static void dcache_dispose(trn_dentry_t *dispose) EXCLUDES(dcache_mutex) {
+	while(dispose != NULL) {
+		trn_dentry_t *next = dispose->lru_next;
+		if(!dispose->negative) {
+			dispose->inode.ops->release(dispose->inode.data);
+		}
+		free(dispose);
+		dispose = next;
+	}
+}
+
+static void dcache_evict_locked(trn_dentry_t **dispose) REQUIRES(dcache_mutex) {
+	while(stats.entries > dcache_limit && lru_tail != NULL) {
+		trn_dentry_t *d = lru_tail;
+		lru_remove(d);
+		dcache_unhash(d);
+		stats.evictions++;
+		dcache_release_locked(d, dispose);
+	}
+}
+
+static void dcache_drop_locked(trn_dentry_t *d, trn_dentry_t **dispose) REQUIRES(dcache_mutex) {
+	dcache_unhash(d);
+	if(d->refcount == 0) {
+		lru_remove(d);
+		dcache_release_locked(d, dispose);
+	}
+}
+
+result_t trn_dcache_lookup(trn_dentry_t *parent, trn_inode_t *parent_inode, const char *name, size_t name_len, trn_dentry_t **out) {
+	uint32_t hash = dcache_hash(parent, name, name_len);
+	trn_dentry_t *dispose = NULL;
+	trn_dentry_t *d;
+	trn_inode_t child;
+	result_t r;
+
+	trn_mutex_lock(&dcache_mutex);
+	d = dcache_find(parent, hash, name, name_len);
+	if(d != NULL) {
+		if(d->negative) {
+			stats.negative_hits++;
+			lru_remove(d);
+			lru_push(d);
+			trn_mutex_unlock(&dcache_mutex);
+			return LIBTRANSISTOR_ERR_FS_NOT_FOUND;
+		}
+		if(d->refcount++ == 0) {
+			lru_remove(d);
+		}
+		stats.hits++;
+		trn_mutex_unlock(&dcache_mutex);
+		*out = d;
+		return RESULT_OK;
+	}
+	stats.misses++;
+	bool caching = dcache_limit > 0;
+	trn_mutex_unlock(&dcache_mutex);
+
+	// the caller holds a reference on parent, so it can't go away while we're
+	// talking to the backend.
+	r = parent_inode->ops->lookup(parent_inode->data, &child, name, name_len);
+	if(r != RESULT_OK && (r != LIBTRANSISTOR_ERR_FS_NOT_FOUND || !caching)) {
+		return r;
+	}
+
+	d = malloc(sizeof(*d) + name_len + 1);
+	if(d == NULL) {
+		if(r == RESULT_OK) {
+			child.ops->release(child.data);
+			r = LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+		}
+		return r;
+	}
+	d->parent = parent;
+	d->hash_next = NULL;
+	d->lru_prev = NULL;
+	d->lru_next = NULL;
+	d->refcount = 0;
+	d->hashed = false;
+	d->negative = r != RESULT_OK;
+	d->hash = hash;
+	d->inode = child;
+	d->name_len = name_len;
+	memcpy(d->name, name, name_len);
+	d->name[name_len] = 0;
+
+	trn_mutex_lock(&dcache_mutex);
+	trn_dentry_t *existing = dcache_find(parent, hash, name, name_len);
+	if(existing != NULL) {
+		if(existing->negative == d->negative) {
+			// someone else resolved this while we weren't holding the lock
+			if(!existing->negative) {
+				if(existing->refcount++ == 0) {
+					lru_remove(existing);
+				}
+				*out = existing;
+			}
+			trn_mutex_unlock(&dcache_mutex);
+			dcache_dispose(d);
+			return r;
+		}
+		dcache_drop_locked(existing, &dispose);
+	}
+
+	if(d->negative && dcache_limit == 0) {
+		// the cache was turned off while we were talking to the backend, and
+		// an unhashed negative dentry would have nothing to keep it around
+		d->lru_next = dispose;
+		dispose = d;
+	} else {
+		if(parent != NULL) {
+			parent->refcount++;
+		}
+		if(dcache_limit > 0) {
+			dcache_hash_insert(d);
+		}
+		if(d->negative) {
+			lru_push(d);
+		} else {
+			d->refcount = 1;
+			*out = d;
+		}
+	}
+	dcache_evict_locked(&dispose);
+	trn_mutex_unlock(&dcache_mutex);
+
+	dcache_dispose(dispose);
+	return r;
+}
+
+void trn_dcache_get(trn_dentry_t *dentry) {
+	trn_mutex_lock(&dcache_mutex);
+	if(dentry->refcount++ == 0 && dentry->hashed) {
+		lru_remove(dentry);
+	}
+	trn_mutex_unlock(&dcache_mutex);
+}
+
+void trn_dcache_put(trn_dentry_t *dentry) {
+	trn_dentry_t *dispose = NULL;
+	if(dentry == NULL) {
+		return;
+	}
+	trn_mutex_lock(&dcache_mutex);
+	dcache_unref_locked(dentry, &dispose);
+	dcache_evict_locked(&dispose);
+	trn_mutex_unlock(&dcache_mutex);
+	dcache_dispose(dispose);
+}
+
+void trn_dcache_invalidate_name(trn_dentry_t *parent, const char *name, size_t name_len) {
+	uint32_t hash = dcache_hash(parent, name, name_len);
+	trn_dentry_t *dispose = NULL;
+
+	trn_mutex_lock(&dcache_mutex);
+	trn_dentry_t *d = dcache_find(parent, hash, name, name_len);
+	if(d != NULL && d->negative) {
+		stats.invalidations++;
+		dcache_drop_locked(d, &dispose);
+	}
+	trn_mutex_unlock(&dcache_mutex);
+	dcache_dispose(dispose);
+}
+
+static void dcache_invalidate_locked(trn_dentry_t *dentry, trn_dentry_t **dispose) REQUIRES(dcache_mutex) {
+	// children first, while dentry is still pinned by them
+	for(size_t i = 0; i < DCACHE_BUCKETS; i++) {
+		trn_dentry_t *d = buckets[i];
+		while(d != NULL) {
+			trn_dentry_t *next = d->hash_next;
+			if(d->parent == dentry) {
+				dcache_invalidate_locked(d, dispose);
+				next = buckets[i]; // the chain may have changed under us
+			}
+			d = next;
+		}
+	}
+	if(dentry->hashed) {
+		stats.invalidations++;
+		dcache_drop_locked(dentry, dispose);
+	}
+}
+
+void trn_dcache_invalidate(trn_dentry_t *dentry) {
+	trn_dentry_t *dispose = NULL;
+	if(dentry == NULL) {
+		trn_dcache_flush();
+		return;
+	}
+	trn_mutex_lock(&dcache_mutex);
+	dcache_invalidate_locked(dentry, &dispose);
+	trn_mutex_unlock(&dcache_mutex);
+	dcache_dispose(dispose);
+}
+
+static void dcache_drop_all_locked(bool negative_only, trn_dentry_t **dispose) REQUIRES(dcache_mutex) {
+	for(size_t i = 0; i < DCACHE_BUCKETS; i++) {
+		trn_dentry_t *d = buckets[i];
+		while(d != NULL) {
+			trn_dentry_t *next = d->hash_next;
+			if(!negative_only || d->negative) {
+				dcache_drop_locked(d, dispose);
+				next = buckets[i];
+			}
+			d = next;
+		}
+	}
+}
+
+void trn_dcache_invalidate_negative() {
+	trn_dentry_t *dispose = NULL;
+	trn_mutex_lock(&dcache_mutex);
+	dcache_drop_all_locked(true, &dispose);
+	trn_mutex_unlock(&dcache_mutex);
+	dcache_dispose(dispose);
+}
+
+void trn_dcache_flush() {
+	trn_dentry_t *dispose = NULL;
+	trn_mutex_lock(&dcache_mutex);
+	dcache_drop_all_locked(false, &dispose);
+	trn_mutex_unlock(&dcache_mutex);
+	dcache_dispose(dispose);
+}
+
+void trn_dcache_set_limit(size_t max_entries) {
+	trn_dentry_t *dispose = NULL;
+	trn_mutex_lock(&dcache_mutex);
+	dcache_limit = max_entries;
+	dcache_evict_locked(&dispose);
+	trn_mutex_unlock(&dcache_mutex);
+	dcache_dispose(dispose);
+}
+
+void trn_dcache_get_stats(trn_dcache_stats_t *out) {
+	trn_mutex_lock(&dcache_mutex);
+	*out = stats;
+	trn_mutex_unlock(&dcache_mutex);
+}
+
+void trn_dcache_reset_stats() {
+	trn_mutex_lock(&dcache_mutex);
+	size_t entries = stats.entries;
+	memset(&stats, 0, sizeof(stats));
+	stats.entries = entries;
+	trn_mutex_unlock(&dcache_mutex);
+}
@@ -3,6 +3,7 @@
 #include<libtransistor/types.h>
 #include<libtransistor/fs/inode.h>
 #include<libtransistor/fs/mountfs.h>
+#include<libtransistor/fs/dcache.h>
 #include<libtransistor/err.h>
 #include<libtransistor/util.h>
 
@@ -20,15 +21,21 @@ static trn_inode_t *root = NULL;
 
 typedef struct {
 	trn_inode_t inode;
-	char *name;
+	const char *name;
+	trn_dentry_t *dentry; // NULL for the root
 } trn_traverse_t;
 
 static trn_traverse_t cwd[MAX_RECURSION];
 static int cwd_recursion = -1;
-static char *empty_name = "";
+static const char *empty_name = "";
 
 result_t trn_fs_set_root(trn_inode_t *new_root) {
 	if(root != NULL) {
+		for(int i = 1; i <= cwd_recursion; i++) {
+			trn_dcache_put(cwd[i].dentry);
+		}
+		// cached inodes may belong to filesystems mounted under the old root
+		trn_dcache_flush();
 		root->ops->release(root->data);
 	}
 	
@@ -36,6 +43,7 @@ result_t trn_fs_set_root(trn_inode_t *new_root) {
 	
 	cwd[0].inode = *new_root;
 	cwd[0].name = empty_name;
+	cwd[0].dentry = NULL;
 	cwd_recursion = 0;
 
 	return RESULT_OK;
@@ -43,9 +51,14 @@ result_t trn_fs_set_root(trn_inode_t *new_root) {
 
 // This will only work if trn_fs_set_root has not been called!
 result_t trn_fs_mount(const char *mount_name, trn_inode_t mount) {
-	if (root != NULL)
-		return trn_mountfs_mount_fs(root, mount_name, mount);
-	return LIBTRANSISTOR_ERR_FS_INTERNAL_ERROR;
+	result_t r;
+	if (root == NULL)
+		return LIBTRANSISTOR_ERR_FS_INTERNAL_ERROR;
+	// the mountpoint may have been looked up before, as a failed lookup or as
+	// whatever was mounted there previously
+	if ((r = trn_mountfs_mount_fs(root, mount_name, mount)) == RESULT_OK)
+		trn_dcache_flush();
+	return r;
 }
 
 
@@ -86,7 +99,7 @@ static result_t trn_fs_traverse(const char *path, size_t max_len, trn_traverse_t
 		if(seglen == 2 && strncmp("..", segment, seglen) == 0) {
 			if(traverse_recursion > 0) { // root is its own parent
 				if(traverse_recursion > borrowed_recursion) { // this is an inode that we opened and that we own
-					trv->inode.ops->release(trv->inode.data);
+					trn_dcache_put(trv->dentry);
 				} else {
 					// reduce how many we're borrowing, because the only place we ever increment traverse_recursion
 					// is when we open an inode that we own
@@ -101,18 +114,11 @@ static result_t trn_fs_traverse(const char *path, size_t max_len, trn_traverse_t
 				goto fail;
 			}
 
-			r = trv->inode.ops->lookup(trv[0].inode.data, &trv[1].inode, segment, seglen);
-			trv[1].name = malloc(seglen+1);
-			if(trv[1].name == NULL) {
-				r = LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
-				goto fail;
-			}
-			memcpy(trv[1].name, segment, seglen);
-			trv[1].name[seglen] = 0;
-			
-			if(r) {
+			if((r = trn_dcache_lookup(trv[0].dentry, &trv[0].inode, segment, seglen, &trv[1].dentry)) != RESULT_OK) {
 				goto fail;
 			}
+			trv[1].inode = trv[1].dentry->inode;
+			trv[1].name = trv[1].dentry->name;
 			traverse_recursion++;
 		}
 		
@@ -131,7 +137,7 @@ static result_t trn_fs_traverse(const char *path, size_t max_len, trn_traverse_t
 	return RESULT_OK;
 fail:
 	for(int i = borrowed_recursion + 1; i <= traverse_recursion; i++) {
-		traverse[i].inode.ops->release(traverse[i].inode.data);
+		trn_dcache_put(traverse[i].dentry);
 	}
 	return r;
 }
@@ -174,7 +180,7 @@ result_t trn_fs_realpath(const char *path, char **resolved_path) {
 
 fail: // release inodes that were opened during traversal
 	for(int i = borrowed_recursion + 1; i <= traverse_recursion; i++) {
-		traverse[i].inode.ops->release(traverse[i].inode.data);
+		trn_dcache_put(traverse[i].dentry);
 	}
 	return r;
 }
@@ -222,9 +228,12 @@ result_t trn_fs_mkdir(const char *path) {
 
 	TRN_FS_DEBUG("Creating child\n");
 	r = traverse[traverse_recursion].inode.ops->create_directory(traverse[traverse_recursion].inode.data, child_path);
+	if(r == RESULT_OK) {
+		trn_dcache_invalidate_name(traverse[traverse_recursion].dentry, child_path, strcspn(child_path, "/"));
+	}
 
 	for(int i = borrowed_recursion + 1; i <= traverse_recursion; i++) {
-		traverse[i].inode.ops->release(traverse[i].inode.data);
+		trn_dcache_put(traverse[i].dentry);
 	}
 	
 	return r;
@@ -240,9 +249,12 @@ result_t trn_fs_unlink(const char *path) {
 	}
 	
 	r = traverse[traverse_recursion].inode.ops->remove_file(traverse[traverse_recursion].inode.data);
+	if(r == RESULT_OK) {
+		trn_dcache_invalidate(traverse[traverse_recursion].dentry);
+	}
 
 	for(int i = borrowed_recursion + 1; i <= traverse_recursion; i++) {
-		traverse[i].inode.ops->release(traverse[i].inode.data);
+		trn_dcache_put(traverse[i].dentry);
 	}
 
 	return r;
@@ -258,9 +270,12 @@ result_t trn_fs_rmdir(const char *path) {
 	}
 	
 	r = traverse[traverse_recursion].inode.ops->remove_empty_directory(traverse[traverse_recursion].inode.data);
+	if(r == RESULT_OK) {
+		trn_dcache_invalidate(traverse[traverse_recursion].dentry);
+	}
 
 	for(int i = borrowed_recursion + 1; i <= traverse_recursion; i++) {
-		traverse[i].inode.ops->release(traverse[i].inode.data);
+		trn_dcache_put(traverse[i].dentry);
 	}
 
 	return r;
@@ -288,9 +303,14 @@ result_t trn_fs_rename(const char *oldpath, const char *newpath) {
 		newpath++;
 
 	r = traverse[traverse_recursion].inode.ops->rename(traverse[traverse_recursion].inode.data, newpath);
+	if(r == RESULT_OK) {
+		// We can't resolve newpath to a dentry (see above), and the target may
+		// have been replaced, so just start over.
+		trn_dcache_flush();
+	}
 
 	for(int i = borrowed_recursion + 1; i <= traverse_recursion; i++) {
-		traverse[i].inode.ops->release(traverse[i].inode.data);
+		trn_dcache_put(traverse[i].dentry);
 	}
 
 	return r;
@@ -313,10 +333,12 @@ result_t trn_fs_open(int *fd, const char *path, int flags) {
 
 		// Create the child (fail if it already exists).
 		r = traverse[traverse_recursion].inode.ops->create_file(traverse[traverse_recursion].inode.data, child);
+		if (r == RESULT_OK)
+			trn_dcache_invalidate_name(traverse[traverse_recursion].dentry, child, strcspn(child, "/"));
 
 		// TODO: Reuse borrow to open the file ?
 		for(int i = borrowed_recursion + 1; i <= traverse_recursion; i++) {
-			traverse[i].inode.ops->release(traverse[i].inode.data);
+			trn_dcache_put(traverse[i].dentry);
 		}
 
 		if (r != RESULT_OK && (flags & O_EXCL || r != LIBTRANSISTOR_ERR_FS_PATH_EXISTS)) {
@@ -331,7 +353,7 @@ result_t trn_fs_open(int *fd, const char *path, int flags) {
 	r = traverse[traverse_recursion].inode.ops->open_as_file(traverse[traverse_recursion].inode.data, flags, fd);
 	
 	for(int i = borrowed_recursion + 1; i <= traverse_recursion; i++) {
-		traverse[i].inode.ops->release(traverse[i].inode.data);
+		trn_dcache_put(traverse[i].dentry);
 	}
 	
 	return r;
@@ -349,12 +371,34 @@ result_t trn_fs_opendir(trn_dir_t *dir, const char *path) {
 	r = traverse[traverse_recursion].inode.ops->open_as_dir(traverse[traverse_recursion].inode.data, dir);
 
 	for(int i = borrowed_recursion + 1; i <= traverse_recursion; i++) {
-		traverse[i].inode.ops->release(traverse[i].inode.data);
+		trn_dcache_put(traverse[i].dentry);
 	}
 	
 	return r;
 }
 
+result_t trn_fs_readdir_batch(trn_dir_t *dir, trn_dirent_t *dirents, size_t count, size_t *read) {
+	result_t r = RESULT_OK;
+	size_t i;
+
+	if(dir->ops->next_batch != NULL) {
+		return dir->ops->next_batch(dir->data, dirents, count, read);
+	}
+
+	for(i = 0; i < count; i++) {
+		if((r = dir->ops->next(dir->data, &dirents[i])) != RESULT_OK) {
+			break;
+		}
+	}
+
+	// hand back whatever we got before hitting the end, or an error
+	if(i > 0 || r == LIBTRANSISTOR_ERR_FS_OUT_OF_DIR_ENTRIES) {
+		r = RESULT_OK;
+	}
+	*read = i;
+	return r;
+}
+
 result_t trn_fs_chdir(const char *path) {
 	result_t r;
 	trn_traverse_t traverse[MAX_RECURSION];
@@ -365,7 +409,7 @@ result_t trn_fs_chdir(const char *path) {
 	}
 
 	for(int i = borrowed_recursion + 1; i <= cwd_recursion; i++) {
-		cwd[i].inode.ops->release(cwd[i].inode.data);
+		trn_dcache_put(cwd[i].dentry);
 	}
 	
 	cwd_recursion = traverse_recursion;
@@ -384,13 +428,18 @@ result_t trn_fs_stat(const char *path, struct stat *st) {
 		return r;
 	}
 
-	bool is_dir;
-	r = traverse[traverse_recursion].inode.ops->is_dir(traverse[traverse_recursion].inode.data, &is_dir);
-
-	st->st_mode = is_dir ? S_IFDIR : S_IFREG;
+	trn_inode_t *inode = &traverse[traverse_recursion].inode;
+	memset(st, 0, sizeof(*st));
+	if(inode->ops->stat != NULL) {
+		r = inode->ops->stat(inode->data, st);
+	} else {
+		bool is_dir;
+		r = inode->ops->is_dir(inode->data, &is_dir);
+		st->st_mode = is_dir ? S_IFDIR : S_IFREG;
+	}
 	
 	for(int i = borrowed_recursion + 1; i <= traverse_recursion; i++) {
-		traverse[i].inode.ops->release(traverse[i].inode.data);
+		trn_dcache_put(traverse[i].dentry);
 	}
 	
 	return r;
@@ -8,19 +8,60 @@
 #include <string.h>
 #include <stdio.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <errno.h>
 #include <libtransistor/util.h>
+#include <libtransistor/mutex.h>
+#include <stdatomic.h>
+
+// Attributes we know about a file, shared between its inode and every file
+// opened from it so that our own writes, truncates and unlinks keep it up to
+// date. Writes made by anyone else aren't noticed, so the size is asked for
+// again whenever the file is opened while nobody else here has it open, but
+// stat in between trusts it, and doesn't have to open the file.
+struct fspfs_attr {
+	_Atomic(int) refcount;
+	trn_mutex_t lock;
+	int open_files GUARDED_BY(lock);
+	bool size_valid GUARDED_BY(lock);
+	uint64_t size GUARDED_BY(lock); // including data that hasn't been written back yet
+};
 
 struct inode {
 	bool is_dir;
 	ifilesystem_t fs;
+	struct fspfs_attr *attr;
 	size_t path_len;
 	char path[0x301];// TODO: Static ? PTR ?
 };
 
+struct cache_buf {
+	char *data;
+	size_t capacity;
+	uint64_t offset;
+	size_t len;
+};
+
 struct ifs_file {
+	trn_mutex_t lock;
 	ifile_t file;
-	off_t head;
+	struct fspfs_attr *attr;
+	off_t head GUARDED_BY(lock);
+	struct cache_buf ra GUARDED_BY(lock); // read-ahead window
+	size_t ra_window GUARDED_BY(lock); // zero if the file isn't being read sequentially
+	uint64_t ra_next GUARDED_BY(lock); // where the next read has to start to be sequential
+	struct cache_buf wb GUARDED_BY(lock); // dirty data waiting to be written back
+};
+
+// Entries are 0x310 bytes each, so this is a bit under 25KiB per IPC.
+#define FSPFS_DIR_BATCH 32
+
+struct fspfs_dir {
+	idirectory_t dir;
+	size_t count; // entries in the buffer
+	size_t pos; // next entry to hand out
+	bool eof;
+	idirectoryentry_t entries[FSPFS_DIR_BATCH];
 };
 
 
@@ -28,6 +69,70 @@ static trn_file_ops_t fspfs_file_ops;
 static trn_inode_ops_t fspfs_inode_ops;
 static trn_dir_ops_t trn_fspfs_dir_ops;
 
+static struct fspfs_attr *attr_create() {
+	struct fspfs_attr *attr = malloc(sizeof(*attr));
+	if (attr == NULL)
+		return NULL;
+	attr->refcount = 1;
+	trn_mutex_create(&attr->lock);
+	attr->open_files = 0;
+	attr->size_valid = false;
+	attr->size = 0;
+	return attr;
+}
+
+static struct fspfs_attr *attr_get(struct fspfs_attr *attr) {
+	atomic_fetch_add(&attr->refcount, 1);
+	return attr;
+}
+
+static void attr_put(struct fspfs_attr *attr) {
+	if (atomic_fetch_sub(&attr->refcount, 1) == 1)
+		free(attr);
+}
+
+static bool attr_get_size(struct fspfs_attr *attr, uint64_t *size) {
+	trn_mutex_lock(&attr->lock);
+	bool valid = attr->size_valid;
+	*size = attr->size;
+	trn_mutex_unlock(&attr->lock);
+	return valid;
+}
+
+static void attr_set_size(struct fspfs_attr *attr, uint64_t size) {
+	trn_mutex_lock(&attr->lock);
+	attr->size_valid = true;
+	attr->size = size;
+	trn_mutex_unlock(&attr->lock);
+}
+
+// A write ending at end went through. If we don't know the size, we still don't.
+static void attr_extend(struct fspfs_attr *attr, uint64_t end) {
+	trn_mutex_lock(&attr->lock);
+	if (attr->size_valid && end > attr->size)
+		attr->size = end;
+	trn_mutex_unlock(&attr->lock);
+}
+
+static void attr_open(struct fspfs_attr *attr) {
+	trn_mutex_lock(&attr->lock);
+	if (attr->open_files++ == 0)
+		attr->size_valid = false; // it may have changed while nobody had it open
+	trn_mutex_unlock(&attr->lock);
+}
+
+static void attr_close(struct fspfs_attr *attr) {
+	trn_mutex_lock(&attr->lock);
+	attr->open_files--;
+	trn_mutex_unlock(&attr->lock);
+}
+
+static void attr_invalidate(struct fspfs_attr *attr) {
+	trn_mutex_lock(&attr->lock);
+	attr->size_valid = false;
+	trn_mutex_unlock(&attr->lock);
+}
+
 static result_t fspfs_is_dir(void *data, bool *out) {
 	struct inode *inode = (struct inode*)data;
 
@@ -56,6 +161,11 @@ static result_t fspfs_lookup(void *data, trn_inode_t *out, const char *name, siz
 		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
 
 	new_inode->fs = inode->fs;
+	new_inode->attr = attr_create();
+	if (new_inode->attr == NULL) {
+		free(new_inode);
+		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+	}
 
 	strncpy(new_inode->path, base_path, base_path_len);
 	new_inode->path[base_path_len] = '/';
@@ -73,6 +183,7 @@ static result_t fspfs_lookup(void *data, trn_inode_t *out, const char *name, siz
 
 	return RESULT_OK;
 fail:
+	attr_put(new_inode->attr);
 	free(new_inode);
 	return r;
 }
@@ -121,8 +232,11 @@ static result_t fspfs_create_directory(void *data, const char *name) {
 
 static result_t fspfs_remove_file(void *data) {
 	struct inode *inode = (struct inode*)data;
+	result_t r;
 
-	return ifilesystem_delete_file(inode->fs, inode->path);
+	if ((r = ifilesystem_delete_file(inode->fs, inode->path)) == RESULT_OK)
+		attr_invalidate(inode->attr);
+	return r;
 }
 
 static result_t fspfs_remove_empty_directory(void *data) {
@@ -174,29 +288,39 @@ static result_t fspfs_open_as_file(void *data, int flags, int *fd) {
 	// In unix land, we're kinda sorta *always* in append mode.
 	ifs_flags |= 4;
 
-	struct ifs_file *f = malloc(sizeof(struct ifs_file));
+	struct ifs_file *f = calloc(1, sizeof(struct ifs_file));
 	if (f == NULL)
 		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+	trn_mutex_create(&f->lock);
+
+	f->attr = attr_get(inode->attr);
 
 	if ((r = ifilesystem_open_file(inode->fs, &f->file, ifs_flags, inode->path)) != RESULT_OK)
 		goto fail;
+	attr_open(f->attr);
 
 	if (flags & O_TRUNC) {
 		if ((r = ifile_set_size(f->file, 0)) != RESULT_OK) {
 			printf("open_set_size: Got an error: %x\n", r);
-			goto fail;
+			attr_invalidate(f->attr);
+			goto fail_ifs;
 		}
+		attr_set_size(f->attr, 0);
 	}
 
 	if (flags & O_APPEND) {
-		if ((r = ifile_get_size(f->file, &file_size)) != RESULT_OK) {
-			printf("open_get_size: Got an error: %x\n", r);
-			goto fail;
+		if (!attr_get_size(f->attr, &file_size)) {
+			if ((r = ifile_get_size(f->file, &file_size)) != RESULT_OK) {
+				printf("open_get_size: Got an error: %x\n", r);
+				goto fail_ifs;
+			}
+			attr_set_size(f->attr, file_size);
 		}
 		f->head = file_size;
 	} else {
 		f->head = 0;
 	}
+	f->ra_next = f->head;
 
 	*fd = fd_create_file(&fspfs_file_ops, f);
 	if (*fd < 0) {
@@ -208,8 +332,10 @@ static result_t fspfs_open_as_file(void *data, int flags, int *fd) {
 	return RESULT_OK;
 
 fail_ifs:
+	attr_close(f->attr);
 	ipc_close(f->file);
 fail:
+	attr_put(f->attr);
 	free(f);
 	return r;
 }
@@ -221,11 +347,14 @@ static result_t fspfs_open_as_dir(void *data, trn_dir_t *out) {
 	if (!inode->is_dir)
 		return LIBTRANSISTOR_ERR_FS_NOT_A_DIRECTORY;
 
-	idirectory_t *dir = malloc(sizeof(idirectory_t));
+	struct fspfs_dir *dir = malloc(sizeof(struct fspfs_dir));
 	if (dir == NULL)
 		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+	dir->count = 0;
+	dir->pos = 0;
+	dir->eof = false;
 
-	if ((r = ifilesystem_open_directory(inode->fs, dir, 3, inode->path)) != RESULT_OK)
+	if ((r = ifilesystem_open_directory(inode->fs, &dir->dir, 3, inode->path)) != RESULT_OK)
 		goto fail;
 
 	out->data = (void*)dir;
@@ -244,43 +373,304 @@ static result_t fspfs_release(void *data) {
 		ipc_close(inode->fs);
 	}
 	
+	attr_put(inode->attr);
 	free(data);
 	return RESULT_OK;
 }
 
-static result_t trn_fspfs_dir_next(void *data, trn_dirent_t *dirent) {
-	idirectory_t *dir = (idirectory_t*)data;
-	result_t r;
-	idirectoryentry_t entry;
+static result_t fspfs_dir_fill(struct fspfs_dir *dir) {
 	uint64_t entries_read;
+	result_t r;
 
-	if ((r = idirectory_read(*dir, &entries_read, &entry, 1 * sizeof(idirectoryentry_t))) != RESULT_OK)
+	if ((r = idirectory_read(dir->dir, &entries_read, dir->entries, sizeof(dir->entries))) != RESULT_OK)
 		return r;
-	if (entries_read == 0)
-		return LIBTRANSISTOR_ERR_FS_OUT_OF_DIR_ENTRIES;
+	dir->count = entries_read;
+	dir->pos = 0;
+	dir->eof = entries_read == 0;
+	return RESULT_OK;
+}
+
+static result_t fspfs_dir_take(struct fspfs_dir *dir, trn_dirent_t *dirent) {
+	idirectoryentry_t *entry = &dir->entries[dir->pos++];
 
-	size_t entry_path_len = strlen(entry.path);
+	size_t entry_path_len = strnlen(entry->path, sizeof(entry->path));
 	if (entry_path_len >= sizeof(dirent->name))
 		return LIBTRANSISTOR_ERR_FS_NAME_TOO_LONG;
 
 	dirent->name_size = entry_path_len;
-	strcpy(dirent->name, entry.path);
-
+	memcpy(dirent->name, entry->path, entry_path_len);
+	dirent->name[entry_path_len] = '\0';
 	return RESULT_OK;
 }
 
+static result_t trn_fspfs_dir_next(void *data, trn_dirent_t *dirent) {
+	struct fspfs_dir *dir = data;
+	result_t r;
+
+	if (dir->pos == dir->count) {
+		if (dir->eof)
+			return LIBTRANSISTOR_ERR_FS_OUT_OF_DIR_ENTRIES;
+		if ((r = fspfs_dir_fill(dir)) != RESULT_OK)
+			return r;
+		if (dir->eof)
+			return LIBTRANSISTOR_ERR_FS_OUT_OF_DIR_ENTRIES;
+	}
+
+	return fspfs_dir_take(dir, dirent);
+}
+
+static result_t trn_fspfs_dir_next_batch(void *data, trn_dirent_t *dirents, size_t count, size_t *read) {
+	struct fspfs_dir *dir = data;
+	size_t i = 0;
+	result_t r = RESULT_OK;
+
+	while (i < count) {
+		if (dir->pos == dir->count) {
+			if (dir->eof || (r = fspfs_dir_fill(dir)) != RESULT_OK || dir->eof)
+				break;
+		}
+		// an entry we can't represent gets reported on its own, by the next call
+		if (i > 0 && strnlen(dir->entries[dir->pos].path, sizeof(dir->entries[dir->pos].path)) >= sizeof(dirents[i].name))
+			break;
+		if ((r = fspfs_dir_take(dir, &dirents[i])) != RESULT_OK)
+			break;
+		i++;
+	}
+
+	if (i > 0)
+		r = RESULT_OK;
+	*read = i;
+	return r;
+}
+
 static void trn_fspfs_dir_close(void *data) {
-	idirectory_t *dir = (idirectory_t*)data;
+	struct fspfs_dir *dir = data;
 
-	ipc_close(*dir);
+	ipc_close(dir->dir);
 	free(dir);
 }
 
+// Read-ahead windows start at FSPFS_READAHEAD_MIN once a file looks like it's
+// being read sequentially, and double on every refill up to
+// FSPFS_READAHEAD_MAX. Any non-sequential read drops the window.
+#define FSPFS_PAGE_SIZE 0x1000
+#define FSPFS_READAHEAD_MIN (16 * 1024)
+#define FSPFS_READAHEAD_MAX (512 * 1024)
+#define FSPFS_WRITEBACK_SIZE (128 * 1024)
+
+static _Atomic(size_t) cache_budget = TRN_FSPFS_DEFAULT_CACHE_BUDGET;
+static _Atomic(size_t) cache_used = 0;
+static _Atomic(uint64_t) stat_read_ipcs = 0;
+static _Atomic(uint64_t) stat_write_ipcs = 0;
+static _Atomic(uint64_t) stat_cached_read_bytes = 0;
+static _Atomic(uint64_t) stat_buffered_write_bytes = 0;
+
+static bool cache_reserve(size_t size) {
+	size_t used = atomic_load(&cache_used);
+	do {
+		if (used + size > atomic_load(&cache_budget))
+			return false;
+	} while (!atomic_compare_exchange_weak(&cache_used, &used, used + size));
+	return true;
+}
+
+// Contents are discarded. On failure, the buffer is left empty.
+static bool cache_buf_resize(struct cache_buf *b, size_t capacity) {
+	if (b->capacity == capacity)
+		return true;
+
+	free(b->data);
+	atomic_fetch_sub(&cache_used, b->capacity);
+	b->data = NULL;
+	b->capacity = 0;
+	b->len = 0;
+
+	if (capacity == 0 || !cache_reserve(capacity))
+		return capacity == 0;
+
+	b->data = malloc(capacity);
+	if (b->data == NULL) {
+		atomic_fetch_sub(&cache_used, capacity);
+		return false;
+	}
+	b->capacity = capacity;
+	return true;
+}
+
+static bool overlaps(uint64_t a_off, size_t a_len, uint64_t b_off, size_t b_len) {
+	return a_len > 0 && b_len > 0 && a_off < b_off + b_len && b_off < a_off + a_len;
+}
+
+static result_t ifs_read(struct ifs_file *f, void *buf, size_t size, uint64_t offset, size_t *bytes_read) {
+	uint64_t out_size;
+	result_t r;
+
+	atomic_fetch_add(&stat_read_ipcs, 1);
+	if ((r = ifile_read(f->file, &out_size, buf, size, 0, offset, size)) != RESULT_OK)
+		return r;
+	*bytes_read = out_size;
+	return RESULT_OK;
+}
+
+static result_t ifs_write(struct ifs_file *f, const void *buf, size_t size, uint64_t offset) {
+	atomic_fetch_add(&stat_write_ipcs, 1);
+	return ifile_write(f->file, 0, offset, size, buf, size);
+}
+
+static result_t writeback_flush(struct ifs_file *f) REQUIRES(f->lock) {
+	result_t r;
+
+	if (f->wb.len == 0)
+		return RESULT_OK;
+	if ((r = ifs_write(f, f->wb.data, f->wb.len, f->wb.offset)) != RESULT_OK) {
+		// whatever size we were reporting, it isn't what's on disk
+		attr_invalidate(f->attr);
+		return r;
+	}
+	f->wb.len = 0;
+	return RESULT_OK;
+}
+
+static result_t cached_pread(struct ifs_file *f, void *buf, size_t size, uint64_t offset, size_t *bytes_read) REQUIRES(f->lock) {
+	char *dst = buf;
+	size_t done = 0;
+	result_t r;
+
+	// the backend has to see dirty data before we can read it back. dirty
+	// data past the read may also have grown the file, so that has to go
+	// out too, or we'd see a short read.
+	if (f->wb.len > 0 && f->wb.offset + f->wb.len > offset) {
+		if ((r = writeback_flush(f)) != RESULT_OK)
+			return r;
+	}
+
+	if (offset == f->ra_next) {
+		if (f->ra_window == 0)
+			f->ra_window = FSPFS_READAHEAD_MIN;
+	} else if (f->ra_window != 0) {
+		f->ra_window = 0;
+		cache_buf_resize(&f->ra, 0);
+	}
+
+	while (done < size) {
+		uint64_t pos = offset + done;
+		size_t chunk;
+
+		if (pos >= f->ra.offset && pos < f->ra.offset + f->ra.len) {
+			chunk = f->ra.offset + f->ra.len - pos;
+			if (chunk > size - done)
+				chunk = size - done;
+			memcpy(dst + done, f->ra.data + (pos - f->ra.offset), chunk);
+			atomic_fetch_add(&stat_cached_read_bytes, chunk);
+			done += chunk;
+			continue;
+		}
+
+		// refill the window, starting on a page boundary. reads that are
+		// bigger than the window are better off going straight into the
+		// caller's buffer.
+		uint64_t start = pos & ~(uint64_t) (FSPFS_PAGE_SIZE - 1);
+		if (f->ra_window != 0 && size - done >= f->ra_window) {
+			// still sequential, so keep growing the window in case the
+			// reads get smaller again
+			if (f->ra_window < FSPFS_READAHEAD_MAX)
+				f->ra_window *= 2;
+			if ((r = ifs_read(f, dst + done, size - done, pos, &chunk)) != RESULT_OK)
+				goto fail;
+			done += chunk;
+			break;
+		}
+		if (f->ra_window == 0 || !cache_buf_resize(&f->ra, f->ra_window)) {
+			if ((r = ifs_read(f, dst + done, size - done, pos, &chunk)) != RESULT_OK)
+				goto fail;
+			done += chunk;
+			break;
+		}
+
+		if ((r = ifs_read(f, f->ra.data, f->ra.capacity, start, &f->ra.len)) != RESULT_OK)
+			goto fail;
+		f->ra.offset = start;
+		if (f->ra_window < FSPFS_READAHEAD_MAX)
+			f->ra_window *= 2;
+		if (f->ra.len <= pos - start)
+			break; // EOF
+	}
+
+	f->ra_next = offset + done;
+	*bytes_read = done;
+	return RESULT_OK;
+
+fail:
+	f->ra.len = 0;
+	if (done > 0) {
+		// report what we did get as a short read
+		f->ra_next = offset + done;
+		*bytes_read = done;
+		return RESULT_OK;
+	}
+	return r;
+}
+
+static result_t cached_pwrite(struct ifs_file *f, const void *buf, size_t size, uint64_t offset, size_t *bytes_written) REQUIRES(f->lock) {
+	result_t r;
+
+	if (overlaps(f->ra.offset, f->ra.len, offset, size))
+		f->ra.len = 0;
+
+	// extend or overwrite the dirty range if that keeps it contiguous
+	if (f->wb.len > 0 &&
+	    offset >= f->wb.offset && offset <= f->wb.offset + f->wb.len &&
+	    offset + size <= f->wb.offset + f->wb.capacity) {
+		goto buffer;
+	}
+
+	if ((r = writeback_flush(f)) != RESULT_OK)
+		return r;
+
+	if (size >= FSPFS_WRITEBACK_SIZE || !cache_buf_resize(&f->wb, FSPFS_WRITEBACK_SIZE)) {
+		if ((r = ifs_write(f, buf, size, offset)) != RESULT_OK) {
+			attr_invalidate(f->attr);
+			return r;
+		}
+		if (size > 0)
+			attr_extend(f->attr, offset + size);
+		*bytes_written = size;
+		return RESULT_OK;
+	}
+	f->wb.offset = offset;
+
+buffer:
+	memcpy(f->wb.data + (offset - f->wb.offset), buf, size);
+	if (offset + size > f->wb.offset + f->wb.len)
+		f->wb.len = offset + size - f->wb.offset;
+	atomic_fetch_add(&stat_buffered_write_bytes, size);
+	if (size > 0)
+		attr_extend(f->attr, offset + size);
+	*bytes_written = size;
+	return RESULT_OK;
+}
+
+static result_t file_size(struct ifs_file *f, uint64_t *size) REQUIRES(f->lock) {
+	result_t r;
+
+	if (attr_get_size(f->attr, size))
+		return RESULT_OK;
+
+	if ((r = ifile_get_size(f->file, size)) != RESULT_OK)
+		return r;
+	// dirty data may extend the file past what fsp-srv knows about
+	if (f->wb.len > 0 && f->wb.offset + f->wb.len > *size)
+		*size = f->wb.offset + f->wb.len;
+	attr_set_size(f->attr, *size);
+	return RESULT_OK;
+}
+
 static result_t fspfs_file_seek(void *data, off_t offset, int whence, off_t *position) {
 	struct ifs_file *file = data;
 	uint64_t fsize;
-	result_t r;
+	result_t r = RESULT_OK;
 
+	trn_mutex_lock(&file->lock);
 	switch(whence) {
 	case SEEK_SET:
 		file->head = offset;
@@ -289,63 +679,276 @@ static result_t fspfs_file_seek(void *data, off_t offset, int whence, off_t *pos
 		file->head+= offset;
 		break;
 	case SEEK_END:
-		if ((r = ifile_get_size(file->file, &fsize)) != RESULT_OK)
-			return r;
+		if ((r = file_size(file, &fsize)) != RESULT_OK)
+			goto done;
 		file->head = fsize + offset;
 		break;
 	default:
-		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+		r = LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+		goto done;
 	}
 
 	*position = file->head;
-	return RESULT_OK;
+done:
+	trn_mutex_unlock(&file->lock);
+	return r;
 }
 
 static result_t fspfs_file_read(void *data, void *buf, size_t buf_size, size_t *bytes_read) {
 	struct ifs_file *f = data;
-	uint64_t out_size;
 	result_t r;
 
-	if ((r = ifile_read(f->file, &out_size, buf, buf_size, 0, f->head, buf_size)) != RESULT_OK) {
+	trn_mutex_lock(&f->lock);
+	if ((r = cached_pread(f, buf, buf_size, f->head, bytes_read)) != RESULT_OK) {
 		printf("read: Got an error: %x\n", r);
-		return r;
+		goto done;
 	}
-	f->head += out_size;
-	*bytes_read = out_size;
-	return RESULT_OK;
+	f->head += *bytes_read;
+done:
+	trn_mutex_unlock(&f->lock);
+	return r;
 }
 
 static result_t fspfs_file_write(void *data, const void *buf, size_t buf_size, size_t *bytes_written) {
 	struct ifs_file *f = data;
 	result_t r;
 
-	if ((r = ifile_write(f->file, 0, f->head, buf_size, buf, buf_size)) != RESULT_OK) {
+	trn_mutex_lock(&f->lock);
+	if ((r = cached_pwrite(f, buf, buf_size, f->head, bytes_written)) != RESULT_OK) {
 		printf("write: Got an error: %x\n", r);
-		return r;
+		goto done;
+	}
+	f->head += *bytes_written;
+done:
+	trn_mutex_unlock(&f->lock);
+	return r;
+}
+
+static result_t fspfs_file_pread(void *data, void *buf, size_t buf_size, off_t offset, size_t *bytes_read) {
+	struct ifs_file *f = data;
+	result_t r;
+
+	if (offset < 0)
+		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+	trn_mutex_lock(&f->lock);
+	r = cached_pread(f, buf, buf_size, offset, bytes_read);
+	trn_mutex_unlock(&f->lock);
+	return r;
+}
+
+static result_t fspfs_file_pwrite(void *data, const void *buf, size_t buf_size, off_t offset, size_t *bytes_written) {
+	struct ifs_file *f = data;
+	result_t r;
+
+	if (offset < 0)
+		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+	trn_mutex_lock(&f->lock);
+	r = cached_pwrite(f, buf, buf_size, offset, bytes_written);
+	trn_mutex_unlock(&f->lock);
+	return r;
+}
+
+static size_t iov_total(const struct iovec *iov, int iovcnt) {
+	size_t total = 0;
+	for (int i = 0; i < iovcnt; i++)
+		total += iov[i].iov_len;
+	return total;
+}
+
+// Scatter/gather goes through a bounce buffer so that the whole vector is a
+// single access as far as the cache is concerned. If we can't get one, fall
+// back to one access per buffer.
+static result_t fspfs_file_readv(void *data, const struct iovec *iov, int iovcnt, size_t *bytes_read) {
+	struct ifs_file *f = data;
+	size_t total = iov_total(iov, iovcnt);
+	size_t out_size = 0;
+	result_t r = RESULT_OK;
+
+	char *bounce = iovcnt > 1 ? malloc(total) : NULL;
+
+	trn_mutex_lock(&f->lock);
+	if (bounce == NULL) {
+		for (int i = 0; i < iovcnt; i++) {
+			size_t chunk;
+			if ((r = cached_pread(f, iov[i].iov_base, iov[i].iov_len, f->head, &chunk)) != RESULT_OK)
+				goto done;
+			f->head += chunk;
+			out_size += chunk;
+			if (chunk < iov[i].iov_len)
+				break;
+		}
+		*bytes_read = out_size;
+		goto done;
+	}
+
+	if ((r = cached_pread(f, bounce, total, f->head, &out_size)) != RESULT_OK)
+		goto done;
+	f->head += out_size;
+	*bytes_read = out_size;
+
+	char *src = bounce;
+	for (int i = 0; i < iovcnt && out_size > 0; i++) {
+		size_t chunk = iov[i].iov_len < out_size ? iov[i].iov_len : out_size;
+		memcpy(iov[i].iov_base, src, chunk);
+		src += chunk;
+		out_size -= chunk;
+	}
+
+done:
+	trn_mutex_unlock(&f->lock);
+	free(bounce);
+	return r;
+}
+
+static result_t fspfs_file_writev(void *data, const struct iovec *iov, int iovcnt, size_t *bytes_written) {
+	struct ifs_file *f = data;
+	size_t total = iov_total(iov, iovcnt);
+	size_t out_size = 0;
+	result_t r = RESULT_OK;
+
+	char *bounce = iovcnt > 1 ? malloc(total) : NULL;
+
+	trn_mutex_lock(&f->lock);
+	if (bounce == NULL) {
+		for (int i = 0; i < iovcnt; i++) {
+			size_t chunk;
+			if ((r = cached_pwrite(f, iov[i].iov_base, iov[i].iov_len, f->head, &chunk)) != RESULT_OK)
+				goto done;
+			f->head += chunk;
+			out_size += chunk;
+		}
+		*bytes_written = out_size;
+		goto done;
+	}
+
+	char *dst = bounce;
+	for (int i = 0; i < iovcnt; i++) {
+		memcpy(dst, iov[i].iov_base, iov[i].iov_len);
+		dst += iov[i].iov_len;
 	}
-	f->head += buf_size;
-	*bytes_written = buf_size;
+
+	if ((r = cached_pwrite(f, bounce, total, f->head, &out_size)) == RESULT_OK) {
+		f->head += out_size;
+		*bytes_written = out_size;
+	}
+
+done:
+	trn_mutex_unlock(&f->lock);
+	free(bounce);
+	return r;
+}
+
+static result_t fspfs_file_flush(void *data) {
+	struct ifs_file *f = data;
+	result_t r;
+
+	trn_mutex_lock(&f->lock);
+	if ((r = writeback_flush(f)) == RESULT_OK)
+		r = ifile_flush(f->file);
+	trn_mutex_unlock(&f->lock);
+	return r;
+}
+
+static result_t fspfs_file_truncate(void *data, off_t length) {
+	struct ifs_file *f = data;
+	result_t r;
+
+	trn_mutex_lock(&f->lock);
+	if ((r = writeback_flush(f)) == RESULT_OK)
+		r = ifile_set_size(f->file, length);
+	if (r == RESULT_OK)
+		attr_set_size(f->attr, length);
+	else
+		attr_invalidate(f->attr);
+	f->ra.len = 0;
+	trn_mutex_unlock(&f->lock);
+	return r;
+}
+
+static result_t fspfs_file_stat(void *data, struct stat *st) {
+	struct ifs_file *f = data;
+	uint64_t size;
+	result_t r;
+
+	trn_mutex_lock(&f->lock);
+	r = file_size(f, &size);
+	trn_mutex_unlock(&f->lock);
+	if (r != RESULT_OK)
+		return r;
+
+	st->st_mode = S_IFREG;
+	st->st_nlink = 1;
+	st->st_size = size;
+	st->st_blksize = FSPFS_PAGE_SIZE;
 	return RESULT_OK;
 }
 
 static result_t fspfs_file_release(trn_file_t *file) {
 	struct ifs_file *f = file->data;
+	result_t r;
+
+	// nobody else can be holding the file at this point
+	trn_mutex_lock(&f->lock);
+	// close reports this, since it only ever comes from the last reference
+	r = writeback_flush(f);
+	cache_buf_resize(&f->ra, 0);
+	cache_buf_resize(&f->wb, 0);
+	trn_mutex_unlock(&f->lock);
 
 	ipc_close(f->file);
+	attr_close(f->attr);
+	attr_put(f->attr);
 	free(f);
-	return RESULT_OK;
+	return r;
 }
 
 static trn_file_ops_t fspfs_file_ops = {
 	.seek = fspfs_file_seek,
 	.read = fspfs_file_read,
 	.write = fspfs_file_write,
-	.release = fspfs_file_release
+	.flush = fspfs_file_flush,
+	.release = fspfs_file_release,
+	.pread = fspfs_file_pread,
+	.pwrite = fspfs_file_pwrite,
+	.readv = fspfs_file_readv,
+	.writev = fspfs_file_writev,
+	.truncate = fspfs_file_truncate,
+	.stat = fspfs_file_stat,
 };
 
+// Only regular files have a size. Unless we've seen it since we last changed
+// it, we have to open the file to ask, once.
+static result_t fspfs_stat(void *data, struct stat *st) {
+	struct inode *inode = (struct inode*)data;
+	ifile_t file;
+	uint64_t size;
+	result_t r;
+
+	st->st_nlink = 1;
+	st->st_blksize = FSPFS_PAGE_SIZE;
+	if (inode->is_dir) {
+		st->st_mode = S_IFDIR;
+		return RESULT_OK;
+	}
+	st->st_mode = S_IFREG;
+
+	if (!attr_get_size(inode->attr, &size)) {
+		if ((r = ifilesystem_open_file(inode->fs, &file, 1, inode->path)) != RESULT_OK)
+			return r;
+		r = ifile_get_size(file, &size);
+		ipc_close(file);
+		if (r != RESULT_OK)
+			return r;
+		attr_set_size(inode->attr, size);
+	}
+	st->st_size = size;
+	return RESULT_OK;
+}
+
 static trn_dir_ops_t trn_fspfs_dir_ops = {
 	.next = trn_fspfs_dir_next,
 	.close = trn_fspfs_dir_close,
+	.next_batch = trn_fspfs_dir_next_batch,
 };
 
 static trn_inode_ops_t fspfs_inode_ops = {
@@ -358,7 +961,8 @@ static trn_inode_ops_t fspfs_inode_ops = {
 	.remove_file = fspfs_remove_file,
 	.remove_empty_directory = fspfs_remove_empty_directory,
 	.open_as_file = fspfs_open_as_file,
-	.open_as_dir = fspfs_open_as_dir
+	.open_as_dir = fspfs_open_as_dir,
+	.stat = fspfs_stat,
 };
 
 // Takes ownership of the ifilesystem. Will close it automatically on release.
@@ -367,6 +971,11 @@ result_t trn_fspfs_create(trn_inode_t *out, ifilesystem_t fs) {
 	if (inode == NULL)
 		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
 
+	inode->attr = attr_create();
+	if (inode->attr == NULL) {
+		free(inode);
+		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+	}
 	inode->is_dir = true;
 	inode->fs = fs;
 	inode->path_len = 1;
@@ -377,3 +986,26 @@ result_t trn_fspfs_create(trn_inode_t *out, ifilesystem_t fs) {
 	out->ops = &fspfs_inode_ops;
 	return RESULT_OK;
 }
+
+void trn_fspfs_set_cache_budget(size_t bytes) {
+	atomic_store(&cache_budget, bytes);
+}
+
+size_t trn_fspfs_get_cache_budget() {
+	return atomic_load(&cache_budget);
+}
+
+void trn_fspfs_get_cache_stats(trn_fspfs_cache_stats_t *out) {
+	out->read_ipcs = atomic_load(&stat_read_ipcs);
+	out->write_ipcs = atomic_load(&stat_write_ipcs);
+	out->cached_read_bytes = atomic_load(&stat_cached_read_bytes);
+	out->buffered_write_bytes = atomic_load(&stat_buffered_write_bytes);
+	out->bytes_in_use = atomic_load(&cache_used);
+}
+
+void trn_fspfs_reset_cache_stats() {
+	atomic_store(&stat_read_ipcs, 0);
+	atomic_store(&stat_write_ipcs, 0);
+	atomic_store(&stat_cached_read_bytes, 0);
+	atomic_store(&stat_buffered_write_bytes, 0);
+}
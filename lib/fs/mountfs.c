@@ -3,23 +3,58 @@
 #include<libtransistor/fs/inode.h>
 #include<libtransistor/fd.h>
 #include<libtransistor/err.h>
+#include<libtransistor/mutex.h>
 
 #include<errno.h>
 #include<string.h>
 #include<stdlib.h>
+#include<stdatomic.h>
 #include<sys/stat.h>
 #include<stdio.h>
 
 #define max(a,b) ((a) > (b) ? (a) : (b))
 
+#define MOUNT_TABLE_INITIAL_SLOTS 16
+
+/*
+ * Mountpoints are found through an open-addressed hash table keyed on their
+ * name. Lookups run on every path operation that starts at the root, from any
+ * number of threads, while mounts are rare, so lookups never take a lock:
+ *
+ * - A slot goes from empty to holding a mountpoint, and from one mountpoint
+ *   to another with the same name, but never back to empty. A lookup that
+ *   sees an empty slot can stop there.
+ * - When the table gets half full, mounting builds a bigger copy and then
+ *   publishes it. Lookups still walking the old table keep seeing a table
+ *   that was valid when they started, so old tables are kept around until
+ *   the mountfs is released.
+ *
+ * Mounting itself is serialized by the mountfs lock.
+ */
+
 struct mountpoint {
-	struct mountpoint *next;
+	struct mountpoint *_Atomic next; // every mountpoint, newest first
 	char name[256]; // TODO: Static array ?
+	size_t name_len;
+	uint32_t hash;
 	trn_inode_t fs;
 	trn_inode_ops_t ops_clone;
 	result_t (*original_release)(void *inode);
 };
 
+struct mount_table {
+	struct mount_table *retired; // the table this one replaced
+	size_t mask;
+	size_t count;
+	struct mountpoint *_Atomic slots[];
+};
+
+struct mountfs {
+	trn_mutex_t lock;
+	struct mount_table *_Atomic table;
+	struct mountpoint *_Atomic mounts;
+};
+
 static struct trn_inode_ops_t mountfs_inode_ops;
 static trn_dir_ops_t trn_mountfs_dir_ops;
 
@@ -27,13 +62,71 @@ static result_t empty_release(void *inode) {
 	return RESULT_OK;
 }
 
+static uint32_t mount_hash(const char *name, size_t len) {
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (uint8_t) name[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static struct mount_table *mount_table_alloc(size_t slots) {
+	struct mount_table *table = calloc(1, sizeof(*table) + slots * sizeof(table->slots[0]));
+	if (table == NULL)
+		return NULL;
+	table->mask = slots - 1;
+	return table;
+}
+
+// Returns the slot holding the mountpoint with the given name, or the empty
+// slot it would go in.
+static struct mountpoint *_Atomic *mount_table_find(struct mount_table *table, const char *name, size_t len, uint32_t hash) {
+	for (size_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+		struct mountpoint *m = atomic_load_explicit(&table->slots[i], memory_order_acquire);
+		if (m == NULL || (m->hash == hash && m->name_len == len && memcmp(m->name, name, len) == 0))
+			return &table->slots[i];
+	}
+}
+
+static result_t mount_table_insert(struct mountfs *mfs, struct mountpoint *m) REQUIRES(mfs->lock) {
+	struct mount_table *table = atomic_load_explicit(&mfs->table, memory_order_relaxed);
+	struct mountpoint *_Atomic *slot = mount_table_find(table, m->name, m->name_len, m->hash);
+	if (atomic_load_explicit(slot, memory_order_relaxed) != NULL) {
+		// mounting over an existing name hides the old mount
+		atomic_store_explicit(slot, m, memory_order_release);
+		return RESULT_OK;
+	}
+
+	if ((table->count + 1) * 2 > table->mask + 1) {
+		struct mount_table *grown = mount_table_alloc((table->mask + 1) * 2);
+		if (grown == NULL)
+			return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+		for (size_t i = 0; i <= table->mask; i++) {
+			struct mountpoint *old = atomic_load_explicit(&table->slots[i], memory_order_relaxed);
+			if (old != NULL)
+				atomic_store_explicit(mount_table_find(grown, old->name, old->name_len, old->hash), old, memory_order_relaxed);
+		}
+		grown->count = table->count;
+		grown->retired = table;
+		table = grown;
+		slot = mount_table_find(table, m->name, m->name_len, m->hash);
+	}
+	atomic_store_explicit(slot, m, memory_order_release);
+	table->count++;
+	// publishes the grown table along with everything in it
+	atomic_store_explicit(&mfs->table, table, memory_order_release);
+	return RESULT_OK;
+}
+
 // It takes ownership of the mountpoint, and will call release on it automatically
 // on umount.
 result_t trn_mountfs_mount_fs(trn_inode_t *fs, const char *name, trn_inode_t mountpoint) {
 	if (fs == NULL || fs->ops != &mountfs_inode_ops)
 		return LIBTRANSISTOR_ERR_FS_INTERNAL_ERROR;
 
-	struct mountpoint **cur_root = (struct mountpoint**)fs->data;
+	struct mountfs *mfs = (struct mountfs*)fs->data;
+	result_t r;
 
 	struct mountpoint *m = malloc(sizeof(struct mountpoint));
 	if (m == NULL)
@@ -58,6 +151,8 @@ result_t trn_mountfs_mount_fs(trn_inode_t *fs, const char *name, trn_inode_t mou
 	}
 	strncpy(m->name, name + i, sizeof(m->name));
 	m->name[sizeof(m->name)-1] = '\0'; // just making sure
+	m->name_len = strlen(m->name);
+	m->hash = mount_hash(m->name, m->name_len);
 	
 	m->fs = mountpoint;
 	m->ops_clone = *m->fs.ops;
@@ -65,9 +160,15 @@ result_t trn_mountfs_mount_fs(trn_inode_t *fs, const char *name, trn_inode_t mou
 	m->ops_clone.release = empty_release;
 	m->fs.ops = &m->ops_clone;
 
-	// TODO: Locking
-	m->next = *cur_root;
-	*cur_root = m;
+	trn_mutex_lock(&mfs->lock);
+	if ((r = mount_table_insert(mfs, m)) != RESULT_OK) {
+		trn_mutex_unlock(&mfs->lock);
+		free(m);
+		return r;
+	}
+	atomic_store_explicit(&m->next, atomic_load_explicit(&mfs->mounts, memory_order_relaxed), memory_order_relaxed);
+	atomic_store_explicit(&mfs->mounts, m, memory_order_release);
+	trn_mutex_unlock(&mfs->lock);
 
 	return RESULT_OK;
 }
@@ -80,12 +181,9 @@ static result_t trn_mountfs_is_dir(void *data, bool *out) {
 
 static result_t trn_mountfs_lookup(void *data, trn_inode_t *out, const char *name, size_t name_length) {
 	// This should only have a single inode ever. So I don't need to check the data out.
-	struct mountpoint **mounts = (struct mountpoint**)data;
-	struct mountpoint *cur_mount = *mounts;
-	for (; cur_mount != NULL; cur_mount = cur_mount->next) {
-		if (strncmp(cur_mount->name, name, name_length) == 0)
-			break;
-	}
+	struct mountfs *mfs = (struct mountfs*)data;
+	struct mount_table *table = atomic_load_explicit(&mfs->table, memory_order_acquire);
+	struct mountpoint *cur_mount = atomic_load_explicit(mount_table_find(table, name, name_length, mount_hash(name, name_length)), memory_order_acquire);
 	if (cur_mount == NULL)
 		return LIBTRANSISTOR_ERR_FS_NOT_FOUND;
 
@@ -95,16 +193,27 @@ static result_t trn_mountfs_lookup(void *data, trn_inode_t *out, const char *nam
 }
 
 static result_t trn_mountfs_release(void *data) {
-	struct mountpoint **mounts = (struct mountpoint**)data;
-	struct mountpoint *cur_mount = *mounts;
+	struct mountfs *mfs = (struct mountfs*)data;
+	struct mountpoint *cur_mount = atomic_load(&mfs->mounts);
 	result_t r;
 
-	for (; cur_mount != NULL; cur_mount = cur_mount->next) {
+	while (cur_mount != NULL) {
+		struct mountpoint *next = atomic_load(&cur_mount->next);
 		// Print the error, and discard it.
 		r = cur_mount->original_release(cur_mount->fs.data);
 		if (r != RESULT_OK)
 			printf("Error unmounting %s: %x\n", cur_mount->name, r);
+		free(cur_mount);
+		cur_mount = next;
 	}
+
+	struct mount_table *table = atomic_load(&mfs->table);
+	while (table != NULL) {
+		struct mount_table *retired = table->retired;
+		free(table);
+		table = retired;
+	}
+	free(mfs);
 	return RESULT_OK;
 }
 
@@ -139,7 +248,7 @@ static result_t trn_mountfs_open_as_dir(void *data, trn_dir_t *out) {
 	if (mounts == NULL)
 		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
 
-	*mounts = *(struct mountpoint**)data;
+	*mounts = atomic_load_explicit(&((struct mountfs*)data)->mounts, memory_order_acquire);
 	out->data = mounts;
 	out->ops = &trn_mountfs_dir_ops;
 	return RESULT_OK;
@@ -156,7 +265,7 @@ static result_t trn_mountfs_dir_next(void *data, trn_dirent_t *dirent) {
 
 	strncpy(dirent->name, (*mount)->name, mount_len);
 	dirent->name_size = mount_len;
-	*mount = (*mount)->next;
+	*mount = atomic_load_explicit(&(*mount)->next, memory_order_relaxed);
 	return RESULT_OK;
 }
 
@@ -179,14 +288,19 @@ static struct trn_inode_ops_t mountfs_inode_ops = {
 };
 
 result_t trn_mountfs_create(trn_inode_t *out) {
-	// TODO: This is a bit dumb. Functions should be passed a pointer to their
-	// data so they can change it directly. This would avoid this allocation.
-	struct mountpoint **mountpoint = malloc(sizeof(struct mountpoint*));
-	if (mountpoint == NULL)
+	struct mountfs *mfs = malloc(sizeof(*mfs));
+	if (mfs == NULL)
 		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
 
-	*mountpoint = NULL;
-	out->data = mountpoint;
+	struct mount_table *table = mount_table_alloc(MOUNT_TABLE_INITIAL_SLOTS);
+	if (table == NULL) {
+		free(mfs);
+		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+	}
+	trn_mutex_create(&mfs->lock);
+	atomic_init(&mfs->table, table);
+	atomic_init(&mfs->mounts, NULL);
+	out->data = mfs;
 	out->ops = &mountfs_inode_ops;
 	return RESULT_OK;
 }
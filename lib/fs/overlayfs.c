@@ -0,0 +1,1401 @@
+#include<libtransistor/fs/overlayfs.h>
+
+#include<libtransistor/types.h>
+#include<libtransistor/err.h>
+#include<libtransistor/fd.h>
+#include<libtransistor/mutex.h>
+#include<libtransistor/fs/fs.h>
+#include<fcntl.h>
+#include<stdatomic.h>
+#include<stdint.h>
+#include<stdlib.h>
+#include<string.h>
+#include<sys/stat.h>
+
+#define WHITEOUT_PREFIX ".wh."
+#define WHITEOUT_PREFIX_LEN 4
+#define OPAQUE_MARKER ".wh..wh..opq"
+#define NAME_MAX_LEN 255
+#define NEG_BUCKETS 256
+#define DIR_BATCH 16
+#define COPY_BUF_SIZE 0x10000
+
+// A name known to be missing from the upper layer, keyed by its full path in
+// the overlay.
+typedef struct neg_entry_t neg_entry_t;
+struct neg_entry_t {
+	neg_entry_t *next; // in its bucket
+	neg_entry_t *lru_prev;
+	neg_entry_t *lru_next;
+	uint64_t hash;
+	size_t len;
+	char path[];
+};
+
+typedef struct {
+	// Guards the negative cache, the stats, and which layers each node has.
+	trn_mutex_t lock;
+	// Held for the whole of anything that changes the upper layer, so that
+	// copy-ups and whiteouts don't race each other.
+	trn_mutex_t write_lock ACQUIRED_BEFORE(lock);
+
+	size_t neg_max GUARDED_BY(lock);
+	size_t neg_count GUARDED_BY(lock);
+	uint64_t neg_gen GUARDED_BY(lock); // bumped whenever entries are invalidated
+	neg_entry_t *neg_buckets[NEG_BUCKETS] GUARDED_BY(lock);
+	neg_entry_t *lru_head GUARDED_BY(lock);
+	neg_entry_t *lru_tail GUARDED_BY(lock);
+	trn_overlayfs_stats_t stats GUARDED_BY(lock);
+
+	char *upper_path; // without a trailing slash
+} ovfs_t;
+
+typedef struct ovnode_t ovnode_t;
+struct ovnode_t {
+	ovfs_t *fs;
+	_Atomic(int) refs;
+	ovnode_t *parent; // holds a reference, NULL for the root
+	char *path; // from the root of the overlay, empty for the root itself
+	size_t path_len;
+	const char *name; // last component of path
+	size_t name_len;
+	bool is_dir;
+	bool in_lower; // the name exists in the lower layer, so removing it needs a whiteout
+
+	// Guarded by fs->lock, and only ever changed with fs->write_lock held.
+	// Layers are kept until the node is released, even once it's been removed.
+	bool removed;
+	bool has_upper;
+	trn_inode_t upper;
+	bool has_lower; // a lower file, or the lower half of a merged directory
+	trn_inode_t lower;
+};
+
+typedef struct {
+	bool removed;
+	bool has_upper;
+	trn_inode_t upper;
+	bool has_lower;
+	trn_inode_t lower;
+} layers_t;
+
+// A directory stream over the upper layer's entries, followed by whatever
+// lower entries they don't hide.
+typedef struct {
+	char **hidden; // sorted; upper entries, and the names of whiteouts
+	size_t hidden_count;
+	char **names; // the upper entries to hand out, pointing into hidden
+	size_t count;
+	size_t pos;
+	bool has_lower;
+	bool lower_done;
+	trn_dir_t lower;
+} ovdir_t;
+
+static trn_inode_ops_t ov_inode_ops;
+static trn_dir_ops_t ov_dir_ops;
+
+static bool is_whiteout_name(const char *name, size_t name_len) {
+	return name_len >= WHITEOUT_PREFIX_LEN && memcmp(name, WHITEOUT_PREFIX, WHITEOUT_PREFIX_LEN) == 0;
+}
+
+/*
+ * Negative cache
+ */
+
+static uint64_t neg_hash(const char *dir, size_t dir_len, const char *name, size_t name_len) {
+	uint64_t h = 14695981039346656037ull;
+	for(size_t i = 0; i < dir_len; i++) {
+		h = (h ^ (uint8_t) dir[i]) * 1099511628211ull;
+	}
+	h = (h ^ '/') * 1099511628211ull;
+	for(size_t i = 0; i < name_len; i++) {
+		h = (h ^ (uint8_t) name[i]) * 1099511628211ull;
+	}
+	return h;
+}
+
+static neg_entry_t **neg_find(ovfs_t *fs, uint64_t hash, const char *dir, size_t dir_len, const char *name, size_t name_len) REQUIRES(fs->lock) {
+	neg_entry_t **ep;
+	for(ep = &fs->neg_buckets[hash % NEG_BUCKETS]; *ep != NULL; ep = &(*ep)->next) {
+		neg_entry_t *e = *ep;
+		if(e->hash == hash && e->len == dir_len + 1 + name_len &&
+		   memcmp(e->path, dir, dir_len) == 0 && e->path[dir_len] == '/' &&
+		   memcmp(e->path + dir_len + 1, name, name_len) == 0) {
+			break;
+		}
+	}
+	return ep;
+}
+
+static void neg_lru_unlink(ovfs_t *fs, neg_entry_t *e) REQUIRES(fs->lock) {
+	if(e->lru_prev != NULL) {
+		e->lru_prev->lru_next = e->lru_next;
+	} else {
+		fs->lru_head = e->lru_next;
+	}
+	if(e->lru_next != NULL) {
+		e->lru_next->lru_prev = e->lru_prev;
+	} else {
+		fs->lru_tail = e->lru_prev;
+	}
+}
+
+static void neg_lru_push(ovfs_t *fs, neg_entry_t *e) REQUIRES(fs->lock) {
+	e->lru_prev = NULL;
+	e->lru_next = fs->lru_head;
+	if(fs->lru_head != NULL) {
+		fs->lru_head->lru_prev = e;
+	} else {
+		fs->lru_tail = e;
+	}
+	fs->lru_head = e;
+}
+
+static void neg_unlink(ovfs_t *fs, neg_entry_t **ep) REQUIRES(fs->lock) {
+	neg_entry_t *e = *ep;
+	*ep = e->next;
+	neg_lru_unlink(fs, e);
+	fs->neg_count--;
+	free(e);
+}
+
+static void neg_trim(ovfs_t *fs) REQUIRES(fs->lock) {
+	while(fs->neg_count > fs->neg_max) {
+		neg_entry_t *e = fs->lru_tail;
+		neg_entry_t **ep = &fs->neg_buckets[e->hash % NEG_BUCKETS];
+		while(*ep != e) {
+			ep = &(*ep)->next;
+		}
+		neg_unlink(fs, ep);
+	}
+}
+
+static void neg_flush(ovfs_t *fs) REQUIRES(fs->lock) {
+	while(fs->lru_head != NULL) {
+		neg_entry_t *e = fs->lru_head;
+		fs->lru_head = e->lru_next;
+		free(e);
+	}
+	memset(fs->neg_buckets, 0, sizeof(fs->neg_buckets));
+	fs->lru_tail = NULL;
+	fs->neg_count = 0;
+	fs->neg_gen++;
+}
+
+static void neg_insert(ovfs_t *fs, uint64_t hash, const char *dir, size_t dir_len, const char *name, size_t name_len) REQUIRES(fs->lock) {
+	if(fs->neg_max == 0 || *neg_find(fs, hash, dir, dir_len, name, name_len) != NULL) {
+		return;
+	}
+	neg_entry_t *e = malloc(sizeof(*e) + dir_len + 1 + name_len + 1);
+	if(e == NULL) {
+		return;
+	}
+	e->hash = hash;
+	e->len = dir_len + 1 + name_len;
+	memcpy(e->path, dir, dir_len);
+	e->path[dir_len] = '/';
+	memcpy(e->path + dir_len + 1, name, name_len);
+	e->path[e->len] = 0;
+
+	e->next = fs->neg_buckets[hash % NEG_BUCKETS];
+	fs->neg_buckets[hash % NEG_BUCKETS] = e;
+	neg_lru_push(fs, e);
+	fs->neg_count++;
+	neg_trim(fs);
+}
+
+// Something was just created in the upper layer at dir/name.
+static void upper_created(ovfs_t *fs, const char *dir, size_t dir_len, const char *name, size_t name_len) {
+	uint64_t hash = neg_hash(dir, dir_len, name, name_len);
+
+	trn_mutex_lock(&fs->lock);
+	neg_entry_t **ep = neg_find(fs, hash, dir, dir_len, name, name_len);
+	if(*ep != NULL) {
+		neg_unlink(fs, ep);
+	}
+	fs->neg_gen++;
+	trn_mutex_unlock(&fs->lock);
+}
+
+/*
+ * Nodes
+ */
+
+static void get_layers(ovnode_t *node, layers_t *l) {
+	ovfs_t *fs = node->fs;
+
+	trn_mutex_lock(&fs->lock);
+	l->removed = node->removed;
+	l->has_upper = node->has_upper;
+	l->upper = node->upper;
+	l->has_lower = node->has_lower;
+	l->lower = node->lower;
+	trn_mutex_unlock(&fs->lock);
+}
+
+static void mark_removed(ovnode_t *node) {
+	trn_mutex_lock(&node->fs->lock);
+	node->removed = true;
+	trn_mutex_unlock(&node->fs->lock);
+}
+
+static ovnode_t *node_create(ovnode_t *parent, const char *name, size_t name_len, bool is_dir) {
+	ovnode_t *node = calloc(1, sizeof(*node));
+	if(node == NULL) {
+		return NULL;
+	}
+	node->path_len = parent->path_len + 1 + name_len;
+	if((node->path = malloc(node->path_len + 1)) == NULL) {
+		free(node);
+		return NULL;
+	}
+	memcpy(node->path, parent->path, parent->path_len);
+	node->path[parent->path_len] = '/';
+	memcpy(node->path + parent->path_len + 1, name, name_len);
+	node->path[node->path_len] = 0;
+	node->name = node->path + parent->path_len + 1;
+	node->name_len = name_len;
+
+	node->fs = parent->fs;
+	node->is_dir = is_dir;
+	atomic_init(&node->refs, 1);
+	atomic_fetch_add(&parent->refs, 1);
+	node->parent = parent;
+	return node;
+}
+
+static void node_put(ovnode_t *node) {
+	// dropping a node can drop its parent, all the way up to the root
+	while(node != NULL && atomic_fetch_sub(&node->refs, 1) == 1) {
+		ovnode_t *parent = node->parent;
+		ovfs_t *fs = node->fs;
+
+		if(node->has_upper) {
+			node->upper.ops->release(node->upper.data);
+		}
+		if(node->has_lower) {
+			node->lower.ops->release(node->lower.data);
+		}
+		if(parent == NULL) {
+			trn_mutex_lock(&fs->lock);
+			neg_flush(fs);
+			trn_mutex_unlock(&fs->lock);
+			free(fs->upper_path);
+			free(fs);
+		}
+		free(node->path);
+		free(node);
+		node = parent;
+	}
+}
+
+// Looks name up in dir's upper layer, going through the negative cache. out
+// may be NULL if only existence matters.
+static result_t upper_lookup(ovnode_t *dir, trn_inode_t *upper_dir, const char *name, size_t name_len, trn_inode_t *out) {
+	ovfs_t *fs = dir->fs;
+	uint64_t hash = neg_hash(dir->path, dir->path_len, name, name_len);
+	trn_inode_t child;
+	uint64_t gen;
+	result_t r;
+
+	trn_mutex_lock(&fs->lock);
+	neg_entry_t **ep = neg_find(fs, hash, dir->path, dir->path_len, name, name_len);
+	if(*ep != NULL) {
+		neg_lru_unlink(fs, *ep);
+		neg_lru_push(fs, *ep);
+		fs->stats.negative_hits++;
+		trn_mutex_unlock(&fs->lock);
+		return LIBTRANSISTOR_ERR_FS_NOT_FOUND;
+	}
+	fs->stats.upper_lookups++;
+	gen = fs->neg_gen;
+	trn_mutex_unlock(&fs->lock);
+
+	r = upper_dir->ops->lookup(upper_dir->data, &child, name, name_len);
+	if(r == LIBTRANSISTOR_ERR_FS_NOT_FOUND) {
+		trn_mutex_lock(&fs->lock);
+		// unless it was created while we were looking
+		if(fs->neg_gen == gen) {
+			neg_insert(fs, hash, dir->path, dir->path_len, name, name_len);
+		}
+		trn_mutex_unlock(&fs->lock);
+		return r;
+	}
+	if(r != RESULT_OK) {
+		return r;
+	}
+	if(out != NULL) {
+		*out = child;
+	} else {
+		child.ops->release(child.data);
+	}
+	return RESULT_OK;
+}
+
+static result_t whiteout_lookup(ovnode_t *dir, trn_inode_t *upper_dir, const char *name, size_t name_len, trn_inode_t *out) {
+	char wh[WHITEOUT_PREFIX_LEN + NAME_MAX_LEN + 1];
+
+	if(name_len > NAME_MAX_LEN) {
+		return LIBTRANSISTOR_ERR_FS_NAME_TOO_LONG;
+	}
+	memcpy(wh, WHITEOUT_PREFIX, WHITEOUT_PREFIX_LEN);
+	memcpy(wh + WHITEOUT_PREFIX_LEN, name, name_len);
+	return upper_lookup(dir, upper_dir, wh, WHITEOUT_PREFIX_LEN + name_len, out);
+}
+
+static result_t lookup_node(ovnode_t *dir, const char *name, size_t name_len, ovnode_t **out) {
+	trn_inode_t upper, lower;
+	bool found_upper = false, found_lower = false;
+	bool upper_is_dir = false, lower_is_dir = false;
+	ovnode_t *node;
+	layers_t l;
+	result_t r;
+
+	if(!dir->is_dir) {
+		return LIBTRANSISTOR_ERR_FS_NOT_A_DIRECTORY;
+	}
+	if(is_whiteout_name(name, name_len)) {
+		return LIBTRANSISTOR_ERR_FS_NOT_FOUND;
+	}
+	get_layers(dir, &l);
+	if(l.removed) {
+		return LIBTRANSISTOR_ERR_FS_NOT_FOUND;
+	}
+
+	if(l.has_lower) {
+		r = l.lower.ops->lookup(l.lower.data, &lower, name, name_len);
+		if(r == RESULT_OK) {
+			found_lower = true;
+		} else if(r != LIBTRANSISTOR_ERR_FS_NOT_FOUND) {
+			return r;
+		}
+	}
+	if(l.has_upper) {
+		r = upper_lookup(dir, &l.upper, name, name_len, &upper);
+		if(r == RESULT_OK) {
+			found_upper = true;
+		} else if(r != LIBTRANSISTOR_ERR_FS_NOT_FOUND) {
+			goto fail;
+		} else if(found_lower) {
+			// the lower one may have been removed
+			r = whiteout_lookup(dir, &l.upper, name, name_len, NULL);
+			if(r == RESULT_OK) {
+				r = LIBTRANSISTOR_ERR_FS_NOT_FOUND;
+				goto fail;
+			} else if(r != LIBTRANSISTOR_ERR_FS_NOT_FOUND) {
+				goto fail;
+			}
+		}
+	}
+	if(!found_upper && !found_lower) {
+		return LIBTRANSISTOR_ERR_FS_NOT_FOUND;
+	}
+
+	if(found_upper && (r = upper.ops->is_dir(upper.data, &upper_is_dir)) != RESULT_OK) {
+		goto fail;
+	}
+	if(found_lower && (r = lower.ops->is_dir(lower.data, &lower_is_dir)) != RESULT_OK) {
+		goto fail;
+	}
+	if((node = node_create(dir, name, name_len, found_upper ? upper_is_dir : lower_is_dir)) == NULL) {
+		r = LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+		goto fail;
+	}
+	node->in_lower = found_lower;
+	if(found_upper) {
+		node->has_upper = true;
+		node->upper = upper;
+	}
+	if(found_lower) {
+		// upper files hide lower ones, and directories are merged unless
+		// they've been made opaque
+		bool merge = !found_upper || (upper_is_dir && lower_is_dir);
+		if(merge && found_upper) {
+			r = upper_lookup(node, &upper, OPAQUE_MARKER, strlen(OPAQUE_MARKER), NULL);
+			if(r == RESULT_OK) {
+				merge = false;
+			} else if(r != LIBTRANSISTOR_ERR_FS_NOT_FOUND) {
+				lower.ops->release(lower.data);
+				node_put(node);
+				return r;
+			}
+		}
+		if(merge) {
+			node->has_lower = true;
+			node->lower = lower;
+		} else {
+			lower.ops->release(lower.data);
+		}
+	}
+
+	*out = node;
+	return RESULT_OK;
+
+fail:
+	if(found_upper) {
+		upper.ops->release(upper.data);
+	}
+	if(found_lower) {
+		lower.ops->release(lower.data);
+	}
+	return r;
+}
+
+/*
+ * Changing the upper layer
+ */
+
+static result_t copy_file(trn_inode_t *from, trn_inode_t *to) {
+	trn_file_t *in = NULL, *out = NULL;
+	int in_fd, out_fd;
+	uint8_t *buf;
+	result_t r;
+
+	if((buf = malloc(COPY_BUF_SIZE)) == NULL) {
+		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+	}
+	if((r = from->ops->open_as_file(from->data, O_RDONLY, &in_fd)) != RESULT_OK) {
+		goto done_buf;
+	}
+	if((r = to->ops->open_as_file(to->data, O_WRONLY | O_TRUNC, &out_fd)) != RESULT_OK) {
+		goto done_in;
+	}
+	in = fd_file_get(in_fd);
+	out = fd_file_get(out_fd);
+	if(in == NULL || out == NULL) {
+		r = LIBTRANSISTOR_ERR_FS_INTERNAL_ERROR;
+		goto done_out;
+	}
+
+	for(;;) {
+		size_t bytes_read, done = 0;
+		if((r = in->ops->read(in->data, buf, COPY_BUF_SIZE, &bytes_read)) != RESULT_OK || bytes_read == 0) {
+			break;
+		}
+		while(done < bytes_read) {
+			size_t bytes_written;
+			if((r = out->ops->write(out->data, buf + done, bytes_read - done, &bytes_written)) != RESULT_OK) {
+				goto done_out;
+			}
+			done+= bytes_written;
+		}
+	}
+	if(r == RESULT_OK && out->ops->flush != NULL) {
+		r = out->ops->flush(out->data);
+	}
+
+done_out:
+	if(out != NULL) {
+		fd_file_put(out);
+	}
+	if(in != NULL) {
+		fd_file_put(in);
+	}
+	fd_close(out_fd);
+done_in:
+	fd_close(in_fd);
+done_buf:
+	free(buf);
+	return r;
+}
+
+// Makes sure node has an upper layer, creating its parents there too. Files
+// get their contents copied if copy_data is set.
+static result_t copy_up(ovfs_t *fs, ovnode_t *node, bool copy_data) REQUIRES(fs->write_lock) {
+	char name[NAME_MAX_LEN + 1];
+	trn_inode_t upper;
+	layers_t l, pl;
+	result_t r;
+
+	get_layers(node, &l);
+	if(l.removed) {
+		return LIBTRANSISTOR_ERR_FS_NOT_FOUND;
+	}
+	if(l.has_upper) {
+		return RESULT_OK;
+	}
+	// the root always has an upper layer, so this stops there
+	if((r = copy_up(fs, node->parent, true)) != RESULT_OK) {
+		return r;
+	}
+	get_layers(node->parent, &pl);
+
+	memcpy(name, node->name, node->name_len);
+	name[node->name_len] = 0;
+	if(node->is_dir) {
+		r = pl.upper.ops->create_directory(pl.upper.data, name);
+	} else {
+		r = pl.upper.ops->create_file(pl.upper.data, name);
+	}
+	if(r != RESULT_OK && r != LIBTRANSISTOR_ERR_FS_PATH_EXISTS) {
+		return r;
+	}
+	upper_created(fs, node->parent->path, node->parent->path_len, node->name, node->name_len);
+	if((r = pl.upper.ops->lookup(pl.upper.data, &upper, node->name, node->name_len)) != RESULT_OK) {
+		return r;
+	}
+	if(!node->is_dir && copy_data && (r = copy_file(&l.lower, &upper)) != RESULT_OK) {
+		upper.ops->remove_file(upper.data);
+		upper.ops->release(upper.data);
+		return r;
+	}
+
+	trn_mutex_lock(&fs->lock);
+	node->has_upper = true;
+	node->upper = upper;
+	fs->stats.copy_ups++;
+	trn_mutex_unlock(&fs->lock);
+	return RESULT_OK;
+}
+
+static result_t make_whiteout(ovfs_t *fs, ovnode_t *dir, const char *name, size_t name_len) REQUIRES(fs->write_lock) {
+	char wh[WHITEOUT_PREFIX_LEN + NAME_MAX_LEN + 1];
+	layers_t l;
+	result_t r;
+
+	if(name_len > NAME_MAX_LEN) {
+		return LIBTRANSISTOR_ERR_FS_NAME_TOO_LONG;
+	}
+	if((r = copy_up(fs, dir, true)) != RESULT_OK) {
+		return r;
+	}
+	get_layers(dir, &l);
+
+	memcpy(wh, WHITEOUT_PREFIX, WHITEOUT_PREFIX_LEN);
+	memcpy(wh + WHITEOUT_PREFIX_LEN, name, name_len);
+	wh[WHITEOUT_PREFIX_LEN + name_len] = 0;
+	r = l.upper.ops->create_file(l.upper.data, wh);
+	if(r != RESULT_OK && r != LIBTRANSISTOR_ERR_FS_PATH_EXISTS) {
+		return r;
+	}
+	upper_created(fs, dir->path, dir->path_len, wh, WHITEOUT_PREFIX_LEN + name_len);
+	return RESULT_OK;
+}
+
+// Removes the whiteout for dir/name, if there is one.
+static result_t remove_whiteout(ovfs_t *fs, ovnode_t *dir, trn_inode_t *upper_dir, const char *name, size_t name_len, bool *removed) REQUIRES(fs->write_lock) {
+	trn_inode_t wh;
+	result_t r;
+
+	*removed = false;
+	r = whiteout_lookup(dir, upper_dir, name, name_len, &wh);
+	if(r == LIBTRANSISTOR_ERR_FS_NOT_FOUND) {
+		return RESULT_OK;
+	}
+	if(r != RESULT_OK) {
+		return r;
+	}
+	r = wh.ops->remove_file(wh.data);
+	wh.ops->release(wh.data);
+	*removed = r == RESULT_OK;
+	return r;
+}
+
+// Hides the lower contents of the upper directory at dir/name.
+static result_t make_opaque(ovfs_t *fs, ovnode_t *dir, trn_inode_t *upper_dir, const char *name, size_t name_len) REQUIRES(fs->write_lock) {
+	trn_inode_t child;
+	char *path;
+	result_t r;
+
+	if((r = upper_dir->ops->lookup(upper_dir->data, &child, name, name_len)) != RESULT_OK) {
+		return r;
+	}
+	r = child.ops->create_file(child.data, OPAQUE_MARKER);
+	child.ops->release(child.data);
+	if(r != RESULT_OK && r != LIBTRANSISTOR_ERR_FS_PATH_EXISTS) {
+		return r;
+	}
+
+	if((path = malloc(dir->path_len + 1 + name_len)) == NULL) {
+		trn_mutex_lock(&fs->lock);
+		neg_flush(fs);
+		trn_mutex_unlock(&fs->lock);
+		return RESULT_OK;
+	}
+	memcpy(path, dir->path, dir->path_len);
+	path[dir->path_len] = '/';
+	memcpy(path + dir->path_len + 1, name, name_len);
+	upper_created(fs, path, dir->path_len + 1 + name_len, OPAQUE_MARKER, strlen(OPAQUE_MARKER));
+	free(path);
+	return RESULT_OK;
+}
+
+/*
+ * Directory streams
+ */
+
+static int compare_names(const void *a, const void *b) {
+	return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+static bool dir_hides(ovdir_t *dir, const char *name) {
+	return bsearch(&name, dir->hidden, dir->hidden_count, sizeof(*dir->hidden), compare_names) != NULL;
+}
+
+static void ovdir_free(ovdir_t *dir) {
+	for(size_t i = 0; i < dir->hidden_count; i++) {
+		free(dir->hidden[i]);
+	}
+	free(dir->hidden);
+	free(dir->names);
+	if(dir->has_lower && dir->lower.ops->close != NULL) {
+		dir->lower.ops->close(dir->lower.data);
+	}
+	free(dir);
+}
+
+static result_t ovdir_add(ovdir_t *dir, const char *name, size_t name_len, bool visible, size_t *capacity) {
+	if(dir->hidden_count == *capacity) {
+		size_t new_capacity = *capacity ? *capacity * 2 : DIR_BATCH;
+		char **hidden = realloc(dir->hidden, new_capacity * sizeof(*hidden));
+		if(hidden == NULL) {
+			return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+		}
+		dir->hidden = hidden;
+		char **names = realloc(dir->names, new_capacity * sizeof(*names));
+		if(names == NULL) {
+			return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+		}
+		dir->names = names;
+		*capacity = new_capacity;
+	}
+	char *copy = malloc(name_len + 1);
+	if(copy == NULL) {
+		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+	}
+	memcpy(copy, name, name_len);
+	copy[name_len] = 0;
+	dir->hidden[dir->hidden_count++] = copy;
+	if(visible) {
+		dir->names[dir->count++] = copy;
+	}
+	return RESULT_OK;
+}
+
+// The upper directory is read in full up front, so we know what to hide.
+static result_t open_merged(layers_t *l, trn_dir_t *out) {
+	trn_dirent_t dirents[DIR_BATCH];
+	trn_dir_t upper;
+	size_t capacity = 0, read;
+	result_t r;
+
+	ovdir_t *dir = calloc(1, sizeof(*dir));
+	if(dir == NULL) {
+		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+	}
+
+	if((r = l->upper.ops->open_as_dir(l->upper.data, &upper)) != RESULT_OK) {
+		free(dir);
+		return r;
+	}
+	for(;;) {
+		if((r = trn_fs_readdir_batch(&upper, dirents, DIR_BATCH, &read)) != RESULT_OK || read == 0) {
+			break;
+		}
+		for(size_t i = 0; i < read && r == RESULT_OK; i++) {
+			const char *name = dirents[i].name;
+			size_t name_len = dirents[i].name_size;
+			if(name_len == strlen(OPAQUE_MARKER) && memcmp(name, OPAQUE_MARKER, name_len) == 0) {
+				continue;
+			}
+			if(is_whiteout_name(name, name_len)) {
+				r = ovdir_add(dir, name + WHITEOUT_PREFIX_LEN, name_len - WHITEOUT_PREFIX_LEN, false, &capacity);
+			} else {
+				r = ovdir_add(dir, name, name_len, true, &capacity);
+			}
+		}
+		if(r != RESULT_OK) {
+			break;
+		}
+	}
+	if(upper.ops->close != NULL) {
+		upper.ops->close(upper.data);
+	}
+	if(r != RESULT_OK) {
+		ovdir_free(dir);
+		return r;
+	}
+	if(dir->hidden_count > 0) {
+		qsort(dir->hidden, dir->hidden_count, sizeof(*dir->hidden), compare_names);
+	}
+
+	if(l->has_lower) {
+		if((r = l->lower.ops->open_as_dir(l->lower.data, &dir->lower)) != RESULT_OK) {
+			ovdir_free(dir);
+			return r;
+		}
+		dir->has_lower = true;
+	}
+
+	out->data = dir;
+	out->ops = &ov_dir_ops;
+	return RESULT_OK;
+}
+
+static result_t ov_dir_rewind(void *data) {
+	ovdir_t *dir = data;
+	result_t r;
+
+	if(dir->has_lower) {
+		if(dir->lower.ops->rewind == NULL) {
+			return LIBTRANSISTOR_ERR_UNIMPLEMENTED;
+		}
+		if((r = dir->lower.ops->rewind(dir->lower.data)) != RESULT_OK) {
+			return r;
+		}
+	}
+	dir->pos = 0;
+	dir->lower_done = false;
+	return RESULT_OK;
+}
+
+static result_t ov_dir_next_batch(void *data, trn_dirent_t *dirents, size_t count, size_t *read) {
+	ovdir_t *dir = data;
+	size_t i = 0;
+	result_t r = RESULT_OK;
+
+	for(; i < count && dir->pos < dir->count; i++) {
+		const char *name = dir->names[dir->pos++];
+		dirents[i].name_size = strlen(name);
+		memcpy(dirents[i].name, name, dirents[i].name_size + 1);
+	}
+
+	while(i < count && dir->has_lower && !dir->lower_done) {
+		size_t lower_read;
+		if((r = trn_fs_readdir_batch(&dir->lower, dirents + i, count - i, &lower_read)) != RESULT_OK) {
+			break;
+		}
+		if(lower_read == 0) {
+			dir->lower_done = true;
+			break;
+		}
+		// squeeze out the hidden ones
+		size_t kept = i;
+		for(size_t j = i; j < i + lower_read; j++) {
+			if(!dir_hides(dir, dirents[j].name)) {
+				if(kept != j) {
+					dirents[kept] = dirents[j];
+				}
+				kept++;
+			}
+		}
+		i = kept;
+	}
+
+	// hand back whatever we got before an error
+	if(i > 0) {
+		r = RESULT_OK;
+	}
+	*read = i;
+	return r;
+}
+
+static result_t ov_dir_next(void *data, trn_dirent_t *dirent) {
+	size_t read;
+	result_t r = ov_dir_next_batch(data, dirent, 1, &read);
+	if(r == RESULT_OK && read == 0) {
+		r = LIBTRANSISTOR_ERR_FS_OUT_OF_DIR_ENTRIES;
+	}
+	return r;
+}
+
+static void ov_dir_close(void *data) {
+	ovdir_free(data);
+}
+
+static trn_dir_ops_t ov_dir_ops = {
+	.rewind = ov_dir_rewind,
+	.next = ov_dir_next,
+	.close = ov_dir_close,
+	.next_batch = ov_dir_next_batch,
+};
+
+static result_t open_dir(ovnode_t *node, trn_dir_t *out) {
+	layers_t l;
+
+	if(!node->is_dir) {
+		return LIBTRANSISTOR_ERR_FS_NOT_A_DIRECTORY;
+	}
+	get_layers(node, &l);
+	if(l.removed) {
+		return LIBTRANSISTOR_ERR_FS_NOT_FOUND;
+	}
+	// there's nothing to hide in the lower layer on its own
+	if(!l.has_upper) {
+		return l.lower.ops->open_as_dir(l.lower.data, out);
+	}
+	return open_merged(&l, out);
+}
+
+static result_t dir_is_empty(ovnode_t *node, bool *empty) {
+	trn_dirent_t dirent;
+	trn_dir_t dir;
+	size_t read;
+	result_t r;
+
+	if((r = open_dir(node, &dir)) != RESULT_OK) {
+		return r;
+	}
+	r = trn_fs_readdir_batch(&dir, &dirent, 1, &read);
+	if(dir.ops->close != NULL) {
+		dir.ops->close(dir.data);
+	}
+	*empty = read == 0;
+	return r;
+}
+
+// Removes an upper directory that only has whiteouts left in it.
+static result_t remove_upper_dir(trn_inode_t *upper) {
+	trn_dirent_t dirents[DIR_BATCH];
+	trn_dir_t dir;
+	size_t read;
+	result_t r;
+
+	// collect the names first, rather than removing things while reading
+	char **names = NULL;
+	size_t count = 0;
+	if((r = upper->ops->open_as_dir(upper->data, &dir)) != RESULT_OK) {
+		return r;
+	}
+	while((r = trn_fs_readdir_batch(&dir, dirents, DIR_BATCH, &read)) == RESULT_OK && read > 0) {
+		char **grown = realloc(names, (count + read) * sizeof(*names));
+		if(grown == NULL) {
+			r = LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+			break;
+		}
+		names = grown;
+		for(size_t i = 0; i < read; i++) {
+			if((names[count] = strdup(dirents[i].name)) != NULL) {
+				count++;
+			}
+		}
+	}
+	if(dir.ops->close != NULL) {
+		dir.ops->close(dir.data);
+	}
+
+	for(size_t i = 0; i < count; i++) {
+		trn_inode_t wh;
+		if(r == RESULT_OK && (r = upper->ops->lookup(upper->data, &wh, names[i], strlen(names[i]))) == RESULT_OK) {
+			r = wh.ops->remove_file(wh.data);
+			wh.ops->release(wh.data);
+		}
+		free(names[i]);
+	}
+	free(names);
+
+	if(r == RESULT_OK) {
+		r = upper->ops->remove_empty_directory(upper->data);
+	}
+	return r;
+}
+
+/*
+ * Inodes
+ */
+
+static result_t ov_is_dir(void *data, bool *out) {
+	ovnode_t *node = data;
+	*out = node->is_dir;
+	return RESULT_OK;
+}
+
+static result_t ov_lookup(void *data, trn_inode_t *out, const char *name, size_t name_length) {
+	ovnode_t *node;
+	result_t r;
+
+	if((r = lookup_node(data, name, name_length, &node)) != RESULT_OK) {
+		return r;
+	}
+	out->data = node;
+	out->ops = &ov_inode_ops;
+	return RESULT_OK;
+}
+
+static result_t ov_release(void *data) {
+	node_put(data);
+	return RESULT_OK;
+}
+
+static result_t ov_create(ovnode_t *dir, const char *name, bool is_dir) {
+	ovfs_t *fs = dir->fs;
+	size_t name_len = strcspn(name, "/");
+	char buf[NAME_MAX_LEN + 1];
+	ovnode_t *existing;
+	bool opaque;
+	layers_t l;
+	result_t r;
+
+	if(!dir->is_dir) {
+		return LIBTRANSISTOR_ERR_FS_NOT_A_DIRECTORY;
+	}
+	if(name_len == 0 || is_whiteout_name(name, name_len)) {
+		return LIBTRANSISTOR_ERR_FS_INVALID_PATH;
+	}
+	if(name_len > NAME_MAX_LEN) {
+		return LIBTRANSISTOR_ERR_FS_NAME_TOO_LONG;
+	}
+	memcpy(buf, name, name_len);
+	buf[name_len] = 0;
+
+	trn_mutex_lock(&fs->write_lock);
+	if((r = lookup_node(dir, buf, name_len, &existing)) == RESULT_OK) {
+		node_put(existing);
+		r = LIBTRANSISTOR_ERR_FS_PATH_EXISTS;
+		goto done;
+	}
+	if(r != LIBTRANSISTOR_ERR_FS_NOT_FOUND) {
+		goto done;
+	}
+	if((r = copy_up(fs, dir, true)) != RESULT_OK) {
+		goto done;
+	}
+	get_layers(dir, &l);
+
+	// if something in the lower layer was removed here, a new directory
+	// mustn't show its contents
+	if((r = remove_whiteout(fs, dir, &l.upper, buf, name_len, &opaque)) != RESULT_OK) {
+		goto done;
+	}
+	if(is_dir) {
+		r = l.upper.ops->create_directory(l.upper.data, buf);
+	} else {
+		r = l.upper.ops->create_file(l.upper.data, buf);
+	}
+	if(r != RESULT_OK) {
+		goto done;
+	}
+	upper_created(fs, dir->path, dir->path_len, buf, name_len);
+	if(is_dir && opaque) {
+		r = make_opaque(fs, dir, &l.upper, buf, name_len);
+	}
+
+done:
+	trn_mutex_unlock(&fs->write_lock);
+	return r;
+}
+
+static result_t ov_create_file(void *data, const char *name) {
+	return ov_create(data, name, false);
+}
+
+static result_t ov_create_directory(void *data, const char *name) {
+	return ov_create(data, name, true);
+}
+
+static result_t ov_remove_file(void *data) {
+	ovnode_t *node = data;
+	ovfs_t *fs = node->fs;
+	layers_t l;
+	result_t r = RESULT_OK;
+
+	if(node->is_dir) {
+		return LIBTRANSISTOR_ERR_FS_NOT_A_FILE;
+	}
+
+	trn_mutex_lock(&fs->write_lock);
+	get_layers(node, &l);
+	if(l.removed) {
+		r = LIBTRANSISTOR_ERR_FS_NOT_FOUND;
+		goto done;
+	}
+	// whiteout first, so that failing halfway leaves the file in place
+	if(node->in_lower && (r = make_whiteout(fs, node->parent, node->name, node->name_len)) != RESULT_OK) {
+		goto done;
+	}
+	if(l.has_upper && (r = l.upper.ops->remove_file(l.upper.data)) != RESULT_OK) {
+		goto done;
+	}
+	mark_removed(node);
+
+done:
+	trn_mutex_unlock(&fs->write_lock);
+	return r;
+}
+
+static result_t ov_remove_empty_directory(void *data) {
+	ovnode_t *node = data;
+	ovfs_t *fs = node->fs;
+	bool empty;
+	layers_t l;
+	result_t r;
+
+	if(!node->is_dir) {
+		return LIBTRANSISTOR_ERR_FS_NOT_A_DIRECTORY;
+	}
+	if(node->parent == NULL) {
+		return LIBTRANSISTOR_ERR_FS_ACCESS_DENIED;
+	}
+
+	trn_mutex_lock(&fs->write_lock);
+	if((r = dir_is_empty(node, &empty)) != RESULT_OK) {
+		goto done;
+	}
+	if(!empty) {
+		r = LIBTRANSISTOR_ERR_FS_DIRECTORY_NOT_EMPTY;
+		goto done;
+	}
+	get_layers(node, &l);
+	if(node->in_lower && (r = make_whiteout(fs, node->parent, node->name, node->name_len)) != RESULT_OK) {
+		goto done;
+	}
+	if(l.has_upper && (r = remove_upper_dir(&l.upper)) != RESULT_OK) {
+		goto done;
+	}
+	mark_removed(node);
+
+done:
+	trn_mutex_unlock(&fs->write_lock);
+	return r;
+}
+
+// Walks newpath from the root, and returns the directory its last component
+// goes in.
+static result_t resolve_parent(ovnode_t *node, const char *path, ovnode_t **out_dir, const char **out_name, size_t *out_name_len) {
+	ovnode_t *dir = node;
+	ovnode_t *next;
+	result_t r;
+
+	while(dir->parent != NULL) {
+		dir = dir->parent;
+	}
+	atomic_fetch_add(&dir->refs, 1);
+
+	for(;;) {
+		while(*path == '/') {
+			path++;
+		}
+		const char *name = path;
+		size_t name_len = strcspn(name, "/");
+		path+= name_len;
+		while(*path == '/') {
+			path++;
+		}
+		if(*path == 0) {
+			*out_dir = dir;
+			*out_name = name;
+			*out_name_len = name_len;
+			return RESULT_OK;
+		}
+
+		if(name_len == 1 && name[0] == '.') {
+			continue;
+		}
+		if(name_len == 2 && memcmp(name, "..", 2) == 0) {
+			if((next = dir->parent) != NULL) {
+				atomic_fetch_add(&next->refs, 1);
+				node_put(dir);
+				dir = next;
+			}
+			continue;
+		}
+		if((r = lookup_node(dir, name, name_len, &next)) != RESULT_OK) {
+			node_put(dir);
+			return r;
+		}
+		node_put(dir);
+		dir = next;
+		if(!dir->is_dir) {
+			node_put(dir);
+			return LIBTRANSISTOR_ERR_FS_NOT_A_DIRECTORY;
+		}
+	}
+}
+
+// newpath is relative to the root of the overlay.
+static result_t ov_rename(void *data, const char *newpath) {
+	ovnode_t *node = data;
+	ovfs_t *fs = node->fs;
+	ovnode_t *dir = NULL, *target = NULL;
+	const char *name;
+	size_t name_len;
+	char buf[NAME_MAX_LEN + 1];
+	char *upper_newpath = NULL;
+	bool opaque = false, had_whiteout, empty;
+	layers_t l, dl, tl;
+	result_t r;
+
+	if(node->parent == NULL) {
+		return LIBTRANSISTOR_ERR_FS_ACCESS_DENIED;
+	}
+
+	trn_mutex_lock(&fs->write_lock);
+	get_layers(node, &l);
+	if(l.removed) {
+		r = LIBTRANSISTOR_ERR_FS_NOT_FOUND;
+		goto done;
+	}
+	// that would mean copying the whole tree up
+	if(node->is_dir && l.has_lower) {
+		r = LIBTRANSISTOR_ERR_UNIMPLEMENTED;
+		goto done;
+	}
+
+	if((r = resolve_parent(node, newpath, &dir, &name, &name_len)) != RESULT_OK) {
+		dir = NULL;
+		goto done;
+	}
+	if(name_len == 0 || (name_len == 1 && name[0] == '.') || (name_len == 2 && memcmp(name, "..", 2) == 0) ||
+	   is_whiteout_name(name, name_len)) {
+		r = LIBTRANSISTOR_ERR_FS_INVALID_PATH;
+		goto done;
+	}
+	if(name_len > NAME_MAX_LEN) {
+		r = LIBTRANSISTOR_ERR_FS_NAME_TOO_LONG;
+		goto done;
+	}
+	memcpy(buf, name, name_len);
+	buf[name_len] = 0;
+
+	// a directory can't be moved into itself
+	for(ovnode_t *d = dir; d != NULL; d = d->parent) {
+		if(d->path_len == node->path_len && memcmp(d->path, node->path, node->path_len) == 0) {
+			r = LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+			goto done;
+		}
+	}
+
+	// whatever is already there gets replaced, if it's the same kind of thing
+	r = lookup_node(dir, buf, name_len, &target);
+	if(r == RESULT_OK) {
+		if(target->path_len == node->path_len && memcmp(target->path, node->path, node->path_len) == 0) {
+			goto done;
+		}
+		if(node->is_dir && !target->is_dir) {
+			r = LIBTRANSISTOR_ERR_FS_NOT_A_DIRECTORY;
+			goto done;
+		}
+		if(!node->is_dir && target->is_dir) {
+			r = LIBTRANSISTOR_ERR_FS_NOT_A_FILE;
+			goto done;
+		}
+		if(target->is_dir) {
+			if((r = dir_is_empty(target, &empty)) != RESULT_OK) {
+				goto done;
+			}
+			if(!empty) {
+				r = LIBTRANSISTOR_ERR_FS_DIRECTORY_NOT_EMPTY;
+				goto done;
+			}
+		}
+		// no whiteout for it, since what we're moving takes its place
+		get_layers(target, &tl);
+		if(tl.has_upper) {
+			if(target->is_dir) {
+				r = remove_upper_dir(&tl.upper);
+			} else {
+				r = tl.upper.ops->remove_file(tl.upper.data);
+			}
+			if(r != RESULT_OK) {
+				goto done;
+			}
+		}
+		opaque = target->in_lower;
+		mark_removed(target);
+	} else if(r != LIBTRANSISTOR_ERR_FS_NOT_FOUND) {
+		goto done;
+	}
+
+	if(!node->is_dir && (r = copy_up(fs, node, true)) != RESULT_OK) {
+		goto done;
+	}
+	if((r = copy_up(fs, dir, true)) != RESULT_OK) {
+		goto done;
+	}
+	get_layers(dir, &dl);
+	if((r = remove_whiteout(fs, dir, &dl.upper, buf, name_len, &had_whiteout)) != RESULT_OK) {
+		goto done;
+	}
+	opaque|= had_whiteout;
+
+	// the upper layer wants a path from its own root
+	size_t upper_path_len = strlen(fs->upper_path);
+	if((upper_newpath = malloc(upper_path_len + dir->path_len + 1 + name_len + 1)) == NULL) {
+		r = LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+		goto done;
+	}
+	memcpy(upper_newpath, fs->upper_path, upper_path_len);
+	memcpy(upper_newpath + upper_path_len, dir->path, dir->path_len);
+	upper_newpath[upper_path_len + dir->path_len] = '/';
+	memcpy(upper_newpath + upper_path_len + dir->path_len + 1, buf, name_len + 1);
+
+	get_layers(node, &l);
+	if((r = l.upper.ops->rename(l.upper.data, upper_newpath)) != RESULT_OK) {
+		goto done;
+	}
+	upper_created(fs, dir->path, dir->path_len, buf, name_len);
+	if(node->is_dir) {
+		// everything under it moved
+		trn_mutex_lock(&fs->lock);
+		neg_flush(fs);
+		trn_mutex_unlock(&fs->lock);
+		if(opaque && (r = make_opaque(fs, dir, &dl.upper, buf, name_len)) != RESULT_OK) {
+			goto done;
+		}
+	}
+	if(node->in_lower && (r = make_whiteout(fs, node->parent, node->name, node->name_len)) != RESULT_OK) {
+		goto done;
+	}
+	// its path is stale now, and fs.c flushes the dcache after a rename
+	mark_removed(node);
+
+done:
+	free(upper_newpath);
+	if(target != NULL) {
+		node_put(target);
+	}
+	if(dir != NULL) {
+		node_put(dir);
+	}
+	trn_mutex_unlock(&fs->write_lock);
+	return r;
+}
+
+static result_t ov_open_as_file(void *data, int flags, int *fd) {
+	ovnode_t *node = data;
+	ovfs_t *fs = node->fs;
+	layers_t l;
+	result_t r;
+
+	if(node->is_dir) {
+		return LIBTRANSISTOR_ERR_FS_NOT_A_FILE;
+	}
+	// there's no point copying what's about to be truncated
+	if((flags & O_ACCMODE) != O_RDONLY || (flags & O_TRUNC)) {
+		trn_mutex_lock(&fs->write_lock);
+		r = copy_up(fs, node, !(flags & O_TRUNC));
+		trn_mutex_unlock(&fs->write_lock);
+		if(r != RESULT_OK) {
+			return r;
+		}
+	}
+
+	// files are handed out straight from the layer they're in
+	get_layers(node, &l);
+	if(l.removed) {
+		return LIBTRANSISTOR_ERR_FS_NOT_FOUND;
+	}
+	if(l.has_upper) {
+		return l.upper.ops->open_as_file(l.upper.data, flags, fd);
+	}
+	return l.lower.ops->open_as_file(l.lower.data, flags, fd);
+}
+
+static result_t ov_open_as_dir(void *data, trn_dir_t *out) {
+	return open_dir(data, out);
+}
+
+static result_t ov_stat(void *data, struct stat *st) {
+	ovnode_t *node = data;
+	trn_inode_t *top;
+	layers_t l;
+
+	get_layers(node, &l);
+	if(l.removed) {
+		return LIBTRANSISTOR_ERR_FS_NOT_FOUND;
+	}
+	top = l.has_upper ? &l.upper : &l.lower;
+	if(top->ops->stat != NULL) {
+		return top->ops->stat(top->data, st);
+	}
+	st->st_mode = node->is_dir ? S_IFDIR : S_IFREG;
+	return RESULT_OK;
+}
+
+static trn_inode_ops_t ov_inode_ops = {
+	.is_dir = ov_is_dir,
+	.lookup = ov_lookup,
+	.release = ov_release,
+	.create_file = ov_create_file,
+	.create_directory = ov_create_directory,
+	.remove_file = ov_remove_file,
+	.remove_empty_directory = ov_remove_empty_directory,
+	.rename = ov_rename,
+	.open_as_file = ov_open_as_file,
+	.open_as_dir = ov_open_as_dir,
+	.stat = ov_stat,
+};
+
+result_t trn_overlayfs_create(trn_inode_t *out, trn_inode_t upper, const char *upper_path, trn_inode_t lower) {
+	bool upper_is_dir, lower_is_dir;
+	result_t r;
+
+	if((r = upper.ops->is_dir(upper.data, &upper_is_dir)) != RESULT_OK ||
+	   (r = lower.ops->is_dir(lower.data, &lower_is_dir)) != RESULT_OK) {
+		return r;
+	}
+	if(!upper_is_dir || !lower_is_dir) {
+		return LIBTRANSISTOR_ERR_FS_NOT_A_DIRECTORY;
+	}
+
+	ovfs_t *fs = calloc(1, sizeof(*fs));
+	if(fs == NULL) {
+		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+	}
+	ovnode_t *root = calloc(1, sizeof(*root));
+	if(root == NULL) {
+		goto fail_fs;
+	}
+	size_t upper_path_len = strlen(upper_path);
+	while(upper_path_len > 0 && upper_path[upper_path_len - 1] == '/') {
+		upper_path_len--;
+	}
+	if((fs->upper_path = strndup(upper_path, upper_path_len)) == NULL) {
+		goto fail_root;
+	}
+	if((root->path = strdup("")) == NULL) {
+		goto fail_upper_path;
+	}
+
+	trn_mutex_create(&fs->lock);
+	trn_mutex_create(&fs->write_lock);
+	fs->neg_max = TRN_OVERLAYFS_DEFAULT_NEGATIVE_CACHE_SIZE;
+
+	root->fs = fs;
+	atomic_init(&root->refs, 1);
+	root->name = root->path;
+	root->is_dir = true;
+	root->has_upper = true;
+	root->upper = upper;
+	root->has_lower = true;
+	root->lower = lower;
+
+	out->data = root;
+	out->ops = &ov_inode_ops;
+	return RESULT_OK;
+
+fail_upper_path:
+	free(fs->upper_path);
+fail_root:
+	free(root);
+fail_fs:
+	free(fs);
+	return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+}
+
+void trn_overlayfs_set_negative_cache_size(trn_inode_t *inode, size_t entries) {
+	ovfs_t *fs = ((ovnode_t*) inode->data)->fs;
+
+	trn_mutex_lock(&fs->lock);
+	fs->neg_max = entries;
+	neg_trim(fs);
+	trn_mutex_unlock(&fs->lock);
+}
+
+void trn_overlayfs_flush_negative_cache(trn_inode_t *inode) {
+	ovfs_t *fs = ((ovnode_t*) inode->data)->fs;
+
+	trn_mutex_lock(&fs->lock);
+	neg_flush(fs);
+	trn_mutex_unlock(&fs->lock);
+}
+
+void trn_overlayfs_get_stats(trn_inode_t *inode, trn_overlayfs_stats_t *stats) {
+	ovfs_t *fs = ((ovnode_t*) inode->data)->fs;
+
+	trn_mutex_lock(&fs->lock);
+	*stats = fs->stats;
+	stats->negative_entries = fs->neg_count;
+	trn_mutex_unlock(&fs->lock);
+}
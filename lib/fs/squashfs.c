@@ -3,6 +3,9 @@
 #include<libtransistor/fs/inode.h>
 #include<libtransistor/fd.h>
 #include<libtransistor/err.h>
+#include<libtransistor/mutex.h>
+#include<libtransistor/condvar.h>
+#include<libtransistor/thread.h>
 
 #include<errno.h>
 #include<string.h>
@@ -10,11 +13,20 @@
 #include<sys/stat.h>
 
 #include "../squashfs/squashfuse.h"
+#include "../squashfs/icache.h"
 
 static trn_dir_ops_t trn_sqfs_dir_ops;
 static trn_file_ops_t trn_sqfs_file_ops;
 static trn_inode_ops_t trn_sqfs_inode_ops;
 
+/*
+ * None of squashfuse's caches, pools and indexes are thread-safe, so every
+ * operation that goes into them takes the filesystem's lock for as long as it
+ * does. That includes the per-file read-ahead state, which pread updates,
+ * so it's serialized too. Decompressing ahead of the reader happens
+ * without it, on the read-ahead worker.
+ */
+
 typedef struct {
 	sqfs *fs;
 	sqfs_dir dir;
@@ -22,21 +34,52 @@ typedef struct {
 	char name_buf[SQUASHFS_NAME_LEN + 1];
 } trn_sqfs_dir_t;
 
+typedef enum {
+	RA_QUEUED,
+	RA_RUNNING,
+	RA_DONE,
+} ra_state_t;
+
+// a data block being decompressed ahead of the reader
+typedef struct ra_job_t ra_job_t;
+struct ra_job_t {
+	ra_job_t *next; // in the worker queue
+	sqfs *fs;
+	ra_state_t state;
+	bool abandoned; // the file let go of it while it was running
+	uint64_t index; // block number within the file
+	sqfs_off_t pos;
+	void *in;
+	size_t insize;
+	bool in_owned;
+	sqfs_block *block;
+	sqfs_err err;
+};
+
 typedef struct {
 	sqfs *fs;
 	sqfs_inode inode;
 	off_t head;
+
+	// read-ahead state
+	off_t ra_expected; // where the next read has to start to count as sequential
+	uint64_t ra_next; // next block to queue
+	sqfs_blocklist ra_bl; // positioned at ra_bl_index, if ra_bl_valid
+	bool ra_bl_valid;
+	uint64_t ra_bl_index;
+	ra_job_t *ra_jobs[TRN_SQFS_READAHEAD_MAX]; // indexed by block number
 } trn_sqfs_file_t;
 
-typedef struct {
-	sqfs *fs;
-	sqfs_inode inode;
-} trn_sqfs_inode_t;
+// handed out by the filesystem's inode cache, and given back on release
+typedef sqfs_icache_entry trn_sqfs_inode_t;
 
 static result_t trn_sqfs_dir_next(void *data, trn_dirent_t *dirent) {
 	trn_sqfs_dir_t *dir = data;
 	sqfs_err err = SQFS_OK;
-	if(!sqfs_dir_next(dir->fs, &dir->dir, &dir->dentry, &err)) {
+	trn_mutex_lock(&dir->fs->lock);
+	bool found = sqfs_dir_next(dir->fs, &dir->dir, &dir->dentry, &err);
+	trn_mutex_unlock(&dir->fs->lock);
+	if(!found) {
 		if(err != SQFS_OK) {
 			return LIBTRANSISTOR_ERR_FS_INTERNAL_ERROR;
 		} else {
@@ -78,23 +121,427 @@ static result_t trn_sqfs_file_seek(void *data, off_t offset, int whence, off_t *
 	return RESULT_OK;
 }
 
+/*
+ * Read-ahead
+ *
+ * When a file is being read sequentially, the next few data blocks are queued
+ * up for a worker thread to decompress while the reader is busy with what it
+ * already has. The worker only ever runs the decompressor; everything that
+ * touches the filesystem's caches and metadata stays on the reading thread.
+ * Finished blocks are kept by the file until the reader gets to them, and are
+ * then put in the data cache right before they're read, so read-ahead doesn't
+ * depend on the data cache being large.
+ */
+
+static trn_mutex_t ra_mutex = TRN_MUTEX_STATIC_INITIALIZER;
+static trn_condvar_t ra_work_cond = TRN_CONDVAR_STATIC_INITIALIZER;
+static trn_condvar_t ra_done_cond = TRN_CONDVAR_STATIC_INITIALIZER;
+static ra_job_t *ra_queue_head GUARDED_BY(ra_mutex) = NULL;
+static ra_job_t *ra_queue_tail GUARDED_BY(ra_mutex) = NULL;
+static trn_sqfs_readahead_stats_t ra_stats GUARDED_BY(ra_mutex);
+static _Atomic size_t ra_blocks = TRN_SQFS_DEFAULT_READAHEAD;
+static int32_t ra_core GUARDED_BY(ra_mutex) = -2;
+static trn_thread_t ra_thread GUARDED_BY(ra_mutex);
+static enum {
+	RA_WORKER_STOPPED,
+	RA_WORKER_RUNNING,
+	RA_WORKER_FAILED,
+} ra_worker_state GUARDED_BY(ra_mutex) = RA_WORKER_STOPPED;
+
+static void ra_job_free(ra_job_t *job) {
+	if(job->in_owned) {
+		free(job->in);
+	}
+	if(job->block != NULL) {
+		sqfs_block_dispose(job->block);
+	}
+	free(job);
+}
+
+static void ra_job_run(ra_job_t *job) {
+	job->err = sqfs_block_decompress(job->fs, job->in, job->insize, job->fs->sb.block_size, &job->block);
+	if(job->in_owned) {
+		free(job->in);
+		job->in_owned = false;
+	}
+}
+
+static void ra_worker(void *arg) {
+	trn_mutex_lock(&ra_mutex);
+	while(true) {
+		while(ra_queue_head == NULL) {
+			trn_condvar_wait(&ra_work_cond, &ra_mutex, -1);
+		}
+		ra_job_t *job = ra_queue_head;
+		ra_queue_head = job->next;
+		if(ra_queue_head == NULL) {
+			ra_queue_tail = NULL;
+		}
+		job->state = RA_RUNNING;
+		trn_mutex_unlock(&ra_mutex);
+
+		ra_job_run(job);
+
+		trn_mutex_lock(&ra_mutex);
+		job->state = RA_DONE;
+		if(job->abandoned) {
+			ra_job_free(job);
+		} else {
+			trn_condvar_signal(&ra_done_cond, -1);
+		}
+	}
+}
+
+// only ever called from reading threads, so the worker is started lazily by
+// whoever gets here first
+static bool ra_worker_start() REQUIRES(ra_mutex) {
+	if(ra_worker_state == RA_WORKER_STOPPED) {
+		ra_worker_state = RA_WORKER_FAILED;
+		if(trn_thread_create(&ra_thread, ra_worker, NULL, -1, ra_core, 0x10000, NULL) == RESULT_OK) {
+			if(trn_thread_start(&ra_thread) == RESULT_OK) {
+				ra_worker_state = RA_WORKER_RUNNING;
+			} else {
+				trn_thread_destroy(&ra_thread);
+			}
+		}
+	}
+	return ra_worker_state == RA_WORKER_RUNNING;
+}
+
+static void ra_dequeue(ra_job_t *job) REQUIRES(ra_mutex) {
+	ra_job_t **link = &ra_queue_head;
+	ra_job_t *prev = NULL;
+	while(*link != job) {
+		prev = *link;
+		link = &(*link)->next;
+	}
+	*link = job->next;
+	if(ra_queue_tail == job) {
+		ra_queue_tail = prev;
+	}
+}
+
+static void ra_drop(trn_sqfs_file_t *file, size_t slot) {
+	ra_job_t *job = file->ra_jobs[slot];
+	if(job == NULL) {
+		return;
+	}
+	file->ra_jobs[slot] = NULL;
+
+	trn_mutex_lock(&ra_mutex);
+	ra_stats.discarded++;
+	if(job->state == RA_RUNNING) {
+		// the worker will free it when it's done
+		job->abandoned = true;
+		job = NULL;
+	} else if(job->state == RA_QUEUED) {
+		ra_dequeue(job);
+	}
+	trn_mutex_unlock(&ra_mutex);
+
+	if(job != NULL) {
+		ra_job_free(job);
+	}
+}
+
+static void ra_reset(trn_sqfs_file_t *file) {
+	for(size_t i = 0; i < TRN_SQFS_READAHEAD_MAX; i++) {
+		ra_drop(file, i);
+	}
+	file->ra_next = 0;
+	file->ra_bl_valid = false;
+}
+
+// moves ra_bl to the given block. returns false if we can't get there.
+static bool ra_seek_blocklist(trn_sqfs_file_t *file, uint64_t index) {
+	size_t block_size = file->fs->sb.block_size;
+	if(!file->ra_bl_valid || file->ra_bl_index >= index) {
+		if(sqfs_blockidx_blocklist(file->fs, &file->inode, &file->ra_bl, index * block_size) != SQFS_OK) {
+			return false;
+		}
+		file->ra_bl_valid = true;
+	}
+	while(!file->ra_bl.started || file->ra_bl.pos < index * block_size) {
+		if(file->ra_bl.remain == 0 || sqfs_blocklist_next(&file->ra_bl) != SQFS_OK) {
+			file->ra_bl_valid = false;
+			return false;
+		}
+	}
+	file->ra_bl_index = index;
+	return true;
+}
+
+// queues blocks [first, last] that aren't queued or cached already
+static void ra_submit(trn_sqfs_file_t *file, uint64_t first, uint64_t last) {
+	uint64_t count = sqfs_blocklist_count(file->fs, &file->inode);
+	if(last >= count) {
+		last = count - 1;
+	}
+	if(file->ra_next > first) {
+		first = file->ra_next;
+	}
+
+	for(uint64_t index = first; index <= last && count > 0; index++) {
+		size_t slot = index % TRN_SQFS_READAHEAD_MAX;
+		ra_drop(file, slot);
+		file->ra_next = index + 1;
+
+		if(!ra_seek_blocklist(file, index)) {
+			return;
+		}
+		if(file->ra_bl.input_size == 0 || sqfs_cache_contains(&file->fs->data_cache, file->ra_bl.block)) {
+			continue; // hole, or nothing to do
+		}
+
+		ra_job_t *job = malloc(sizeof(*job));
+		if(job == NULL) {
+			return;
+		}
+		memset(job, 0, sizeof(*job));
+		job->fs = file->fs;
+		job->index = index;
+		job->pos = file->ra_bl.block;
+		if(sqfs_data_block_fetch(file->fs, job->pos, file->ra_bl.header, &job->in, &job->insize, &job->in_owned) != SQFS_OK) {
+			// uncompressed blocks don't need any help
+			free(job);
+			continue;
+		}
+
+		trn_mutex_lock(&ra_mutex);
+		if(!ra_worker_start()) {
+			trn_mutex_unlock(&ra_mutex);
+			ra_job_free(job);
+			return;
+		}
+		job->state = RA_QUEUED;
+		if(ra_queue_tail != NULL) {
+			ra_queue_tail->next = job;
+		} else {
+			ra_queue_head = job;
+		}
+		ra_queue_tail = job;
+		ra_stats.issued++;
+		trn_condvar_signal(&ra_work_cond, 1);
+		trn_mutex_unlock(&ra_mutex);
+
+		file->ra_jobs[slot] = job;
+	}
+}
+
+// if the given block was read ahead, moves it into the data cache
+static void ra_collect(trn_sqfs_file_t *file, uint64_t index) {
+	size_t slot = index % TRN_SQFS_READAHEAD_MAX;
+	ra_job_t *job = file->ra_jobs[slot];
+	if(job == NULL) {
+		return;
+	}
+	if(job->index != index) {
+		ra_drop(file, slot);
+		return;
+	}
+	file->ra_jobs[slot] = NULL;
+
+	trn_mutex_lock(&ra_mutex);
+	if(job->state == RA_DONE) {
+		ra_stats.hits++;
+	} else {
+		ra_stats.waits++;
+		if(job->state == RA_QUEUED) {
+			// the worker hasn't gotten to it yet, so do it ourselves instead of waiting
+			ra_dequeue(job);
+			job->state = RA_RUNNING;
+			trn_mutex_unlock(&ra_mutex);
+			ra_job_run(job);
+			trn_mutex_lock(&ra_mutex);
+			job->state = RA_DONE;
+		}
+		while(job->state != RA_DONE) {
+			trn_condvar_wait(&ra_done_cond, &ra_mutex, -1);
+		}
+	}
+	trn_mutex_unlock(&ra_mutex);
+
+	if(job->err == SQFS_OK) {
+		sqfs_data_cache_insert(&file->fs->data_cache, job->pos, job->block);
+		job->block = NULL;
+	}
+	ra_job_free(job);
+}
+
+static result_t trn_sqfs_file_read_at(trn_sqfs_file_t *file, void *buf, size_t size, off_t offset, size_t *bytes_read) {
+	uint64_t file_size = file->inode.xtra.reg.file_size;
+	size_t block_size = file->fs->sb.block_size;
+	size_t window = ra_blocks;
+
+	if(offset < 0) {
+		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+	}
+	if(size == 0 || (uint64_t) offset >= file_size) {
+		*bytes_read = 0;
+		return RESULT_OK;
+	}
+	if(size > file_size - offset) {
+		size = file_size - offset;
+	}
+
+	bool sequential = offset == file->ra_expected;
+	if(!sequential || window == 0) {
+		ra_reset(file);
+	}
+	if(window == 0 || !sequential || file_size <= block_size) {
+		off_t osize = size;
+		if(sqfs_read_range(file->fs, &file->inode, offset, &osize, buf)) {
+			return LIBTRANSISTOR_ERR_FS_IO_ERROR;
+		}
+		file->ra_expected = offset + osize;
+		*bytes_read = osize;
+		return RESULT_OK;
+	}
+
+	uint64_t first = offset / block_size;
+	uint64_t last = (offset + size - 1) / block_size;
+	uint64_t upto = last + window;
+	if(upto >= first + TRN_SQFS_READAHEAD_MAX) {
+		upto = first + TRN_SQFS_READAHEAD_MAX - 1;
+	}
+	ra_submit(file, first + 1, upto);
+
+	// a block at a time, so that each one is still cached when we copy out of it
+	size_t total = 0;
+	while(total < size) {
+		off_t pos = offset + total;
+		off_t chunk = block_size - (pos % block_size);
+		if((size_t) chunk > size - total) {
+			chunk = size - total;
+		}
+		ra_collect(file, pos / block_size);
+		if(sqfs_read_range(file->fs, &file->inode, pos, &chunk, (uint8_t*) buf + total)) {
+			if(total == 0) {
+				return LIBTRANSISTOR_ERR_FS_IO_ERROR;
+			}
+			break;
+		}
+		total+= chunk;
+	}
+	file->ra_expected = offset + total;
+	*bytes_read = total;
+	return RESULT_OK;
+}
+
 static result_t trn_sqfs_file_read(void *data, void *buf, size_t size, size_t *bytes_read) {
 	trn_sqfs_file_t *file = data;
-	off_t osize = size;
-	if(sqfs_read_range(file->fs, &file->inode, file->head, &osize, buf)) {
-		return LIBTRANSISTOR_ERR_FS_IO_ERROR;
+	trn_mutex_lock(&file->fs->lock);
+	result_t r = trn_sqfs_file_read_at(file, buf, size, file->head, bytes_read);
+	if(r == RESULT_OK) {
+		file->head+= *bytes_read;
 	}
-	file->head+= osize;
-	*bytes_read = osize;
-	return RESULT_OK;
+	trn_mutex_unlock(&file->fs->lock);
+	return r;
+}
+
+static result_t trn_sqfs_file_pread(void *data, void *buf, size_t size, off_t offset, size_t *bytes_read) {
+	trn_sqfs_file_t *file = data;
+	trn_mutex_lock(&file->fs->lock);
+	result_t r = trn_sqfs_file_read_at(file, buf, size, offset, bytes_read);
+	trn_mutex_unlock(&file->fs->lock);
+	return r;
+}
+
+static result_t trn_sqfs_file_readv(void *data, const struct iovec *iov, int iovcnt, size_t *bytes_read) {
+	trn_sqfs_file_t *file = data;
+	size_t total = 0;
+	result_t r = RESULT_OK;
+	trn_mutex_lock(&file->fs->lock);
+	for(int i = 0; i < iovcnt; i++) {
+		size_t chunk;
+		if((r = trn_sqfs_file_read_at(file, iov[i].iov_base, iov[i].iov_len, file->head, &chunk)) != RESULT_OK) {
+			goto done;
+		}
+		file->head+= chunk;
+		total+= chunk;
+		if(chunk < iov[i].iov_len) {
+			break;
+		}
+	}
+	*bytes_read = total;
+done:
+	trn_mutex_unlock(&file->fs->lock);
+	return r;
 }
 
 static result_t trn_sqfs_file_write(void *data, const void *buf, size_t size, size_t *bytes_written) {
 	return LIBTRANSISTOR_ERR_FS_READ_ONLY;
 }
 
+static result_t trn_sqfs_file_pwrite(void *data, const void *buf, size_t size, off_t offset, size_t *bytes_written) {
+	return LIBTRANSISTOR_ERR_FS_READ_ONLY;
+}
+
+static void trn_sqfs_fill_stat(sqfs_inode *inode, struct stat *st) {
+	st->st_mode = inode->base.mode;
+	st->st_ino = inode->base.inode_number;
+	st->st_nlink = inode->nlink;
+	st->st_mtime = inode->base.mtime;
+	if(S_ISREG(inode->base.mode)) {
+		st->st_size = inode->xtra.reg.file_size;
+	}
+}
+
+static result_t trn_sqfs_file_stat(void *data, struct stat *st) {
+	trn_sqfs_file_t *file = data;
+	trn_sqfs_fill_stat(&file->inode, st);
+	return RESULT_OK;
+}
+
+// only for images that are in memory, and files mksquashfs didn't compress
+static result_t trn_sqfs_file_mmap(void *data, off_t offset, size_t length, const void **addr) {
+	trn_sqfs_file_t *file = data;
+	trn_mutex_lock(&file->fs->lock);
+	sqfs_err err = sqfs_file_in_image(file->fs, &file->inode, offset, length, addr);
+	trn_mutex_unlock(&file->fs->lock);
+	if(err != SQFS_OK) {
+		return LIBTRANSISTOR_ERR_UNIMPLEMENTED;
+	}
+	return RESULT_OK;
+}
+
+// hands out the rest of the block holding offset, but only if it's stored
+// as-is in an in-memory image. Anything in the data cache could be evicted by
+// another thread's read while the caller is still using it, so those are left
+// to pread.
+static result_t trn_sqfs_file_peek(void *data, off_t offset, const void **addr, size_t *length) {
+	trn_sqfs_file_t *file = data;
+	uint64_t file_size = file->inode.xtra.reg.file_size;
+	size_t block_size = file->fs->sb.block_size;
+
+	if(offset < 0) {
+		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+	}
+	if(*length == 0 || (uint64_t) offset >= file_size) {
+		*length = 0;
+		return RESULT_OK;
+	}
+	size_t n = block_size - offset % block_size;
+	if(n > file_size - offset) {
+		n = file_size - offset;
+	}
+	if(n > *length) {
+		n = *length;
+	}
+
+	trn_mutex_lock(&file->fs->lock);
+	sqfs_err err = sqfs_file_in_image(file->fs, &file->inode, offset, n, addr);
+	trn_mutex_unlock(&file->fs->lock);
+	if(err != SQFS_OK) {
+		return LIBTRANSISTOR_ERR_UNIMPLEMENTED;
+	}
+	*length = n;
+	return RESULT_OK;
+}
+
 static result_t trn_sqfs_file_release(trn_file_t *f) {
 	trn_sqfs_file_t *file = f->data;
+	ra_reset(file);
 	free(file);
 	return RESULT_OK;
 }
@@ -104,6 +551,12 @@ static trn_file_ops_t trn_sqfs_file_ops = {
 	.read = trn_sqfs_file_read,
 	.write = trn_sqfs_file_write,
 	.release = trn_sqfs_file_release,
+	.pread = trn_sqfs_file_pread,
+	.pwrite = trn_sqfs_file_pwrite,
+	.readv = trn_sqfs_file_readv,
+	.stat = trn_sqfs_file_stat,
+	.mmap = trn_sqfs_file_mmap,
+	.peek = trn_sqfs_file_peek,
 };
 
 static result_t trn_sqfs_is_dir(void *data, bool *out) {
@@ -112,6 +565,12 @@ static result_t trn_sqfs_is_dir(void *data, bool *out) {
 	return RESULT_OK;
 }
 
+static result_t trn_sqfs_stat(void *data, struct stat *st) {
+	trn_sqfs_inode_t *inode = data;
+	trn_sqfs_fill_stat(&inode->inode, st);
+	return RESULT_OK;
+}
+
 static result_t trn_sqfs_lookup(void *data, trn_inode_t *out, const char *name, size_t name_length) {
 	trn_sqfs_inode_t *inode = data;
 
@@ -120,37 +579,31 @@ static result_t trn_sqfs_lookup(void *data, trn_inode_t *out, const char *name,
 		return LIBTRANSISTOR_ERR_FS_NOT_A_DIRECTORY;
 	}
 
-	sqfs_dir_entry entry;
-	char namebuf[SQUASHFS_NAME_LEN + 1];
-	sqfs_dentry_init(&entry, namebuf);
-
+	sqfs_inode_id id;
 	bool found;
-	sqfs_err err = sqfs_dir_lookup(inode->fs, &inode->inode, name, name_length, &entry, &found);
-	if(err != SQFS_OK) {
-		return LIBTRANSISTOR_ERR_FS_INTERNAL_ERROR;
-	}
-	if(!found) {
-		return LIBTRANSISTOR_ERR_FS_NOT_FOUND;
-	}
-
-	trn_sqfs_inode_t *out_data = malloc(sizeof(*out_data));
-	if(out_data == NULL) {
-		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
-	}
-	out->data = out_data;
-
-	out_data->fs = inode->fs;
-	err = sqfs_inode_get(inode->fs, &out_data->inode, entry.inode);
+	trn_sqfs_inode_t *out_data;
+	result_t r = RESULT_OK;
+	trn_mutex_lock(&inode->fs->lock);
+	sqfs_err err = sqfs_dirhash_lookup(inode->fs, &inode->inode, name, name_length, &id, &found);
 	if(err != SQFS_OK) {
-		free(out_data);
-		return LIBTRANSISTOR_ERR_FS_INTERNAL_ERROR;
+		r = LIBTRANSISTOR_ERR_FS_INTERNAL_ERROR;
+	} else if(!found) {
+		r = LIBTRANSISTOR_ERR_FS_NOT_FOUND;
+	} else if(sqfs_icache_get(inode->fs, id, &out_data) != SQFS_OK) {
+		r = LIBTRANSISTOR_ERR_FS_INTERNAL_ERROR;
+	} else {
+		out->data = out_data;
 	}
-	
-	return RESULT_OK;
+	trn_mutex_unlock(&inode->fs->lock);
+	return r;
 }
 
 static result_t trn_sqfs_release(void *data) {
-	// TODO: implement this
+	trn_sqfs_inode_t *inode = data;
+	sqfs *fs = inode->fs;
+	trn_mutex_lock(&fs->lock);
+	sqfs_icache_put(fs, inode);
+	trn_mutex_unlock(&fs->lock);
 	return RESULT_OK;
 }
 
@@ -166,6 +619,7 @@ static result_t trn_sqfs_open_as_file(void *data, int mode, int *fd) {
 		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
 	}
 
+	memset(file, 0, sizeof(*file));
 	file->fs = inode->fs;
 	file->inode = inode->inode;
 	file->head = 0;
@@ -191,7 +645,9 @@ static result_t trn_sqfs_open_as_dir(void *data, trn_dir_t *out) {
 	}
 
 	dir->fs = inode->fs;
+	trn_mutex_lock(&inode->fs->lock);
 	sqfs_err err = sqfs_dir_open(inode->fs, &inode->inode, &dir->dir, 0);
+	trn_mutex_unlock(&inode->fs->lock);
 	if(err != SQFS_OK) {
 		return LIBTRANSISTOR_ERR_FS_INTERNAL_ERROR;
 	}
@@ -234,19 +690,134 @@ static trn_inode_ops_t trn_sqfs_inode_ops = {
 	.remove_empty_directory = trn_sqfs_remove_empty_directory,
 	.open_as_file = trn_sqfs_open_as_file,
 	.open_as_dir = trn_sqfs_open_as_dir,
+	.stat = trn_sqfs_stat,
 };
 
-result_t trn_sqfs_open_root(trn_inode_t *out, sqfs *fs) {
-	trn_sqfs_inode_t *out_data = malloc(sizeof(*out_data));
-	if(out_data == NULL) {
+static sqfs_cache *trn_sqfs_cache(sqfs *fs, trn_sqfs_cache_t cache) {
+	switch(cache) {
+	case TRN_SQFS_CACHE_METADATA:
+		return &fs->md_cache;
+	case TRN_SQFS_CACHE_DATA:
+		return &fs->data_cache;
+	case TRN_SQFS_CACHE_FRAGMENT:
+		return &fs->frag_cache;
+	default:
+		return NULL;
+	}
+}
+
+result_t trn_sqfs_set_cache_size(sqfs *fs, trn_sqfs_cache_t cache, size_t blocks) {
+	sqfs_cache *c = trn_sqfs_cache(fs, cache);
+	if(c == NULL || blocks == 0) {
+		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+	}
+	trn_mutex_lock(&fs->lock);
+	sqfs_err err = sqfs_block_cache_resize(fs, c, blocks);
+	trn_mutex_unlock(&fs->lock);
+	if(err != SQFS_OK) {
 		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
 	}
+	return RESULT_OK;
+}
 
-	out_data->fs = fs;
-	sqfs_err err = SQFS_OK;
-	err = sqfs_inode_get(fs, &out_data->inode, sqfs_inode_root(fs));
+result_t trn_sqfs_get_cache_stats(sqfs *fs, trn_sqfs_cache_t cache, trn_sqfs_cache_stats_t *out) {
+	sqfs_cache *c = trn_sqfs_cache(fs, cache);
+	if(c == NULL) {
+		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+	}
+	trn_mutex_lock(&fs->lock);
+	out->hits = c->stats.hits;
+	out->misses = c->stats.misses;
+	out->evictions = c->stats.evictions;
+	out->blocks = c->count;
+	trn_mutex_unlock(&fs->lock);
+	return RESULT_OK;
+}
+
+void trn_sqfs_reset_cache_stats(sqfs *fs) {
+	trn_mutex_lock(&fs->lock);
+	memset(&fs->md_cache.stats, 0, sizeof(fs->md_cache.stats));
+	memset(&fs->data_cache.stats, 0, sizeof(fs->data_cache.stats));
+	memset(&fs->frag_cache.stats, 0, sizeof(fs->frag_cache.stats));
+	trn_mutex_unlock(&fs->lock);
+}
+
+result_t trn_sqfs_set_inode_cache_size(sqfs *fs, size_t inodes) {
+	trn_mutex_lock(&fs->lock);
+	sqfs_icache_set_max_unused(fs->icache, inodes);
+	trn_mutex_unlock(&fs->lock);
+	return RESULT_OK;
+}
+
+void trn_sqfs_get_inode_cache_stats(sqfs *fs, trn_sqfs_inode_cache_stats_t *out) {
+	trn_mutex_lock(&fs->lock);
+	out->hits = fs->icache->stats.hits;
+	out->misses = fs->icache->stats.misses;
+	out->evictions = fs->icache->stats.evictions;
+	out->cached = fs->icache->count;
+	out->unused = fs->icache->nunused;
+	trn_mutex_unlock(&fs->lock);
+}
+
+void trn_sqfs_reset_inode_cache_stats(sqfs *fs) {
+	trn_mutex_lock(&fs->lock);
+	memset(&fs->icache->stats, 0, sizeof(fs->icache->stats));
+	trn_mutex_unlock(&fs->lock);
+}
+
+result_t trn_sqfs_set_lookup_index(sqfs *fs, size_t max_bytes, size_t min_dir_size) {
+	trn_mutex_lock(&fs->lock);
+	sqfs_dirhash_configure(&fs->dirhash, max_bytes, min_dir_size);
+	trn_mutex_unlock(&fs->lock);
+	return RESULT_OK;
+}
+
+void trn_sqfs_get_lookup_index_stats(sqfs *fs, trn_sqfs_lookup_index_stats_t *out) {
+	trn_mutex_lock(&fs->lock);
+	out->hits = fs->dirhash.stats.hits;
+	out->misses = fs->dirhash.stats.misses;
+	out->builds = fs->dirhash.stats.builds;
+	out->evictions = fs->dirhash.stats.evictions;
+	out->directories = fs->dirhash.count;
+	out->bytes = fs->dirhash.bytes;
+	trn_mutex_unlock(&fs->lock);
+}
+
+void trn_sqfs_reset_lookup_index_stats(sqfs *fs) {
+	trn_mutex_lock(&fs->lock);
+	memset(&fs->dirhash.stats, 0, sizeof(fs->dirhash.stats));
+	trn_mutex_unlock(&fs->lock);
+}
+
+result_t trn_sqfs_set_readahead(size_t blocks, int32_t worker_core) {
+	if(blocks > TRN_SQFS_READAHEAD_MAX) {
+		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+	}
+	trn_mutex_lock(&ra_mutex);
+	ra_core = worker_core;
+	trn_mutex_unlock(&ra_mutex);
+	ra_blocks = blocks;
+	return RESULT_OK;
+}
+
+void trn_sqfs_get_readahead_stats(trn_sqfs_readahead_stats_t *out) {
+	trn_mutex_lock(&ra_mutex);
+	*out = ra_stats;
+	trn_mutex_unlock(&ra_mutex);
+}
+
+void trn_sqfs_reset_readahead_stats() {
+	trn_mutex_lock(&ra_mutex);
+	memset(&ra_stats, 0, sizeof(ra_stats));
+	trn_mutex_unlock(&ra_mutex);
+}
+
+result_t trn_sqfs_open_root(trn_inode_t *out, sqfs *fs) {
+	trn_sqfs_inode_t *out_data;
+	trn_mutex_lock(&fs->lock);
+	sqfs_err err = sqfs_icache_get(fs, sqfs_inode_root(fs), &out_data);
+	trn_mutex_unlock(&fs->lock);
 	if(err != SQFS_OK) {
-		free(out_data);
 		return LIBTRANSISTOR_ERR_FS_INTERNAL_ERROR;
 	}
 	
@@ -0,0 +1,946 @@
+#include<libtransistor/fs/tmpfs.h>
+
+#include<libtransistor/types.h>
+#include<libtransistor/err.h>
+#include<libtransistor/fd.h>
+#include<libtransistor/mutex.h>
+#include<fcntl.h>
+#include<stdatomic.h>
+#include<stdint.h>
+#include<stdlib.h>
+#include<string.h>
+#include<sys/stat.h>
+
+#define PAGE_SIZE TRN_TMPFS_PAGE_SIZE
+#define NAME_MAX_LEN 255
+#define DIR_MIN_CAPACITY 8
+
+typedef struct tmpfs_t tmpfs_t;
+typedef struct tmpfs_node_t tmpfs_node_t;
+
+// A single lock covers the tree and all file contents. Everything a tmpfs
+// operation does is a memcpy or a pointer update, so there's little to gain
+// from anything finer.
+struct tmpfs_t {
+	trn_mutex_t lock;
+	_Atomic(int) refs; // one for every inode, file and directory handed out
+	size_t max_bytes;
+	size_t used_bytes GUARDED_BY(lock);
+	uint64_t next_ino GUARDED_BY(lock);
+	tmpfs_node_t *root;
+};
+
+// Nodes stay around while they're linked into the tree or somebody still has a
+// handle to them, so a file that's removed while open keeps its contents until
+// it's closed. Everything in here is guarded by fs->lock.
+struct tmpfs_node_t {
+	tmpfs_t *fs;
+	int refs; // handles, not counting the directory entry
+	bool linked; // the root is always linked
+	tmpfs_node_t *parent; // NULL for the root and for removed nodes
+	char *name;
+	size_t name_len;
+	uint64_t ino;
+	bool is_dir;
+	union {
+		struct {
+			tmpfs_node_t **children; // in creation order
+			size_t count;
+			size_t capacity;
+		} dir;
+		struct {
+			uint8_t **pages; // NULL entries are holes, which read as zeroes
+			size_t npages; // length of pages, which may go past the end of the file
+			uint64_t size;
+		} file;
+	};
+};
+
+typedef struct {
+	tmpfs_node_t *node;
+	int flags;
+	off_t head;
+} tmpfs_file_t;
+
+typedef struct {
+	tmpfs_node_t *node;
+	size_t pos;
+} tmpfs_dir_t;
+
+static trn_inode_ops_t tmpfs_inode_ops;
+static trn_file_ops_t tmpfs_file_ops;
+static trn_dir_ops_t tmpfs_dir_ops;
+
+static tmpfs_node_t *node_create(tmpfs_t *fs, const char *name, size_t name_len, bool is_dir) {
+	tmpfs_node_t *node = calloc(1, sizeof(*node));
+	if(node == NULL) {
+		return NULL;
+	}
+	node->name = malloc(name_len + 1);
+	if(node->name == NULL) {
+		free(node);
+		return NULL;
+	}
+	memcpy(node->name, name, name_len);
+	node->name[name_len] = 0;
+	node->name_len = name_len;
+	node->fs = fs;
+	node->is_dir = is_dir;
+	return node;
+}
+
+static void node_free(tmpfs_t *fs, tmpfs_node_t *node) REQUIRES(fs->lock) {
+	if(node->is_dir) {
+		for(size_t i = 0; i < node->dir.count; i++) {
+			node_free(fs, node->dir.children[i]);
+		}
+		free(node->dir.children);
+	} else {
+		for(size_t i = 0; i < node->file.npages; i++) {
+			if(node->file.pages[i] != NULL) {
+				free(node->file.pages[i]);
+				fs->used_bytes-= PAGE_SIZE;
+			}
+		}
+		free(node->file.pages);
+	}
+	free(node->name);
+	free(node);
+}
+
+static tmpfs_node_t *dir_find(tmpfs_node_t *dir, const char *name, size_t name_len) {
+	for(size_t i = 0; i < dir->dir.count; i++) {
+		tmpfs_node_t *child = dir->dir.children[i];
+		if(child->name_len == name_len && memcmp(child->name, name, name_len) == 0) {
+			return child;
+		}
+	}
+	return NULL;
+}
+
+// Makes sure dir_add can't fail.
+static result_t dir_reserve(tmpfs_node_t *dir) {
+	if(dir->dir.count < dir->dir.capacity) {
+		return RESULT_OK;
+	}
+	size_t capacity = dir->dir.capacity ? dir->dir.capacity * 2 : DIR_MIN_CAPACITY;
+	tmpfs_node_t **children = realloc(dir->dir.children, capacity * sizeof(*children));
+	if(children == NULL) {
+		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+	}
+	dir->dir.children = children;
+	dir->dir.capacity = capacity;
+	return RESULT_OK;
+}
+
+static void dir_add(tmpfs_node_t *dir, tmpfs_node_t *child) {
+	dir->dir.children[dir->dir.count++] = child;
+	child->parent = dir;
+	child->linked = true;
+}
+
+// Takes the node out of its directory. It's freed once nobody has a handle to it.
+static void node_unlink(tmpfs_t *fs, tmpfs_node_t *node) REQUIRES(fs->lock) {
+	tmpfs_node_t *dir = node->parent;
+	size_t i = 0;
+	while(dir->dir.children[i] != node) {
+		i++;
+	}
+	// keep the order, so that open directory streams don't see entries twice
+	memmove(&dir->dir.children[i], &dir->dir.children[i + 1], (dir->dir.count - i - 1) * sizeof(*dir->dir.children));
+	dir->dir.count--;
+
+	node->parent = NULL;
+	node->linked = false;
+	if(node->refs == 0) {
+		node_free(fs, node);
+	}
+}
+
+static void node_get(tmpfs_node_t *node) {
+	node->refs++;
+	atomic_fetch_add(&node->fs->refs, 1);
+}
+
+static void node_put(tmpfs_node_t *node) {
+	tmpfs_t *fs = node->fs;
+
+	trn_mutex_lock(&fs->lock);
+	if(--node->refs == 0 && !node->linked) {
+		node_free(fs, node);
+	}
+	trn_mutex_unlock(&fs->lock);
+
+	// the last handle takes everything that's left with it
+	if(atomic_fetch_sub(&fs->refs, 1) == 1) {
+		trn_mutex_lock(&fs->lock);
+		node_free(fs, fs->root);
+		trn_mutex_unlock(&fs->lock);
+		free(fs);
+	}
+}
+
+/*
+ * File contents
+ *
+ * Bytes past the end of the file in pages that exist are always zero, so
+ * growing a file never has to clear anything. Growing it doesn't add pages
+ * either, so pages past npages are holes just like NULL ones.
+ */
+
+static result_t file_read(tmpfs_node_t *node, void *buf, size_t size, off_t offset, size_t *bytes_read) {
+	if(offset < 0) {
+		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+	}
+	if((uint64_t) offset >= node->file.size) {
+		*bytes_read = 0;
+		return RESULT_OK;
+	}
+	if(size > node->file.size - offset) {
+		size = node->file.size - offset;
+	}
+
+	uint8_t *out = buf;
+	for(size_t done = 0; done < size;) {
+		uint64_t pos = offset + done;
+		size_t in_page = pos % PAGE_SIZE;
+		size_t n = PAGE_SIZE - in_page;
+		if(n > size - done) {
+			n = size - done;
+		}
+		size_t index = pos / PAGE_SIZE;
+		uint8_t *page = index < node->file.npages ? node->file.pages[index] : NULL;
+		if(page == NULL) {
+			memset(out + done, 0, n);
+		} else {
+			memcpy(out + done, page + in_page, n);
+		}
+		done+= n;
+	}
+	*bytes_read = size;
+	return RESULT_OK;
+}
+
+static result_t file_write(tmpfs_t *fs, tmpfs_node_t *node, const void *buf, size_t size, off_t offset, size_t *bytes_written) REQUIRES(fs->lock) {
+	if(offset < 0 || (uint64_t) offset + size < (uint64_t) offset) {
+		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+	}
+	if(size == 0) {
+		*bytes_written = 0;
+		return RESULT_OK;
+	}
+
+	uint64_t end = offset + size;
+	size_t first = offset / PAGE_SIZE;
+	size_t last = (end - 1) / PAGE_SIZE;
+
+	// refuse up front rather than leaving a partial write behind
+	size_t missing = 0;
+	for(size_t i = first; i <= last; i++) {
+		if(i >= node->file.npages || node->file.pages[i] == NULL) {
+			missing++;
+		}
+	}
+	if(missing > (fs->max_bytes - fs->used_bytes) / PAGE_SIZE) {
+		return LIBTRANSISTOR_ERR_FS_NO_SPACE;
+	}
+
+	if(last >= node->file.npages) {
+		size_t npages = node->file.npages * 2;
+		if(npages <= last) {
+			npages = last + 1;
+		}
+		uint8_t **pages = realloc(node->file.pages, npages * sizeof(*pages));
+		if(pages == NULL) {
+			return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+		}
+		memset(pages + node->file.npages, 0, (npages - node->file.npages) * sizeof(*pages));
+		node->file.pages = pages;
+		node->file.npages = npages;
+	}
+
+	const uint8_t *in = buf;
+	size_t done = 0;
+	while(done < size) {
+		uint64_t pos = offset + done;
+		size_t in_page = pos % PAGE_SIZE;
+		size_t n = PAGE_SIZE - in_page;
+		if(n > size - done) {
+			n = size - done;
+		}
+		uint8_t **page = &node->file.pages[pos / PAGE_SIZE];
+		if(*page == NULL) {
+			if((*page = malloc(PAGE_SIZE)) == NULL) {
+				break;
+			}
+			if(n < PAGE_SIZE) {
+				memset(*page, 0, PAGE_SIZE);
+			}
+			fs->used_bytes+= PAGE_SIZE;
+		}
+		memcpy(*page + in_page, in + done, n);
+		done+= n;
+	}
+	if(done == 0) {
+		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+	}
+
+	if(offset + done > node->file.size) {
+		node->file.size = offset + done;
+	}
+	*bytes_written = done;
+	return RESULT_OK;
+}
+
+static result_t file_resize(tmpfs_t *fs, tmpfs_node_t *node, off_t length) REQUIRES(fs->lock) {
+	if(length < 0) {
+		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+	}
+	if((uint64_t) length < node->file.size) {
+		size_t keep = (length + PAGE_SIZE - 1) / PAGE_SIZE;
+		for(size_t i = keep; i < node->file.npages; i++) {
+			if(node->file.pages[i] != NULL) {
+				free(node->file.pages[i]);
+				node->file.pages[i] = NULL;
+				fs->used_bytes-= PAGE_SIZE;
+			}
+		}
+		if(keep == 0) {
+			free(node->file.pages);
+			node->file.pages = NULL;
+			node->file.npages = 0;
+		} else if(length % PAGE_SIZE != 0 && keep <= node->file.npages && node->file.pages[keep - 1] != NULL) {
+			memset(node->file.pages[keep - 1] + length % PAGE_SIZE, 0, PAGE_SIZE - length % PAGE_SIZE);
+		}
+	}
+	// growing just makes a hole
+	node->file.size = length;
+	return RESULT_OK;
+}
+
+static void node_stat(tmpfs_node_t *node, struct stat *st) {
+	st->st_ino = node->ino;
+	st->st_nlink = node->linked ? 1 : 0;
+	st->st_blksize = PAGE_SIZE;
+	if(node->is_dir) {
+		st->st_mode = S_IFDIR | 0777;
+		return;
+	}
+	size_t pages = 0;
+	for(size_t i = 0; i < node->file.npages; i++) {
+		if(node->file.pages[i] != NULL) {
+			pages++;
+		}
+	}
+	st->st_mode = S_IFREG | 0666;
+	st->st_size = node->file.size;
+	st->st_blocks = pages * (PAGE_SIZE / 512);
+}
+
+/*
+ * Open files
+ */
+
+static result_t tmpfs_file_seek(void *data, off_t offset, int whence, off_t *position) {
+	tmpfs_file_t *f = data;
+	tmpfs_t *fs = f->node->fs;
+	off_t base;
+
+	trn_mutex_lock(&fs->lock);
+	switch(whence) {
+	case SEEK_SET:
+		base = 0;
+		break;
+	case SEEK_CUR:
+		base = f->head;
+		break;
+	case SEEK_END:
+		base = f->node->file.size;
+		break;
+	default:
+		trn_mutex_unlock(&fs->lock);
+		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+	}
+	if(base + offset < 0) {
+		trn_mutex_unlock(&fs->lock);
+		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+	}
+	*position = f->head = base + offset;
+	trn_mutex_unlock(&fs->lock);
+	return RESULT_OK;
+}
+
+static result_t tmpfs_file_read(void *data, void *buf, size_t size, size_t *bytes_read) {
+	tmpfs_file_t *f = data;
+	tmpfs_t *fs = f->node->fs;
+	result_t r;
+
+	trn_mutex_lock(&fs->lock);
+	if((r = file_read(f->node, buf, size, f->head, bytes_read)) == RESULT_OK) {
+		f->head+= *bytes_read;
+	}
+	trn_mutex_unlock(&fs->lock);
+	return r;
+}
+
+static result_t tmpfs_file_pread(void *data, void *buf, size_t size, off_t offset, size_t *bytes_read) {
+	tmpfs_file_t *f = data;
+	tmpfs_t *fs = f->node->fs;
+	result_t r;
+
+	trn_mutex_lock(&fs->lock);
+	r = file_read(f->node, buf, size, offset, bytes_read);
+	trn_mutex_unlock(&fs->lock);
+	return r;
+}
+
+static result_t tmpfs_file_readv(void *data, const struct iovec *iov, int iovcnt, size_t *bytes_read) {
+	tmpfs_file_t *f = data;
+	tmpfs_t *fs = f->node->fs;
+	result_t r = RESULT_OK;
+	size_t total = 0;
+
+	trn_mutex_lock(&fs->lock);
+	for(int i = 0; i < iovcnt; i++) {
+		size_t n;
+		if((r = file_read(f->node, iov[i].iov_base, iov[i].iov_len, f->head, &n)) != RESULT_OK) {
+			break;
+		}
+		f->head+= n;
+		total+= n;
+		if(n < iov[i].iov_len) {
+			break;
+		}
+	}
+	trn_mutex_unlock(&fs->lock);
+
+	if(total > 0) {
+		r = RESULT_OK;
+	}
+	*bytes_read = total;
+	return r;
+}
+
+static result_t tmpfs_file_write(void *data, const void *buf, size_t size, size_t *bytes_written) {
+	tmpfs_file_t *f = data;
+	tmpfs_t *fs = f->node->fs;
+	result_t r;
+
+	if((f->flags & O_ACCMODE) == O_RDONLY) {
+		return LIBTRANSISTOR_ERR_FS_ACCESS_DENIED;
+	}
+
+	trn_mutex_lock(&fs->lock);
+	if(f->flags & O_APPEND) {
+		f->head = f->node->file.size;
+	}
+	if((r = file_write(fs, f->node, buf, size, f->head, bytes_written)) == RESULT_OK) {
+		f->head+= *bytes_written;
+	}
+	trn_mutex_unlock(&fs->lock);
+	return r;
+}
+
+static result_t tmpfs_file_pwrite(void *data, const void *buf, size_t size, off_t offset, size_t *bytes_written) {
+	tmpfs_file_t *f = data;
+	tmpfs_t *fs = f->node->fs;
+	result_t r;
+
+	if((f->flags & O_ACCMODE) == O_RDONLY) {
+		return LIBTRANSISTOR_ERR_FS_ACCESS_DENIED;
+	}
+
+	trn_mutex_lock(&fs->lock);
+	r = file_write(fs, f->node, buf, size, offset, bytes_written);
+	trn_mutex_unlock(&fs->lock);
+	return r;
+}
+
+static result_t tmpfs_file_writev(void *data, const struct iovec *iov, int iovcnt, size_t *bytes_written) {
+	tmpfs_file_t *f = data;
+	tmpfs_t *fs = f->node->fs;
+	result_t r = RESULT_OK;
+	size_t total = 0;
+
+	if((f->flags & O_ACCMODE) == O_RDONLY) {
+		return LIBTRANSISTOR_ERR_FS_ACCESS_DENIED;
+	}
+
+	trn_mutex_lock(&fs->lock);
+	if(f->flags & O_APPEND) {
+		f->head = f->node->file.size;
+	}
+	for(int i = 0; i < iovcnt; i++) {
+		size_t n;
+		if((r = file_write(fs, f->node, iov[i].iov_base, iov[i].iov_len, f->head, &n)) != RESULT_OK) {
+			break;
+		}
+		f->head+= n;
+		total+= n;
+		if(n < iov[i].iov_len) {
+			break;
+		}
+	}
+	trn_mutex_unlock(&fs->lock);
+
+	if(total > 0) {
+		r = RESULT_OK;
+	}
+	*bytes_written = total;
+	return r;
+}
+
+static result_t tmpfs_file_truncate(void *data, off_t length) {
+	tmpfs_file_t *f = data;
+	tmpfs_t *fs = f->node->fs;
+	result_t r;
+
+	if((f->flags & O_ACCMODE) == O_RDONLY) {
+		return LIBTRANSISTOR_ERR_FS_ACCESS_DENIED;
+	}
+
+	trn_mutex_lock(&fs->lock);
+	r = file_resize(fs, f->node, length);
+	trn_mutex_unlock(&fs->lock);
+	return r;
+}
+
+static result_t tmpfs_file_stat(void *data, struct stat *st) {
+	tmpfs_file_t *f = data;
+	tmpfs_t *fs = f->node->fs;
+
+	trn_mutex_lock(&fs->lock);
+	node_stat(f->node, st);
+	trn_mutex_unlock(&fs->lock);
+	return RESULT_OK;
+}
+
+static result_t tmpfs_file_release(trn_file_t *file) {
+	tmpfs_file_t *f = file->data;
+	node_put(f->node);
+	free(f);
+	return RESULT_OK;
+}
+
+static trn_file_ops_t tmpfs_file_ops = {
+	.seek = tmpfs_file_seek,
+	.read = tmpfs_file_read,
+	.write = tmpfs_file_write,
+	.release = tmpfs_file_release,
+	.pread = tmpfs_file_pread,
+	.pwrite = tmpfs_file_pwrite,
+	.readv = tmpfs_file_readv,
+	.writev = tmpfs_file_writev,
+	.truncate = tmpfs_file_truncate,
+	.stat = tmpfs_file_stat,
+};
+
+/*
+ * Directory streams
+ */
+
+static result_t tmpfs_dir_rewind(void *data) {
+	tmpfs_dir_t *dir = data;
+	tmpfs_t *fs = dir->node->fs;
+
+	trn_mutex_lock(&fs->lock);
+	dir->pos = 0;
+	trn_mutex_unlock(&fs->lock);
+	return RESULT_OK;
+}
+
+static result_t tmpfs_dir_next_batch(void *data, trn_dirent_t *dirents, size_t count, size_t *read) {
+	tmpfs_dir_t *dir = data;
+	tmpfs_t *fs = dir->node->fs;
+	size_t i;
+
+	trn_mutex_lock(&fs->lock);
+	for(i = 0; i < count && dir->pos < dir->node->dir.count; i++) {
+		tmpfs_node_t *child = dir->node->dir.children[dir->pos++];
+		memcpy(dirents[i].name, child->name, child->name_len + 1);
+		dirents[i].name_size = child->name_len;
+	}
+	trn_mutex_unlock(&fs->lock);
+
+	*read = i;
+	return RESULT_OK;
+}
+
+static result_t tmpfs_dir_next(void *data, trn_dirent_t *dirent) {
+	size_t read;
+	tmpfs_dir_next_batch(data, dirent, 1, &read);
+	return read == 1 ? RESULT_OK : LIBTRANSISTOR_ERR_FS_OUT_OF_DIR_ENTRIES;
+}
+
+static void tmpfs_dir_close(void *data) {
+	tmpfs_dir_t *dir = data;
+	node_put(dir->node);
+	free(dir);
+}
+
+static trn_dir_ops_t tmpfs_dir_ops = {
+	.rewind = tmpfs_dir_rewind,
+	.next = tmpfs_dir_next,
+	.close = tmpfs_dir_close,
+	.next_batch = tmpfs_dir_next_batch,
+};
+
+/*
+ * Inodes
+ */
+
+static result_t tmpfs_is_dir(void *data, bool *out) {
+	tmpfs_node_t *node = data;
+	*out = node->is_dir;
+	return RESULT_OK;
+}
+
+static result_t tmpfs_lookup(void *data, trn_inode_t *out, const char *name, size_t name_length) {
+	tmpfs_node_t *node = data;
+	tmpfs_t *fs = node->fs;
+	tmpfs_node_t *child;
+
+	if(!node->is_dir) {
+		return LIBTRANSISTOR_ERR_FS_NOT_A_DIRECTORY;
+	}
+
+	trn_mutex_lock(&fs->lock);
+	if((child = dir_find(node, name, name_length)) == NULL) {
+		trn_mutex_unlock(&fs->lock);
+		return LIBTRANSISTOR_ERR_FS_NOT_FOUND;
+	}
+	node_get(child);
+	trn_mutex_unlock(&fs->lock);
+
+	out->data = child;
+	out->ops = &tmpfs_inode_ops;
+	return RESULT_OK;
+}
+
+static result_t tmpfs_release(void *data) {
+	node_put(data);
+	return RESULT_OK;
+}
+
+static result_t tmpfs_create(tmpfs_node_t *dir, const char *name, bool is_dir) {
+	tmpfs_t *fs = dir->fs;
+	size_t name_len = strcspn(name, "/");
+	tmpfs_node_t *node;
+	result_t r;
+
+	if(!dir->is_dir) {
+		return LIBTRANSISTOR_ERR_FS_NOT_A_DIRECTORY;
+	}
+	if(name_len == 0) {
+		return LIBTRANSISTOR_ERR_FS_INVALID_PATH;
+	}
+	if(name_len > NAME_MAX_LEN) {
+		return LIBTRANSISTOR_ERR_FS_NAME_TOO_LONG;
+	}
+
+	trn_mutex_lock(&fs->lock);
+	if(!dir->linked) {
+		r = LIBTRANSISTOR_ERR_FS_NOT_FOUND;
+		goto done;
+	}
+	if(dir_find(dir, name, name_len) != NULL) {
+		r = LIBTRANSISTOR_ERR_FS_PATH_EXISTS;
+		goto done;
+	}
+	if((r = dir_reserve(dir)) != RESULT_OK) {
+		goto done;
+	}
+	if((node = node_create(fs, name, name_len, is_dir)) == NULL) {
+		r = LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+		goto done;
+	}
+	node->ino = fs->next_ino++;
+	dir_add(dir, node);
+
+done:
+	trn_mutex_unlock(&fs->lock);
+	return r;
+}
+
+static result_t tmpfs_create_file(void *data, const char *name) {
+	return tmpfs_create(data, name, false);
+}
+
+static result_t tmpfs_create_directory(void *data, const char *name) {
+	return tmpfs_create(data, name, true);
+}
+
+static result_t tmpfs_remove_file(void *data) {
+	tmpfs_node_t *node = data;
+	tmpfs_t *fs = node->fs;
+	result_t r = RESULT_OK;
+
+	if(node->is_dir) {
+		return LIBTRANSISTOR_ERR_FS_NOT_A_FILE;
+	}
+
+	trn_mutex_lock(&fs->lock);
+	if(!node->linked) {
+		r = LIBTRANSISTOR_ERR_FS_NOT_FOUND;
+	} else {
+		node_unlink(fs, node);
+	}
+	trn_mutex_unlock(&fs->lock);
+	return r;
+}
+
+static result_t tmpfs_remove_empty_directory(void *data) {
+	tmpfs_node_t *node = data;
+	tmpfs_t *fs = node->fs;
+	result_t r = RESULT_OK;
+
+	if(!node->is_dir) {
+		return LIBTRANSISTOR_ERR_FS_NOT_A_DIRECTORY;
+	}
+	if(node == fs->root) {
+		return LIBTRANSISTOR_ERR_FS_ACCESS_DENIED;
+	}
+
+	trn_mutex_lock(&fs->lock);
+	if(!node->linked) {
+		r = LIBTRANSISTOR_ERR_FS_NOT_FOUND;
+	} else if(node->dir.count > 0) {
+		r = LIBTRANSISTOR_ERR_FS_DIRECTORY_NOT_EMPTY;
+	} else {
+		node_unlink(fs, node);
+	}
+	trn_mutex_unlock(&fs->lock);
+	return r;
+}
+
+// newpath is relative to the root of the filesystem.
+static result_t tmpfs_rename(void *data, const char *newpath) {
+	tmpfs_node_t *node = data;
+	tmpfs_t *fs = node->fs;
+	tmpfs_node_t *dir, *target;
+	const char *name;
+	size_t name_len;
+	char *name_copy = NULL;
+	result_t r = RESULT_OK;
+
+	if(node == fs->root) {
+		return LIBTRANSISTOR_ERR_FS_ACCESS_DENIED;
+	}
+
+	trn_mutex_lock(&fs->lock);
+	if(!node->linked) {
+		r = LIBTRANSISTOR_ERR_FS_NOT_FOUND;
+		goto done;
+	}
+
+	// find the directory the last component goes in
+	dir = fs->root;
+	for(;;) {
+		while(*newpath == '/') {
+			newpath++;
+		}
+		name = newpath;
+		name_len = strcspn(name, "/");
+		newpath+= name_len;
+		while(*newpath == '/') {
+			newpath++;
+		}
+		if(*newpath == 0) {
+			break;
+		}
+
+		if(name_len == 2 && memcmp(name, "..", 2) == 0) {
+			if(dir->parent != NULL) {
+				dir = dir->parent;
+			}
+		} else if(!(name_len == 1 && name[0] == '.')) {
+			if((dir = dir_find(dir, name, name_len)) == NULL) {
+				r = LIBTRANSISTOR_ERR_FS_NOT_FOUND;
+				goto done;
+			}
+			if(!dir->is_dir) {
+				r = LIBTRANSISTOR_ERR_FS_NOT_A_DIRECTORY;
+				goto done;
+			}
+		}
+	}
+	if(name_len == 0 || (name_len == 1 && name[0] == '.') || (name_len == 2 && memcmp(name, "..", 2) == 0)) {
+		r = LIBTRANSISTOR_ERR_FS_INVALID_PATH;
+		goto done;
+	}
+	if(name_len > NAME_MAX_LEN) {
+		r = LIBTRANSISTOR_ERR_FS_NAME_TOO_LONG;
+		goto done;
+	}
+
+	// a directory can't be moved into itself
+	for(tmpfs_node_t *d = dir; d != NULL; d = d->parent) {
+		if(d == node) {
+			r = LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+			goto done;
+		}
+	}
+
+	// whatever is already there gets replaced, if it's the same kind of thing
+	if((target = dir_find(dir, name, name_len)) == node) {
+		goto done;
+	}
+	if(target != NULL) {
+		if(node->is_dir && !target->is_dir) {
+			r = LIBTRANSISTOR_ERR_FS_NOT_A_DIRECTORY;
+			goto done;
+		}
+		if(!node->is_dir && target->is_dir) {
+			r = LIBTRANSISTOR_ERR_FS_NOT_A_FILE;
+			goto done;
+		}
+		if(target->is_dir && target->dir.count > 0) {
+			r = LIBTRANSISTOR_ERR_FS_DIRECTORY_NOT_EMPTY;
+			goto done;
+		}
+	}
+
+	// get everything that can fail out of the way first
+	if((name_copy = malloc(name_len + 1)) == NULL) {
+		r = LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+		goto done;
+	}
+	memcpy(name_copy, name, name_len);
+	name_copy[name_len] = 0;
+	if((r = dir_reserve(dir)) != RESULT_OK) {
+		free(name_copy);
+		goto done;
+	}
+
+	if(target != NULL) {
+		node_unlink(fs, target);
+	}
+	// node_unlink would free the node if we didn't have a handle to it
+	node_unlink(fs, node);
+	free(node->name);
+	node->name = name_copy;
+	node->name_len = name_len;
+	dir_add(dir, node);
+
+done:
+	trn_mutex_unlock(&fs->lock);
+	return r;
+}
+
+static result_t tmpfs_open_as_file(void *data, int flags, int *fd) {
+	tmpfs_node_t *node = data;
+	tmpfs_t *fs = node->fs;
+	result_t r;
+
+	if(node->is_dir) {
+		return LIBTRANSISTOR_ERR_FS_NOT_A_FILE;
+	}
+
+	tmpfs_file_t *f = malloc(sizeof(*f));
+	if(f == NULL) {
+		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+	}
+	f->node = node;
+	f->flags = flags;
+	f->head = 0;
+
+	trn_mutex_lock(&fs->lock);
+	if((flags & O_TRUNC) && (r = file_resize(fs, node, 0)) != RESULT_OK) {
+		trn_mutex_unlock(&fs->lock);
+		free(f);
+		return r;
+	}
+	node_get(node);
+	trn_mutex_unlock(&fs->lock);
+
+	*fd = fd_create_file(&tmpfs_file_ops, f);
+	if(*fd < 0) {
+		node_put(node);
+		free(f);
+		return LIBTRANSISTOR_ERR_UNSPECIFIED;
+	}
+	return RESULT_OK;
+}
+
+static result_t tmpfs_open_as_dir(void *data, trn_dir_t *out) {
+	tmpfs_node_t *node = data;
+	tmpfs_t *fs = node->fs;
+
+	if(!node->is_dir) {
+		return LIBTRANSISTOR_ERR_FS_NOT_A_DIRECTORY;
+	}
+
+	tmpfs_dir_t *dir = malloc(sizeof(*dir));
+	if(dir == NULL) {
+		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+	}
+	dir->node = node;
+	dir->pos = 0;
+
+	trn_mutex_lock(&fs->lock);
+	node_get(node);
+	trn_mutex_unlock(&fs->lock);
+
+	out->data = dir;
+	out->ops = &tmpfs_dir_ops;
+	return RESULT_OK;
+}
+
+static result_t tmpfs_stat(void *data, struct stat *st) {
+	tmpfs_node_t *node = data;
+	tmpfs_t *fs = node->fs;
+
+	trn_mutex_lock(&fs->lock);
+	node_stat(node, st);
+	trn_mutex_unlock(&fs->lock);
+	return RESULT_OK;
+}
+
+static trn_inode_ops_t tmpfs_inode_ops = {
+	.is_dir = tmpfs_is_dir,
+	.lookup = tmpfs_lookup,
+	.release = tmpfs_release,
+	.create_file = tmpfs_create_file,
+	.create_directory = tmpfs_create_directory,
+	.remove_file = tmpfs_remove_file,
+	.remove_empty_directory = tmpfs_remove_empty_directory,
+	.rename = tmpfs_rename,
+	.open_as_file = tmpfs_open_as_file,
+	.open_as_dir = tmpfs_open_as_dir,
+	.stat = tmpfs_stat,
+};
+
+result_t trn_tmpfs_create(trn_inode_t *out, size_t max_bytes) {
+	tmpfs_t *fs = malloc(sizeof(*fs));
+	if(fs == NULL) {
+		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+	}
+	if((fs->root = node_create(fs, "", 0, true)) == NULL) {
+		free(fs);
+		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+	}
+	trn_mutex_create(&fs->lock);
+	atomic_init(&fs->refs, 1);
+	fs->max_bytes = max_bytes - max_bytes % PAGE_SIZE;
+	fs->used_bytes = 0;
+	fs->next_ino = 2;
+
+	fs->root->refs = 1;
+	fs->root->linked = true;
+	fs->root->ino = 1;
+
+	out->data = fs->root;
+	out->ops = &tmpfs_inode_ops;
+	return RESULT_OK;
+}
+
+size_t trn_tmpfs_get_used_bytes(trn_inode_t *inode) {
+	tmpfs_node_t *node = inode->data;
+	tmpfs_t *fs = node->fs;
+	size_t used;
+
+	trn_mutex_lock(&fs->lock);
+	used = fs->used_bytes;
+	trn_mutex_unlock(&fs->lock);
+	return used;
+}
@@ -1073,7 +1073,9 @@ result_t ipc_send(ipc_object_t object, ipc_request_t *rq, ipc_response_fmt_t *rs
 	return RESULT_OK;
 }
 
-result_t ipc_send_multi(ipc_multi_session_t *multi, ipc_request_t *rq, ipc_response_fmt_t *rs) {
+// Takes a session out of the pool for this thread to use, cloning a new one
+// if they're all busy.
+static result_t ipc_multi_acquire(ipc_multi_session_t *multi, ipc_multi_session_node_t **out) {
 	result_t r;
 	
 	ipc_multi_session_node_t *node = &multi->first;
@@ -1108,11 +1110,74 @@ result_t ipc_send_multi(ipc_multi_session_t *multi, ipc_request_t *rq, ipc_respo
 		}
 		node = new_node;
 	}
+	*out = node;
+	return RESULT_OK;
+}
+
+result_t ipc_send_multi(ipc_multi_session_t *multi, ipc_request_t *rq, ipc_response_fmt_t *rs) {
+	ipc_multi_session_node_t *node;
+	result_t r;
+
+	if((r = ipc_multi_acquire(multi, &node)) != RESULT_OK) {
+		return r;
+	}
 	r = ipc_send(node->object, rq, rs);
 	atomic_store(&node->is_busy, false);
 	return r;
 }
 
+result_t ipc_send_multi_async(ipc_multi_session_t *multi, ipc_request_t *rq, uint32_t *buffer, ipc_async_request_t *request) {
+	result_t r;
+
+	if((r = ipc_multi_acquire(multi, &request->node)) != RESULT_OK) {
+		return r;
+	}
+	request->buffer = buffer;
+	memset(buffer, 0, IPC_ASYNC_BUFFER_SIZE);
+	ipc_object_t object = request->node->object;
+	if((r = ipc_pack_request(buffer, rq, object)) != RESULT_OK) {
+		goto fail;
+	}
+	ipc_debug_message(IPC_DEBUG_LEVEL_ALL, buffer, "out async request", r);
+	r = svcSendAsyncRequestWithUserBuffer(&request->event, buffer, IPC_ASYNC_BUFFER_SIZE, object.object_id >= 0 ? object.domain->session : object.session);
+	if(r) {
+		goto fail;
+	}
+	return RESULT_OK;
+
+fail:
+	atomic_store(&request->node->is_busy, false);
+	return r;
+}
+
+result_t ipc_wait_multi_async(ipc_async_request_t *request, ipc_response_fmt_t *rs) {
+	ipc_object_t object = request->node->object;
+	uint32_t index;
+	ipc_message_t msg;
+	result_t r;
+
+	r = svcWaitSynchronization(&index, &request->event, 1, UINT64_MAX);
+	svcCloseHandle(request->event);
+	if(r) {
+		goto done;
+	}
+	ipc_debug_message(IPC_DEBUG_LEVEL_ALL, request->buffer, "in async response", r);
+
+	r = ipc_unpack(request->buffer, &msg);
+	if(r) {
+		ipc_debug_message(IPC_DEBUG_LEVEL_UNPACKING_ERRORS, request->buffer, "bad response", r);
+		goto done;
+	}
+	r = ipc_unflatten_response(&msg, rs, object);
+	if(r) {
+		ipc_debug_message(IPC_DEBUG_LEVEL_UNFLATTENING_ERRORS, request->buffer, "bad response", r);
+	}
+
+done:
+	atomic_store(&request->node->is_busy, false);
+	return r;
+}
+
 static result_t ipc_close_session(session_h session) {
 	result_t r;
 	
@@ -8,36 +8,100 @@
 #include<libtransistor/util.h>
 #include<libtransistor/internal_util.h>
 #include<libtransistor/ipc/sm.h>
+#include<libtransistor/tls.h>
+#include<libtransistor/mutex.h>
+#include<libtransistor/alloc_pages.h>
+#include<libtransistor/runtime_config.h>
 
 #include<string.h>
 #include<malloc.h>
+#include<errno.h>
 #include<arpa/inet.h>
 #include<netinet/in.h>
 
-#define TRANSFER_MEM_SIZE 4*256*2*1024
-
-result_t bsd_result;
-int      bsd_errno;
+// for calls made before the thread is set up enough to keep its own
+static result_t early_bsd_result;
+static int      early_bsd_errno;
 
 static loader_config_socket_service_t bsd_service;
 static ipc_multi_session_t bsd_multi;
 static ipc_object_t iresolver_object;
 
-static uint8_t __attribute__((aligned(0x1000))) transfer_buffer[TRANSFER_MEM_SIZE];
+static bsd_config_t bsd_config;
+static void *transfer_buffer;
+static size_t transfer_buffer_size;
 static transfer_memory_h transfer_mem;
 
 static int bsd_initializations = 0;
 
+static void bsd_dns_cache_setup(const bsd_dns_cache_config_t *config);
+static void bsd_dns_cache_teardown();
+
+result_t *bsd_result_location() {
+	trn_thread_t *thread = trn_get_thread();
+	return thread != NULL ? &thread->bsd_last_result : &early_bsd_result;
+}
+
+int *bsd_errno_location() {
+	trn_thread_t *thread = trn_get_thread();
+	return thread != NULL ? &thread->bsd_last_errno : &early_bsd_errno;
+}
+
 result_t bsd_init() {
 	return bsd_init_ex(false, LCONFIG_SOCKET_SERVICE_UNSPECIFIED);
 }
 
 result_t bsd_init_ex(bool require_override, loader_config_socket_service_t service) {
+	return bsd_init_config(require_override, service, &_trn_runconf_bsd_config, _trn_runconf_bsd_transfer_mem_size);
+}
+
+static uint32_t bsd_config_tcp_max(uint32_t size, uint32_t max_size) {
+	return max_size != 0 ? max_size : size;
+}
+
+size_t bsd_config_transfer_mem_size(const bsd_config_t *config) {
+	uint64_t sum = (uint64_t) bsd_config_tcp_max(config->tcp_tx_buf_size, config->tcp_tx_buf_max_size) +
+		bsd_config_tcp_max(config->tcp_rx_buf_size, config->tcp_rx_buf_max_size) +
+		config->udp_tx_buf_size + config->udp_rx_buf_size;
+	sum = (sum + 0xfff) & ~0xfffull;
+	return sum * config->sb_efficiency;
+}
+
+// Catches configurations bsd would refuse before they get sent to it.
+static result_t bsd_config_validate(const bsd_config_t *config, size_t transfer_mem_size) {
+	if(config->version != 1 ||
+	   config->tcp_tx_buf_size == 0 || config->tcp_rx_buf_size == 0 ||
+	   config->udp_tx_buf_size == 0 || config->udp_rx_buf_size == 0 ||
+	   config->sb_efficiency < 1 || config->sb_efficiency > 8) {
+		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+	}
+	if((config->tcp_tx_buf_max_size != 0 && config->tcp_tx_buf_max_size < config->tcp_tx_buf_size) ||
+	   (config->tcp_rx_buf_max_size != 0 && config->tcp_rx_buf_max_size < config->tcp_rx_buf_size)) {
+		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+	}
+	if(transfer_mem_size % 0x1000 != 0) {
+		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+	}
+	return RESULT_OK;
+}
+
+const bsd_config_t *bsd_get_config() {
+	return &bsd_config;
+}
+
+result_t bsd_init_config(bool require_override, loader_config_socket_service_t service, const bsd_config_t *config, size_t transfer_mem_size) {
 	result_t r;
 
+	r = bsd_config_validate(config, transfer_mem_size);
+	if(r) {
+		return r;
+	}
 	if(bsd_initializations++ > 0) {
 		return RESULT_OK;
 	}
+	if(transfer_mem_size == 0) {
+		transfer_mem_size = bsd_config_transfer_mem_size(config);
+	}
 
 	r = sm_init();
 	if(r) {
@@ -71,26 +135,33 @@ result_t bsd_init_ex(bool require_override, loader_config_socket_service_t servi
 	}
 
 	if(!bsd_multi.original.is_borrowed) {
-		r = svcCreateTransferMemory(&transfer_mem, transfer_buffer, TRANSFER_MEM_SIZE, 0);
-		if(r) {
+		transfer_buffer = alloc_pages(transfer_mem_size, transfer_mem_size, NULL);
+		if(transfer_buffer == NULL) {
+			r = LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
 			goto fail_iresolver;
 		}
+		transfer_buffer_size = transfer_mem_size;
+
+		r = svcCreateTransferMemory(&transfer_mem, transfer_buffer, transfer_buffer_size, 0);
+		if(r) {
+			goto fail_transfer_buffer;
+		}
 
 		struct {
 			uint32_t fields[8];
 			uint64_t pid_copy;
 			uint64_t tmem_size;
 		} raw;
-		raw.fields[0] = 0x1;
-		raw.fields[1] = 0x8000;
-		raw.fields[2] = 0x10000;
-		raw.fields[3] = 0x40000;
-		raw.fields[4] = 0x40000;
-		raw.fields[5] = 0x2400;
-		raw.fields[6] = 0xA500;
-		raw.fields[7] = 0x4;
+		raw.fields[0] = config->version;
+		raw.fields[1] = config->tcp_tx_buf_size;
+		raw.fields[2] = config->tcp_rx_buf_size;
+		raw.fields[3] = config->tcp_tx_buf_max_size;
+		raw.fields[4] = config->tcp_rx_buf_max_size;
+		raw.fields[5] = config->udp_tx_buf_size;
+		raw.fields[6] = config->udp_rx_buf_size;
+		raw.fields[7] = config->sb_efficiency;
 		raw.pid_copy = 0;
-		raw.tmem_size = TRANSFER_MEM_SIZE;
+		raw.tmem_size = transfer_buffer_size;
     
 		ipc_request_t rq = ipc_default_request;
 		rq.type = 4;
@@ -120,12 +191,17 @@ result_t bsd_init_ex(bool require_override, loader_config_socket_service_t servi
 		}
 	}
 
+	bsd_config = *config;
+	bsd_dns_cache_setup(&_trn_runconf_bsd_dns_cache_config);
 	sm_finalize();
 	
 	return RESULT_OK;
 
 fail_transfer_memory:
 	svcCloseHandle(transfer_mem);
+fail_transfer_buffer:
+	free_pages(transfer_buffer);
+	transfer_buffer = NULL;
 fail_iresolver:
 	ipc_close(iresolver_object);
 fail_bsd:
@@ -330,6 +406,161 @@ int bsd_sendto(int socket, const void *message, size_t length, int flags, const
 	return response[0];
 }
 
+// Requests for a batch in flight at once, each on its own session
+#define BSD_BATCH_DEPTH 8
+
+typedef struct {
+	uint32_t raw[2];
+	ipc_buffer_t buffers[2];
+	ipc_buffer_t *buffer_ptrs[2];
+	ipc_request_t rq;
+	int32_t response[3]; // ret, errno, address_len
+	ipc_response_fmt_t rs;
+	ipc_async_request_t async;
+	bool in_flight;
+} bsd_batch_slot_t;
+
+// SendTo (or Send, without an address) or RecvFrom for one datagram
+static void bsd_batch_request(bsd_batch_slot_t *slot, int socket, int flags, bsd_datagram_t *dg, bool send) {
+	int num_buffers = 1;
+
+	slot->raw[0] = socket;
+	slot->raw[1] = flags;
+	slot->buffers[0] = (ipc_buffer_t) {.addr = dg->buf, .size = dg->len, .type = send ? 0x21 : 0x22};
+	if(dg->addr != NULL) {
+		slot->buffers[1] = (ipc_buffer_t) {.addr = dg->addr, .size = dg->addr_len, .type = send ? 0x21 : 0x22};
+		num_buffers = 2;
+	}
+	slot->buffer_ptrs[0] = &slot->buffers[0];
+	slot->buffer_ptrs[1] = &slot->buffers[1];
+
+	slot->rq = ipc_default_request;
+	slot->rq.num_buffers = num_buffers;
+	slot->rq.buffers = slot->buffer_ptrs;
+	slot->rq.request_id = send ? (dg->addr != NULL ? 11 : 10) : 9;
+	slot->rq.raw_data = slot->raw;
+	slot->rq.raw_data_size = sizeof(slot->raw);
+
+	slot->rs = ipc_default_response_fmt;
+	slot->rs.raw_data_size = send ? 2 * sizeof(int32_t) : 3 * sizeof(int32_t);
+	slot->rs.raw_data = (uint32_t*) slot->response;
+}
+
+static void bsd_batch_finish(bsd_batch_slot_t *slot, bsd_datagram_t *dg, result_t r, bool send) {
+	if(r) {
+		dg->result = -1;
+		dg->error = trn_result_to_errno(r);
+		dg->ipc_result = r;
+	} else if(slot->response[0] < 0) {
+		dg->result = -1;
+		dg->error = slot->response[1];
+		dg->ipc_result = LIBTRANSISTOR_ERR_BSD_ERRNO_SET;
+	} else {
+		dg->result = slot->response[0];
+		dg->error = 0;
+		dg->ipc_result = RESULT_OK;
+		if(!send && dg->addr != NULL) {
+			dg->addr_len = slot->response[2];
+		}
+	}
+}
+
+/*
+ * bsd takes one datagram per request, so a batch is sent as that many
+ * requests, but with up to BSD_BATCH_DEPTH in flight at once, each on its
+ * own session out of the multi session pool. The round trips overlap, and
+ * bsd works on them side by side. A request that can't be sent
+ * asynchronously is sent synchronously instead.
+ *
+ * Requests that go out after one has failed are still completed, but once
+ * one fails no more are started.
+ */
+static void bsd_batch(int socket, bsd_datagram_t *msgs, int count, int first_flags, int flags, bool send) {
+	bsd_batch_slot_t slots[BSD_BATCH_DEPTH];
+	uint32_t *pages = memalign(0x1000, BSD_BATCH_DEPTH * IPC_ASYNC_BUFFER_SIZE);
+	int next = 0, done = 0;
+	bool failed = false;
+
+	for(int i = 0; i < count; i++) {
+		msgs[i].result = -1;
+		msgs[i].error = EAGAIN;
+		msgs[i].ipc_result = LIBTRANSISTOR_ERR_BSD_ERRNO_SET;
+	}
+	for(;;) {
+		while(!failed && next < count && next - done < BSD_BATCH_DEPTH) {
+			int i = next++;
+			bsd_batch_slot_t *slot = &slots[i % BSD_BATCH_DEPTH];
+			uint32_t *buffer = pages + (i % BSD_BATCH_DEPTH) * (IPC_ASYNC_BUFFER_SIZE / sizeof(*pages));
+
+			bsd_batch_request(slot, socket, i == 0 ? first_flags : flags, &msgs[i], send);
+			slot->in_flight = pages != NULL && ipc_send_multi_async(&bsd_multi, &slot->rq, buffer, &slot->async) == RESULT_OK;
+			if(!slot->in_flight) {
+				bsd_batch_finish(slot, &msgs[i], ipc_send_multi(&bsd_multi, &slot->rq, &slot->rs), send);
+				failed = msgs[i].result < 0;
+			} else if(i == 0 && first_flags != flags) {
+				// the first one decides whether there's any point sending the rest
+				bsd_batch_finish(slot, &msgs[i], ipc_wait_multi_async(&slot->async, &slot->rs), send);
+				slot->in_flight = false;
+				failed = msgs[i].result < 0;
+			}
+		}
+		if(done == next) {
+			break;
+		}
+		bsd_batch_slot_t *slot = &slots[done % BSD_BATCH_DEPTH];
+		if(slot->in_flight) {
+			bsd_batch_finish(slot, &msgs[done], ipc_wait_multi_async(&slot->async, &slot->rs), send);
+			slot->in_flight = false;
+			failed = failed || msgs[done].result < 0;
+		}
+		done++;
+	}
+	free(pages);
+}
+
+// Moves the datagrams that went through to the front, keeping their order.
+static int bsd_batch_compact(bsd_datagram_t *msgs, int count) {
+	int n = 0;
+
+	for(int i = 0; i < count; i++) {
+		if(msgs[i].result >= 0) {
+			if(i != n) {
+				bsd_datagram_t tmp = msgs[n];
+				msgs[n] = msgs[i];
+				msgs[i] = tmp;
+			}
+			n++;
+		}
+	}
+	return n;
+}
+
+static int bsd_batch_result(bsd_datagram_t *msgs, int count, int n) {
+	if(n == 0 && count > 0) {
+		bsd_result = msgs[0].ipc_result;
+		bsd_errno = msgs[0].error;
+		return -1;
+	}
+	return n;
+}
+
+int bsd_sendmmsg(int socket, bsd_datagram_t *msgs, int count, int flags) {
+	BSD_INITIALIZATION_GUARD(-1);
+
+	// ones that were already in flight when another failed may have gone out
+	// too, so a prefix isn't enough to say which need sending again
+	bsd_batch(socket, msgs, count, flags, flags, true);
+	return bsd_batch_result(msgs, count, bsd_batch_compact(msgs, count));
+}
+
+int bsd_recvmmsg(int socket, bsd_datagram_t *msgs, int count, int flags) {
+	BSD_INITIALIZATION_GUARD(-1);
+
+	// like Linux's MSG_WAITFORONE: only the first one waits
+	bsd_batch(socket, msgs, count, flags, flags | MSG_DONTWAIT, false);
+	return bsd_batch_result(msgs, count, bsd_batch_compact(msgs, count));
+}
+
 // def tested via PS
 // impl untested
 int bsd_accept(int socket, struct sockaddr *restrict address, socklen_t *restrict address_len) {
@@ -513,6 +744,39 @@ int bsd_listen(int socket, int backlog) {
 	return response[0];
 }
 
+int bsd_fcntl(int socket, int cmd, int arg) {
+	BSD_INITIALIZATION_GUARD(-1);
+	
+	result_t r;
+
+	uint32_t raw[] = {socket, cmd, arg};
+  
+	ipc_request_t rq = ipc_default_request;
+	rq.request_id = 20;
+	rq.raw_data = raw;
+	rq.raw_data_size = sizeof(raw);
+
+	int32_t response[2]; // ret, errno
+  
+	ipc_response_fmt_t rs = ipc_default_response_fmt;
+	rs.raw_data_size = sizeof(response);
+	rs.raw_data = (uint32_t*) response;
+  
+	r = ipc_send_multi(&bsd_multi, &rq, &rs);
+	if(r) {
+		bsd_result = r;
+		return -1;
+	}
+
+	if(response[0] < 0) {
+		bsd_result = LIBTRANSISTOR_ERR_BSD_ERRNO_SET;
+		bsd_errno = response[1];
+		return -1;
+	}
+  
+	return response[0];
+}
+
 // def untested
 int bsd_setsockopt(int socket, int level, int option_name, const void *option_value, socklen_t option_len) {
 	return 0;
@@ -737,6 +1001,12 @@ static int bsd_getaddrinfo_impl(const char *node, const char *service, const str
 		return -1;
 	}
 
+	if(response[0] != 0) { // the name didn't resolve; response[0] is an EAI_* code saying why
+		bsd_result = LIBTRANSISTOR_ERR_BSD_ERRNO_SET;
+		bsd_errno = response[1];
+		return response[0];
+	}
+
 	r = bsd_ai_unpack(res, response_packed, response[2], limit);
 	if(r) {
 		bsd_result = r;
@@ -746,29 +1016,279 @@ static int bsd_getaddrinfo_impl(const char *node, const char *service, const str
 	return response[0];
 }
 
-int bsd_getaddrinfo_fixed(const char *node, const char *service, const struct addrinfo *hints, struct addrinfo_fixed *res, int num_addrinfos) {
-	BSD_INITIALIZATION_GUARD(-1);
-	
-	for(int i = 0; i < num_addrinfos; i++) {
-		res[i].ai.ai_addr = (struct sockaddr*) &(res[i].addr);
-		res[i].ai.ai_canonname = res[i].canonname;
-		res[i].ai.ai_next = (i+1) == num_addrinfos ? NULL : &(res[i + 1].ai);
+/*
+ * DNS cache
+ *
+ * Lookups are kept in an arena of equal slots, each with the lookup's key
+ * followed by the addrinfo chain it resolved to, laid out back to back.
+ * bsd_getaddrinfo hands out the chain in the slot itself, so a slot can't be
+ * reused until every caller has freed it; one that expires or gets flushed in
+ * the meantime is only marked stale, and freed along with its last chain.
+ */
+#define BSD_DNS_TICKS_PER_MS 19200
+#define BSD_DNS_KEY_MAX 0x200
+
+typedef enum {
+	BSD_DNS_FREE = 0,
+	BSD_DNS_LIVE,
+	BSD_DNS_STALE, // expired or flushed, with chains still out
+} bsd_dns_state_t;
+
+typedef struct {
+	bsd_dns_state_t state;
+	uint32_t hash;
+	int refs;
+	uint64_t expires;
+	uint64_t last_used;
+	int result; // what sfdnsres said; nonzero for a name that didn't resolve
+	int error;
+	struct addrinfo *ai;
+	size_t key_len;
+	uint8_t data[] __attribute__((aligned(8))); // key, then the chain
+} bsd_dns_entry_t;
+
+static trn_mutex_t dns_cache_mutex = TRN_MUTEX_STATIC_INITIALIZER;
+static bsd_dns_cache_config_t dns_cache_config;
+static uint8_t *dns_cache_arena;
+static size_t dns_cache_stride;
+static int dns_cache_refs; // chains out of the arena that haven't been freed
+static bool dns_cache_retired; // bsd was finalized with chains still out
+
+static bsd_dns_entry_t *bsd_dns_entry(uint32_t i) {
+	return (bsd_dns_entry_t*) (dns_cache_arena + i * dns_cache_stride);
+}
+
+static void bsd_dns_cache_setup(const bsd_dns_cache_config_t *config) {
+	trn_mutex_lock(&dns_cache_mutex);
+	dns_cache_retired = false;
+	if(dns_cache_arena == NULL && config->entries > 0) {
+		dns_cache_stride = ((size_t) config->entry_size + 15) & ~(size_t) 15;
+		if(dns_cache_stride > sizeof(bsd_dns_entry_t)) {
+			// without room for it, lookups just aren't cached
+			dns_cache_arena = memalign(16, config->entries * dns_cache_stride);
+		}
+		if(dns_cache_arena != NULL) {
+			memset(dns_cache_arena, 0, config->entries * dns_cache_stride);
+			dns_cache_config = *config;
+		}
 	}
-	return bsd_getaddrinfo_impl(node, service, hints, &res->ai, num_addrinfos);
+	trn_mutex_unlock(&dns_cache_mutex);
 }
 
-int bsd_getaddrinfo(const char *node, const char *service, const struct addrinfo *hints, struct addrinfo **res) {
-	BSD_INITIALIZATION_GUARD(-1);
-	
+static void bsd_dns_flush_locked() {
+	if(dns_cache_arena == NULL) {
+		return;
+	}
+	for(uint32_t i = 0; i < dns_cache_config.entries; i++) {
+		bsd_dns_entry_t *entry = bsd_dns_entry(i);
+		if(entry->state == BSD_DNS_LIVE) {
+			entry->state = entry->refs > 0 ? BSD_DNS_STALE : BSD_DNS_FREE;
+		}
+	}
+}
+
+void bsd_dns_cache_flush() {
+	trn_mutex_lock(&dns_cache_mutex);
+	bsd_dns_flush_locked();
+	trn_mutex_unlock(&dns_cache_mutex);
+}
+
+static void bsd_dns_cache_teardown() {
+	trn_mutex_lock(&dns_cache_mutex);
+	bsd_dns_flush_locked();
+	if(dns_cache_refs == 0) {
+		free(dns_cache_arena);
+		dns_cache_arena = NULL;
+	} else {
+		dns_cache_retired = true;
+	}
+	trn_mutex_unlock(&dns_cache_mutex);
+}
+
+// Gives the chain back if it came out of the arena, and says whether it did.
+static bool bsd_dns_release(struct addrinfo *ai) {
+	uint8_t *p = (uint8_t*) ai;
+
+	trn_mutex_lock(&dns_cache_mutex);
+	if(dns_cache_arena == NULL || p < dns_cache_arena || p >= dns_cache_arena + dns_cache_config.entries * dns_cache_stride) {
+		trn_mutex_unlock(&dns_cache_mutex);
+		return false;
+	}
+	bsd_dns_entry_t *entry = bsd_dns_entry((p - dns_cache_arena) / dns_cache_stride);
+	if(--entry->refs == 0 && entry->state == BSD_DNS_STALE) {
+		entry->state = BSD_DNS_FREE;
+	}
+	if(--dns_cache_refs == 0 && dns_cache_retired) {
+		free(dns_cache_arena);
+		dns_cache_arena = NULL;
+	}
+	trn_mutex_unlock(&dns_cache_mutex);
+	return true;
+}
+
+// Everything a lookup depends on, in one string of bytes. Returns 0 for
+// lookups too long to cache.
+static size_t bsd_dns_key(const char *node, const char *service, const struct addrinfo *hints, uint8_t *key) {
+	const char *strings[] = {node, service};
+	size_t len = 0;
+
+	key[len++] = hints != NULL;
+	if(hints != NULL) {
+		int32_t fields[] = {hints->ai_flags, hints->ai_family, hints->ai_socktype, hints->ai_protocol};
+		memcpy(key + len, fields, sizeof(fields));
+		len+= sizeof(fields);
+	}
+	for(int i = 0; i < 2; i++) {
+		key[len++] = strings[i] != NULL;
+		if(strings[i] == NULL) {
+			continue;
+		}
+		size_t n = strlen(strings[i]) + 1;
+		if(len + n + 1 > BSD_DNS_KEY_MAX) {
+			return 0;
+		}
+		memcpy(key + len, strings[i], n);
+		len+= n;
+	}
+	return len;
+}
+
+static uint32_t bsd_dns_hash(const uint8_t *key, size_t len) {
+	uint32_t hash = 2166136261u; // FNV-1a
+	for(size_t i = 0; i < len; i++) {
+		hash = (hash ^ key[i]) * 16777619u;
+	}
+	return hash;
+}
+
+// Finds the live entry for a key, retiring any expired ones on the way.
+static bsd_dns_entry_t *bsd_dns_find(const uint8_t *key, size_t key_len, uint32_t hash, uint64_t now) {
+	bsd_dns_entry_t *found = NULL;
+
+	if(dns_cache_arena == NULL || dns_cache_retired) {
+		return NULL;
+	}
+	for(uint32_t i = 0; i < dns_cache_config.entries; i++) {
+		bsd_dns_entry_t *entry = bsd_dns_entry(i);
+		if(entry->state != BSD_DNS_LIVE) {
+			continue;
+		}
+		if(entry->expires <= now) {
+			entry->state = entry->refs > 0 ? BSD_DNS_STALE : BSD_DNS_FREE;
+		} else if(entry->hash == hash && entry->key_len == key_len && memcmp(entry->data, key, key_len) == 0) {
+			found = entry;
+		}
+	}
+	return found;
+}
+
+// A free slot, or else the least recently used one nobody holds a chain from.
+static bsd_dns_entry_t *bsd_dns_claim() {
+	bsd_dns_entry_t *victim = NULL;
+
+	if(dns_cache_arena == NULL || dns_cache_retired) {
+		return NULL;
+	}
+	for(uint32_t i = 0; i < dns_cache_config.entries; i++) {
+		bsd_dns_entry_t *entry = bsd_dns_entry(i);
+		if(entry->state == BSD_DNS_FREE) {
+			return entry;
+		}
+		if(entry->state == BSD_DNS_LIVE && entry->refs == 0 && (victim == NULL || entry->last_used < victim->last_used)) {
+			victim = entry;
+		}
+	}
+	return victim;
+}
+
+// Lays a chain out back to back in out, or returns NULL if it doesn't fit.
+static struct addrinfo *bsd_dns_copy_chain(const struct addrinfo *src, uint8_t *out, size_t size) {
+	struct addrinfo *head = NULL, **link = &head;
+	size_t used = 0;
+
+	for(; src != NULL; src = src->ai_next) {
+		size_t addrlen = src->ai_addr != NULL ? src->ai_addrlen : 0;
+		size_t canonlen = src->ai_canonname != NULL ? strlen(src->ai_canonname) + 1 : 0;
+		size_t need = (sizeof(struct addrinfo) + addrlen + canonlen + 7) & ~(size_t) 7;
+		if(used + need > size) {
+			return NULL;
+		}
+		struct addrinfo *ai = (struct addrinfo*) (out + used);
+		uint8_t *extra = (uint8_t*) (ai + 1);
+		*ai = *src;
+		if(addrlen > 0) {
+			ai->ai_addr = memcpy(extra, src->ai_addr, addrlen);
+			extra+= addrlen;
+		}
+		if(canonlen > 0) {
+			ai->ai_canonname = memcpy(extra, src->ai_canonname, canonlen);
+		}
+		ai->ai_next = NULL;
+		*link = ai;
+		link = &ai->ai_next;
+		used+= need;
+	}
+	return head;
+}
+
+static bool bsd_dns_fill(bsd_dns_entry_t *entry, const uint8_t *key, size_t key_len, uint32_t hash, int result, const struct addrinfo *ai, uint64_t now) {
+	size_t room = dns_cache_stride - sizeof(bsd_dns_entry_t);
+	size_t chain_at = (key_len + 7) & ~(size_t) 7;
+	uint32_t ttl_ms = result == 0 ? dns_cache_config.ttl_ms : dns_cache_config.negative_ttl_ms;
+
+	if(chain_at > room) {
+		return false;
+	}
+	entry->ai = NULL;
+	if(result == 0 && (entry->ai = bsd_dns_copy_chain(ai, entry->data + chain_at, room - chain_at)) == NULL) {
+		return false;
+	}
+	memcpy(entry->data, key, key_len);
+	entry->key_len = key_len;
+	entry->hash = hash;
+	entry->result = result;
+	entry->error = bsd_errno;
+	entry->refs = 0;
+	entry->expires = now + (uint64_t) ttl_ms * BSD_DNS_TICKS_PER_MS;
+	entry->last_used = now;
+	entry->state = BSD_DNS_LIVE;
+	return true;
+}
+
+static int bsd_dns_take(bsd_dns_entry_t *entry, struct addrinfo **res, uint64_t now) {
+	entry->last_used = now;
+	if(entry->result != 0) {
+		bsd_result = LIBTRANSISTOR_ERR_BSD_ERRNO_SET;
+		bsd_errno = entry->error;
+		return entry->result;
+	}
+	entry->refs++;
+	dns_cache_refs++;
+	*res = entry->ai;
+	return 0;
+}
+
+// Only answers that will still hold next time are worth keeping.
+static bool bsd_dns_cacheable(int result) {
+	if(result == 0) {
+		return dns_cache_config.ttl_ms > 0;
+	}
+	return result > 0 && result != EAI_AGAIN && result != EAI_MEMORY && result != EAI_SYSTEM &&
+		dns_cache_config.negative_ttl_ms > 0;
+}
+
+// Asks sfdnsres, with every addrinfo in the chain allocated on its own.
+static int bsd_getaddrinfo_uncached(const char *node, const char *service, const struct addrinfo *hints, struct addrinfo **res) {
 	struct addrinfo *ai;
 	ai = malloc(sizeof(struct addrinfo));
 	if(ai == NULL) {
-		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+		bsd_result = LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+		return -1;
 	}
 	memset(ai, 0, sizeof(struct addrinfo));
-  
-	result_t r;
-	if((r = bsd_getaddrinfo_impl(node, service, hints, ai, -1)) != RESULT_OK) {
+
+	int r;
+	if((r = bsd_getaddrinfo_impl(node, service, hints, ai, -1)) != 0) {
 		free(ai);
 		return r;
 	}
@@ -776,6 +1296,103 @@ int bsd_getaddrinfo(const char *node, const char *service, const struct addrinfo
 	return r;
 }
 
+int bsd_getaddrinfo(const char *node, const char *service, const struct addrinfo *hints, struct addrinfo **res) {
+	BSD_INITIALIZATION_GUARD(-1);
+
+	uint8_t key[BSD_DNS_KEY_MAX];
+	size_t key_len = bsd_dns_key(node, service, hints, key);
+	uint32_t hash = bsd_dns_hash(key, key_len);
+	bsd_dns_entry_t *entry;
+	int r;
+
+	if(key_len == 0) {
+		return bsd_getaddrinfo_uncached(node, service, hints, res);
+	}
+
+	trn_mutex_lock(&dns_cache_mutex);
+	uint64_t now = svcGetSystemTick();
+	if((entry = bsd_dns_find(key, key_len, hash, now)) != NULL) {
+		r = bsd_dns_take(entry, res, now);
+		trn_mutex_unlock(&dns_cache_mutex);
+		return r;
+	}
+	trn_mutex_unlock(&dns_cache_mutex);
+
+	// not while holding the lock, so other lookups don't wait on this one
+	struct addrinfo *ai = NULL;
+	r = bsd_getaddrinfo_uncached(node, service, hints, &ai);
+
+	trn_mutex_lock(&dns_cache_mutex);
+	now = svcGetSystemTick();
+	if(bsd_dns_cacheable(r)) {
+		// another thread might have looked the same name up meanwhile
+		if((entry = bsd_dns_find(key, key_len, hash, now)) == NULL &&
+		   (entry = bsd_dns_claim()) != NULL &&
+		   !bsd_dns_fill(entry, key, key_len, hash, r, ai, now)) {
+			entry->state = BSD_DNS_FREE;
+			entry = NULL;
+		}
+	} else {
+		entry = NULL;
+	}
+	if(entry != NULL) {
+		r = bsd_dns_take(entry, res, now);
+	} else if(r == 0) {
+		*res = ai;
+		ai = NULL;
+	}
+	trn_mutex_unlock(&dns_cache_mutex);
+
+	if(ai != NULL) {
+		bsd_freeaddrinfo(ai);
+	}
+	return r;
+}
+
+int bsd_getaddrinfo_fixed(const char *node, const char *service, const struct addrinfo *hints, struct addrinfo_fixed *res, int num_addrinfos) {
+	BSD_INITIALIZATION_GUARD(-1);
+
+	for(int i = 0; i < num_addrinfos; i++) {
+		res[i].ai.ai_addr = (struct sockaddr*) &(res[i].addr);
+		res[i].ai.ai_canonname = res[i].canonname;
+		res[i].ai.ai_next = (i+1) == num_addrinfos ? NULL : &(res[i + 1].ai);
+	}
+	if(dns_cache_arena == NULL) {
+		return bsd_getaddrinfo_impl(node, service, hints, &res->ai, num_addrinfos);
+	}
+
+	struct addrinfo *chain;
+	int r = bsd_getaddrinfo(node, service, hints, &chain);
+	if(r != 0) {
+		return r;
+	}
+	const struct addrinfo *src = chain;
+	for(int i = 0; i < num_addrinfos && src != NULL; i++, src = src->ai_next) {
+		struct addrinfo *ai = &res[i].ai;
+		ai->ai_flags = src->ai_flags;
+		ai->ai_family = src->ai_family;
+		ai->ai_socktype = src->ai_socktype;
+		ai->ai_protocol = src->ai_protocol;
+		ai->ai_addrlen = src->ai_addrlen;
+		if(src->ai_addr == NULL || src->ai_addrlen == 0) {
+			ai->ai_addr = NULL;
+		} else {
+			memcpy(&res[i].addr, src->ai_addr, src->ai_addrlen < sizeof(res[i].addr) ? src->ai_addrlen : sizeof(res[i].addr));
+		}
+		if(src->ai_canonname == NULL) {
+			ai->ai_canonname = NULL;
+		} else {
+			strncpy(res[i].canonname, src->ai_canonname, sizeof(res[i].canonname) - 1);
+			res[i].canonname[sizeof(res[i].canonname) - 1] = 0;
+		}
+		if(src->ai_next == NULL) {
+			ai->ai_next = NULL;
+		}
+	}
+	bsd_freeaddrinfo(chain);
+	return 0;
+}
+
 // def tested via PS
 int bsd_close(int socket) {
 	BSD_INITIALIZATION_GUARD(-1);
@@ -811,11 +1428,15 @@ int bsd_close(int socket) {
 }
 
 static void bsd_force_finalize() {
+	bsd_dns_cache_teardown();
 	ipc_close(iresolver_object);
-	if(!bsd_multi.original.is_borrowed) {
+	ipc_close_multi(&bsd_multi);
+	// bsd lets go of the transfer memory along with the session
+	if(transfer_buffer != NULL) {
 		svcCloseHandle(transfer_mem);
+		free_pages(transfer_buffer);
+		transfer_buffer = NULL;
 	}
-	ipc_close_multi(&bsd_multi);
 
 	bsd_initializations = 0;
 }
@@ -1039,6 +1660,9 @@ bail:
 }
 
 void bsd_freeaddrinfo(struct addrinfo *res) {
+	if(bsd_dns_release(res)) {
+		return;
+	}
 	if(res->ai_next != NULL) {
 		bsd_freeaddrinfo(res->ai_next);
 	}
@@ -6,18 +6,30 @@
 #include<libtransistor/err.h>
 #include<libtransistor/util.h>
 #include<libtransistor/ipc/sm.h>
+#include<libtransistor/tls.h>
 
 #include<string.h>
 #include<malloc.h>
 
 #define TRANSFER_MEM_SIZE 3*1024*1024
 
-result_t nv_result;
-int nv_errno;
+// for calls made before the thread is set up enough to keep its own
+static result_t early_nv_result;
+static int early_nv_errno;
 
 static ipc_object_t nv_object;
 static int nv_initializations = 0;
 
+result_t *nv_result_location() {
+	trn_thread_t *thread = trn_get_thread();
+	return thread != NULL ? &thread->nv_last_result : &early_nv_result;
+}
+
+int *nv_errno_location() {
+	trn_thread_t *thread = trn_get_thread();
+	return thread != NULL ? &thread->nv_last_errno : &early_nv_errno;
+}
+
 static uint8_t __attribute__((aligned(0x1000))) transfer_buffer[TRANSFER_MEM_SIZE];
 static transfer_memory_h transfer_mem;
 
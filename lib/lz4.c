@@ -287,6 +287,68 @@ void LZ4_wildCopy(void* dstPtr, const void* srcPtr, void* dstEnd)
 }
 
 
+/*-************************************
+*  AArch64 NEON
+**************************************/
+/* LZ4_NEON :
+ * Use 16-byte NEON copies in the decoder. Defaults to on for AArch64 (e.g. the
+ * Cortex-A57); define as 0 to get the portable decoder back for comparison.
+ */
+#ifndef LZ4_NEON
+#  if defined(__aarch64__) && defined(__ARM_NEON)
+#    define LZ4_NEON 1
+#  else
+#    define LZ4_NEON 0
+#  endif
+#endif
+
+#if LZ4_NEON
+#include <arm_neon.h>
+
+/* like LZ4_wildCopy, but can overwrite up to 16 bytes beyond dstEnd */
+LZ4_FORCE_INLINE void LZ4_wildCopy16(void* dstPtr, const void* srcPtr, void* dstEnd)
+{
+    BYTE* d = (BYTE*)dstPtr;
+    const BYTE* s = (const BYTE*)srcPtr;
+    BYTE* const e = (BYTE*)dstEnd;
+
+    do { vst1q_u8(d, vld1q_u8(s)); d+=16; s+=16; } while (d<e);
+}
+
+/* LZ4_patternIndex[offset][i] == i % offset */
+static const BYTE LZ4_patternIndex[16][16] = {
+    { 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1 },
+    { 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
+    { 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3 },
+    { 0, 1, 2, 3, 4, 0, 1, 2, 3, 4, 0, 1, 2, 3, 4, 0 },
+    { 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3 },
+    { 0, 1, 2, 3, 4, 5, 6, 0, 1, 2, 3, 4, 5, 6, 0, 1 },
+    { 0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7 },
+    { 0, 1, 2, 3, 4, 5, 6, 7, 8, 0, 1, 2, 3, 4, 5, 6 },
+    { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0, 1, 2, 3, 4, 5 },
+    { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10, 0, 1, 2, 3, 4 },
+    { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11, 0, 1, 2, 3 },
+    { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12, 0, 1, 2 },
+    { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13, 0, 1 },
+    { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14, 0 },
+};
+
+/* Copies an overlapping match with 0 < offset < 16 : the first offset bytes
+ * of the match are spread over a whole register, which is then stored at a
+ * stride that keeps the pattern in phase.
+ * Reads 16 bytes from match, and can overwrite up to 16 bytes beyond dstEnd. */
+LZ4_FORCE_INLINE void LZ4_patternCopy16(BYTE* op, const BYTE* match, size_t offset, BYTE* const dstEnd)
+{
+    uint8x16_t const pattern = vqtbl1q_u8(vld1q_u8(match), vld1q_u8(LZ4_patternIndex[offset]));
+    size_t const step = 16 - (16 % offset);
+
+    do { vst1q_u8(op, pattern); op+=step; } while (op<dstEnd);
+}
+#endif /* LZ4_NEON */
+
+
 /*-************************************
 *  Common Constants
 **************************************/
@@ -1256,6 +1318,11 @@ LZ4_FORCE_INLINE int LZ4_decompress_generic(
             op += length;
             break;     /* Necessarily EOF, due to parsing restrictions */
         }
+#if LZ4_NEON
+        if (likely(cpy <= oend-16) & likely(endOnInput ? ip+length <= iend-16 : 1))
+            LZ4_wildCopy16(op, ip, cpy);
+        else
+#endif
         LZ4_wildCopy(op, ip, cpy);
         ip += length; op = cpy;
 
@@ -1305,6 +1372,14 @@ LZ4_FORCE_INLINE int LZ4_decompress_generic(
 
         /* copy match within block */
         cpy = op + length;
+#if LZ4_NEON
+        if (likely(cpy <= oend-16) & likely(offset != 0)) {
+            if (offset >= 16) LZ4_wildCopy16(op, match, cpy);
+            else LZ4_patternCopy16(op, match, offset, cpy);
+            op = cpy;
+            continue;
+        }
+#endif
         if (unlikely(offset<8)) {
             op[0] = match[0];
             op[1] = match[1];
@@ -27,59 +27,230 @@
 #include "fs.h"
 
 #include <stdlib.h>
+#include <string.h>
 
-sqfs_err sqfs_cache_init(sqfs_cache *cache, size_t size, size_t count,
-		sqfs_cache_dispose dispose) {
-	cache->size = size;
-	cache->count = count;
-	cache->dispose = dispose;
-	cache->next = 0;
-	
-	cache->idxs = calloc(count, sizeof(sqfs_cache_idx));
-	cache->buf = calloc(count, size);
-	if (cache->idxs && cache->buf)
-		return SQFS_OK;
-	
-	sqfs_cache_destroy(cache);
-	return SQFS_ERR;
-}
+enum {
+	SQFS_CACHE_FREE,
+	SQFS_CACHE_PROBATION,
+	SQFS_CACHE_PROTECTED
+};
 
 static void *sqfs_cache_entry(sqfs_cache *cache, size_t i) {
 	return cache->buf + i * cache->size;
 }
 
-void sqfs_cache_destroy(sqfs_cache *cache) {
-	if (cache->buf && cache->idxs) {
+static size_t sqfs_cache_bucket(sqfs_cache *cache, sqfs_cache_idx idx) {
+	return (size_t)((idx * 0x9E3779B97F4A7C15ULL) >> 32) & cache->bucket_mask;
+}
+
+static void sqfs_cache_free(sqfs_cache *cache) {
+	if (cache->buf && cache->idxs && cache->segment) {
 		size_t i;
 		for (i = 0; i < cache->count; ++i) {
-			if (cache->idxs[i] != SQFS_CACHE_IDX_INVALID)
+			if (cache->segment[i] != SQFS_CACHE_FREE)
 				cache->dispose(sqfs_cache_entry(cache, i));
 		}
 	}
 	free(cache->buf);
 	free(cache->idxs);
+	free(cache->hash_next);
+	free(cache->lru_prev);
+	free(cache->lru_next);
+	free(cache->segment);
+	free(cache->buckets);
+	cache->buf = NULL;
+	cache->idxs = NULL;
+	cache->hash_next = NULL;
+	cache->lru_prev = NULL;
+	cache->lru_next = NULL;
+	cache->segment = NULL;
+	cache->buckets = NULL;
 }
 
-void *sqfs_cache_get(sqfs_cache *cache, sqfs_cache_idx idx) {
+static sqfs_err sqfs_cache_alloc(sqfs_cache *cache, size_t count) {
+	size_t i, buckets = 1;
+	while (buckets < count * 2)
+		buckets <<= 1;
+	
+	cache->count = count;
+	cache->bucket_mask = buckets - 1;
+	cache->idxs = calloc(count, sizeof(sqfs_cache_idx));
+	cache->buf = calloc(count, cache->size);
+	cache->hash_next = calloc(count, sizeof(size_t));
+	cache->lru_prev = calloc(count, sizeof(size_t));
+	cache->lru_next = calloc(count, sizeof(size_t));
+	cache->segment = calloc(count, sizeof(uint8_t));
+	cache->buckets = calloc(buckets, sizeof(size_t));
+	if (!(cache->idxs && cache->buf && cache->hash_next && cache->lru_prev &&
+			cache->lru_next && cache->segment && cache->buckets)) {
+		sqfs_cache_free(cache);
+		return SQFS_ERR;
+	}
+	
+	for (i = 0; i < buckets; ++i)
+		cache->buckets[i] = SQFS_CACHE_NONE;
+	for (i = 0; i < count; ++i)
+		cache->lru_next[i] = i + 1 < count ? i + 1 : SQFS_CACHE_NONE;
+	cache->free_head = 0;
+	cache->probation_head = cache->probation_tail = SQFS_CACHE_NONE;
+	cache->protected_head = cache->protected_tail = SQFS_CACHE_NONE;
+	cache->protected_count = 0;
+	/* a quarter of the cache is reserved for entries that were only used once */
+	cache->protected_max = count - (count + 3) / 4;
+	return SQFS_OK;
+}
+
+sqfs_err sqfs_cache_init(sqfs_cache *cache, size_t size, size_t count,
+		sqfs_cache_dispose dispose) {
+	memset(cache, 0, sizeof(*cache));
+	cache->size = size;
+	cache->dispose = dispose;
+	return sqfs_cache_alloc(cache, count);
+}
+
+void sqfs_cache_destroy(sqfs_cache *cache) {
+	sqfs_cache_free(cache);
+}
+
+sqfs_err sqfs_cache_resize(sqfs_cache *cache, size_t count) {
+	sqfs_cache resized;
+	if (count == 0)
+		return SQFS_ERR;
+	
+	/* leave the old cache alone if we can't get the new one */
+	if (sqfs_cache_init(&resized, cache->size, count, cache->dispose))
+		return SQFS_ERR;
+	resized.stats = cache->stats;
+	sqfs_cache_free(cache);
+	*cache = resized;
+	return SQFS_OK;
+}
+
+static void sqfs_cache_unlink(sqfs_cache *cache, size_t i) {
+	size_t *head, *tail;
+	if (cache->segment[i] == SQFS_CACHE_PROTECTED) {
+		head = &cache->protected_head;
+		tail = &cache->protected_tail;
+		cache->protected_count--;
+	} else {
+		head = &cache->probation_head;
+		tail = &cache->probation_tail;
+	}
+	
+	if (cache->lru_prev[i] != SQFS_CACHE_NONE)
+		cache->lru_next[cache->lru_prev[i]] = cache->lru_next[i];
+	else
+		*head = cache->lru_next[i];
+	if (cache->lru_next[i] != SQFS_CACHE_NONE)
+		cache->lru_prev[cache->lru_next[i]] = cache->lru_prev[i];
+	else
+		*tail = cache->lru_prev[i];
+}
+
+static void sqfs_cache_push(sqfs_cache *cache, size_t i, uint8_t segment) {
+	size_t *head, *tail;
+	if (segment == SQFS_CACHE_PROTECTED) {
+		head = &cache->protected_head;
+		tail = &cache->protected_tail;
+		cache->protected_count++;
+	} else {
+		head = &cache->probation_head;
+		tail = &cache->probation_tail;
+	}
+	
+	cache->segment[i] = segment;
+	cache->lru_prev[i] = SQFS_CACHE_NONE;
+	cache->lru_next[i] = *head;
+	if (*head != SQFS_CACHE_NONE)
+		cache->lru_prev[*head] = i;
+	else
+		*tail = i;
+	*head = i;
+}
+
+static size_t sqfs_cache_find(sqfs_cache *cache, sqfs_cache_idx idx) {
 	size_t i;
-	for (i = 0; i < cache->count; ++i) {
+	for (i = cache->buckets[sqfs_cache_bucket(cache, idx)];
+			i != SQFS_CACHE_NONE; i = cache->hash_next[i]) {
 		if (cache->idxs[i] == idx)
-			return sqfs_cache_entry(cache, i);
+			return i;
 	}
-	return NULL;
+	return SQFS_CACHE_NONE;
+}
+
+static void sqfs_cache_unhash(sqfs_cache *cache, size_t i) {
+	size_t *link = &cache->buckets[sqfs_cache_bucket(cache, cache->idxs[i])];
+	while (*link != i)
+		link = &cache->hash_next[*link];
+	*link = cache->hash_next[i];
+	cache->idxs[i] = SQFS_CACHE_IDX_INVALID;
+}
+
+void *sqfs_cache_get(sqfs_cache *cache, sqfs_cache_idx idx) {
+	size_t i = idx == SQFS_CACHE_IDX_INVALID ? SQFS_CACHE_NONE
+		: sqfs_cache_find(cache, idx);
+	if (i == SQFS_CACHE_NONE) {
+		cache->stats.misses++;
+		return NULL;
+	}
+	cache->stats.hits++;
+	
+	if (cache->segment[i] == SQFS_CACHE_PROTECTED || cache->protected_max == 0) {
+		sqfs_cache_unlink(cache, i);
+		sqfs_cache_push(cache, i, cache->segment[i]);
+	} else {
+		/* second hit, promote it. make room by demoting the least recently
+		 * used protected entry */
+		sqfs_cache_unlink(cache, i);
+		if (cache->protected_count == cache->protected_max) {
+			size_t demote = cache->protected_tail;
+			sqfs_cache_unlink(cache, demote);
+			sqfs_cache_push(cache, demote, SQFS_CACHE_PROBATION);
+		}
+		sqfs_cache_push(cache, i, SQFS_CACHE_PROTECTED);
+	}
+	return sqfs_cache_entry(cache, i);
+}
+
+bool sqfs_cache_contains(sqfs_cache *cache, sqfs_cache_idx idx) {
+	return idx != SQFS_CACHE_IDX_INVALID
+		&& sqfs_cache_find(cache, idx) != SQFS_CACHE_NONE;
 }
 
 void *sqfs_cache_add(sqfs_cache *cache, sqfs_cache_idx idx) {
-	size_t i = (cache->next++);
-	cache->next %= cache->count;
+	size_t i, *bucket;
 	
-	if (cache->idxs[i] != SQFS_CACHE_IDX_INVALID)
+	if (cache->free_head != SQFS_CACHE_NONE) {
+		i = cache->free_head;
+		cache->free_head = cache->lru_next[i];
+	} else {
+		i = cache->probation_tail != SQFS_CACHE_NONE ? cache->probation_tail
+			: cache->protected_tail;
+		sqfs_cache_unlink(cache, i);
+		sqfs_cache_unhash(cache, i);
 		cache->dispose(sqfs_cache_entry(cache, i));
+		cache->stats.evictions++;
+	}
 	
 	cache->idxs[i] = idx;
+	bucket = &cache->buckets[sqfs_cache_bucket(cache, idx)];
+	cache->hash_next[i] = *bucket;
+	*bucket = i;
+	sqfs_cache_push(cache, i, SQFS_CACHE_PROBATION);
 	return sqfs_cache_entry(cache, i);
 }
 
+void sqfs_cache_invalidate(sqfs_cache *cache, sqfs_cache_idx idx) {
+	size_t i = sqfs_cache_find(cache, idx);
+	if (i == SQFS_CACHE_NONE)
+		return;
+	sqfs_cache_unlink(cache, i);
+	sqfs_cache_unhash(cache, i);
+	cache->segment[i] = SQFS_CACHE_FREE;
+	cache->lru_next[i] = cache->free_head;
+	cache->free_head = i;
+}
+
 static void sqfs_block_cache_dispose(void *data) {
 	sqfs_block_cache_entry *entry = (sqfs_block_cache_entry*)data;
 	sqfs_block_dispose(entry->block);
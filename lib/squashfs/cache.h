@@ -27,17 +27,28 @@
 
 #include "common.h"
 
-/* Really simplistic cache
- *  - Linear search
- *  - Linear eviction
+/* Hashed cache with segmented-LRU eviction
+ *  - Hash lookup
+ *  - New entries start out probationary, and are promoted to the protected
+ *    segment when they are hit again. Probationary entries are evicted
+ *    first, so a single streaming pass can't push out hot entries.
  *  - No thread safety
  *  - Misses are caller's responsibility
+ *  - An entry returned by sqfs_cache_get or sqfs_cache_add stays valid until
+ *    the next sqfs_cache_add, sqfs_cache_invalidate or sqfs_cache_resize
  */
 #define SQFS_CACHE_IDX_INVALID 0
+#define SQFS_CACHE_NONE ((size_t)-1)
 
 typedef uint64_t sqfs_cache_idx;
 typedef void (*sqfs_cache_dispose)(void* data);
 
+typedef struct {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+} sqfs_cache_stats;
+
 typedef struct {
 	sqfs_cache_idx *idxs;
 	uint8_t *buf;
@@ -45,15 +56,37 @@ typedef struct {
 	sqfs_cache_dispose dispose;
 	
 	size_t size, count;
-	size_t next; /* next block to evict */
+	
+	/* per-slot links, SQFS_CACHE_NONE-terminated */
+	size_t *hash_next;
+	size_t *lru_prev, *lru_next;
+	uint8_t *segment;
+	
+	size_t *buckets;
+	size_t bucket_mask;
+	
+	/* LRU lists, head is most recently used */
+	size_t probation_head, probation_tail;
+	size_t protected_head, protected_tail;
+	size_t protected_count, protected_max;
+	size_t free_head; /* chained through lru_next */
+	
+	sqfs_cache_stats stats;
 } sqfs_cache;
 
 sqfs_err sqfs_cache_init(sqfs_cache *cache, size_t size, size_t count,
 	sqfs_cache_dispose dispose);
 void sqfs_cache_destroy(sqfs_cache *cache);
 
+/* Drops every entry. count must be at least 1. Statistics are kept. */
+sqfs_err sqfs_cache_resize(sqfs_cache *cache, size_t count);
+
 void *sqfs_cache_get(sqfs_cache *cache, sqfs_cache_idx idx);
+/* Like sqfs_cache_get, but doesn't count as a use */
+bool sqfs_cache_contains(sqfs_cache *cache, sqfs_cache_idx idx);
 void *sqfs_cache_add(sqfs_cache *cache, sqfs_cache_idx idx);
+/* Forget idx without disposing of it, for entries whose fill failed */
+void sqfs_cache_invalidate(sqfs_cache *cache, sqfs_cache_idx idx);
 
 
 typedef struct {
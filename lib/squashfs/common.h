@@ -59,6 +59,8 @@ typedef struct sqfs_inode sqfs_inode;
 typedef struct {
 	size_t size;
 	void *data;
+	bool borrowed; /* data points into a memory-backed image, don't free it */
+	struct sqfs_pool *pool; /* if non-NULL, the pool this block goes back to */
 } sqfs_block;
 
 typedef struct {
@@ -24,6 +24,7 @@
  */
 #include "dir.h"
 
+#include "dirhash.h"
 #include "fs.h"
 #include "swap.h"
 
@@ -280,11 +281,9 @@ sqfs_err sqfs_dir_lookup(sqfs *fs, sqfs_inode *inode,
 sqfs_err sqfs_lookup_path(sqfs *fs, sqfs_inode *inode, const char *path,
 		bool *found) {
 	sqfs_err err;
-	sqfs_name buf;
-	sqfs_dir_entry entry;
+	sqfs_inode_id id;
 	
 	*found = false;
-	sqfs_dentry_init(&entry, buf);
 	
 	while (*path) {
 		const char *name;
@@ -302,12 +301,12 @@ sqfs_err sqfs_lookup_path(sqfs *fs, sqfs_inode *inode, const char *path,
 		if (size == 0) /* we're done */
 			break;
 		
-		if ((err = sqfs_dir_lookup(fs, inode, name, size, &entry, &dfound)))
+		if ((err = sqfs_dirhash_lookup(fs, inode, name, size, &id, &dfound)))
 			return err;
 		if (!dfound)
 			return SQFS_OK; /* not found */
 		
-		if ((err = sqfs_inode_get(fs, inode, sqfs_dentry_inode(&entry))))
+		if ((err = sqfs_inode_get(fs, inode, id)))
 			return err;
 	}
 	
@@ -0,0 +1,287 @@
+#include "dirhash.h"
+
+#include "dir.h"
+#include "fs.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+typedef struct {
+	sqfs_inode_id inode;
+	uint32_t hash;
+	uint32_t name_off; /* the name runs up to the next entry's name_off */
+} sqfs_dirhash_entry;
+
+struct sqfs_dirhash_dir {
+	sqfs_dirhash_dir *next; /* in its bucket */
+	sqfs_dirhash_dir *lru_prev, *lru_next;
+	sqfs_inode_num inode_number;
+	size_t bytes;
+	/* the index wouldn't fit, so this just stops us walking the directory
+	   again to find that out */
+	bool oversized;
+	uint32_t mask;
+	uint32_t *slots; /* entry index + 1, or 0 if empty */
+	sqfs_dirhash_entry *entries; /* plus one more, which ends the last name */
+	char *names;
+};
+
+#define SQFS_DIRHASH_MIN_ENTRIES 64
+#define SQFS_DIRHASH_MIN_SLOTS 16
+
+/* FNV-1a */
+static uint32_t sqfs_dirhash_name(const char *name, size_t namelen) {
+	uint32_t hash = 2166136261u;
+	size_t i;
+	for (i = 0; i < namelen; ++i) {
+		hash ^= (uint8_t)name[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static sqfs_dirhash_dir **sqfs_dirhash_bucket(sqfs_dirhash *dh,
+		sqfs_inode_num inode_number) {
+	return &dh->buckets[inode_number % SQFS_DIRHASH_BUCKETS];
+}
+
+static void sqfs_dirhash_free(sqfs_dirhash_dir *d) {
+	free(d->slots);
+	free(d->entries);
+	free(d->names);
+	free(d);
+}
+
+static void sqfs_dirhash_lru_unlink(sqfs_dirhash *dh, sqfs_dirhash_dir *d) {
+	if (d->lru_prev)
+		d->lru_prev->lru_next = d->lru_next;
+	else
+		dh->lru_head = d->lru_next;
+	if (d->lru_next)
+		d->lru_next->lru_prev = d->lru_prev;
+	else
+		dh->lru_tail = d->lru_prev;
+}
+
+static void sqfs_dirhash_lru_push(sqfs_dirhash *dh, sqfs_dirhash_dir *d) {
+	d->lru_prev = NULL;
+	d->lru_next = dh->lru_head;
+	if (dh->lru_head)
+		dh->lru_head->lru_prev = d;
+	else
+		dh->lru_tail = d;
+	dh->lru_head = d;
+}
+
+static void sqfs_dirhash_remove(sqfs_dirhash *dh, sqfs_dirhash_dir *d) {
+	sqfs_dirhash_dir **bp = sqfs_dirhash_bucket(dh, d->inode_number);
+	while (*bp != d)
+		bp = &(*bp)->next;
+	*bp = d->next;
+	sqfs_dirhash_lru_unlink(dh, d);
+	dh->bytes -= d->bytes;
+	--dh->count;
+	sqfs_dirhash_free(d);
+}
+
+static void sqfs_dirhash_insert(sqfs_dirhash *dh, sqfs_dirhash_dir *d) {
+	sqfs_dirhash_dir **bp = sqfs_dirhash_bucket(dh, d->inode_number);
+	d->next = *bp;
+	*bp = d;
+	sqfs_dirhash_lru_push(dh, d);
+	dh->bytes += d->bytes;
+	++dh->count;
+}
+
+/* Evict least recently used indexes until `extra` more bytes would fit */
+static void sqfs_dirhash_trim(sqfs_dirhash *dh, size_t extra) {
+	while (dh->lru_tail && dh->bytes + extra > dh->max_bytes) {
+		sqfs_dirhash_remove(dh, dh->lru_tail);
+		++dh->stats.evictions;
+	}
+}
+
+void sqfs_dirhash_init(sqfs_dirhash *dh, size_t max_bytes, size_t min_dir_size) {
+	memset(dh, 0, sizeof(*dh));
+	dh->max_bytes = max_bytes;
+	dh->min_dir_size = min_dir_size;
+}
+
+void sqfs_dirhash_destroy(sqfs_dirhash *dh) {
+	while (dh->lru_tail)
+		sqfs_dirhash_remove(dh, dh->lru_tail);
+}
+
+void sqfs_dirhash_configure(sqfs_dirhash *dh, size_t max_bytes,
+		size_t min_dir_size) {
+	dh->max_bytes = max_bytes;
+	dh->min_dir_size = min_dir_size;
+	sqfs_dirhash_trim(dh, 0);
+}
+
+static sqfs_err sqfs_dirhash_build(sqfs *fs, sqfs_inode *inode,
+		size_t max_bytes, sqfs_dirhash_dir *d) {
+	sqfs_err err;
+	sqfs_dir dir;
+	sqfs_dir_entry entry;
+	sqfs_name name;
+	size_t count = 0, entries_cap = SQFS_DIRHASH_MIN_ENTRIES;
+	size_t names_size = 0, names_cap = SQFS_DIRHASH_MIN_ENTRIES * 16;
+	size_t nslots, i;
+	sqfs_dirhash_entry *entries;
+	char *names;
+
+	if ((err = sqfs_dir_open(fs, inode, &dir, 0)))
+		return err;
+
+	d->entries = malloc(entries_cap * sizeof(*d->entries));
+	d->names = malloc(names_cap);
+	if (!d->entries || !d->names)
+		return SQFS_ERR;
+
+	sqfs_dentry_init(&entry, name);
+	while (sqfs_dir_next(fs, &dir, &entry, &err)) {
+		size_t size = sqfs_dentry_name_size(&entry);
+
+		/* keep room for the terminating entry */
+		if (count + 2 > entries_cap) {
+			entries = realloc(d->entries, 2 * entries_cap * sizeof(*entries));
+			if (!entries)
+				return SQFS_ERR;
+			d->entries = entries;
+			entries_cap *= 2;
+		}
+		if (names_size + size > names_cap) {
+			names = realloc(d->names, 2 * names_cap + size);
+			if (!names)
+				return SQFS_ERR;
+			d->names = names;
+			names_cap = 2 * names_cap + size;
+		}
+
+		d->entries[count].inode = sqfs_dentry_inode(&entry);
+		d->entries[count].hash = sqfs_dirhash_name(entry.name, size);
+		d->entries[count].name_off = names_size;
+		memcpy(d->names + names_size, entry.name, size);
+		names_size += size;
+		++count;
+
+		/* give up early on directories that are never going to fit */
+		if ((count + 1) * sizeof(*d->entries) + names_size > max_bytes) {
+			d->oversized = true;
+			break;
+		}
+	}
+	if (err)
+		return err;
+
+	nslots = SQFS_DIRHASH_MIN_SLOTS;
+	while (nslots < 2 * count)
+		nslots *= 2;
+	d->bytes = sizeof(*d) + nslots * sizeof(*d->slots) +
+		(count + 1) * sizeof(*d->entries) + names_size;
+	if (d->oversized || d->bytes > max_bytes) {
+		free(d->entries);
+		free(d->names);
+		d->entries = NULL;
+		d->names = NULL;
+		d->oversized = true;
+		d->bytes = sizeof(*d);
+		return SQFS_OK;
+	}
+
+	d->entries[count].name_off = names_size;
+	/* if shrinking fails, we just keep the bigger buffers */
+	if ((entries = realloc(d->entries, (count + 1) * sizeof(*entries))))
+		d->entries = entries;
+	if ((names = realloc(d->names, names_size ? names_size : 1)))
+		d->names = names;
+
+	if (!(d->slots = calloc(nslots, sizeof(*d->slots))))
+		return SQFS_ERR;
+	d->mask = nslots - 1;
+	for (i = 0; i < count; ++i) {
+		uint32_t h = d->entries[i].hash & d->mask;
+		while (d->slots[h])
+			h = (h + 1) & d->mask;
+		d->slots[h] = i + 1;
+	}
+
+	return SQFS_OK;
+}
+
+/* Returns NULL if the directory can't be indexed right now */
+static sqfs_dirhash_dir *sqfs_dirhash_get(sqfs *fs, sqfs_inode *inode) {
+	sqfs_dirhash *dh = &fs->dirhash;
+	sqfs_inode_num inode_number = inode->base.inode_number;
+	sqfs_dirhash_dir *d;
+
+	for (d = *sqfs_dirhash_bucket(dh, inode_number); d; d = d->next) {
+		if (d->inode_number == inode_number) {
+			sqfs_dirhash_lru_unlink(dh, d);
+			sqfs_dirhash_lru_push(dh, d);
+			return d;
+		}
+	}
+
+	if (!(d = calloc(1, sizeof(*d))))
+		return NULL;
+	d->inode_number = inode_number;
+	if (sqfs_dirhash_build(fs, inode, dh->max_bytes, d)) {
+		/* out of memory or a bad directory; the walk will sort it out */
+		sqfs_dirhash_free(d);
+		return NULL;
+	}
+	++dh->stats.builds;
+
+	sqfs_dirhash_trim(dh, d->bytes);
+	sqfs_dirhash_insert(dh, d);
+	return d;
+}
+
+static bool sqfs_dirhash_find(sqfs_dirhash_dir *d, const char *name,
+		size_t namelen, sqfs_inode_id *id) {
+	uint32_t hash = sqfs_dirhash_name(name, namelen);
+	uint32_t h;
+
+	for (h = hash & d->mask; d->slots[h]; h = (h + 1) & d->mask) {
+		sqfs_dirhash_entry *e = &d->entries[d->slots[h] - 1];
+		if (e->hash == hash && e[1].name_off - e->name_off == namelen &&
+				memcmp(d->names + e->name_off, name, namelen) == 0) {
+			*id = e->inode;
+			return true;
+		}
+	}
+	return false;
+}
+
+sqfs_err sqfs_dirhash_lookup(sqfs *fs, sqfs_inode *inode, const char *name,
+		size_t namelen, sqfs_inode_id *id, bool *found) {
+	sqfs_dirhash *dh = &fs->dirhash;
+	sqfs_dirhash_dir *d;
+	sqfs_dir_entry entry;
+	sqfs_name namebuf;
+	sqfs_err err;
+
+	*found = false;
+	if (!S_ISDIR(inode->base.mode))
+		return SQFS_ERR;
+
+	/* an index is never much smaller than the listing it was built from */
+	if (dh->max_bytes && inode->xtra.dir.dir_size >= dh->min_dir_size &&
+			inode->xtra.dir.dir_size <= dh->max_bytes &&
+			(d = sqfs_dirhash_get(fs, inode)) && !d->oversized) {
+		++dh->stats.hits;
+		*found = sqfs_dirhash_find(d, name, namelen, id);
+		return SQFS_OK;
+	}
+
+	++dh->stats.misses;
+	sqfs_dentry_init(&entry, namebuf);
+	if ((err = sqfs_dir_lookup(fs, inode, name, namelen, &entry, found)))
+		return err;
+	if (*found)
+		*id = sqfs_dentry_inode(&entry);
+	return SQFS_OK;
+}
@@ -0,0 +1,49 @@
+#ifndef SQFS_DIRHASH_H
+#define SQFS_DIRHASH_H
+
+#include "common.h"
+
+/* Name lookup index for large directories
+ *  - Built by walking a directory once, the first time a name is looked up
+ *    in it, if its listing is at least min_dir_size bytes
+ *  - Maps names to inode ids with an open-addressed table, so a lookup in an
+ *    indexed directory reads no metadata
+ *  - The indexes kept for a filesystem use at most max_bytes between them;
+ *    the least recently used directory's index is dropped to make room
+ *  - No thread safety
+ */
+#define SQFS_DIRHASH_BUCKETS 64
+
+typedef struct sqfs_dirhash_dir sqfs_dirhash_dir;
+
+typedef struct {
+	uint64_t hits; /* lookups answered by an index */
+	uint64_t misses; /* lookups that walked the directory */
+	uint64_t builds;
+	uint64_t evictions;
+} sqfs_dirhash_stats;
+
+typedef struct sqfs_dirhash {
+	size_t max_bytes; /* zero disables indexing */
+	size_t min_dir_size;
+	size_t bytes;
+	size_t count;
+	sqfs_dirhash_dir *buckets[SQFS_DIRHASH_BUCKETS]; /* by inode number */
+	sqfs_dirhash_dir *lru_head, *lru_tail; /* most recently used first */
+	sqfs_dirhash_stats stats;
+} sqfs_dirhash;
+
+void sqfs_dirhash_init(sqfs_dirhash *dh, size_t max_bytes, size_t min_dir_size);
+void sqfs_dirhash_destroy(sqfs_dirhash *dh);
+
+/* Drops indexes until the rest fit in max_bytes */
+void sqfs_dirhash_configure(sqfs_dirhash *dh, size_t max_bytes,
+	size_t min_dir_size);
+
+/* Like sqfs_dir_lookup, but only yields the entry's inode id. Large
+   directories are looked up in their index, which is built if needed; others
+   fall back to sqfs_dir_lookup. */
+sqfs_err sqfs_dirhash_lookup(sqfs *fs, sqfs_inode *inode, const char *name,
+	size_t namelen, sqfs_inode_id *id, bool *found);
+
+#endif
@@ -112,6 +112,49 @@ sqfs_err sqfs_blocklist_next(sqfs_blocklist *bl) {
 	return SQFS_OK;
 }
 
+sqfs_err sqfs_file_in_image(sqfs *fs, sqfs_inode *inode, sqfs_off_t start,
+		size_t size, const void **data) {
+	sqfs_err err;
+	sqfs_blocklist bl;
+	size_t block_size = fs->sb.block_size;
+	uint64_t file_size, first, last, index, base = 0;
+	bool compressed;
+	uint32_t stored;
+	
+	if (!fs->image || !S_ISREG(inode->base.mode))
+		return SQFS_ERR;
+	file_size = inode->xtra.reg.file_size;
+	if (start < 0 || size == 0 || (uint64_t)start > file_size ||
+			size > file_size - (uint64_t)start)
+		return SQFS_ERR;
+	
+	first = (uint64_t)start / block_size;
+	last = ((uint64_t)start + size - 1) / block_size;
+	if (last >= sqfs_blocklist_count(fs, inode))
+		return SQFS_ERR; /* the tail is in a fragment */
+	
+	if ((err = sqfs_blockidx_blocklist(fs, inode, &bl, first * block_size)))
+		return err;
+	for (index = first; index <= last; ++index) {
+		while (!bl.started || bl.pos < index * block_size) {
+			if ((err = sqfs_blocklist_next(&bl)))
+				return err;
+		}
+		
+		/* a block stored as-is holds exactly its share of the file, so
+		   consecutive ones line up; holes and compressed blocks don't */
+		sqfs_data_header(bl.header, &compressed, &stored);
+		if (compressed || stored == 0)
+			return SQFS_ERR;
+		if (index == first)
+			base = bl.block;
+	}
+	
+	*data = sqfs_image_range(fs, base + fs->offset +
+		((uint64_t)start - first * block_size), size);
+	return *data ? SQFS_OK : SQFS_ERR;
+}
+
 sqfs_err sqfs_read_range(sqfs *fs, sqfs_inode *inode, sqfs_off_t start,
 		sqfs_off_t *size, void *buf) {
 	sqfs_err err = SQFS_OK;
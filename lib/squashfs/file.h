@@ -60,6 +60,12 @@ sqfs_err sqfs_blocklist_next(sqfs_blocklist *bl);
 sqfs_err sqfs_read_range(sqfs *fs, sqfs_inode *inode, sqfs_off_t start,
 	sqfs_off_t *size, void *buf);
 
+/* For memory-backed images: if the file's bytes in [start, start + size) are
+   stored uncompressed, point *data at them in the image. Fails otherwise. */
+sqfs_err sqfs_file_in_image(sqfs *fs, sqfs_inode *inode, sqfs_off_t start,
+	size_t size, const void **data);
+
+
 
 /*** Block index for skipping to the middle of large files ***/
 
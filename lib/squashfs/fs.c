@@ -25,6 +25,7 @@
 #include "fs.h"
 
 #include "file.h"
+#include "icache.h"
 #include "nonstd.h"
 #include "swap.h"
 #include "xattr.h"
@@ -37,6 +38,11 @@
 
 #define DATA_CACHED_BLKS 1
 #define FRAG_CACHED_BLKS 3
+#define DIRHASH_MAX_BYTES (2 * 1024 * 1024)
+/* smaller directories fit in a metadata block or two, and walking them is
+   cheap */
+#define DIRHASH_MIN_DIR_SIZE SQUASHFS_METADATA_SIZE
+#define ICACHE_MAX_UNUSED 256
 
 void sqfs_version_supported(int *min_major, int *min_minor, int *max_major,
 		int *max_minor) {
@@ -54,13 +60,20 @@ sqfs_compression_type sqfs_compression(sqfs *fs) {
 	return fs->sb.compression;
 }
 
-sqfs_err sqfs_init(sqfs *fs, sqfs_fd_t fd, size_t offset) {
+/* Keep enough spare buffers around to refill every cache slot, plus one for
+ * the block being read when an eviction happens */
+static void sqfs_pools_fit(sqfs *fs) {
+	size_t md = fs->md_cache.count;
+	size_t data = fs->data_cache.count + fs->frag_cache.count;
+	sqfs_pool_set_max_free(&fs->hdr_pool, md + data + 1);
+	sqfs_pool_set_max_free(&fs->md_pool, md + 1);
+	sqfs_pool_set_max_free(&fs->data_pool, data + 1);
+}
+
+static sqfs_err sqfs_init_common(sqfs *fs) {
 	sqfs_err err = SQFS_OK;
-	memset(fs, 0, sizeof(*fs));
 	
-	fs->fd = fd;
-	fs->offset = offset;
-	if (sqfs_pread(fd, &fs->sb, sizeof(fs->sb), fs->offset) != sizeof(fs->sb))
+	if (sqfs_source_pread(fs, &fs->sb, sizeof(fs->sb), fs->offset) != sizeof(fs->sb))
 		return SQFS_BADFORMAT;
 	sqfs_swapin_super_block(&fs->sb);
 	
@@ -76,12 +89,12 @@ sqfs_err sqfs_init(sqfs *fs, sqfs_fd_t fd, size_t offset) {
 	if (!(fs->decompressor = sqfs_decompressor_get(fs->sb.compression)))
 		return SQFS_BADCOMP;
 	
-	err = sqfs_table_init(&fs->id_table, fd, fs->sb.id_table_start + fs->offset,
+	err = sqfs_table_init(&fs->id_table, fs, fs->sb.id_table_start + fs->offset,
 		sizeof(uint32_t), fs->sb.no_ids);
-	err |= sqfs_table_init(&fs->frag_table, fd, fs->sb.fragment_table_start + fs->offset,
+	err |= sqfs_table_init(&fs->frag_table, fs, fs->sb.fragment_table_start + fs->offset,
 		sizeof(struct squashfs_fragment_entry), fs->sb.fragments);
 	if (sqfs_export_ok(fs)) {
-		err |= sqfs_table_init(&fs->export_table, fd, fs->sb.lookup_table_start + fs->offset,
+		err |= sqfs_table_init(&fs->export_table, fs, fs->sb.lookup_table_start + fs->offset,
 			sizeof(uint64_t), fs->sb.inodes);
 	}
 	err |= sqfs_xattr_init(fs);
@@ -89,6 +102,19 @@ sqfs_err sqfs_init(sqfs *fs, sqfs_fd_t fd, size_t offset) {
 	err |= sqfs_block_cache_init(&fs->data_cache, DATA_CACHED_BLKS);
 	err |= sqfs_block_cache_init(&fs->frag_cache, FRAG_CACHED_BLKS);
 	err |= sqfs_blockidx_init(&fs->blockidx);
+	sqfs_dirhash_init(&fs->dirhash, DIRHASH_MAX_BYTES, DIRHASH_MIN_DIR_SIZE);
+	err |= sqfs_icache_create(&fs->icache, ICACHE_MAX_UNUSED);
+	
+	sqfs_pool_init(&fs->hdr_pool, 0, 0);
+	sqfs_pool_init(&fs->md_pool, SQUASHFS_METADATA_SIZE, 0);
+	sqfs_pool_init(&fs->data_pool, fs->sb.block_size, 0);
+	sqfs_pools_fit(fs);
+	if (!fs->image) {
+		fs->scratch_size = fs->sb.block_size > SQUASHFS_METADATA_SIZE ?
+			fs->sb.block_size : SQUASHFS_METADATA_SIZE;
+		if (!(fs->scratch = malloc(fs->scratch_size)))
+			err |= SQFS_ERR;
+	}
 	if (err) {
 		sqfs_destroy(fs);
 		return SQFS_ERR;
@@ -97,6 +123,22 @@ sqfs_err sqfs_init(sqfs *fs, sqfs_fd_t fd, size_t offset) {
 	return SQFS_OK;
 }
 
+sqfs_err sqfs_init(sqfs *fs, sqfs_fd_t fd, size_t offset) {
+	memset(fs, 0, sizeof(*fs));
+	fs->fd = fd;
+	fs->offset = offset;
+	return sqfs_init_common(fs);
+}
+
+sqfs_err sqfs_init_memory(sqfs *fs, const void *image, size_t size, size_t offset) {
+	memset(fs, 0, sizeof(*fs));
+	fs->fd = -1;
+	fs->offset = offset;
+	fs->image = image;
+	fs->image_size = size;
+	return sqfs_init_common(fs);
+}
+
 void sqfs_destroy(sqfs *fs) {
 	sqfs_table_destroy(&fs->id_table);
 	sqfs_table_destroy(&fs->frag_table);
@@ -106,6 +148,42 @@ void sqfs_destroy(sqfs *fs) {
 	sqfs_cache_destroy(&fs->data_cache);
 	sqfs_cache_destroy(&fs->frag_cache);
 	sqfs_cache_destroy(&fs->blockidx);
+	sqfs_dirhash_destroy(&fs->dirhash);
+	sqfs_icache_destroy(fs->icache);
+	fs->icache = NULL;
+	/* after the caches, which give their blocks back to the pools */
+	sqfs_pool_destroy(&fs->hdr_pool);
+	sqfs_pool_destroy(&fs->md_pool);
+	sqfs_pool_destroy(&fs->data_pool);
+	free(fs->scratch);
+	fs->scratch = NULL;
+}
+
+sqfs_err sqfs_block_cache_resize(sqfs *fs, sqfs_cache *cache, size_t count) {
+	sqfs_err err = sqfs_cache_resize(cache, count);
+	sqfs_pools_fit(fs);
+	return err;
+}
+
+const uint8_t *sqfs_image_range(sqfs *fs, sqfs_off_t off, size_t count) {
+	if (!fs->image || off < 0 || (uint64_t)off > fs->image_size ||
+			count > fs->image_size - (uint64_t)off)
+		return NULL;
+	return fs->image + off;
+}
+
+ssize_t sqfs_source_pread(sqfs *fs, void *buf, size_t count, sqfs_off_t off) {
+	if (!fs->image)
+		return sqfs_pread(fs->fd, buf, count, off);
+	
+	if (off < 0)
+		return -1;
+	if ((uint64_t)off >= fs->image_size)
+		return 0;
+	if (count > fs->image_size - (uint64_t)off)
+		count = fs->image_size - (uint64_t)off;
+	memcpy(buf, fs->image + off, count);
+	return count;
 }
 
 void sqfs_md_header(uint16_t hdr, bool *compressed, uint16_t *size) {
@@ -120,40 +198,78 @@ void sqfs_data_header(uint32_t hdr, bool *compressed, uint32_t *size) {
 	*size = hdr & ~SQUASHFS_COMPRESSED_BIT_BLOCK;
 }
 
-sqfs_err sqfs_block_read(sqfs *fs, sqfs_off_t pos, bool compressed,
-		uint32_t size, size_t outsize, sqfs_block **block) {
+sqfs_err sqfs_block_decompress(sqfs *fs, void *in, size_t insize,
+		size_t outsize, sqfs_block **block) {
 	sqfs_err err = SQFS_ERR;
 	if (!(*block = malloc(sizeof(**block))))
 		return SQFS_ERR;
-	if (!((*block)->data = malloc(size)))
+	(*block)->borrowed = false;
+	(*block)->pool = NULL;
+	if (!((*block)->data = malloc(outsize)))
 		goto error;
 	
-	if (sqfs_pread(fs->fd, (*block)->data, size, pos + fs->offset) != size)
+	err = fs->decompressor(in, insize, (*block)->data, &outsize);
+	if (err)
 		goto error;
+	(*block)->size = outsize;
+	return SQFS_OK;
 
-	if (compressed) {
-		char *decomp = malloc(outsize);
-		if (!decomp)
-			goto error;
-		
-		err = fs->decompressor((*block)->data, size, decomp, &outsize);
-		if (err) {
-			free(decomp);
-			goto error;
+error:
+	sqfs_block_dispose(*block);
+	*block = NULL;
+	return err;
+}
+
+sqfs_err sqfs_block_read(sqfs *fs, sqfs_off_t pos, bool compressed,
+		uint32_t size, size_t outsize, sqfs_block **block) {
+	sqfs_err err = SQFS_OK;
+	sqfs_pool *pool = outsize == SQUASHFS_METADATA_SIZE ? &fs->md_pool
+		: &fs->data_pool;
+	void *in;
+	
+	*block = NULL;
+	if (outsize > pool->size)
+		return SQFS_ERR;
+	
+	if (fs->image) {
+		/* the decompressors don't write to their input */
+		if (!(in = (void*)sqfs_image_range(fs, pos + fs->offset, size)))
+			return SQFS_ERR;
+		if (!compressed) {
+			if (!(*block = sqfs_pool_get(&fs->hdr_pool)))
+				return SQFS_ERR;
+			(*block)->data = in;
+			(*block)->size = size;
+			(*block)->borrowed = true;
+			return SQFS_OK;
 		}
-		free((*block)->data);
-		(*block)->data = decomp;
-		(*block)->size = outsize;
-	} else {
+	} else if (!compressed) {
+		if (size > pool->size || !(*block = sqfs_pool_get(pool)))
+			return SQFS_ERR;
+		if (sqfs_pread(fs->fd, (*block)->data, size, pos + fs->offset) != size)
+			goto error;
 		(*block)->size = size;
+		return SQFS_OK;
+	} else {
+		if (size > fs->scratch_size)
+			return SQFS_ERR;
+		if (sqfs_pread(fs->fd, fs->scratch, size, pos + fs->offset) != size)
+			return SQFS_ERR;
+		in = fs->scratch;
 	}
-
+	
+	if (!(*block = sqfs_pool_get(pool)))
+		return SQFS_ERR;
+	err = fs->decompressor(in, size, (*block)->data, &outsize);
+	if (err)
+		goto error;
+	(*block)->size = outsize;
 	return SQFS_OK;
 
 error:
 	sqfs_block_dispose(*block);
 	*block = NULL;
-	return err;
+	return err ? err : SQFS_ERR;
 }
 
 sqfs_err sqfs_md_block_read(sqfs *fs, sqfs_off_t pos, size_t *data_size,
@@ -165,7 +281,7 @@ sqfs_err sqfs_md_block_read(sqfs *fs, sqfs_off_t pos, size_t *data_size,
 	
 	*data_size = 0;
 	
-	if (sqfs_pread(fs->fd, &hdr, sizeof(hdr), pos + fs->offset) != sizeof(hdr))
+	if (sqfs_source_pread(fs, &hdr, sizeof(hdr), pos + fs->offset) != sizeof(hdr))
 		return SQFS_ERR;
 	pos += sizeof(hdr);
 	*data_size += sizeof(hdr);
@@ -188,6 +304,44 @@ sqfs_err sqfs_data_block_read(sqfs *fs, sqfs_off_t pos, uint32_t hdr,
 		fs->sb.block_size, block);
 }
 
+sqfs_err sqfs_data_block_fetch(sqfs *fs, sqfs_off_t pos, uint32_t hdr,
+		void **in, size_t *insize, bool *owned) {
+	bool compressed;
+	uint32_t size;
+	sqfs_data_header(hdr, &compressed, &size);
+	if (!compressed)
+		return SQFS_ERR;
+	
+	if (fs->image) {
+		const uint8_t *src = sqfs_image_range(fs, pos + fs->offset, size);
+		if (!src)
+			return SQFS_ERR;
+		*in = (void*)src;
+		*owned = false;
+	} else {
+		if (!(*in = malloc(size)))
+			return SQFS_ERR;
+		if (sqfs_pread(fs->fd, *in, size, pos + fs->offset) != size) {
+			free(*in);
+			return SQFS_ERR;
+		}
+		*owned = true;
+	}
+	*insize = size;
+	return SQFS_OK;
+}
+
+void sqfs_data_cache_insert(sqfs_cache *cache, sqfs_off_t pos,
+		sqfs_block *block) {
+	sqfs_block_cache_entry *entry;
+	if (sqfs_cache_contains(cache, pos)) {
+		sqfs_block_dispose(block);
+		return;
+	}
+	entry = sqfs_cache_add(cache, pos);
+	entry->block = block;
+}
+
 sqfs_err sqfs_md_cache(sqfs *fs, sqfs_off_t *pos, sqfs_block **block) {
 	sqfs_block_cache_entry *entry = sqfs_cache_get(
 		&fs->md_cache, *pos);
@@ -197,8 +351,10 @@ sqfs_err sqfs_md_cache(sqfs *fs, sqfs_off_t *pos, sqfs_block **block) {
 		/* fprintf(stderr, "MD BLOCK: %12llx\n", (long long)*pos); */
 		err = sqfs_md_block_read(fs, *pos,
 			&entry->data_size, &entry->block);
-		if (err)
+		if (err) {
+			sqfs_cache_invalidate(&fs->md_cache, *pos);
 			return err;
+		}
 	}
 	*block = entry->block;
 	*pos += entry->data_size;
@@ -213,15 +369,22 @@ sqfs_err sqfs_data_cache(sqfs *fs, sqfs_cache *cache, sqfs_off_t pos,
 		entry = sqfs_cache_add(cache, pos);
 		err = sqfs_data_block_read(fs, pos, hdr,
 			&entry->block);
-		if (err)
+		if (err) {
+			sqfs_cache_invalidate(cache, pos);
 			return err;
+		}
 	}
 	*block = entry->block;
 	return SQFS_OK;
 }
 
 void sqfs_block_dispose(sqfs_block *block) {
-	free(block->data);
+	if (block->pool) {
+		sqfs_pool_put(block->pool, block);
+		return;
+	}
+	if (!block->borrowed)
+		free(block->data);
 	free(block);
 }
 
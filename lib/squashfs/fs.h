@@ -29,13 +29,23 @@
 
 #include "squashfs_fs.h"
 
+#include<libtransistor/mutex.h>
+
 #include "cache.h"
 #include "decompress.h"
+#include "dirhash.h"
+#include "pool.h"
 #include "table.h"
 
 struct sqfs {
+	/* nothing below is thread-safe, so lib/fs/squashfs.c holds this around
+	 * everything that touches it. zeroed by sqfs_init, which unlocks it. */
+	trn_mutex_t lock;
 	sqfs_fd_t fd;
 	size_t offset;
+	/* if non-NULL, the image is in memory and fd is unused */
+	const uint8_t *image;
+	size_t image_size;
 	struct squashfs_super_block sb;
 	sqfs_table id_table;
 	sqfs_table frag_table;
@@ -46,6 +56,16 @@ struct sqfs {
 	sqfs_cache blockidx;
 	sqfs_decompressor decompressor;
 	
+	/* buffers for the block caches */
+	sqfs_pool hdr_pool; /* headers only, for blocks borrowed from the image */
+	sqfs_pool md_pool;
+	sqfs_pool data_pool; /* data and fragment blocks */
+	void *scratch; /* compressed input, when reading from fd */
+	size_t scratch_size;
+	
+	sqfs_dirhash dirhash; /* name lookup indexes for large directories */
+	struct sqfs_icache *icache; /* decoded inodes, see icache.h */
+	
 	struct squashfs_xattr_id_table xattr_info;
 	sqfs_table xattr_table;
 };
@@ -87,6 +107,10 @@ size_t sqfs_divceil(uint64_t total, size_t group);
 
 
 sqfs_err sqfs_init(sqfs *fs, sqfs_fd_t fd, size_t offset);
+/* Use an image that is already mapped in memory. Uncompressed blocks are
+ * referenced in place, and compressed blocks are decompressed straight out of
+ * the image. The image must outlive the filesystem. */
+sqfs_err sqfs_init_memory(sqfs *fs, const void *image, size_t size, size_t offset);
 void sqfs_destroy(sqfs *fs);
 
 /* Ok to call these even on incompletely constructed filesystems */
@@ -94,6 +118,12 @@ void sqfs_version(sqfs *fs, int *major, int *minor);
 sqfs_compression_type sqfs_compression(sqfs *fs);
 
 
+/* Returns NULL if [off, off + count) isn't entirely within the image, or the
+   image isn't in memory */
+const uint8_t *sqfs_image_range(sqfs *fs, sqfs_off_t off, size_t count);
+/* Read from the image, whether it's backed by a file or by memory */
+ssize_t sqfs_source_pread(sqfs *fs, void *buf, size_t count, sqfs_off_t off);
+
 void sqfs_md_header(uint16_t hdr, bool *compressed, uint16_t *size);
 void sqfs_data_header(uint32_t hdr, bool *compressed, uint32_t *size);
 
@@ -106,6 +136,24 @@ sqfs_err sqfs_md_block_read(sqfs *fs, sqfs_off_t pos, size_t *data_size,
 sqfs_err sqfs_data_block_read(sqfs *fs, sqfs_off_t pos, uint32_t hdr,
 	sqfs_block **block);
 
+/* Resize one of the block caches, and the pools backing them */
+sqfs_err sqfs_block_cache_resize(sqfs *fs, sqfs_cache *cache, size_t count);
+
+/* Decompress a block that has already been read. This only looks at the
+ * decompressor, so it's safe to call from another thread. */
+sqfs_err sqfs_block_decompress(sqfs *fs, void *in, size_t insize,
+	size_t outsize, sqfs_block **block);
+
+/* Get the raw bytes of a compressed data block, so that it can be handed to
+ * sqfs_block_decompress elsewhere. If *owned is set, free *in when done. */
+sqfs_err sqfs_data_block_fetch(sqfs *fs, sqfs_off_t pos, uint32_t hdr,
+	void **in, size_t *insize, bool *owned);
+
+/* Put a data block that was read some other way into a cache. Takes
+ * ownership of block. */
+void sqfs_data_cache_insert(sqfs_cache *cache, sqfs_off_t pos,
+	sqfs_block *block);
+
 /* Don't dispose after getting block, it's in the cache */
 sqfs_err sqfs_md_cache(sqfs *fs, sqfs_off_t *pos, sqfs_block **block);
 sqfs_err sqfs_data_cache(sqfs *fs, sqfs_cache *cache, sqfs_off_t pos,
@@ -0,0 +1,166 @@
+#include "icache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SQFS_ICACHE_MIN_BUCKETS 64
+
+static size_t sqfs_icache_hash(sqfs_icache *ic, sqfs_inode_id id) {
+	/* the low 16 bits are an offset into a metadata block, the rest is the
+	   block's position, so mix them before masking */
+	uint64_t h = id * 0x9e3779b97f4a7c15ull;
+	return (h >> 32) & (ic->nbuckets - 1);
+}
+
+static void sqfs_icache_lru_unlink(sqfs_icache *ic, sqfs_icache_entry *e) {
+	if (e->lru_prev)
+		e->lru_prev->lru_next = e->lru_next;
+	else
+		ic->lru_head = e->lru_next;
+	if (e->lru_next)
+		e->lru_next->lru_prev = e->lru_prev;
+	else
+		ic->lru_tail = e->lru_prev;
+	e->lru_prev = e->lru_next = NULL;
+	--ic->nunused;
+}
+
+static void sqfs_icache_lru_push(sqfs_icache *ic, sqfs_icache_entry *e) {
+	e->lru_prev = NULL;
+	e->lru_next = ic->lru_head;
+	if (ic->lru_head)
+		ic->lru_head->lru_prev = e;
+	else
+		ic->lru_tail = e;
+	ic->lru_head = e;
+	++ic->nunused;
+}
+
+static void sqfs_icache_unhash(sqfs_icache *ic, sqfs_icache_entry *e) {
+	sqfs_icache_entry **bp = &ic->buckets[sqfs_icache_hash(ic, e->id)];
+	while (*bp != e)
+		bp = &(*bp)->next;
+	*bp = e->next;
+	--ic->count;
+}
+
+/* Double the buckets once the chains get long. Failing to is harmless. */
+static void sqfs_icache_grow(sqfs_icache *ic) {
+	sqfs_icache_entry **ob = ic->buckets;
+	size_t oc = ic->nbuckets;
+	size_t i;
+
+	if (!(ic->buckets = calloc(oc * 2, sizeof(*ic->buckets)))) {
+		ic->buckets = ob;
+		return;
+	}
+	ic->nbuckets = oc * 2;
+	for (i = 0; i < oc; ++i) {
+		sqfs_icache_entry *e = ob[i];
+		while (e) {
+			sqfs_icache_entry *n = e->next;
+			size_t b = sqfs_icache_hash(ic, e->id);
+			e->next = ic->buckets[b];
+			ic->buckets[b] = e;
+			e = n;
+		}
+	}
+	free(ob);
+}
+
+static void sqfs_icache_trim(sqfs_icache *ic) {
+	while (ic->nunused > ic->max_unused) {
+		sqfs_icache_entry *e = ic->lru_tail;
+		sqfs_icache_lru_unlink(ic, e);
+		sqfs_icache_unhash(ic, e);
+		free(e);
+		++ic->stats.evictions;
+	}
+}
+
+sqfs_err sqfs_icache_create(sqfs_icache **out, size_t max_unused) {
+	sqfs_icache *ic = calloc(1, sizeof(*ic));
+	if (!ic)
+		return SQFS_ERR;
+
+	ic->max_unused = max_unused;
+	ic->nbuckets = SQFS_ICACHE_MIN_BUCKETS;
+	while (ic->nbuckets < max_unused)
+		ic->nbuckets *= 2;
+	if (!(ic->buckets = calloc(ic->nbuckets, sizeof(*ic->buckets)))) {
+		free(ic);
+		return SQFS_ERR;
+	}
+
+	*out = ic;
+	return SQFS_OK;
+}
+
+void sqfs_icache_destroy(sqfs_icache *ic) {
+	size_t i;
+
+	if (!ic)
+		return;
+	for (i = 0; i < ic->nbuckets; ++i) {
+		sqfs_icache_entry *e = ic->buckets[i];
+		while (e) {
+			sqfs_icache_entry *n = e->next;
+			free(e);
+			e = n;
+		}
+	}
+	free(ic->buckets);
+	free(ic);
+}
+
+void sqfs_icache_set_max_unused(sqfs_icache *ic, size_t max_unused) {
+	ic->max_unused = max_unused;
+	sqfs_icache_trim(ic);
+}
+
+sqfs_err sqfs_icache_get(sqfs *fs, sqfs_inode_id id, sqfs_icache_entry **out) {
+	sqfs_icache *ic = fs->icache;
+	sqfs_icache_entry *e;
+	sqfs_err err;
+	size_t b;
+
+	for (e = ic->buckets[sqfs_icache_hash(ic, id)]; e; e = e->next) {
+		if (e->id == id) {
+			if (e->refs++ == 0)
+				sqfs_icache_lru_unlink(ic, e);
+			++ic->stats.hits;
+			*out = e;
+			return SQFS_OK;
+		}
+	}
+
+	++ic->stats.misses;
+	if (!(e = calloc(1, sizeof(*e))))
+		return SQFS_ERR;
+	if ((err = sqfs_inode_get(fs, &e->inode, id))) {
+		free(e);
+		return err;
+	}
+	e->fs = fs;
+	e->id = id;
+	e->refs = 1;
+
+	if (ic->count >= ic->nbuckets)
+		sqfs_icache_grow(ic);
+	b = sqfs_icache_hash(ic, id);
+	e->next = ic->buckets[b];
+	ic->buckets[b] = e;
+	++ic->count;
+
+	*out = e;
+	return SQFS_OK;
+}
+
+void sqfs_icache_put(sqfs *fs, sqfs_icache_entry *e) {
+	sqfs_icache *ic = fs->icache;
+
+	if (--e->refs == 0) {
+		sqfs_icache_lru_push(ic, e);
+		sqfs_icache_trim(ic);
+	}
+}
@@ -0,0 +1,58 @@
+#ifndef SQFS_ICACHE_H
+#define SQFS_ICACHE_H
+
+#include "common.h"
+
+#include "fs.h"
+
+/* Cache of decoded inodes
+ *  - Keyed by inode id, which is what directory entries refer to inodes by
+ *  - Entries are refcounted; sqfs_icache_get hands out a reference, and the
+ *    same entry to everyone asking for the same inode
+ *  - Unreferenced entries stay cached, up to max_unused of them, and are
+ *    evicted least recently released first
+ *  - No thread safety
+ */
+typedef struct sqfs_icache_entry {
+	/* these two come first, so the entry can double as a handle holding
+	   the filesystem and inode */
+	sqfs *fs;
+	sqfs_inode inode;
+
+	sqfs_inode_id id;
+	size_t refs;
+	struct sqfs_icache_entry *next; /* in its bucket */
+	struct sqfs_icache_entry *lru_prev, *lru_next; /* while unreferenced */
+} sqfs_icache_entry;
+
+typedef struct {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+} sqfs_icache_stats;
+
+typedef struct sqfs_icache {
+	size_t max_unused;
+	size_t nunused;
+	size_t count;
+	size_t nbuckets; /* power of two */
+	sqfs_icache_entry **buckets;
+	sqfs_icache_entry *lru_head, *lru_tail; /* most recently released first */
+	sqfs_icache_stats stats;
+} sqfs_icache;
+
+/* The filesystem only holds a pointer to its cache, since entries embed
+   sqfs_inode, which fs.h defines after struct sqfs */
+sqfs_err sqfs_icache_create(sqfs_icache **out, size_t max_unused);
+/* Frees referenced entries too; handles can't outlive their filesystem */
+void sqfs_icache_destroy(sqfs_icache *ic);
+
+/* Evicts unreferenced entries beyond the new limit */
+void sqfs_icache_set_max_unused(sqfs_icache *ic, size_t max_unused);
+
+/* Find or decode an inode, and take a reference to it */
+sqfs_err sqfs_icache_get(sqfs *fs, sqfs_inode_id id, sqfs_icache_entry **out);
+/* Drop a reference taken by sqfs_icache_get */
+void sqfs_icache_put(sqfs *fs, sqfs_icache_entry *entry);
+
+#endif
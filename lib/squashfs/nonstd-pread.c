@@ -46,20 +46,6 @@
 	#include "common.h"
 
 	ssize_t sqfs_pread(sqfs_fd_t fd, void *buf, size_t count, sqfs_off_t off) {
-		off_t cur_pos;
-		if((cur_pos = lseek(fd, 0, SEEK_CUR)) == -1) {
-			return -1;
-		}
-
-		if(lseek(fd, off, SEEK_SET) == -1) {
-			return -1;
-		}
-
-		ssize_t num_read = read(fd, buf, count);
-		if(lseek(fd, cur_pos, SEEK_SET) == -1) {
-			return -1;
-		}
-		
-		return num_read;
+		return pread(fd, buf, count, off);
 	}
 #endif
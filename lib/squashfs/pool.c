@@ -0,0 +1,52 @@
+#include "pool.h"
+
+#include <stdlib.h>
+
+void sqfs_pool_init(sqfs_pool *pool, size_t size, size_t max_free) {
+	pool->size = size;
+	pool->max_free = max_free;
+	pool->nfree = 0;
+	pool->free_head = NULL;
+	pool->allocs = 0;
+}
+
+void sqfs_pool_destroy(sqfs_pool *pool) {
+	sqfs_pool_set_max_free(pool, 0);
+}
+
+void sqfs_pool_set_max_free(sqfs_pool *pool, size_t max_free) {
+	pool->max_free = max_free;
+	while (pool->nfree > max_free) {
+		sqfs_block *block = pool->free_head;
+		pool->free_head = block->data;
+		pool->nfree--;
+		free(block);
+	}
+}
+
+sqfs_block *sqfs_pool_get(sqfs_pool *pool) {
+	sqfs_block *block = pool->free_head;
+	if (block) {
+		pool->free_head = block->data;
+		pool->nfree--;
+	} else {
+		if (!(block = malloc(sizeof(*block) + pool->size)))
+			return NULL;
+		pool->allocs++;
+	}
+	block->data = block + 1;
+	block->size = pool->size;
+	block->borrowed = false;
+	block->pool = pool;
+	return block;
+}
+
+void sqfs_pool_put(sqfs_pool *pool, sqfs_block *block) {
+	if (pool->nfree >= pool->max_free) {
+		free(block);
+		return;
+	}
+	block->data = pool->free_head;
+	pool->free_head = block;
+	pool->nfree++;
+}
@@ -0,0 +1,32 @@
+#ifndef SQFS_POOL_H
+#define SQFS_POOL_H
+
+#include "common.h"
+
+/* Pool of same-sized blocks
+ *  - Each buffer holds an sqfs_block header followed by `size` bytes of data,
+ *    so getting a block is one pop off a free list
+ *  - Disposed blocks go back on the free list, up to max_free of them, so
+ *    once the caches are warm a miss doesn't touch the heap
+ *  - No thread safety
+ */
+typedef struct sqfs_pool {
+	size_t size;
+	size_t max_free;
+	size_t nfree;
+	sqfs_block *free_head; /* chained through data */
+	uint64_t allocs; /* buffers that had to come from the heap */
+} sqfs_pool;
+
+void sqfs_pool_init(sqfs_pool *pool, size_t size, size_t max_free);
+void sqfs_pool_destroy(sqfs_pool *pool);
+
+/* Frees spare buffers beyond the new limit */
+void sqfs_pool_set_max_free(sqfs_pool *pool, size_t max_free);
+
+/* The block's data points at the pool's buffer, and its size is the pool's */
+sqfs_block *sqfs_pool_get(sqfs_pool *pool);
+/* Use sqfs_block_dispose, which calls this for pooled blocks */
+void sqfs_pool_put(sqfs_pool *pool, sqfs_block *block);
+
+#endif
@@ -32,7 +32,7 @@
 #include <stdlib.h>
 #include <string.h>
 
-sqfs_err sqfs_table_init(sqfs_table *table, sqfs_fd_t fd, sqfs_off_t start, size_t each,
+sqfs_err sqfs_table_init(sqfs_table *table, sqfs *fs, sqfs_off_t start, size_t each,
 		size_t count) {
 	size_t i;
 	size_t nblocks, bread;
@@ -46,7 +46,7 @@ sqfs_err sqfs_table_init(sqfs_table *table, sqfs_fd_t fd, sqfs_off_t start, size
 	table->each = each;
 	if (!(table->blocks = malloc(bread)))
 		goto err;
-	if (sqfs_pread(fd, table->blocks, bread, start) != (ssize_t) bread)
+	if (sqfs_source_pread(fs, table->blocks, bread, start) != (ssize_t) bread)
 		goto err;
 	
 	for (i = 0; i < nblocks; ++i)
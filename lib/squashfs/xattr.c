@@ -58,13 +58,13 @@ sqfs_err sqfs_xattr_init(sqfs *fs) {
 	if (start == SQUASHFS_INVALID_BLK)
 		return SQFS_OK;
 	
-	bread = sqfs_pread(fs->fd, &fs->xattr_info, sizeof(fs->xattr_info),
+	bread = sqfs_source_pread(fs, &fs->xattr_info, sizeof(fs->xattr_info),
 		start + fs->offset);
 	if (bread != sizeof(fs->xattr_info))
 		return SQFS_ERR;
 	sqfs_swapin_xattr_id_table(&fs->xattr_info);
 	
-	return sqfs_table_init(&fs->xattr_table, fs->fd,
+	return sqfs_table_init(&fs->xattr_table, fs,
 		start + sizeof(fs->xattr_info) + fs->offset, sizeof(struct squashfs_xattr_id),
 		fs->xattr_info.xattr_ids);
 }
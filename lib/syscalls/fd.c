@@ -4,6 +4,7 @@
 #include<stdlib.h>
 #include<libtransistor/types.h>
 #include<libtransistor/svc.h>
+#include<libtransistor/util.h>
 #include<stdatomic.h>
 
 #define FD_MAX 1024
@@ -14,6 +15,7 @@ struct fd {
 };
 
 static struct fd fds[FD_MAX] = {{0}};
+static _Atomic uint64_t next_file_id = 1;
 
 static void lock_fd(struct fd *fd) {
 	int expected = 0;
@@ -34,6 +36,7 @@ int fd_create_file(trn_file_ops_t *fops, void *data) {
 	f->ops = fops;
 	f->data = data;
 	f->refcount = 1;
+	f->id = next_file_id++;
 
 	int fd = 10;
 	trn_file_t *expected = NULL;
@@ -69,18 +72,25 @@ end:
 	return f;
 }
 
-void fd_file_put(trn_file_t *file) {
-	if (file == NULL)
-		return;
+// Returns what release said, if this dropped the last reference
+static result_t fd_file_put_result(trn_file_t *file) {
+	result_t r = RESULT_OK;
 
 	// If we're the last to abandon our pointer, we're responsible for
 	// destroying it.
 	if (atomic_fetch_sub(&file->refcount, 1) == 1) {
 		if(file->ops->release != NULL) {
-			file->ops->release(file);
+			r = file->ops->release(file);
 		}
 		free(file);
 	}
+	return r;
+}
+
+void fd_file_put(trn_file_t *file) {
+	if (file == NULL)
+		return;
+	fd_file_put_result(file);
 }
 
 int fd_close(int fd) {
@@ -99,8 +109,11 @@ int fd_close(int fd) {
 	// We can now give up the lock
 	fds[fd].lock = 0;
 
-	// Then, actually release the file
-	fd_file_put(file);
+	// Then, actually release the file. If that fails, say writing out what it
+	// had buffered, the fd is still gone, but close should report it.
+	result_t r = fd_file_put_result(file);
+	if (r != RESULT_OK)
+		return -trn_result_to_errno(r);
 	return 0;
 }
 
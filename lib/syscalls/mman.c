@@ -0,0 +1,148 @@
+#include<libtransistor/fd.h>
+
+#include<libtransistor/types.h>
+#include<libtransistor/alloc_pages.h>
+#include<libtransistor/mutex.h>
+
+#include<errno.h>
+#include<stdlib.h>
+#include<string.h>
+#include<unistd.h>
+
+#define PAGE_SIZE 0x1000
+#define PAGE_ROUND_UP(x) (((x) + PAGE_SIZE - 1) & ~((size_t) PAGE_SIZE - 1))
+
+// Horizon can only alias heap memory into the stack region, which as_reserve
+// stays out of, so private mappings are plain page allocations. What this
+// table buys us is being able to tell them apart from mappings that point
+// straight into a file's memory, which munmap has to leave alone.
+typedef struct mapping_t mapping_t;
+struct mapping_t {
+	mapping_t *next;
+	void *addr;
+	size_t length; // in whole pages
+	void *pages; // from alloc_pages, or NULL if addr belongs to the file
+};
+
+static trn_mutex_t mappings_mutex = TRN_MUTEX_STATIC_INITIALIZER;
+static mapping_t *mappings GUARDED_BY(mappings_mutex) = NULL;
+
+static void *mapping_add(void *addr, size_t length, void *pages) {
+	mapping_t *m = malloc(sizeof(*m));
+	if(m == NULL) {
+		return NULL;
+	}
+	m->addr = addr;
+	m->length = length;
+	m->pages = pages;
+
+	trn_mutex_lock(&mappings_mutex);
+	m->next = mappings;
+	mappings = m;
+	trn_mutex_unlock(&mappings_mutex);
+	return addr;
+}
+
+static void *map_private(size_t length, int fd, off_t offset) {
+	void *pages = alloc_pages(length, length, NULL);
+	if(pages == NULL) {
+		errno = ENOMEM;
+		return MAP_FAILED;
+	}
+
+	size_t filled = 0;
+	if(fd >= 0) {
+		while(filled < length) {
+			ssize_t r = pread(fd, (uint8_t*) pages + filled, length - filled, offset + filled);
+			if(r < 0) {
+				if(errno == ESPIPE) {
+					errno = ENODEV;
+				}
+				goto fail;
+			}
+			if(r == 0) {
+				break;
+			}
+			filled+= r;
+		}
+	}
+	// past the end of the file, and anonymous mappings, read as zeroes
+	memset((uint8_t*) pages + filled, 0, length - filled);
+
+	if(mapping_add(pages, length, pages) == NULL) {
+		errno = ENOMEM;
+		goto fail;
+	}
+	return pages;
+
+fail:
+	free_pages(pages);
+	return MAP_FAILED;
+}
+
+void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset) {
+	int type = flags & (MAP_SHARED | MAP_PRIVATE);
+
+	// addr is only a hint, which we're free to ignore
+	if(length == 0 || offset < 0 || (offset % PAGE_SIZE) != 0 ||
+	   (type != MAP_SHARED && type != MAP_PRIVATE) || (flags & MAP_FIXED)) {
+		errno = EINVAL;
+		return MAP_FAILED;
+	}
+	// we can't write changes back to files, or make memory executable
+	if((type == MAP_SHARED && (prot & PROT_WRITE) && !(flags & MAP_ANONYMOUS)) || (prot & PROT_EXEC)) {
+		errno = ENOTSUP;
+		return MAP_FAILED;
+	}
+
+	size_t pages_length = PAGE_ROUND_UP(length);
+	if(flags & MAP_ANONYMOUS) {
+		return map_private(pages_length, -1, 0);
+	}
+
+	trn_file_t *f = fd_file_get(fd);
+	if(f == NULL) {
+		errno = EBADF;
+		return MAP_FAILED;
+	}
+
+	// read-only mappings of files that are already in memory are free
+	const void *in_place;
+	if(!(prot & PROT_WRITE) && f->ops->mmap != NULL &&
+	   f->ops->mmap(f->data, offset, length, &in_place) == RESULT_OK) {
+		fd_file_put(f);
+		if(mapping_add((void*) in_place, pages_length, NULL) == NULL) {
+			errno = ENOMEM;
+			return MAP_FAILED;
+		}
+		return (void*) in_place;
+	}
+	fd_file_put(f);
+
+	return map_private(pages_length, fd, offset);
+}
+
+int munmap(void *addr, size_t length) {
+	mapping_t **mp, *m;
+
+	trn_mutex_lock(&mappings_mutex);
+	for(mp = &mappings; (m = *mp) != NULL; mp = &m->next) {
+		if(m->addr == addr) {
+			break;
+		}
+	}
+	// only whole mappings can be unmapped
+	if(m == NULL || length == 0 || PAGE_ROUND_UP(length) != m->length) {
+		trn_mutex_unlock(&mappings_mutex);
+		errno = EINVAL;
+		return -1;
+	}
+	*mp = m->next;
+	trn_mutex_unlock(&mappings_mutex);
+
+	if(m->pages != NULL) {
+		free_pages(m->pages);
+	}
+	free(m);
+	return 0;
+}
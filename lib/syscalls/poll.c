@@ -0,0 +1,934 @@
+#include<libtransistor/fd.h>
+
+#include<libtransistor/types.h>
+#include<libtransistor/err.h>
+#include<libtransistor/svc.h>
+#include<libtransistor/mutex.h>
+#include<libtransistor/waiter.h>
+#include<libtransistor/util.h>
+#include<libtransistor/ipc/bsd.h>
+
+#include<errno.h>
+#include<poll.h>
+#include<stdlib.h>
+#include<string.h>
+#include<sys/select.h>
+#include<sys/time.h>
+
+// How long a wait goes without checking again on files that can't say when
+// they become ready, or, with sockets in the mix, on files that can.
+#define POLL_SLICE_MS 10
+#define TICKS_PER_MS 19200
+
+/*
+ * poll, select and epoll_wait all wait the same way. Sockets are handed to a
+ * single bsd_poll, which is the only thing that can block on them. Every
+ * other file is asked through its `poll` op, and if it isn't ready, gives
+ * either a handle to wait on through a waiter, or nothing, in which case it's
+ * asked again every POLL_SLICE_MS. A bsd_poll can't be woken by a handle, so
+ * with both kinds of files in one wait, it goes in slices of POLL_SLICE_MS.
+ */
+
+typedef struct poll_set_t poll_set_t;
+
+struct poll_set_t {
+	// bsd's view of the sockets, with revents filled in by the wait
+	struct pollfd *sockets;
+	nfds_t socket_count;
+	// Sets revents on everything that isn't a socket, with poll_file, and
+	// returns how many are ready.
+	int (*check_files)(poll_set_t *set);
+	void *data;
+
+	// what the files that aren't ready gave to wait on
+	handle_t *handles;
+	size_t handle_count;
+	size_t handle_capacity;
+	bool recheck; // some file that isn't ready has to be asked again
+};
+
+static int bsd_result_errno() {
+	return bsd_result == LIBTRANSISTOR_ERR_BSD_ERRNO_SET ? bsd_errno : trn_result_to_errno(bsd_result);
+}
+
+// What's left of a timeout in milliseconds (-1 for none) that started at start.
+static int poll_remaining(uint64_t start, int timeout) {
+	if(timeout < 0) {
+		return -1;
+	}
+	uint64_t elapsed = (svcGetSystemTick() - start) / TICKS_PER_MS;
+	return elapsed >= (uint64_t) timeout ? 0 : timeout - (int) elapsed;
+}
+
+static void poll_set_add_handle(poll_set_t *set, handle_t handle) {
+	if(set->handle_count == set->handle_capacity) {
+		size_t capacity = set->handle_capacity == 0 ? 8 : set->handle_capacity * 2;
+		handle_t *handles = realloc(set->handles, capacity * sizeof(*handles));
+		if(handles == NULL) {
+			set->recheck = true;
+			return;
+		}
+		set->handles = handles;
+		set->handle_capacity = capacity;
+	}
+	set->handles[set->handle_count++] = handle;
+}
+
+// Which of events a file that isn't a socket has ready, right now.
+static short poll_file(poll_set_t *set, trn_file_t *file, short events) {
+	handle_t handle = INVALID_HANDLE;
+	short revents = 0;
+
+	if(file->ops->poll == NULL) {
+		return events & (POLLIN | POLLRDNORM | POLLOUT | POLLWRNORM);
+	}
+	if(file->ops->poll(file->data, events, &revents, &handle) != RESULT_OK) {
+		return POLLERR;
+	}
+	if(revents == 0) {
+		if(handle == INVALID_HANDLE) {
+			set->recheck = true;
+		} else {
+			poll_set_add_handle(set, handle);
+		}
+	}
+	return revents;
+}
+
+static bool poll_signalled(void *data, handle_t handle) {
+	return true;
+}
+
+// Waits up to timeout milliseconds (-1 for as long as it takes) for any of
+// the handles the files gave.
+static void poll_wait_handles(poll_set_t *set, int timeout) {
+	waiter_t *waiter = NULL;
+	wait_record_t **records = NULL;
+	size_t added = 0;
+
+	if(set->handle_count == 0) {
+		goto sleep;
+	}
+	if((waiter = waiter_create()) == NULL ||
+	   (records = malloc(set->handle_count * sizeof(*records))) == NULL) {
+		goto sleep;
+	}
+	for(; added < set->handle_count; added++) {
+		if((records[added] = waiter_add(waiter, set->handles[added], poll_signalled, NULL)) == NULL) {
+			goto sleep;
+		}
+	}
+	waiter_wait(waiter, timeout < 0 ? UINT64_MAX : (uint64_t) timeout * 1000000);
+	goto done;
+
+sleep:
+	// nothing to wait on: this only ends by timing out, or in the next
+	// recheck, so it doesn't matter how long it is as long as it's bounded
+	if(timeout < 0 || timeout > POLL_SLICE_MS * 100) {
+		timeout = POLL_SLICE_MS * 100;
+	}
+	svcSleepThread((uint64_t) timeout * 1000000);
+
+done:
+	for(size_t i = 0; i < added; i++) {
+		waiter_cancel(waiter, records[i]);
+	}
+	free(records);
+	if(waiter != NULL) {
+		waiter_destroy(waiter);
+	}
+}
+
+// Waits for anything in the set to be ready, returning how many are, or -1
+// with errno set.
+static int poll_set_wait(poll_set_t *set, int timeout) {
+	uint64_t start = svcGetSystemTick();
+
+	for(;;) {
+		set->handle_count = 0;
+		set->recheck = false;
+		int ready = set->check_files(set);
+		int slice = ready > 0 ? 0 : poll_remaining(start, timeout);
+		bool files_waiting = set->recheck || set->handle_count > 0;
+
+		if(set->socket_count > 0) {
+			if(files_waiting && (slice < 0 || slice > POLL_SLICE_MS)) {
+				slice = POLL_SLICE_MS;
+			}
+			int n = bsd_poll(set->sockets, set->socket_count, slice);
+			if(n < 0) {
+				errno = bsd_result_errno();
+				return -1;
+			}
+			ready+= n;
+		} else if(slice != 0) {
+			if(set->recheck && (slice < 0 || slice > POLL_SLICE_MS)) {
+				slice = POLL_SLICE_MS;
+			}
+			poll_wait_handles(set, slice);
+		}
+
+		if(ready > 0 || poll_remaining(start, timeout) == 0) {
+			return ready;
+		}
+	}
+}
+
+static void poll_set_finalize(poll_set_t *set) {
+	free(set->handles);
+}
+
+// poll
+
+#define POLL_SLOT_IGNORED -1
+#define POLL_SLOT_FILE -2
+
+typedef struct {
+	struct pollfd *fds;
+	nfds_t nfds;
+	int *slots; // where each fd's socket is in the set, or one of POLL_SLOT_*
+} poll_fds_t;
+
+static int poll_check_files(poll_set_t *set) {
+	poll_fds_t *p = set->data;
+	int ready = 0;
+
+	for(nfds_t i = 0; i < p->nfds; i++) {
+		if(p->slots[i] != POLL_SLOT_FILE) {
+			continue;
+		}
+		trn_file_t *file = fd_file_get(p->fds[i].fd);
+		if(file == NULL) {
+			p->fds[i].revents = POLLNVAL;
+		} else {
+			p->fds[i].revents = poll_file(set, file, p->fds[i].events);
+			fd_file_put(file);
+		}
+		if(p->fds[i].revents != 0) {
+			ready++;
+		}
+	}
+	return ready;
+}
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout) {
+	poll_fds_t p = {.fds = fds, .nfds = nfds};
+	poll_set_t set = {.check_files = poll_check_files, .data = &p};
+
+	// the sockets, then the slots
+	set.sockets = malloc((nfds > 0 ? nfds : 1) * (sizeof(*set.sockets) + sizeof(*p.slots)));
+	if(set.sockets == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+	p.slots = (int*) (set.sockets + nfds);
+
+	for(nfds_t i = 0; i < nfds; i++) {
+		fds[i].revents = 0;
+		if(fds[i].fd < 0) {
+			p.slots[i] = POLL_SLOT_IGNORED;
+			continue;
+		}
+		// anything that isn't an open socket, including fds that aren't
+		// open at all, is left to poll_check_files
+		p.slots[i] = POLL_SLOT_FILE;
+		trn_file_t *file = fd_file_get(fds[i].fd);
+		if(file == NULL) {
+			continue;
+		}
+		int bsd_fd = socket_get_bsd(file);
+		fd_file_put(file);
+		if(bsd_fd >= 0) {
+			p.slots[i] = set.socket_count;
+			set.sockets[set.socket_count++] = (struct pollfd) {.fd = bsd_fd, .events = fds[i].events};
+		}
+	}
+
+	int ret = poll_set_wait(&set, timeout);
+	if(ret >= 0) {
+		for(nfds_t i = 0; i < nfds; i++) {
+			if(p.slots[i] >= 0) {
+				fds[i].revents = set.sockets[p.slots[i]].revents;
+			}
+		}
+	}
+	poll_set_finalize(&set);
+	free(set.sockets);
+	return ret;
+}
+
+// select
+
+int select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *errorfds, struct timeval *timeout) {
+	struct pollfd *fds;
+	int count = 0;
+
+	if(nfds < 0 || nfds > FD_SETSIZE || (timeout != NULL && (timeout->tv_sec < 0 || timeout->tv_usec < 0))) {
+		errno = EINVAL;
+		return -1;
+	}
+	if((fds = malloc((nfds > 0 ? nfds : 1) * sizeof(*fds))) == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+	for(int fd = 0; fd < nfds; fd++) {
+		short events = 0;
+		if(readfds != NULL && FD_ISSET(fd, readfds)) {
+			events|= POLLIN;
+		}
+		if(writefds != NULL && FD_ISSET(fd, writefds)) {
+			events|= POLLOUT;
+		}
+		if(errorfds != NULL && FD_ISSET(fd, errorfds)) {
+			events|= POLLPRI;
+		}
+		if(events != 0) {
+			fds[count++] = (struct pollfd) {.fd = fd, .events = events};
+		}
+	}
+
+	// rounded up, so a short timeout doesn't turn into none
+	int ms = -1;
+	if(timeout != NULL) {
+		ms = timeout->tv_sec > 1000000 ? 1000000000 : timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000;
+	}
+	int ret = poll(fds, count, ms);
+	if(ret < 0) {
+		goto done;
+	}
+
+	for(int i = 0; i < count; i++) {
+		if(fds[i].revents & POLLNVAL) {
+			errno = EBADF;
+			ret = -1;
+			goto done;
+		}
+	}
+	if(readfds != NULL) {
+		FD_ZERO(readfds);
+	}
+	if(writefds != NULL) {
+		FD_ZERO(writefds);
+	}
+	if(errorfds != NULL) {
+		FD_ZERO(errorfds);
+	}
+	ret = 0;
+	for(int i = 0; i < count; i++) {
+		short revents = fds[i].revents;
+		if((fds[i].events & POLLIN) && (revents & (POLLIN | POLLHUP | POLLERR))) {
+			FD_SET(fds[i].fd, readfds);
+			ret++;
+		}
+		if((fds[i].events & POLLOUT) && (revents & (POLLOUT | POLLERR))) {
+			FD_SET(fds[i].fd, writefds);
+			ret++;
+		}
+		if((fds[i].events & POLLPRI) && (revents & POLLPRI)) {
+			FD_SET(fds[i].fd, errorfds);
+			ret++;
+		}
+	}
+
+done:
+	free(fds);
+	return ret;
+}
+
+// epoll
+
+/*
+ * An epoll instance keeps its interest list, along with the bsd_poll set
+ * built from it, between calls, so waiting on thousands of sockets doesn't
+ * mean looking up thousands of fds every time. The set is only rebuilt after
+ * epoll_ctl changes something.
+ *
+ * Readiness is level triggered; EPOLLET isn't supported. Like on Linux, fds
+ * that can't be polled (files without a `poll` op) can't be added. Closing an
+ * fd doesn't tell the instance about it, so entries hold on to the id of the
+ * file they were added for, and are dropped once they're found to be stale.
+ *
+ * epoll_wait doesn't hold the instance's lock while it waits, so other
+ * threads can epoll_ctl meanwhile. It waits on a copy of the interest list,
+ * and epoll_ctl wakes it to start over with the new one: with an event if
+ * there are no sockets in it, and otherwise with a datagram to a loopback
+ * socket that goes into the bsd_poll, since nothing else can end one early.
+ * Taking a wakeup back is only safe while no other wait might be about to
+ * miss it, so if several threads wait at once, all but the first check for
+ * changes every POLL_SLICE_MS instead. Whatever a wait finds ready is checked
+ * against the entries as they are by the time it retakes the lock.
+ */
+
+typedef struct {
+	int fd;
+	uint64_t file_id; // to tell if fd still means the same file, or 0 once it doesn't
+	int bsd_fd; // -1 if it isn't a socket
+	uint32_t events; // none while a oneshot entry waits to be rearmed
+	short revents;
+	epoll_data_t data;
+} epoll_entry_t;
+
+typedef struct {
+	trn_mutex_t mutex;
+	epoll_entry_t *entries;
+	size_t count;
+	size_t capacity;
+	int *by_fd; // index of each fd's entry, plus one, or zero
+	int by_fd_size;
+
+	struct pollfd *sockets;
+	size_t *socket_entries; // which entry each socket is for
+	nfds_t socket_count;
+	bool dirty;
+
+	size_t next; // where handing out events starts next time, so they all get a turn
+
+	_Atomic(uint32_t) generation; // bumped by every change epoll_ctl makes
+	int waiting; // how many waits are going on without the lock
+	bool woken; // wake_wevent is signalled, and nobody has cleared it yet
+	bool wake_pending; // a datagram went to wake_socket, and nobody has taken it yet
+	wevent_h wake_wevent;
+	revent_h wake_revent;
+	int wake_socket; // -1 until a wait on sockets needs it, or -2 if it couldn't be made
+	struct sockaddr_in wake_addr;
+} epoll_t;
+
+// An entry as it was when a wait started
+typedef struct {
+	int fd;
+	uint64_t file_id;
+	int bsd_fd;
+	uint32_t events;
+	short revents;
+} epoll_watch_t;
+
+// What one wait waits on, taken from the instance under its lock
+typedef struct {
+	epoll_t *ep;
+	epoll_watch_t *watches;
+	size_t count;
+	struct pollfd *sockets;
+	size_t *socket_watches; // which watch each socket is for
+	nfds_t socket_count;
+	uint32_t generation;
+	bool wakeable; // whether epoll_ctl wakes it, or it has to keep checking
+} epoll_snapshot_t;
+
+static trn_file_ops_t epoll_fops;
+
+static short epoll_to_poll(uint32_t events) {
+	return ((events & EPOLLIN) ? POLLIN : 0) |
+		((events & EPOLLPRI) ? POLLPRI : 0) |
+		((events & EPOLLOUT) ? POLLOUT : 0);
+}
+
+static uint32_t poll_to_epoll(short revents) {
+	return ((revents & POLLIN) ? EPOLLIN : 0) |
+		((revents & POLLPRI) ? EPOLLPRI : 0) |
+		((revents & POLLOUT) ? EPOLLOUT : 0) |
+		((revents & POLLERR) ? EPOLLERR : 0) |
+		((revents & POLLHUP) ? EPOLLHUP : 0);
+}
+
+static epoll_t *epoll_get(int epfd, trn_file_t **file) {
+	if((*file = fd_file_get(epfd)) == NULL) {
+		errno = EBADF;
+		return NULL;
+	}
+	if((*file)->ops != &epoll_fops) {
+		fd_file_put(*file);
+		errno = EINVAL;
+		return NULL;
+	}
+	return (*file)->data;
+}
+
+static epoll_entry_t *epoll_find(epoll_t *ep, int fd) {
+	if(fd < 0 || fd >= ep->by_fd_size || ep->by_fd[fd] == 0) {
+		return NULL;
+	}
+	return &ep->entries[ep->by_fd[fd] - 1];
+}
+
+static void epoll_remove(epoll_t *ep, epoll_entry_t *e) {
+	size_t i = e - ep->entries;
+
+	ep->by_fd[e->fd] = 0;
+	if(i != ep->count - 1) {
+		ep->entries[i] = ep->entries[ep->count - 1];
+		ep->by_fd[ep->entries[i].fd] = i + 1;
+	}
+	ep->count--;
+	ep->dirty = true;
+}
+
+static int epoll_add(epoll_t *ep, int fd, trn_file_t *file, int bsd_fd, struct epoll_event *event) {
+	if(fd >= ep->by_fd_size) {
+		int size = ep->by_fd_size == 0 ? 64 : ep->by_fd_size;
+		while(size <= fd) {
+			size*= 2;
+		}
+		int *by_fd = realloc(ep->by_fd, size * sizeof(*by_fd));
+		if(by_fd == NULL) {
+			return ENOMEM;
+		}
+		memset(by_fd + ep->by_fd_size, 0, (size - ep->by_fd_size) * sizeof(*by_fd));
+		ep->by_fd = by_fd;
+		ep->by_fd_size = size;
+	}
+	if(ep->count == ep->capacity) {
+		size_t capacity = ep->capacity == 0 ? 16 : ep->capacity * 2;
+		epoll_entry_t *entries = realloc(ep->entries, capacity * sizeof(*entries));
+		if(entries == NULL) {
+			return ENOMEM;
+		}
+		ep->entries = entries;
+		struct pollfd *sockets = realloc(ep->sockets, capacity * sizeof(*sockets));
+		if(sockets == NULL) {
+			return ENOMEM;
+		}
+		ep->sockets = sockets;
+		size_t *socket_entries = realloc(ep->socket_entries, capacity * sizeof(*socket_entries));
+		if(socket_entries == NULL) {
+			return ENOMEM;
+		}
+		ep->socket_entries = socket_entries;
+		ep->capacity = capacity;
+	}
+	ep->entries[ep->count] = (epoll_entry_t) {
+		.fd = fd,
+		.file_id = file->id,
+		.bsd_fd = bsd_fd,
+		.events = event->events,
+		.data = event->data,
+	};
+	ep->by_fd[fd] = ++ep->count;
+	ep->dirty = true;
+	return 0;
+}
+
+static void epoll_rebuild(epoll_t *ep) {
+	ep->socket_count = 0;
+	for(size_t i = 0; i < ep->count; i++) {
+		epoll_entry_t *e = &ep->entries[i];
+		e->revents = 0;
+		if(e->bsd_fd < 0 || e->events == 0) {
+			continue;
+		}
+		ep->sockets[ep->socket_count] = (struct pollfd) {.fd = e->bsd_fd, .events = epoll_to_poll(e->events)};
+		ep->socket_entries[ep->socket_count++] = i;
+	}
+	ep->dirty = false;
+}
+
+static bool epoll_wake_socket_open(epoll_t *ep) REQUIRES(ep->mutex) {
+	socklen_t len = sizeof(ep->wake_addr);
+	ep->wake_addr = (struct sockaddr_in) {
+		.sin_family = AF_INET,
+		.sin_addr = {.s_addr = htonl(INADDR_LOOPBACK)},
+	};
+	int s = bsd_socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if(s < 0) {
+		ep->wake_socket = -2;
+		return false;
+	}
+	if(bsd_bind(s, (struct sockaddr*) &ep->wake_addr, sizeof(ep->wake_addr)) != 0 ||
+	   bsd_getsockname(s, (struct sockaddr*) &ep->wake_addr, &len) != 0) {
+		bsd_close(s);
+		ep->wake_socket = -2;
+		return false;
+	}
+	ep->wake_socket = s;
+	return true;
+}
+
+// Takes back whatever wakeup is left over, for a wait that nothing else is
+// waiting alongside, and returns whether epoll_ctl can wake it.
+static bool epoll_wake_prepare(epoll_t *ep, bool sockets) REQUIRES(ep->mutex) {
+	if(ep->woken) {
+		svcClearEvent(ep->wake_revent);
+		ep->woken = false;
+	}
+	if(ep->wake_pending) {
+		char byte;
+		if(bsd_recv(ep->wake_socket, &byte, sizeof(byte), MSG_DONTWAIT) != sizeof(byte)) {
+			return false; // still on its way, so a later wait takes it back
+		}
+		ep->wake_pending = false;
+	}
+	if(!sockets) {
+		return true;
+	}
+	return ep->wake_socket >= 0 || (ep->wake_socket == -1 && epoll_wake_socket_open(ep));
+}
+
+static void epoll_wake(epoll_t *ep) REQUIRES(ep->mutex) {
+	if(ep->waiting == 0) {
+		return;
+	}
+	if(!ep->woken) {
+		svcSignalEvent(ep->wake_wevent);
+		ep->woken = true;
+	}
+	if(ep->wake_socket >= 0 && !ep->wake_pending) {
+		char byte = 0;
+		ep->wake_pending = bsd_sendto(ep->wake_socket, &byte, sizeof(byte), MSG_DONTWAIT,
+		                              (struct sockaddr*) &ep->wake_addr, sizeof(ep->wake_addr)) == sizeof(byte);
+	}
+}
+
+static int epoll_check_files(poll_set_t *set) {
+	epoll_snapshot_t *snap = set->data;
+	epoll_t *ep = snap->ep;
+	int ready = 0;
+
+	// an epoll_ctl since the wait started ends it, so it can start over
+	if(ep->generation != snap->generation) {
+		return 1;
+	}
+	if(!snap->wakeable) {
+		set->recheck = true;
+	} else if(snap->socket_count == 0) {
+		poll_set_add_handle(set, ep->wake_revent);
+	}
+
+	for(size_t i = 0; i < snap->count; i++) {
+		epoll_watch_t *w = &snap->watches[i];
+		if(w->bsd_fd >= 0) {
+			continue;
+		}
+		trn_file_t *file = fd_file_get(w->fd);
+		if(file == NULL || file->id != w->file_id) {
+			w->revents = POLLNVAL; // stale, to be dropped
+		} else {
+			w->revents = poll_file(set, file, epoll_to_poll(w->events));
+		}
+		if(file != NULL) {
+			fd_file_put(file);
+		}
+		if(w->revents != 0) {
+			ready++;
+		}
+	}
+	return ready;
+}
+
+// Copies what's to be waited on out of the instance.
+static int epoll_snapshot(epoll_t *ep, epoll_snapshot_t *snap) REQUIRES(ep->mutex) {
+	if(ep->dirty) {
+		epoll_rebuild(ep);
+	}
+	snap->ep = ep;
+	snap->count = 0;
+	snap->socket_count = ep->socket_count;
+	snap->generation = ep->generation;
+
+	// the watches, then the sockets and maybe wake_socket, then which watch
+	// each socket is for
+	size_t n = ep->count + 1;
+	snap->watches = malloc(n * (sizeof(*snap->watches) + sizeof(*snap->sockets) + sizeof(*snap->socket_watches)));
+	if(snap->watches == NULL) {
+		return ENOMEM;
+	}
+	snap->sockets = (struct pollfd*) (snap->watches + n);
+	snap->socket_watches = (size_t*) (snap->sockets + n);
+
+	for(size_t i = 0; i < ep->count; i++) {
+		epoll_entry_t *e = &ep->entries[i];
+		e->revents = 0;
+		if(e->events == 0) {
+			continue;
+		}
+		snap->watches[snap->count++] = (epoll_watch_t) {
+			.fd = e->fd,
+			.file_id = e->file_id,
+			.bsd_fd = e->bsd_fd,
+			.events = e->events,
+		};
+	}
+	// the sockets were put together in entry order, skipping the same entries
+	memcpy(snap->sockets, ep->sockets, ep->socket_count * sizeof(*snap->sockets));
+	for(nfds_t i = 0, w = 0; i < ep->socket_count; i++, w++) {
+		while(snap->watches[w].bsd_fd < 0) {
+			w++;
+		}
+		snap->socket_watches[i] = w;
+	}
+	return 0;
+}
+
+// One wait on the whole interest list, leaving revents set on each entry
+// that's still there, and returning how many that is. Takes the lock, and
+// drops it while it waits.
+static int epoll_wait_once(epoll_t *ep, int timeout) EXCLUDES(ep->mutex) {
+	epoll_snapshot_t snap;
+	int err;
+
+	trn_mutex_lock(&ep->mutex);
+	if((err = epoll_snapshot(ep, &snap)) != 0) {
+		trn_mutex_unlock(&ep->mutex);
+		errno = err;
+		return -1;
+	}
+	snap.wakeable = timeout != 0 && ep->waiting == 0 && epoll_wake_prepare(ep, snap.socket_count > 0);
+	ep->waiting++;
+	trn_mutex_unlock(&ep->mutex);
+
+	nfds_t socket_count = snap.socket_count;
+	if(snap.wakeable && socket_count > 0) {
+		snap.sockets[socket_count++] = (struct pollfd) {.fd = ep->wake_socket, .events = POLLIN};
+	}
+	poll_set_t set = {
+		.sockets = snap.sockets,
+		.socket_count = socket_count,
+		.check_files = epoll_check_files,
+		.data = &snap,
+	};
+	int ready = poll_set_wait(&set, timeout);
+	poll_set_finalize(&set);
+	for(nfds_t i = 0; ready >= 0 && i < snap.socket_count; i++) {
+		snap.watches[snap.socket_watches[i]].revents = snap.sockets[i].revents;
+	}
+
+	trn_mutex_lock(&ep->mutex);
+	ep->waiting--;
+	if(ready >= 0) {
+		ready = 0;
+		for(size_t i = 0; i < snap.count; i++) {
+			epoll_watch_t *w = &snap.watches[i];
+			epoll_entry_t *e = epoll_find(ep, w->fd);
+			// only if it's still the same file, and it still wants to hear about it
+			if(w->revents == 0 || e == NULL || e->file_id != w->file_id || e->events == 0) {
+				continue;
+			}
+			e->revents = w->revents;
+			ready++;
+		}
+	}
+	trn_mutex_unlock(&ep->mutex);
+	free(snap.watches);
+	return ready;
+}
+
+static bool epoll_entry_stale(epoll_entry_t *e) {
+	if(e->revents & POLLNVAL) {
+		return true;
+	}
+	if(e->bsd_fd < 0) {
+		return false; // epoll_check_files already looked
+	}
+	trn_file_t *file = fd_file_get(e->fd);
+	if(file == NULL) {
+		return true;
+	}
+	bool stale = file->id != e->file_id;
+	fd_file_put(file);
+	return stale;
+}
+
+int epoll_create1(int flags) {
+	if((flags & ~EPOLL_CLOEXEC) != 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	epoll_t *ep = calloc(1, sizeof(*ep));
+	if(ep == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+	trn_mutex_create(&ep->mutex);
+	ep->wake_socket = -1;
+	result_t r = svcCreateEvent(&ep->wake_wevent, &ep->wake_revent);
+	if(r != RESULT_OK) {
+		free(ep);
+		errno = trn_result_to_errno(r);
+		return -1;
+	}
+	int fd = fd_create_file(&epoll_fops, ep);
+	if(fd < 0) {
+		svcCloseHandle(ep->wake_wevent);
+		svcCloseHandle(ep->wake_revent);
+		free(ep);
+		errno = -fd;
+		return -1;
+	}
+	return fd;
+}
+
+int epoll_create(int size) {
+	if(size <= 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	return epoll_create1(0);
+}
+
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event) {
+	trn_file_t *ep_file, *file;
+	int err = 0;
+
+	epoll_t *ep = epoll_get(epfd, &ep_file);
+	if(ep == NULL) {
+		return -1;
+	}
+	if((file = fd_file_get(fd)) == NULL) {
+		fd_file_put(ep_file);
+		errno = EBADF;
+		return -1;
+	}
+
+	trn_mutex_lock(&ep->mutex);
+	epoll_entry_t *e = epoll_find(ep, fd);
+	if(e != NULL && e->file_id != file->id) {
+		// left over from a file that used to be at fd
+		epoll_remove(ep, e);
+		e = NULL;
+	}
+	if(op != EPOLL_CTL_DEL && (event == NULL || (event->events & EPOLLET))) {
+		err = EINVAL;
+		goto done;
+	}
+	switch(op) {
+	case EPOLL_CTL_ADD: {
+		int bsd_fd = socket_get_bsd(file);
+		if(e != NULL) {
+			err = EEXIST;
+		} else if(file == ep_file) {
+			err = EINVAL;
+		} else if(bsd_fd < 0 && file->ops->poll == NULL) {
+			err = EPERM;
+		} else {
+			err = epoll_add(ep, fd, file, bsd_fd, event);
+		}
+		break;
+	}
+	case EPOLL_CTL_MOD:
+		if(e == NULL) {
+			err = ENOENT;
+		} else {
+			e->events = event->events;
+			e->data = event->data;
+			ep->dirty = true;
+		}
+		break;
+	case EPOLL_CTL_DEL:
+		if(e == NULL) {
+			err = ENOENT;
+		} else {
+			epoll_remove(ep, e);
+		}
+		break;
+	default:
+		err = EINVAL;
+		break;
+	}
+
+done:
+	if(err == 0) {
+		ep->generation++;
+		epoll_wake(ep);
+	}
+	trn_mutex_unlock(&ep->mutex);
+	fd_file_put(file);
+	fd_file_put(ep_file);
+	if(err != 0) {
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
+
+int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout) {
+	trn_file_t *ep_file;
+	int n = 0;
+
+	if(maxevents <= 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	epoll_t *ep = epoll_get(epfd, &ep_file);
+	if(ep == NULL) {
+		return -1;
+	}
+
+	uint64_t start = svcGetSystemTick();
+	for(;;) {
+		if(epoll_wait_once(ep, poll_remaining(start, timeout)) < 0) {
+			n = -1;
+			break;
+		}
+
+		trn_mutex_lock(&ep->mutex);
+		bool dropped = false;
+		size_t first = ep->count > 0 ? ep->next % ep->count : 0;
+		for(size_t k = 0; k < ep->count && n < maxevents; k++) {
+			size_t i = (first + k) % ep->count;
+			epoll_entry_t *e = &ep->entries[i];
+			if(e->revents == 0) {
+				continue;
+			}
+			if(epoll_entry_stale(e)) {
+				e->file_id = 0;
+				dropped = true;
+				continue;
+			}
+			events[n].events = poll_to_epoll(e->revents);
+			events[n].data = e->data;
+			n++;
+			if(e->events & EPOLLONESHOT) {
+				e->events = 0;
+				e->revents = 0;
+				ep->dirty = true;
+			}
+			ep->next = i + 1;
+		}
+		if(dropped) {
+			for(size_t i = ep->count; i-- > 0; ) {
+				if(ep->entries[i].file_id == 0) {
+					epoll_remove(ep, &ep->entries[i]);
+				}
+			}
+		}
+		trn_mutex_unlock(&ep->mutex);
+		// nothing that was ready is still there, because it was closed, or
+		// changed by epoll_ctl meanwhile, so keep waiting
+		if(n > 0 || poll_remaining(start, timeout) == 0) {
+			break;
+		}
+	}
+	fd_file_put(ep_file);
+	return n;
+}
+
+// An epoll instance is itself readable when something in it is ready.
+static result_t epoll_poll(void *data, short events, short *revents, handle_t *handle) {
+	epoll_t *ep = data;
+
+	int ready = epoll_wait_once(ep, 0);
+	if(ready < 0) {
+		return errno == ENOMEM ? LIBTRANSISTOR_ERR_OUT_OF_MEMORY : bsd_result;
+	}
+	*revents = ready > 0 ? (events & (POLLIN | POLLRDNORM)) : 0;
+	return RESULT_OK;
+}
+
+static result_t epoll_release(trn_file_t *file) {
+	epoll_t *ep = file->data;
+
+	if(ep->wake_socket >= 0) {
+		bsd_close(ep->wake_socket);
+	}
+	svcCloseHandle(ep->wake_wevent);
+	svcCloseHandle(ep->wake_revent);
+	free(ep->entries);
+	free(ep->by_fd);
+	free(ep->sockets);
+	free(ep->socket_entries);
+	free(ep);
+	return RESULT_OK;
+}
+
+static trn_file_ops_t epoll_fops = {
+	.release = epoll_release,
+	.poll = epoll_poll,
+};
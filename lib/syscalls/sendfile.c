@@ -0,0 +1,219 @@
+#include<libtransistor/fd.h>
+
+#include<libtransistor/types.h>
+#include<libtransistor/err.h>
+#include<libtransistor/util.h>
+
+#include<errno.h>
+#include<malloc.h>
+#include<unistd.h>
+
+// Bounce buffer chunk when the sink is positional, like a file. Chunks are
+// kept aligned to the source offset, so backends with large blocks (fsp-srv,
+// mostly) see whole, aligned requests on both sides.
+#define COPY_CHUNK_FILE (1024 * 1024)
+// Bounce buffer chunk when the sink is a stream, like a socket.
+#define COPY_CHUNK_STREAM (64 * 1024)
+
+/*
+ * There's no kernel to move data between files for us, so what sendfile and
+ * copy_file_range buy over a read/write loop is picking the cheapest way
+ * through for the pair of files involved:
+ *
+ *  - if the source implements `peek` (squashfs, blobfd), each write goes
+ *    straight out of the memory the source already keeps its data in, like
+ *    the blob, or an uncompressed block in an in-memory squashfs image,
+ *    without copying it anywhere first.
+ *  - otherwise, it's read into a bounce buffer sized for the sink: big and
+ *    aligned for files, and smaller for streams, which take it in pieces.
+ */
+
+typedef struct {
+	trn_file_t *file;
+	off_t *offset; // where to start and report back, or NULL to use the position
+	off_t pos; // where the next byte is
+	off_t head; // the position to put back when done, if moved
+	bool moved;
+} copy_end_t;
+
+static int copy_end_open(copy_end_t *end, int fd, off_t *offset) {
+	end->file = fd_file_get(fd);
+	end->offset = offset;
+	end->pos = offset != NULL ? *offset : 0;
+	end->moved = false;
+	if(end->file == NULL) {
+		return EBADF;
+	}
+	return end->pos < 0 ? EINVAL : 0;
+}
+
+// Positional I/O on the file, emulated with seek if it doesn't have any,
+// remembering to put the position back afterwards.
+static result_t copy_end_seek(copy_end_t *end) {
+	off_t ignored;
+	result_t r;
+
+	if(end->file->ops->seek == NULL) {
+		return LIBTRANSISTOR_ERR_UNIMPLEMENTED;
+	}
+	if(!end->moved && end->offset != NULL) {
+		if((r = end->file->ops->seek(end->file->data, 0, SEEK_CUR, &end->head)) != RESULT_OK) {
+			return r;
+		}
+		end->moved = true;
+	}
+	return end->file->ops->seek(end->file->data, end->pos, SEEK_SET, &ignored);
+}
+
+static void copy_end_close(copy_end_t *end) {
+	off_t ignored;
+
+	if(end->file == NULL) {
+		return;
+	}
+	if(end->offset != NULL) {
+		*end->offset = end->pos;
+		if(end->moved) {
+			end->file->ops->seek(end->file->data, end->head, SEEK_SET, &ignored);
+		}
+	}
+	fd_file_put(end->file);
+}
+
+static result_t copy_read(copy_end_t *in, void *buf, size_t size, size_t *got) {
+	trn_file_ops_t *ops = in->file->ops;
+	result_t r;
+
+	if(ops->pread != NULL) {
+		return ops->pread(in->file->data, buf, size, in->pos, got);
+	}
+	if(ops->read == NULL) {
+		return LIBTRANSISTOR_ERR_UNIMPLEMENTED;
+	}
+	if((r = copy_end_seek(in)) != RESULT_OK) {
+		return r;
+	}
+	return ops->read(in->file->data, buf, size, got);
+}
+
+// Writes all of buf, unless the sink fails partway.
+static result_t copy_write(copy_end_t *out, const void *buf, size_t size, size_t *wrote) {
+	trn_file_ops_t *ops = out->file->ops;
+	result_t r = RESULT_OK;
+
+	*wrote = 0;
+	if(out->offset != NULL && ops->pwrite == NULL && (r = copy_end_seek(out)) != RESULT_OK) {
+		return r;
+	}
+	while(*wrote < size) {
+		size_t n = 0;
+		if(out->offset != NULL && ops->pwrite != NULL) {
+			r = ops->pwrite(out->file->data, (const uint8_t*) buf + *wrote, size - *wrote, out->pos, &n);
+		} else if(ops->write != NULL) {
+			r = ops->write(out->file->data, (const uint8_t*) buf + *wrote, size - *wrote, &n);
+		} else {
+			r = LIBTRANSISTOR_ERR_UNIMPLEMENTED;
+		}
+		if(r != RESULT_OK) {
+			break;
+		}
+		if(n == 0) {
+			r = LIBTRANSISTOR_ERR_FS_NO_SPACE;
+			break;
+		}
+		*wrote+= n;
+		out->pos+= n;
+	}
+	return r;
+}
+
+static ssize_t copy_range(int in_fd, off_t *in_off, int out_fd, off_t *out_off, size_t count) {
+	copy_end_t in = {.file = NULL}, out = {.file = NULL};
+	uint8_t *bounce = NULL;
+	size_t copied = 0;
+	off_t ignored;
+	result_t r;
+
+	int err;
+	if((err = copy_end_open(&in, in_fd, in_off)) != 0 ||
+	   (err = copy_end_open(&out, out_fd, out_off)) != 0) {
+		r = LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+		errno = err;
+		goto done;
+	}
+	// without an offset, the source is read from, and moved past, its position
+	if(in_off == NULL) {
+		if(in.file->ops->seek == NULL) {
+			r = LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+			errno = EINVAL;
+			goto done;
+		}
+		if((r = in.file->ops->seek(in.file->data, 0, SEEK_CUR, &in.pos)) != RESULT_OK) {
+			errno = trn_result_to_errno(r);
+			goto done;
+		}
+	}
+
+	bool positional = out_off != NULL && out.file->ops->pwrite != NULL;
+	size_t chunk_size = positional ? COPY_CHUNK_FILE : COPY_CHUNK_STREAM;
+	r = RESULT_OK;
+	while(copied < count) {
+		const void *src = NULL;
+		size_t n = count - copied;
+
+		if(in.file->ops->peek == NULL ||
+		   in.file->ops->peek(in.file->data, in.pos, &src, &n) != RESULT_OK) {
+			if(bounce == NULL && (bounce = memalign(0x1000, chunk_size)) == NULL) {
+				r = LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+				break;
+			}
+			n = chunk_size - (positional ? in.pos % chunk_size : 0);
+			if(n > count - copied) {
+				n = count - copied;
+			}
+			if((r = copy_read(&in, bounce, n, &n)) != RESULT_OK) {
+				break;
+			}
+			src = bounce;
+		}
+		if(n == 0) {
+			break; // end of file
+		}
+
+		size_t wrote;
+		r = copy_write(&out, src, n, &wrote);
+		in.pos+= wrote;
+		copied+= wrote;
+		if(r != RESULT_OK) {
+			break;
+		}
+	}
+	free(bounce);
+
+	// a failure only counts if nothing made it across
+	if(r != RESULT_OK && copied == 0) {
+		errno = trn_result_to_errno(r);
+	} else {
+		r = RESULT_OK;
+	}
+	if(in_off == NULL) {
+		in.file->ops->seek(in.file->data, in.pos, SEEK_SET, &ignored);
+	}
+
+done:
+	copy_end_close(&in);
+	copy_end_close(&out);
+	return r == RESULT_OK ? (ssize_t) copied : -1;
+}
+
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count) {
+	return copy_range(in_fd, offset, out_fd, NULL, count);
+}
+
+ssize_t copy_file_range(int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len, unsigned int flags) {
+	if(flags != 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	return copy_range(fd_in, off_in, fd_out, off_out, len);
+}
@@ -2,7 +2,9 @@
 #include<libtransistor/fd.h>
 
 #include<sys/socket.h>
+#include<fcntl.h>
 #include<stdlib.h>
+#include<string.h>
 #include<errno.h>
 
 static trn_file_ops_t socket_fops;
@@ -26,6 +28,12 @@ int socket_from_bsd(int bsd_fd) {
 	return fd;
 }
 
+int socket_get_bsd(trn_file_t *file) {
+	if (file->ops != &socket_fops)
+		return -1;
+	return *((int*)file->data);
+}
+
 int socket(int domain, int type, int protocol) {
 	bsd_init();
 	int bsd_fd = bsd_socket(domain, type, protocol);
@@ -177,6 +185,44 @@ ssize_t send(int socket, const void *data, size_t length, int flags) {
 	return ret;
 }
 
+int socket_sendmmsg(int fd, bsd_datagram_t *msgs, int count, int flags) {
+	trn_file_t *f = fd_file_get(fd);
+	if (f == NULL) {
+		errno = EBADF;
+		return -1;
+	}
+	int bsd_fd = socket_get_bsd(f);
+	fd_file_put(f);
+	if (bsd_fd < 0) {
+		errno = ENOTSOCK;
+		return -1;
+	}
+
+	int ret = bsd_sendmmsg(bsd_fd, msgs, count, flags);
+	if (ret < 0)
+		errno = bsd_errno;
+	return ret;
+}
+
+int socket_recvmmsg(int fd, bsd_datagram_t *msgs, int count, int flags) {
+	trn_file_t *f = fd_file_get(fd);
+	if (f == NULL) {
+		errno = EBADF;
+		return -1;
+	}
+	int bsd_fd = socket_get_bsd(f);
+	fd_file_put(f);
+	if (bsd_fd < 0) {
+		errno = ENOTSOCK;
+		return -1;
+	}
+
+	int ret = bsd_recvmmsg(bsd_fd, msgs, count, flags);
+	if (ret < 0)
+		errno = bsd_errno;
+	return ret;
+}
+
 static result_t __socket_read(void *data, void *buf, size_t len, size_t *bytes_read) {
 	int bsd_sock = *((int*)data);
 	ssize_t ret;
@@ -203,6 +249,104 @@ static result_t __socket_write(void *data, const void *buf, size_t len, size_t *
 	return RESULT_OK;
 }
 
+// bsd has no scatter/gather, so we bounce through a single buffer to keep it
+// to one IPC per call.
+static result_t __socket_readv(void *data, const struct iovec *iov, int iovcnt, size_t *bytes_read) {
+	int bsd_sock = *((int*)data);
+	size_t total = 0;
+	ssize_t ret;
+
+	if (iovcnt == 1)
+		return __socket_read(data, iov[0].iov_base, iov[0].iov_len, bytes_read);
+
+	for (int i = 0; i < iovcnt; i++)
+		total += iov[i].iov_len;
+	if (total == 0) {
+		// nothing to do, and malloc(0) may well return NULL
+		*bytes_read = 0;
+		return RESULT_OK;
+	}
+
+	char *bounce = malloc(total);
+	if (bounce == NULL)
+		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+
+	ret = bsd_recv(bsd_sock, bounce, total, 0);
+	if (ret < 0) {
+		free(bounce);
+		return bsd_result;
+	}
+
+	size_t remaining = ret;
+	char *src = bounce;
+	for (int i = 0; i < iovcnt && remaining > 0; i++) {
+		size_t chunk = iov[i].iov_len < remaining ? iov[i].iov_len : remaining;
+		memcpy(iov[i].iov_base, src, chunk);
+		src += chunk;
+		remaining -= chunk;
+	}
+
+	free(bounce);
+	*bytes_read = ret;
+	return RESULT_OK;
+}
+
+static result_t __socket_writev(void *data, const struct iovec *iov, int iovcnt, size_t *bytes_written) {
+	int bsd_sock = *((int*)data);
+	size_t total = 0;
+	ssize_t ret;
+
+	if (iovcnt == 1)
+		return __socket_write(data, iov[0].iov_base, iov[0].iov_len, bytes_written);
+
+	for (int i = 0; i < iovcnt; i++)
+		total += iov[i].iov_len;
+	if (total == 0) {
+		*bytes_written = 0;
+		return RESULT_OK;
+	}
+
+	char *bounce = malloc(total);
+	if (bounce == NULL)
+		return LIBTRANSISTOR_ERR_OUT_OF_MEMORY;
+
+	char *dst = bounce;
+	for (int i = 0; i < iovcnt; i++) {
+		memcpy(dst, iov[i].iov_base, iov[i].iov_len);
+		dst += iov[i].iov_len;
+	}
+
+	ret = bsd_send(bsd_sock, bounce, total, 0);
+	free(bounce);
+	if (ret < 0) {
+		return bsd_result;
+	}
+
+	*bytes_written = ret;
+	return RESULT_OK;
+}
+
+// Only O_NONBLOCK means anything to a socket, and bsd has its own value for it.
+static result_t __socket_fcntl(void *data, int cmd, int arg, int *out) {
+	int bsd_sock = *((int*)data);
+	int flags;
+
+	switch (cmd) {
+	case F_GETFL:
+		if ((flags = bsd_fcntl(bsd_sock, F_GETFL, 0)) < 0)
+			return bsd_result;
+		*out = O_RDWR | ((flags & BSD_O_NONBLOCK) ? O_NONBLOCK : 0);
+		return RESULT_OK;
+	case F_SETFL:
+		if (bsd_fcntl(bsd_sock, F_SETFL, (arg & O_NONBLOCK) ? BSD_O_NONBLOCK : 0) < 0)
+			return bsd_result;
+		*out = 0;
+		return RESULT_OK;
+	default:
+		return LIBTRANSISTOR_ERR_INVALID_ARGUMENT;
+	}
+}
+
 static result_t __socket_release(trn_file_t *f) {
 	int bsd_sock = *((int*)f->data);
 	result_t ret = RESULT_OK;
@@ -217,4 +361,7 @@ static trn_file_ops_t socket_fops = {
 	.read = __socket_read,
 	.write = __socket_write,
 	.release = __socket_release,
+	.readv = __socket_readv,
+	.writev = __socket_writev,
+	.fcntl = __socket_fcntl,
 };
@@ -49,14 +49,70 @@ int _execve_r(struct _reent *reent, const char *name, char *const *argv, char *c
 	return -1;
 }
 
+int _fcntl_r(struct _reent *reent, int file, int cmd, int arg) {
+	int res = 0;
+	result_t r;
+
+	trn_file_t *f = fd_file_get(file);
+	if (f == NULL) {
+		reent->_errno = EBADF;
+		return -1;
+	}
+
+	switch (cmd) {
+	case F_GETFD:
+	case F_SETFD:
+		// there's no exec, so nothing to close on it
+		break;
+	case F_GETFL:
+	case F_SETFL:
+		if (f->ops->fcntl == NULL)
+			break;
+		if ((r = f->ops->fcntl(f->data, cmd, arg, &res)) != RESULT_OK) {
+			reent->_errno = trn_result_to_errno(r);
+			res = -1;
+		}
+		break;
+	default:
+		reent->_errno = EINVAL;
+		res = -1;
+		break;
+	}
+
+	fd_file_put(f);
+	return res;
+}
+
 int _fork_r(struct _reent *reent) {
 	reent->_errno = ENOSYS;
 	return -1;
 }
 
 int _fstat_r(struct _reent *reent, int file, struct stat *st) {
-	reent->_errno = ENOSYS;
-	return -1;
+	int res = 0;
+	result_t r;
+
+	trn_file_t *f = fd_file_get(file);
+	if (f == NULL) {
+		reent->_errno = EBADF;
+		return -1;
+	}
+
+	if (f->ops->stat == NULL) {
+		reent->_errno = ENOSYS;
+		res = -1;
+		goto finalize;
+	}
+
+	memset(st, 0, sizeof(*st));
+	if ((r = f->ops->stat(f->data, st)) != RESULT_OK) {
+		reent->_errno = trn_result_to_errno(r);
+		res = -1;
+	}
+
+finalize:
+	fd_file_put(f);
+	return res;
 }
 
 int _getpid_r(struct _reent *reent) {
@@ -234,6 +290,238 @@ finalize:
 	return res;
 }
 
+// Positional I/O doesn't go through the file's head, so there's no need to
+// serialize it against other users of the same file. If the backend doesn't
+// support it natively, we fall back to saving and restoring the head.
+ssize_t pread(int file, void *buf, size_t len, off_t offset) {
+	ssize_t res = -1;
+	size_t bytes_read = 0;
+	off_t pos, ignored;
+	result_t r;
+
+	trn_file_t *f = fd_file_get(file);
+	if (f == NULL) {
+		errno = EBADF;
+		return -1;
+	}
+
+	if (f->ops->pread != NULL) {
+		r = f->ops->pread(f->data, buf, len, offset, &bytes_read);
+	} else if (f->ops->seek != NULL && f->ops->read != NULL) {
+		if ((r = f->ops->seek(f->data, 0, SEEK_CUR, &pos)) == RESULT_OK &&
+		    (r = f->ops->seek(f->data, offset, SEEK_SET, &ignored)) == RESULT_OK) {
+			r = f->ops->read(f->data, buf, len, &bytes_read);
+			f->ops->seek(f->data, pos, SEEK_SET, &ignored);
+		}
+	} else {
+		errno = ESPIPE;
+		goto finalize;
+	}
+
+	if (r != RESULT_OK) {
+		errno = trn_result_to_errno(r);
+		goto finalize;
+	}
+	res = bytes_read;
+
+finalize:
+	fd_file_put(f);
+	return res;
+}
+
+ssize_t pwrite(int file, const void *buf, size_t len, off_t offset) {
+	ssize_t res = -1;
+	size_t bytes_written = 0;
+	off_t pos, ignored;
+	result_t r;
+
+	trn_file_t *f = fd_file_get(file);
+	if (f == NULL) {
+		errno = EBADF;
+		return -1;
+	}
+
+	if (f->ops->pwrite != NULL) {
+		r = f->ops->pwrite(f->data, buf, len, offset, &bytes_written);
+	} else if (f->ops->seek != NULL && f->ops->write != NULL) {
+		if ((r = f->ops->seek(f->data, 0, SEEK_CUR, &pos)) == RESULT_OK &&
+		    (r = f->ops->seek(f->data, offset, SEEK_SET, &ignored)) == RESULT_OK) {
+			r = f->ops->write(f->data, buf, len, &bytes_written);
+			f->ops->seek(f->data, pos, SEEK_SET, &ignored);
+		}
+	} else {
+		errno = ESPIPE;
+		goto finalize;
+	}
+
+	if (r != RESULT_OK) {
+		errno = trn_result_to_errno(r);
+		goto finalize;
+	}
+	res = bytes_written;
+
+finalize:
+	fd_file_put(f);
+	return res;
+}
+
+#define IOV_MAX_COUNT 1024
+
+ssize_t readv(int file, const struct iovec *iov, int iovcnt) {
+	ssize_t res = -1;
+	size_t bytes_read = 0;
+	result_t r = RESULT_OK;
+
+	if (iovcnt < 0 || iovcnt > IOV_MAX_COUNT) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	trn_file_t *f = fd_file_get(file);
+	if (f == NULL) {
+		errno = EBADF;
+		return -1;
+	}
+
+	if (f->ops->readv != NULL) {
+		r = f->ops->readv(f->data, iov, iovcnt, &bytes_read);
+	} else if (f->ops->read != NULL) {
+		for (int i = 0; i < iovcnt; i++) {
+			size_t chunk = 0;
+			if ((r = f->ops->read(f->data, iov[i].iov_base, iov[i].iov_len, &chunk)) != RESULT_OK) {
+				break;
+			}
+			bytes_read+= chunk;
+			if (chunk < iov[i].iov_len) {
+				break;
+			}
+		}
+		if (bytes_read > 0) { // report the partial read, like a short read
+			r = RESULT_OK;
+		}
+	} else {
+		errno = ENOSYS;
+		goto finalize;
+	}
+
+	if (r != RESULT_OK) {
+		errno = trn_result_to_errno(r);
+		goto finalize;
+	}
+	res = bytes_read;
+
+finalize:
+	fd_file_put(f);
+	return res;
+}
+
+ssize_t writev(int file, const struct iovec *iov, int iovcnt) {
+	ssize_t res = -1;
+	size_t bytes_written = 0;
+	result_t r = RESULT_OK;
+
+	if (iovcnt < 0 || iovcnt > IOV_MAX_COUNT) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	trn_file_t *f = fd_file_get(file);
+	if (f == NULL) {
+		errno = EBADF;
+		return -1;
+	}
+
+	if (f->ops->writev != NULL) {
+		r = f->ops->writev(f->data, iov, iovcnt, &bytes_written);
+	} else if (f->ops->write != NULL) {
+		for (int i = 0; i < iovcnt; i++) {
+			size_t chunk = 0;
+			if ((r = f->ops->write(f->data, iov[i].iov_base, iov[i].iov_len, &chunk)) != RESULT_OK) {
+				break;
+			}
+			bytes_written+= chunk;
+			if (chunk < iov[i].iov_len) {
+				break;
+			}
+		}
+		if (bytes_written > 0) {
+			r = RESULT_OK;
+		}
+	} else {
+		errno = ENOSYS;
+		goto finalize;
+	}
+
+	if (r != RESULT_OK) {
+		errno = trn_result_to_errno(r);
+		goto finalize;
+	}
+	res = bytes_written;
+
+finalize:
+	fd_file_put(f);
+	return res;
+}
+
+int fsync(int file) {
+	int res = 0;
+	result_t r;
+
+	trn_file_t *f = fd_file_get(file);
+	if (f == NULL) {
+		errno = EBADF;
+		return -1;
+	}
+
+	// nothing is buffered, so there's nothing to do
+	if (f->ops->flush == NULL)
+		goto finalize;
+
+	if ((r = f->ops->flush(f->data)) != RESULT_OK) {
+		errno = trn_result_to_errno(r);
+		res = -1;
+	}
+
+finalize:
+	fd_file_put(f);
+	return res;
+}
+
+int fdatasync(int file) {
+	return fsync(file);
+}
+
+int ftruncate(int file, off_t length) {
+	int res = 0;
+	result_t r;
+
+	if (length < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	trn_file_t *f = fd_file_get(file);
+	if (f == NULL) {
+		errno = EBADF;
+		return -1;
+	}
+
+	if (f->ops->truncate == NULL) {
+		errno = EINVAL;
+		res = -1;
+		goto finalize;
+	}
+
+	if ((r = f->ops->truncate(f->data, length)) != RESULT_OK) {
+		errno = trn_result_to_errno(r);
+		res = -1;
+	}
+
+finalize:
+	fd_file_put(f);
+	return res;
+}
+
 int _gettimeofday_r(struct _reent *reent, struct timeval *__restrict p, void *__restrict z) {
 	uint64_t time;
 	result_t res;
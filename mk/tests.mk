@@ -1,6 +1,6 @@
 # LIBTRANSISTOR TESTS
 
-libtransistor_TESTS := malloc bsd_ai_packing bsd sfdnsres nv helloworld hid hexdump args ssp stdin vi gpu display am sqfs_img audio_output init_fini_arrays ipc_server pthread ipc_fs fs_stress cpp unwind cpp_exceptions cpp_dynamic_memory hid_init_stress usb usb_serial thread mutex override_heap condvar # fs_release_inodes
+libtransistor_TESTS := malloc bsd_ai_packing bsd bsd_threads bsd_config bsd_mmsg sfdnsres dns_cache nv helloworld hid hexdump args ssp stdin vi gpu display am sqfs_img audio_output init_fini_arrays ipc_server pthread ipc_fs fs_stress fspfs_cache sqfs_cache sqfs_readahead sqfs_lookup_index sqfs_inode_cache mmap tmpfs overlayfs aio mountfs sendfile poll buffered_fd lz4 cpp unwind cpp_exceptions cpp_dynamic_memory hid_init_stress usb usb_serial thread mutex override_heap condvar # fs_release_inodes
 libtransistor_DYNAMIC_TESTS := simple dlfcn bad_resolution preemption elf
 
 # RUN RULES
@@ -13,6 +13,24 @@ run_bsd_test: $(BUILD_DIR)/test/test_bsd.nro $(SOURCE_ROOT)/test_helpers/bsd.rb
 run_sfdnsres_test: $(BUILD_DIR)/test/test_sfdnsres.nro
 	$(MEPHISTO) --enable-sockets --initialize-memory --load-nro $<
 
+run_bsd_threads_test: $(BUILD_DIR)/test/test_bsd_threads.nro
+	$(MEPHISTO) --enable-sockets --initialize-memory --load-nro $<
+
+run_bsd_config_test: $(BUILD_DIR)/test/test_bsd_config.nro
+	$(MEPHISTO) --enable-sockets --initialize-memory --load-nro $<
+
+run_bsd_mmsg_test: $(BUILD_DIR)/test/test_bsd_mmsg.nro
+	$(MEPHISTO) --enable-sockets --initialize-memory --load-nro $<
+
+run_dns_cache_test: $(BUILD_DIR)/test/test_dns_cache.nro
+	$(MEPHISTO) --enable-sockets --initialize-memory --load-nro $<
+
+run_poll_test: $(BUILD_DIR)/test/test_poll.nro
+	$(MEPHISTO) --enable-sockets --initialize-memory --load-nro $<
+
+run_buffered_fd_test: $(BUILD_DIR)/test/test_buffered_fd.nro
+	$(MEPHISTO) --enable-sockets --initialize-memory --load-nro $<
+
 run_ssp_test: $(BUILD_DIR)/test/test_ssp.nro
 	$(MEPHISTO) --enable-sockets --initialize-memory --load-nro $<
 
@@ -26,6 +44,34 @@ run_ipc_fs_test: $(BUILD_DIR)/test/test_fs_stress.nro
 	echo "test text" > $(BUILD_DIR)/SwitchFS/SDCard/test_file
 	cd $(BUILD_DIR); $(realpath $(MEPHISTO)) --initialize-memory --load-nro $(realpath $<)
 
+run_fspfs_cache_test: $(BUILD_DIR)/test/test_fspfs_cache.nro
+	mkdir -p $(BUILD_DIR)/SwitchFS/SDCard/
+	cd $(BUILD_DIR); $(realpath $(MEPHISTO)) --initialize-memory --load-nro $(realpath $<)
+
+run_tmpfs_test: $(BUILD_DIR)/test/test_tmpfs.nro
+	mkdir -p $(BUILD_DIR)/SwitchFS/SDCard/
+	cd $(BUILD_DIR); $(realpath $(MEPHISTO)) --initialize-memory --load-nro $(realpath $<)
+
+run_overlayfs_test: $(BUILD_DIR)/test/test_overlayfs.nro
+	mkdir -p $(BUILD_DIR)/SwitchFS/SDCard/
+	cd $(BUILD_DIR); $(realpath $(MEPHISTO)) --initialize-memory --load-nro $(realpath $<)
+
+run_aio_test: $(BUILD_DIR)/test/test_aio.nro
+	mkdir -p $(BUILD_DIR)/SwitchFS/SDCard/
+	cd $(BUILD_DIR); $(realpath $(MEPHISTO)) --initialize-memory --load-nro $(realpath $<)
+
+run_sendfile_test: $(BUILD_DIR)/test/test_sendfile.nro
+	mkdir -p $(BUILD_DIR)/SwitchFS/SDCard/
+	cd $(BUILD_DIR); $(realpath $(MEPHISTO)) --enable-sockets --initialize-memory --load-nro $(realpath $<)
+
+# results are left in $(BUILD_DIR)/bench_fs.jsonl, one JSON object per line
+run_bench_fs: $(BUILD_DIR)/test/bench_fs.nro
+	rm -rf $(BUILD_DIR)/SwitchFS/SDCard/bench_fs
+	mkdir -p $(BUILD_DIR)/SwitchFS/SDCard/bench_fs/small
+	for i in $$(seq 0 255); do echo "file $$i" > $(BUILD_DIR)/SwitchFS/SDCard/bench_fs/small/file_$$i; done
+	seq 1 3000000 | head -c 16777216 > $(BUILD_DIR)/SwitchFS/SDCard/bench_fs/big
+	cd $(BUILD_DIR); $(realpath $(MEPHISTO)) --initialize-memory --load-nro $(realpath $<) > bench_fs.log; status=$$?; cat bench_fs.log; grep '^{"bench"' bench_fs.log > bench_fs.jsonl; exit $$status
+
 run_%_test: $(BUILD_DIR)/test/test_%.nro
 	$(MEPHISTO) --initialize-memory --load-nro $<
 
@@ -87,6 +133,10 @@ $(BUILD_DIR)/test/test_%.nro.so: $(BUILD_DIR)/test/test_%.o $(BUILD_DIR)/test/te
 	mkdir -p $(@D)
 	$(LD) $(LD_FLAGS) -o $@ $< $(BUILD_DIR)/test/test_$*.squashfs.o $(LIBTRANSISTOR_NRO_LDFLAGS)
 
+$(BUILD_DIR)/test/bench_fs.nro.so: $(BUILD_DIR)/test/bench_fs.o $(BUILD_DIR)/test/bench_fs.squashfs.o $(DIST)
+	mkdir -p $(@D)
+	$(LD) $(LD_FLAGS) -o $@ $< $(BUILD_DIR)/test/bench_fs.squashfs.o $(LIBTRANSISTOR_NRO_LDFLAGS)
+
 $(BUILD_DIR)/test/test_%.nso.so: $(BUILD_DIR)/test/test_%.o $(BUILD_DIR)/test/test_%.squashfs.o $(DIST)
 	mkdir -p $(@D)
 	$(LD) $(LD_FLAGS) -o $@ $< $(BUILD_DIR)/test/test_$*.squashfs.o $(LIBTRANSISTOR_NSO_LDFLAGS)
@@ -137,6 +187,71 @@ $(BUILD_DIR)/test/dynamic/test_%.squashfs:  $(BUILD_DIR)/test/dynamic/libdynamic
 	mkdir -p $(@D)
 	mksquashfs $^ $@ -comp xz -nopad -noappend
 
+# lots of small files, plus one big one to stream through the data cache
+$(BUILD_DIR)/test/test_sqfs_cache.squashfs:
+	rm -rf $(BUILD_DIR)/test/fs_test_sqfs_cache
+	mkdir -p $(BUILD_DIR)/test/fs_test_sqfs_cache/dir
+	for i in $$(seq 0 511); do echo "file $$i" > $(BUILD_DIR)/test/fs_test_sqfs_cache/dir/file_$$i; done
+	seq 1 1000000 > $(BUILD_DIR)/test/fs_test_sqfs_cache/big
+	mksquashfs $(BUILD_DIR)/test/fs_test_sqfs_cache/* $@ -comp xz -nopad -noappend
+
+$(BUILD_DIR)/test/test_sqfs_inode_cache.squashfs: $(BUILD_DIR)/test/test_sqfs_cache.squashfs
+	cp $< $@
+
+# 64 MiB of compressible, but not trivially compressible, data
+$(BUILD_DIR)/test/test_sqfs_readahead.squashfs:
+	rm -rf $(BUILD_DIR)/test/fs_test_sqfs_readahead
+	mkdir -p $(BUILD_DIR)/test/fs_test_sqfs_readahead
+	seq 1 10000000 | head -c 67108864 > $(BUILD_DIR)/test/fs_test_sqfs_readahead/stream
+	mksquashfs $(BUILD_DIR)/test/fs_test_sqfs_readahead/* $@ -comp xz -nopad -noappend
+
+# stored as-is, so that it can be mapped without copying
+$(BUILD_DIR)/test/test_mmap.squashfs:
+	rm -rf $(BUILD_DIR)/test/fs_test_mmap
+	mkdir -p $(BUILD_DIR)/test/fs_test_mmap
+	seq 1 200000 > $(BUILD_DIR)/test/fs_test_mmap/asset
+	mksquashfs $(BUILD_DIR)/test/fs_test_mmap/* $@ -noD -no-fragments -nopad -noappend
+
+# a few files to override, and a directory of ones that aren't
+$(BUILD_DIR)/test/test_overlayfs.squashfs:
+	rm -rf $(BUILD_DIR)/test/fs_test_overlayfs
+	mkdir -p $(BUILD_DIR)/test/fs_test_overlayfs/sub
+	echo "lower a" > $(BUILD_DIR)/test/fs_test_overlayfs/a.txt
+	echo "lower b" > $(BUILD_DIR)/test/fs_test_overlayfs/b.txt
+	echo "lower c" > $(BUILD_DIR)/test/fs_test_overlayfs/sub/c.txt
+	for i in $$(seq 0 63); do echo "asset $$i" > $(BUILD_DIR)/test/fs_test_overlayfs/asset_$$i; done
+	mksquashfs $(BUILD_DIR)/test/fs_test_overlayfs/* $@ -comp xz -nopad -noappend
+
+# 4 MiB to stream through with a queue of reads
+$(BUILD_DIR)/test/test_aio.squashfs:
+	rm -rf $(BUILD_DIR)/test/fs_test_aio
+	mkdir -p $(BUILD_DIR)/test/fs_test_aio
+	seq 1 1000000 | head -c 4194304 > $(BUILD_DIR)/test/fs_test_aio/stream
+	mksquashfs $(BUILD_DIR)/test/fs_test_aio/* $@ -comp xz -nopad -noappend
+
+# 8 MiB to send from the data cache, and copy onto the SD card
+$(BUILD_DIR)/test/test_sendfile.squashfs:
+	rm -rf $(BUILD_DIR)/test/fs_test_sendfile
+	mkdir -p $(BUILD_DIR)/test/fs_test_sendfile
+	seq 1 2000000 | head -c 8388608 > $(BUILD_DIR)/test/fs_test_sendfile/stream
+	mksquashfs $(BUILD_DIR)/test/fs_test_sendfile/* $@ -comp xz -nopad -noappend
+
+# the same tree run_bench_fs puts on the SD card
+$(BUILD_DIR)/test/bench_fs.squashfs:
+	rm -rf $(BUILD_DIR)/test/fs_bench_fs
+	mkdir -p $(BUILD_DIR)/test/fs_bench_fs/bench_fs/small
+	for i in $$(seq 0 255); do echo "file $$i" > $(BUILD_DIR)/test/fs_bench_fs/bench_fs/small/file_$$i; done
+	seq 1 3000000 | head -c 16777216 > $(BUILD_DIR)/test/fs_bench_fs/bench_fs/big
+	mksquashfs $(BUILD_DIR)/test/fs_bench_fs/* $@ -comp xz -nopad -noappend
+
+# one directory big enough to be indexed, and one that isn't
+$(BUILD_DIR)/test/test_sqfs_lookup_index.squashfs:
+	rm -rf $(BUILD_DIR)/test/fs_test_sqfs_lookup_index
+	mkdir -p $(BUILD_DIR)/test/fs_test_sqfs_lookup_index/big $(BUILD_DIR)/test/fs_test_sqfs_lookup_index/small
+	cd $(BUILD_DIR)/test/fs_test_sqfs_lookup_index/big && seq -f 'entry_%g' 0 19999 | xargs touch
+	cd $(BUILD_DIR)/test/fs_test_sqfs_lookup_index/small && seq -f 'entry_%g' 0 15 | xargs touch
+	mksquashfs $(BUILD_DIR)/test/fs_test_sqfs_lookup_index/* $@ -comp xz -nopad -noappend
+
 $(BUILD_DIR)/test/test_%.squashfs: $(LIBTRANSISTOR_HOME)/test/fs_test_%/*
 	mkdir -p $(@D)
 	mksquashfs $^ $@ -comp xz -nopad -noappend
@@ -156,3 +271,4 @@ default: \
 	$(addprefix $(BUILD_DIR)/test/test_,$(addsuffix .nro,$(libtransistor_TESTS))) \
 	$(addprefix $(BUILD_DIR)/test/test_,$(addsuffix .nso,$(libtransistor_TESTS))) \
 	$(addprefix $(BUILD_DIR)/test/dynamic/test_,$(addsuffix .nro,$(libtransistor_DYNAMIC_TESTS))) \
+	$(BUILD_DIR)/test/bench_fs.nro \
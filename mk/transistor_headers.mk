@@ -2,8 +2,10 @@
 
 libtransistor_HEADER_NAMES := \
 	address_space.h \
+	aio.h \
 	alloc_pages.h \
 	audio.h \
+	buffered_fd.h \
 	collections/list.h \
 	condvar.h \
 	display/binder.h \
@@ -20,11 +22,14 @@ libtransistor_HEADER_NAMES := \
 	err/modules.h \
 	fd.h \
 	fs/blobfd.h \
+	fs/dcache.h \
 	fs/fs.h \
 	fs/fspfs.h \
 	fs/inode.h \
 	fs/mountfs.h \
 	fs/squashfs.h \
+	fs/tmpfs.h \
+	fs/overlayfs.h \
 	gfx/blit.h \
 	gfx/gfx.h \
 	gpu/gpu.h \
@@ -76,6 +81,7 @@ libtransistor_HEADER_NAMES := \
 
 libtransistor_CPP_HEADER_NAMES := \
 	address_space.hpp \
+	aio.hpp \
 	ipcclient.hpp \
 	ipc/hid.hpp \
 	ipc.hpp \
@@ -3,7 +3,9 @@
 
 libtransistor_OBJECT_NAMES := \
 	address_space.o \
+	aio.o \
 	alloc_pages.o \
+	buffered_fd.o \
 	condvar.o \
 	crt0_common.o \
 	display/binder.o \
@@ -15,10 +17,13 @@ libtransistor_OBJECT_NAMES := \
 	environment.o \
 	err.o \
 	fs/blobfd.o \
+	fs/dcache.o \
 	fs/fs.o \
 	fs/fspfs.o \
 	fs/mountfs.o \
 	fs/squashfs.o \
+	fs/tmpfs.o \
+	fs/overlayfs.o \
 	gfx/blit.o \
 	gpu/gpu.o \
 	hid.o \
@@ -61,11 +66,14 @@ libtransistor_OBJECT_NAMES := \
 	squashfs/cache.o \
 	squashfs/decompress.o \
 	squashfs/dir.o \
+	squashfs/dirhash.o \
 	squashfs/file.o \
 	squashfs/fs.o \
 	squashfs/hash.o \
+	squashfs/icache.o \
 	squashfs/nonstd-pread.o \
 	squashfs/nonstd-stat.o \
+	squashfs/pool.o \
 	squashfs/stack.o \
 	squashfs/swap.o \
 	squashfs/table.o \
@@ -75,8 +83,11 @@ libtransistor_OBJECT_NAMES := \
 	strtold.o \
 	svc.o \
 	syscalls/fd.o \
+	syscalls/mman.o \
 	syscalls/phal.o \
+	syscalls/poll.o \
 	syscalls/sched.o \
+	syscalls/sendfile.o \
 	syscalls/socket.o \
 	syscalls/syscalls.o \
 	thread.o \
@@ -88,6 +99,7 @@ libtransistor_OBJECT_NAMES := \
 
 libtransistor_CPP_OBJECT_NAMES := \
 	address_space.o \
+	aio.o \
 	ipcclient.o \
 	ipc/hid.o \
 	ipcserver.o \
@@ -0,0 +1,365 @@
+#include<libtransistor/types.h>
+#include<libtransistor/svc.h>
+#include<libtransistor/err.h>
+#include<libtransistor/fs/fs.h>
+#include<libtransistor/fs/tmpfs.h>
+#include<libtransistor/fs/blobfd.h>
+#include<errno.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<fcntl.h>
+#include<unistd.h>
+#include<dirent.h>
+#include<sys/stat.h>
+
+/*
+ * Measures the same operations on every backend, through the same path-based
+ * calls applications use, so that the cost of trn_fs_traverse and mountfs is
+ * included. Each result is printed as one line of JSON:
+ *
+ *   {"bench":"fs","backend":"squashfs","op":"stat","count":2048,"value":3.21,"unit":"us/op"}
+ *
+ * Every backend gets the same tree, BENCH_DIR under its mountpoint: SMALL_FILES
+ * files small/file_N holding "file N\n", and a BIG_SIZE file, big. The image
+ * and the SD card's copy are made by mk/tests.mk; the tmpfs one is made here.
+ */
+#define BENCH_DIR "bench_fs"
+#define SMALL_FILES 256
+#define BIG_SIZE (16 * 1024 * 1024)
+#define SEQ_CHUNK_SIZE (64 * 1024)
+#define RAND_CHUNK_SIZE 4096
+#define RAND_READS 2048
+#define ROUNDS 8
+#define CREATE_FILES 64
+#define TICKS_PER_US 19.2
+
+typedef struct {
+	const char *name;
+	const char *root; // mountpoint holding BENCH_DIR
+	bool writable;
+} backend_t;
+
+static uint8_t buf[SEQ_CHUNK_SIZE];
+static uint8_t big[BIG_SIZE];
+
+static void emit(const char *backend, const char *op, int count, double value, const char *unit) {
+	printf("{\"bench\":\"fs\",\"backend\":\"%s\",\"op\":\"%s\",\"count\":%d,\"value\":%.3f,\"unit\":\"%s\"}\n",
+	       backend, op, count, value, unit);
+}
+
+static void emit_latency(const char *backend, const char *op, int count, uint64_t ticks) {
+	emit(backend, op, count, ticks / TICKS_PER_US / count, "us/op");
+}
+
+static void emit_throughput(const char *backend, const char *op, int count, size_t bytes, uint64_t ticks) {
+	double secs = ticks / TICKS_PER_US / 1000000.0;
+	emit(backend, op, count, (bytes / (1024.0 * 1024.0)) / secs, "MiB/s");
+}
+
+static uint32_t next_random(uint32_t *seed) {
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 8;
+}
+
+static int bench_open(const backend_t *b) {
+	char path[128];
+	int count = 0;
+
+	uint64_t start = svcGetSystemTick();
+	for(int round = 0; round < ROUNDS; round++) {
+		for(int i = 0; i < SMALL_FILES; i++, count++) {
+			snprintf(path, sizeof(path), "%s/" BENCH_DIR "/small/file_%d", b->root, i);
+			int fd = open(path, O_RDONLY);
+			if(fd < 0) {
+				printf("bench_fs %s: failed to open %s: %s\n", b->name, path, strerror(errno));
+				return 1;
+			}
+			close(fd);
+		}
+	}
+	emit_latency(b->name, "open", count, svcGetSystemTick() - start);
+	return 0;
+}
+
+static int bench_stat(const backend_t *b) {
+	struct stat st;
+	char path[128];
+	int count = 0;
+
+	uint64_t start = svcGetSystemTick();
+	for(int round = 0; round < ROUNDS; round++) {
+		for(int i = 0; i < SMALL_FILES; i++, count++) {
+			snprintf(path, sizeof(path), "%s/" BENCH_DIR "/small/file_%d", b->root, i);
+			if(stat(path, &st) != 0) {
+				printf("bench_fs %s: failed to stat %s: %s\n", b->name, path, strerror(errno));
+				return 1;
+			}
+		}
+	}
+	emit_latency(b->name, "stat", count, svcGetSystemTick() - start);
+	return 0;
+}
+
+static int bench_readdir(const backend_t *b) {
+	struct dirent *ent;
+	char path[128];
+	int entries = 0;
+
+	snprintf(path, sizeof(path), "%s/" BENCH_DIR "/small", b->root);
+	uint64_t start = svcGetSystemTick();
+	for(int round = 0; round < ROUNDS; round++) {
+		DIR *dir = opendir(path);
+		if(dir == NULL) {
+			printf("bench_fs %s: failed to open %s: %s\n", b->name, path, strerror(errno));
+			return 1;
+		}
+		while((ent = readdir(dir)) != NULL) {
+			entries++;
+		}
+		closedir(dir);
+	}
+	uint64_t ticks = svcGetSystemTick() - start;
+	if(entries < ROUNDS * SMALL_FILES) {
+		printf("bench_fs %s: readdir found %d entries, expected %d\n", b->name, entries / ROUNDS, SMALL_FILES);
+		return 1;
+	}
+	emit_latency(b->name, "readdir", entries, ticks);
+	return 0;
+}
+
+static int bench_read_fd(const char *name, int fd) {
+	uint32_t seed = 1;
+	size_t total = 0;
+	ssize_t r;
+
+	uint64_t start = svcGetSystemTick();
+	while((r = read(fd, buf, SEQ_CHUNK_SIZE)) > 0) {
+		total+= r;
+	}
+	uint64_t ticks = svcGetSystemTick() - start;
+	if(r < 0 || total != BIG_SIZE) {
+		printf("bench_fs %s: sequential read got %zu bytes: %s\n", name, total, strerror(errno));
+		return 1;
+	}
+	emit_throughput(name, "seq_read", BIG_SIZE / SEQ_CHUNK_SIZE, total, ticks);
+
+	start = svcGetSystemTick();
+	for(int i = 0; i < RAND_READS; i++) {
+		off_t offset = (next_random(&seed) % (BIG_SIZE / RAND_CHUNK_SIZE)) * RAND_CHUNK_SIZE;
+		if(pread(fd, buf, RAND_CHUNK_SIZE, offset) != RAND_CHUNK_SIZE) {
+			printf("bench_fs %s: random read at 0x%lx failed: %s\n", name, (long) offset, strerror(errno));
+			return 1;
+		}
+	}
+	ticks = svcGetSystemTick() - start;
+	emit_throughput(name, "rand_read", RAND_READS, (size_t) RAND_READS * RAND_CHUNK_SIZE, ticks);
+	emit_latency(name, "rand_read", RAND_READS, ticks);
+	return 0;
+}
+
+static int bench_read(const backend_t *b) {
+	char path[128];
+
+	snprintf(path, sizeof(path), "%s/" BENCH_DIR "/big", b->root);
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		printf("bench_fs %s: failed to open %s: %s\n", b->name, path, strerror(errno));
+		return 1;
+	}
+	int ret = bench_read_fd(b->name, fd);
+	close(fd);
+	return ret;
+}
+
+static int bench_create_delete(const backend_t *b) {
+	char path[128];
+	char contents[32];
+
+	snprintf(path, sizeof(path), "%s/" BENCH_DIR "/scratch", b->root);
+	if(mkdir(path, 0777) != 0 && errno != EEXIST) {
+		printf("bench_fs %s: failed to create %s: %s\n", b->name, path, strerror(errno));
+		return 1;
+	}
+
+	uint64_t start = svcGetSystemTick();
+	for(int i = 0; i < CREATE_FILES; i++) {
+		snprintf(path, sizeof(path), "%s/" BENCH_DIR "/scratch/file_%d", b->root, i);
+		int len = snprintf(contents, sizeof(contents), "file %d\n", i);
+		int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		if(fd < 0 || write(fd, contents, len) != len) {
+			printf("bench_fs %s: failed to create %s: %s\n", b->name, path, strerror(errno));
+			return 1;
+		}
+		close(fd);
+	}
+	uint64_t create_ticks = svcGetSystemTick() - start;
+
+	start = svcGetSystemTick();
+	for(int i = 0; i < CREATE_FILES; i++) {
+		snprintf(path, sizeof(path), "%s/" BENCH_DIR "/scratch/file_%d", b->root, i);
+		if(unlink(path) != 0) {
+			printf("bench_fs %s: failed to delete %s: %s\n", b->name, path, strerror(errno));
+			return 1;
+		}
+	}
+	uint64_t delete_ticks = svcGetSystemTick() - start;
+
+	snprintf(path, sizeof(path), "%s/" BENCH_DIR "/scratch", b->root);
+	rmdir(path);
+	emit_latency(b->name, "create", CREATE_FILES, create_ticks);
+	emit_latency(b->name, "delete", CREATE_FILES, delete_ticks);
+	return 0;
+}
+
+static int bench_backend(const backend_t *b) {
+	if(bench_open(b) != 0 || bench_stat(b) != 0 || bench_readdir(b) != 0 || bench_read(b) != 0) {
+		return 1;
+	}
+	if(b->writable && bench_create_delete(b) != 0) {
+		return 1;
+	}
+	return 0;
+}
+
+// Builds the same tree in the tmpfs that the image and SD card hold.
+static int populate_tmpfs(const char *root) {
+	char path[128];
+	char contents[32];
+
+	snprintf(path, sizeof(path), "%s/" BENCH_DIR, root);
+	if(mkdir(path, 0777) != 0) {
+		return 1;
+	}
+	snprintf(path, sizeof(path), "%s/" BENCH_DIR "/small", root);
+	if(mkdir(path, 0777) != 0) {
+		return 1;
+	}
+	for(int i = 0; i < SMALL_FILES; i++) {
+		snprintf(path, sizeof(path), "%s/" BENCH_DIR "/small/file_%d", root, i);
+		int len = snprintf(contents, sizeof(contents), "file %d\n", i);
+		int fd = open(path, O_WRONLY | O_CREAT, 0666);
+		if(fd < 0 || write(fd, contents, len) != len) {
+			return 1;
+		}
+		close(fd);
+	}
+	snprintf(path, sizeof(path), "%s/" BENCH_DIR "/big", root);
+	int fd = open(path, O_WRONLY | O_CREAT, 0666);
+	if(fd < 0 || write(fd, big, BIG_SIZE) != BIG_SIZE) {
+		return 1;
+	}
+	close(fd);
+	return 0;
+}
+
+// No paths to go through here, just the fd: opening is creating one over
+// memory that's already there, and reading is copying it.
+static int bench_blobfd() {
+	blob_file blob;
+	struct stat st;
+	int count = 0;
+
+	uint64_t start = svcGetSystemTick();
+	for(int round = 0; round < ROUNDS; round++) {
+		for(int i = 0; i < SMALL_FILES; i++, count++) {
+			int fd = blobfd_create(&blob, big, 64);
+			if(fd < 0) {
+				printf("bench_fs blobfd: failed to create fd\n");
+				return 1;
+			}
+			close(fd);
+		}
+	}
+	emit_latency("blobfd", "open", count, svcGetSystemTick() - start);
+
+	int fd = blobfd_create(&blob, big, BIG_SIZE);
+	if(fd < 0) {
+		printf("bench_fs blobfd: failed to create fd\n");
+		return 1;
+	}
+	count = 0;
+	start = svcGetSystemTick();
+	for(int round = 0; round < ROUNDS; round++) {
+		for(int i = 0; i < SMALL_FILES; i++, count++) {
+			fstat(fd, &st);
+		}
+	}
+	emit_latency("blobfd", "stat", count, svcGetSystemTick() - start);
+
+	int ret = bench_read_fd("blobfd", fd);
+	close(fd);
+	return ret;
+}
+
+// What the root mountfs costs on its own: finding mountpoints, and listing them.
+static int bench_mountfs() {
+	static const char *mountpoints[] = {"/squashfs", "/tmp_bench_fs"};
+	struct stat st;
+	int count = 0;
+
+	uint64_t start = svcGetSystemTick();
+	for(int round = 0; round < ROUNDS * SMALL_FILES; round++, count++) {
+		if(stat(mountpoints[round % 2], &st) != 0) {
+			printf("bench_fs mountfs: failed to stat %s: %s\n", mountpoints[round % 2], strerror(errno));
+			return 1;
+		}
+	}
+	emit_latency("mountfs", "stat", count, svcGetSystemTick() - start);
+
+	count = 0;
+	start = svcGetSystemTick();
+	for(int round = 0; round < ROUNDS * SMALL_FILES; round++) {
+		DIR *dir = opendir("/");
+		if(dir == NULL) {
+			printf("bench_fs mountfs: failed to open /: %s\n", strerror(errno));
+			return 1;
+		}
+		while(readdir(dir) != NULL) {
+			count++;
+		}
+		closedir(dir);
+	}
+	emit_latency("mountfs", "readdir", count, svcGetSystemTick() - start);
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	backend_t squashfs = {.name = "squashfs", .root = "/squashfs", .writable = false};
+	backend_t tmpfs = {.name = "tmpfs", .root = "/tmp_bench_fs", .writable = true};
+	backend_t fspfs = {.name = "fspfs", .root = "/sd", .writable = true};
+	trn_inode_t tmp;
+	struct stat st;
+	result_t r;
+
+	// the image's copy of big is what every other backend gets
+	int fd = open("/squashfs/" BENCH_DIR "/big", O_RDONLY);
+	if(fd < 0 || read(fd, big, BIG_SIZE) != BIG_SIZE) {
+		printf("bench_fs: failed to read the image's big file\n");
+		return 1;
+	}
+	close(fd);
+
+	if((r = trn_tmpfs_create(&tmp, 0)) != RESULT_OK) {
+		printf("failed to create tmpfs: 0x%x\n", r);
+		return 1;
+	}
+	if((r = trn_fs_mount(tmpfs.root, tmp)) != RESULT_OK) {
+		printf("failed to mount tmpfs: 0x%x\n", r);
+		return 1;
+	}
+	if(populate_tmpfs(tmpfs.root) != 0) {
+		printf("bench_fs: failed to populate tmpfs: %s\n", strerror(errno));
+		return 1;
+	}
+
+	if(bench_backend(&squashfs) != 0 || bench_backend(&tmpfs) != 0 ||
+	   bench_blobfd() != 0 || bench_mountfs() != 0) {
+		return 1;
+	}
+	if(stat("/sd/" BENCH_DIR "/big", &st) != 0) {
+		printf("bench_fs: no prepared tree on the sd card, skipping fspfs\n");
+		return 0;
+	}
+	return bench_backend(&fspfs);
+}
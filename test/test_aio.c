@@ -0,0 +1,300 @@
+#include<libtransistor/types.h>
+#include<libtransistor/svc.h>
+#include<libtransistor/err.h>
+#include<libtransistor/waiter.h>
+#include<libtransistor/aio.h>
+#include<libtransistor/thread.h>
+#include<errno.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<fcntl.h>
+#include<unistd.h>
+
+// The image (see mk/tests.mk) holds one BENCH_SIZE file, "stream".
+#define SQFS_FILE "/squashfs/stream"
+#define SD_FILE "/sd/aio_bench"
+#define BENCH_SIZE (4 * 1024 * 1024)
+#define CHUNK_SIZE (16 * 1024)
+#define QUEUE_DEPTH 16
+#define PREAD_THREADS 4
+#define TICKS_PER_US 19.2
+
+typedef struct {
+	trn_aio_t *aio;
+	trn_aio_request_t requests[QUEUE_DEPTH];
+	uint8_t *expected; // what the file holds, or is to hold
+	off_t next;
+	int outstanding;
+	int errors;
+} bench_t;
+
+static uint8_t chunks[QUEUE_DEPTH][CHUNK_SIZE];
+
+static double mib_per_sec(uint64_t ticks) {
+	double secs = ticks / TICKS_PER_US / 1000000.0;
+	return (BENCH_SIZE / (1024.0 * 1024.0)) / secs;
+}
+
+// Reads the whole file one chunk at a time, waiting for each one.
+static int read_sync(const char *path, uint8_t *out, uint64_t *ticks) {
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		return 1;
+	}
+
+	uint64_t start = svcGetSystemTick();
+	for(off_t off = 0; off < BENCH_SIZE; off += CHUNK_SIZE) {
+		if(pread(fd, out + off, CHUNK_SIZE, off) != CHUNK_SIZE) {
+			perror("pread");
+			close(fd);
+			return 1;
+		}
+	}
+	*ticks = svcGetSystemTick() - start;
+
+	close(fd);
+	return 0;
+}
+
+// Keeps the request going with the next chunk until the whole file has been read.
+static void read_done(trn_aio_request_t *req, void *data) {
+	bench_t *bench = data;
+	uint8_t *expected = bench->expected + req->offset;
+
+	bench->outstanding--;
+	if(req->result != RESULT_OK || req->transferred != CHUNK_SIZE || memcmp(req->buf, expected, CHUNK_SIZE) != 0) {
+		printf("aio: bad read at 0x%lx: result 0x%x, %zu bytes\n", (long) req->offset, req->result, req->transferred);
+		bench->errors++;
+		return;
+	}
+	if(bench->next < BENCH_SIZE) {
+		req->offset = bench->next;
+		if(trn_aio_submit(bench->aio, req) != RESULT_OK) {
+			bench->errors++;
+			return;
+		}
+		bench->next += CHUNK_SIZE;
+		bench->outstanding++;
+	}
+}
+
+// Reads the whole file with QUEUE_DEPTH chunks in flight at all times.
+static int read_async(waiter_t *waiter, const char *path, uint8_t *expected, uint64_t *ticks) {
+	bench_t bench = {.expected = expected};
+	trn_aio_stats_t stats;
+	result_t r;
+
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		perror("open");
+		return 1;
+	}
+	if((r = trn_aio_create(&bench.aio, waiter, TRN_AIO_DEFAULT_WORKERS)) != RESULT_OK) {
+		printf("failed to create aio context: 0x%x\n", r);
+		close(fd);
+		return 1;
+	}
+
+	uint64_t start = svcGetSystemTick();
+	for(int i = 0; i < QUEUE_DEPTH; i++) {
+		trn_aio_request_t *req = &bench.requests[i];
+		req->fd = fd;
+		req->opcode = TRN_AIO_READ;
+		req->buf = chunks[i];
+		req->size = CHUNK_SIZE;
+		req->offset = bench.next;
+		req->callback = read_done;
+		req->data = &bench;
+		if((r = trn_aio_submit(bench.aio, req)) != RESULT_OK) {
+			printf("failed to submit read: 0x%x\n", r);
+			bench.errors++;
+			break;
+		}
+		bench.next += CHUNK_SIZE;
+		bench.outstanding++;
+	}
+	// the requests hold the file open, so it's fine to let go of it now
+	close(fd);
+
+	while(bench.outstanding > 0) {
+		waiter_wait(waiter, 1000000000);
+	}
+	*ticks = svcGetSystemTick() - start;
+
+	trn_aio_get_stats(bench.aio, &stats);
+	printf("aio: %lu requests in %lu backend calls\n", stats.completed, stats.backend_calls);
+	trn_aio_destroy(bench.aio);
+	return bench.errors != 0;
+}
+
+typedef struct {
+	int fd;
+	int index;
+	uint8_t *expected;
+	int errors;
+} pread_thread_t;
+
+// Reads every PREAD_THREADS-th chunk, back to front, so that the threads are
+// all over the file at once instead of following each other through it.
+static void pread_thread(void *arg) {
+	pread_thread_t *t = arg;
+	static uint8_t bufs[PREAD_THREADS][CHUNK_SIZE];
+	uint8_t *buf = bufs[t->index];
+
+	for(off_t off = BENCH_SIZE - (t->index + 1) * CHUNK_SIZE; off >= 0; off -= PREAD_THREADS * CHUNK_SIZE) {
+		if(pread(t->fd, buf, CHUNK_SIZE, off) != CHUNK_SIZE || memcmp(buf, t->expected + off, CHUNK_SIZE) != 0) {
+			t->errors++;
+		}
+	}
+}
+
+// pread may be called from any number of threads at once, which is what the
+// aio workers count on.
+static int read_parallel(const char *label, const char *path, uint8_t *expected) {
+	trn_thread_t threads[PREAD_THREADS];
+	pread_thread_t args[PREAD_THREADS];
+	int started = 0;
+	int errors = 0;
+
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		perror("open");
+		return 1;
+	}
+	for(; started < PREAD_THREADS; started++) {
+		args[started] = (pread_thread_t) {.fd = fd, .index = started, .expected = expected};
+		if(trn_thread_create(&threads[started], pread_thread, &args[started], -1, -2, 0x10000, NULL) != RESULT_OK) {
+			break;
+		}
+		if(trn_thread_start(&threads[started]) != RESULT_OK) {
+			trn_thread_destroy(&threads[started]);
+			break;
+		}
+	}
+	for(int i = 0; i < started; i++) {
+		trn_thread_join(&threads[i], -1);
+		trn_thread_destroy(&threads[i]);
+		errors += args[i].errors;
+	}
+	close(fd);
+
+	if(started < PREAD_THREADS || errors != 0) {
+		printf("aio %s: %d threads, %d bad preads\n", label, started, errors);
+		return 1;
+	}
+	return 0;
+}
+
+static int bench_file(waiter_t *waiter, const char *label, const char *path, uint8_t *expected) {
+	uint64_t sync_ticks, async_ticks;
+
+	if(read_sync(path, expected, &sync_ticks) != 0) {
+		printf("aio %s: failed to read %s\n", label, path);
+		return 1;
+	}
+	if(read_parallel(label, path, expected) != 0 || read_async(waiter, path, expected, &async_ticks) != 0) {
+		return 1;
+	}
+	printf("aio %s: sync: %7.2f MiB/s, qd%d: %7.2f MiB/s (%.2fx)\n", label,
+	       mib_per_sec(sync_ticks), QUEUE_DEPTH, mib_per_sec(async_ticks), (double) sync_ticks / async_ticks);
+	return 0;
+}
+
+static void write_done(trn_aio_request_t *req, void *data) {
+	bench_t *bench = data;
+
+	bench->outstanding--;
+	if(req->result != RESULT_OK || req->transferred != CHUNK_SIZE) {
+		printf("aio: bad write at 0x%lx: result 0x%x, %zu bytes\n", (long) req->offset, req->result, req->transferred);
+		bench->errors++;
+		return;
+	}
+	if(bench->next < BENCH_SIZE) {
+		req->offset = bench->next;
+		req->buf = bench->expected + req->offset;
+		if(trn_aio_submit(bench->aio, req) != RESULT_OK) {
+			bench->errors++;
+			return;
+		}
+		bench->next += CHUNK_SIZE;
+		bench->outstanding++;
+	}
+}
+
+// Writes the file the SD card benchmark reads, QUEUE_DEPTH chunks at a time.
+static int write_sd_file(waiter_t *waiter, uint8_t *contents) {
+	bench_t bench = {.expected = contents};
+
+	int fd = open(SD_FILE, O_WRONLY | O_CREAT | O_TRUNC);
+	if(fd < 0) {
+		return -1;
+	}
+	if(trn_aio_create(&bench.aio, waiter, TRN_AIO_DEFAULT_WORKERS) != RESULT_OK) {
+		close(fd);
+		return 1;
+	}
+	for(int i = 0; i < QUEUE_DEPTH; i++) {
+		trn_aio_request_t *req = &bench.requests[i];
+		req->fd = fd;
+		req->opcode = TRN_AIO_WRITE;
+		req->buf = contents + bench.next;
+		req->size = CHUNK_SIZE;
+		req->offset = bench.next;
+		req->callback = write_done;
+		req->data = &bench;
+		if(trn_aio_submit(bench.aio, req) != RESULT_OK) {
+			bench.errors++;
+			break;
+		}
+		bench.next += CHUNK_SIZE;
+		bench.outstanding++;
+	}
+	close(fd);
+
+	while(bench.outstanding > 0) {
+		waiter_wait(waiter, 1000000000);
+	}
+	trn_aio_destroy(bench.aio);
+	return bench.errors != 0;
+}
+
+int main(int argc, char *argv[]) {
+	static uint8_t expected[BENCH_SIZE];
+	static uint8_t contents[BENCH_SIZE];
+
+	waiter_t *waiter = waiter_create();
+	if(waiter == NULL) {
+		printf("failed to create waiter\n");
+		return 1;
+	}
+
+	if(bench_file(waiter, "squashfs", SQFS_FILE, expected) != 0) {
+		return 1;
+	}
+
+	for(size_t i = 0; i < BENCH_SIZE; i++) {
+		contents[i] = (uint8_t) ((i * 31) ^ (i >> 12));
+	}
+	int r = write_sd_file(waiter, contents);
+	if(r < 0) {
+		printf("aio fspfs: no sd card, skipping\n");
+		waiter_destroy(waiter);
+		return 0;
+	}
+	if(r != 0) {
+		printf("aio fspfs: failed to write %s\n", SD_FILE);
+		return 1;
+	}
+	if(bench_file(waiter, "fspfs", SD_FILE, expected) != 0) {
+		return 1;
+	}
+	if(memcmp(expected, contents, BENCH_SIZE) != 0) {
+		printf("aio fspfs: %s doesn't hold what was written\n", SD_FILE);
+		return 1;
+	}
+	unlink(SD_FILE);
+
+	waiter_destroy(waiter);
+	return 0;
+}
@@ -0,0 +1,175 @@
+#include<libtransistor/types.h>
+#include<libtransistor/svc.h>
+#include<libtransistor/err.h>
+#include<libtransistor/thread.h>
+#include<libtransistor/ipc/bsd.h>
+#include<stdio.h>
+#include<string.h>
+
+/*
+ * iperf, more or less: streams TRANSFER_SIZE bytes over a loopback TCP
+ * connection with bsd initialized with the default buffers, and then with
+ * ones sized for bulk transfers, and reports the throughput of each.
+ */
+#define PORT 5620
+#define TRANSFER_SIZE (32 * 1024 * 1024)
+#define CHUNK_SIZE (64 * 1024)
+#define TICKS_PER_US 19.2
+
+typedef struct {
+	int listener;
+	int error;
+} sender_t;
+
+static uint8_t send_buf[CHUNK_SIZE];
+static uint8_t recv_buf[CHUNK_SIZE];
+
+static void sender_thread(void *arg) {
+	sender_t *sender = arg;
+	size_t sent = 0;
+
+	int fd = bsd_accept(sender->listener, NULL, NULL);
+	if(fd < 0) {
+		sender->error = bsd_errno;
+		return;
+	}
+	while(sent < TRANSFER_SIZE) {
+		int r = bsd_send(fd, send_buf, CHUNK_SIZE, 0);
+		if(r <= 0) {
+			sender->error = bsd_errno;
+			break;
+		}
+		sent+= r;
+	}
+	bsd_close(fd);
+}
+
+static int stream(const char *label, const bsd_config_t *config) {
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(PORT),
+		.sin_addr = {.s_addr = htonl(INADDR_LOOPBACK)},
+	};
+	sender_t sender = {.listener = -1};
+	trn_thread_t thread;
+	size_t received = 0;
+	int fd = -1, ret = 1;
+	result_t r;
+
+	if((r = bsd_init_config(false, LCONFIG_SOCKET_SERVICE_UNSPECIFIED, config, 0)) != RESULT_OK) {
+		printf("failed to init bsd: 0x%x\n", r);
+		return 1;
+	}
+	if(memcmp(bsd_get_config(), config, sizeof(*config)) != 0) {
+		// somebody else initialized bsd first, so this measures their buffers
+		printf("bsd_config %s: bsd was already initialized with another configuration\n", label);
+	}
+
+	sender.listener = bsd_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if(sender.listener < 0 ||
+	   bsd_bind(sender.listener, (struct sockaddr*) &addr, sizeof(addr)) < 0 ||
+	   bsd_listen(sender.listener, 1) < 0) {
+		printf("failed to listen: 0x%x, %d\n", bsd_result, bsd_errno);
+		goto done;
+	}
+	if(trn_thread_create(&thread, sender_thread, &sender, -1, -2, 0x10000, NULL) != RESULT_OK) {
+		printf("failed to create sender thread\n");
+		goto done;
+	}
+	if(trn_thread_start(&thread) != RESULT_OK) {
+		printf("failed to start sender thread\n");
+		trn_thread_destroy(&thread);
+		goto done;
+	}
+
+	fd = bsd_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if(fd < 0 || bsd_connect(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+		printf("failed to connect: 0x%x, %d\n", bsd_result, bsd_errno);
+	} else {
+		uint64_t start = svcGetSystemTick();
+		int n;
+		while((n = bsd_recv(fd, recv_buf, sizeof(recv_buf), 0)) > 0) {
+			received+= n;
+		}
+		uint64_t ticks = svcGetSystemTick() - start;
+		if(received == TRANSFER_SIZE) {
+			printf("bsd_config %s: tcp %#x/%#x (max %#x/%#x), %#zx transfer memory: %.2f MiB/s\n", label,
+			       config->tcp_tx_buf_size, config->tcp_rx_buf_size,
+			       config->tcp_tx_buf_max_size, config->tcp_rx_buf_max_size, bsd_config_transfer_mem_size(config),
+			       (TRANSFER_SIZE / (1024.0 * 1024.0)) / (ticks / TICKS_PER_US / 1000000.0));
+			ret = 0;
+		}
+	}
+	if(fd >= 0) {
+		bsd_close(fd);
+	}
+	trn_thread_join(&thread, -1);
+	trn_thread_destroy(&thread);
+	if(ret != 0 || sender.error != 0) {
+		printf("bsd_config %s: received %zu bytes, sender error %d\n", label, received, sender.error);
+		ret = 1;
+	}
+
+done:
+	if(sender.listener >= 0) {
+		bsd_close(sender.listener);
+	}
+	bsd_finalize();
+	return ret;
+}
+
+static int expect_invalid(const char *what, const bsd_config_t *config, size_t transfer_mem_size) {
+	result_t r = bsd_init_config(false, LCONFIG_SOCKET_SERVICE_UNSPECIFIED, config, transfer_mem_size);
+	if(r != LIBTRANSISTOR_ERR_INVALID_ARGUMENT) {
+		printf("bsd_config: %s gave 0x%x\n", what, r);
+		if(r == RESULT_OK) {
+			bsd_finalize();
+		}
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	const bsd_config_t defaults = BSD_CONFIG_DEFAULT;
+	bsd_config_t config;
+	int failures = 0;
+
+	config = defaults;
+	config.version = 2;
+	failures+= expect_invalid("unknown version", &config, 0);
+	config = defaults;
+	config.udp_rx_buf_size = 0;
+	failures+= expect_invalid("empty buffer", &config, 0);
+	config = defaults;
+	config.tcp_rx_buf_max_size = config.tcp_rx_buf_size - 1;
+	failures+= expect_invalid("maximum under initial size", &config, 0);
+	config = defaults;
+	config.sb_efficiency = 9;
+	failures+= expect_invalid("sb_efficiency of 9", &config, 0);
+	failures+= expect_invalid("unaligned transfer memory", &defaults, 0x1001);
+	if(failures != 0) {
+		return 1;
+	}
+
+	if(bsd_config_transfer_mem_size(&defaults) != 0x234000) {
+		printf("bsd_config: default configuration needs %#zx transfer memory\n", bsd_config_transfer_mem_size(&defaults));
+		return 1;
+	}
+
+	for(size_t i = 0; i < sizeof(send_buf); i++) {
+		send_buf[i] = i * 31;
+	}
+	if(stream("default", &defaults) != 0) {
+		return 1;
+	}
+	config = defaults;
+	config.tcp_tx_buf_size = 0x20000;
+	config.tcp_rx_buf_size = 0x20000;
+	config.tcp_tx_buf_max_size = 0x100000;
+	config.tcp_rx_buf_max_size = 0x100000;
+	if(stream("bulk", &config) != 0) {
+		return 1;
+	}
+	return 0;
+}
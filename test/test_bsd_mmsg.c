@@ -0,0 +1,153 @@
+#include<libtransistor/types.h>
+#include<libtransistor/svc.h>
+#include<libtransistor/err.h>
+#include<libtransistor/ipc/bsd.h>
+#include<errno.h>
+#include<stdio.h>
+#include<string.h>
+
+/*
+ * Moves small datagrams over loopback, one call per datagram and then in
+ * batches, and reports packets per second for each. Every round sends BATCH
+ * datagrams to a socket and then reads them all back, so none get dropped
+ * for lack of buffer space; only the side being measured is timed.
+ */
+#define PORT 5630
+#define BATCH 32
+#define ROUNDS 200
+#define PACKET_SIZE 64
+#define TICKS_PER_US 19.2
+
+static uint8_t packets[BATCH][PACKET_SIZE];
+static uint8_t received[BATCH][PACKET_SIZE];
+static bsd_datagram_t msgs[BATCH];
+
+static struct sockaddr_in addr;
+
+static int send_round(int fd, bool batched) {
+	if(batched) {
+		for(int i = 0; i < BATCH; i++) {
+			msgs[i] = (bsd_datagram_t) {
+				.buf = packets[i], .len = PACKET_SIZE,
+				.addr = (struct sockaddr*) &addr, .addr_len = sizeof(addr),
+			};
+		}
+		return bsd_sendmmsg(fd, msgs, BATCH, 0);
+	}
+	for(int i = 0; i < BATCH; i++) {
+		if(bsd_sendto(fd, packets[i], PACKET_SIZE, 0, (struct sockaddr*) &addr, sizeof(addr)) != PACKET_SIZE) {
+			return i;
+		}
+	}
+	return BATCH;
+}
+
+// Receives a round, checking that every datagram that was sent turns up
+// once, in whatever order.
+static int recv_round(int fd, bool batched) {
+	uint32_t seen = 0;
+	int got = 0;
+
+	while(got < BATCH) {
+		int n;
+		if(batched) {
+			for(int i = 0; i < BATCH - got; i++) {
+				msgs[i] = (bsd_datagram_t) {.buf = received[got + i], .len = PACKET_SIZE};
+			}
+			if((n = bsd_recvmmsg(fd, msgs, BATCH - got, 0)) < 0) {
+				return got;
+			}
+			for(int i = 0; i < n; i++) {
+				if(msgs[i].result != PACKET_SIZE) {
+					return got;
+				}
+				if(msgs[i].buf != received[got + i]) {
+					memcpy(received[got + i], msgs[i].buf, PACKET_SIZE);
+				}
+			}
+		} else {
+			if(bsd_recv(fd, received[got], PACKET_SIZE, 0) != PACKET_SIZE) {
+				return got;
+			}
+			n = 1;
+		}
+		for(int i = got; i < got + n; i++) {
+			int index = received[i][0];
+			if(index >= BATCH || memcmp(received[i], packets[index], PACKET_SIZE) != 0 || (seen & (1u << index))) {
+				printf("bsd_mmsg: got a datagram that wasn't sent, or twice\n");
+				return -1;
+			}
+			seen|= 1u << index;
+		}
+		got+= n;
+	}
+	return got;
+}
+
+static int bench(int fd, bool batched, uint64_t *send_ticks, uint64_t *recv_ticks) {
+	*send_ticks = 0;
+	*recv_ticks = 0;
+	for(int round = 0; round < ROUNDS; round++) {
+		uint64_t start = svcGetSystemTick();
+		int sent = send_round(fd, batched);
+		uint64_t middle = svcGetSystemTick();
+		int got = recv_round(fd, batched);
+		uint64_t end = svcGetSystemTick();
+		if(sent != BATCH || got != BATCH) {
+			printf("bsd_mmsg: sent %d, received %d of %d: 0x%x, %d\n", sent, got, BATCH, bsd_result, bsd_errno);
+			return 1;
+		}
+		*send_ticks+= middle - start;
+		*recv_ticks+= end - middle;
+	}
+	return 0;
+}
+
+static double pps(uint64_t ticks) {
+	return (ROUNDS * BATCH) / (ticks / TICKS_PER_US / 1000000.0);
+}
+
+int main(int argc, char *argv[]) {
+	uint64_t single_send, single_recv, batch_send, batch_recv;
+	result_t r;
+
+	addr = (struct sockaddr_in) {
+		.sin_family = AF_INET,
+		.sin_port = htons(PORT),
+		.sin_addr = {.s_addr = htonl(INADDR_LOOPBACK)},
+	};
+	if((r = bsd_init()) != RESULT_OK) {
+		printf("failed to init bsd: 0x%x\n", r);
+		return 1;
+	}
+	int fd = bsd_socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if(fd < 0 || bsd_bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+		printf("failed to bind: 0x%x, %d\n", bsd_result, bsd_errno);
+		return 1;
+	}
+	for(int i = 0; i < BATCH; i++) {
+		packets[i][0] = i;
+		for(int j = 1; j < PACKET_SIZE; j++) {
+			packets[i][j] = i * 7 + j;
+		}
+	}
+
+	// nothing waiting: recvmmsg gives up straight away when asked not to wait
+	msgs[0] = (bsd_datagram_t) {.buf = received[0], .len = PACKET_SIZE};
+	if(bsd_recvmmsg(fd, msgs, 1, MSG_DONTWAIT) != -1 || bsd_errno != EAGAIN) {
+		printf("bsd_mmsg: recvmmsg on an empty socket gave %d\n", bsd_errno);
+		return 1;
+	}
+
+	if(bench(fd, false, &single_send, &single_recv) != 0 || bench(fd, true, &batch_send, &batch_recv) != 0) {
+		return 1;
+	}
+	printf("bsd_mmsg: send: %.0f pps one at a time, %.0f pps in batches of %d (%.2fx)\n",
+	       pps(single_send), pps(batch_send), BATCH, (double) single_send / batch_send);
+	printf("bsd_mmsg: recv: %.0f pps one at a time, %.0f pps in batches of %d (%.2fx)\n",
+	       pps(single_recv), pps(batch_recv), BATCH, (double) single_recv / batch_recv);
+
+	bsd_close(fd);
+	bsd_finalize();
+	return 0;
+}
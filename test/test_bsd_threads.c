@@ -0,0 +1,178 @@
+#include<libtransistor/nx.h>
+
+#include<sys/socket.h>
+#include<netinet/in.h>
+#include<errno.h>
+#include<stdio.h>
+#include<string.h>
+#include<unistd.h>
+
+/*
+ * Several threads use sockets at once: some bounce datagrams off themselves
+ * over loopback, and the others keep making calls that fail, each kind of
+ * thread with a different errno. Every failing thread checks that the error
+ * it sees is its own, which it wouldn't be if another thread's failure could
+ * land in between.
+ */
+#define THREADS 6
+#define ITERATIONS 200
+#define BASE_PORT 5600
+// nothing listens here
+#define REFUSED_PORT 5599
+// far past any socket this test opens
+#define BAD_FD 1000
+#define TICKS_PER_US 19.2
+
+typedef enum {
+	ROLE_TRAFFIC,
+	ROLE_BAD_FD,
+	ROLE_REFUSED,
+} role_t;
+
+typedef struct {
+	int index;
+	role_t role;
+	int failures;
+} worker_t;
+
+static struct sockaddr_in loopback(int port) {
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr = {.s_addr = htonl(INADDR_LOOPBACK)},
+	};
+	return addr;
+}
+
+static void traffic(worker_t *w) {
+	struct sockaddr_in addr = loopback(BASE_PORT + w->index);
+	char message[32], response[32];
+
+	int fd = bsd_socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if(fd < 0 || bsd_bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+		printf("thread %d: failed to set up socket: 0x%x, %d\n", w->index, bsd_result, bsd_errno);
+		w->failures++;
+		return;
+	}
+	for(int i = 0; i < ITERATIONS; i++) {
+		int len = snprintf(message, sizeof(message), "thread %d, %d", w->index, i);
+		if(bsd_sendto(fd, message, len, 0, (struct sockaddr*) &addr, sizeof(addr)) != len) {
+			printf("thread %d: sendto failed: 0x%x, %d\n", w->index, bsd_result, bsd_errno);
+			w->failures++;
+			break;
+		}
+		if(bsd_recv(fd, response, sizeof(response), 0) != len || memcmp(message, response, len) != 0) {
+			printf("thread %d: got back something else: 0x%x, %d\n", w->index, bsd_result, bsd_errno);
+			w->failures++;
+			break;
+		}
+	}
+	bsd_close(fd);
+}
+
+static void bad_fd(worker_t *w) {
+	for(int i = 0; i < ITERATIONS; i++) {
+		if(bsd_send(BAD_FD, "x", 1, 0) >= 0) {
+			printf("thread %d: send on a socket that doesn't exist worked\n", w->index);
+			w->failures++;
+		} else if(bsd_result != LIBTRANSISTOR_ERR_BSD_ERRNO_SET || bsd_errno != EBADF) {
+			printf("thread %d: send on a socket that doesn't exist gave 0x%x, %d\n", w->index, bsd_result, bsd_errno);
+			w->failures++;
+		}
+	}
+}
+
+static void refused(worker_t *w) {
+	struct sockaddr_in addr = loopback(REFUSED_PORT);
+
+	for(int i = 0; i < ITERATIONS; i++) {
+		// through the POSIX wrappers, which hand bsd_errno on to errno
+		int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if(fd < 0) {
+			w->failures++;
+			return;
+		}
+		if(connect(fd, (struct sockaddr*) &addr, sizeof(addr)) == 0) {
+			printf("thread %d: connected to a port nothing listens on\n", w->index);
+			w->failures++;
+		} else if(errno != ECONNREFUSED || bsd_errno != ECONNREFUSED) {
+			printf("thread %d: refused connect gave errno %d, bsd_errno %d\n", w->index, errno, bsd_errno);
+			w->failures++;
+		}
+		close(fd);
+	}
+}
+
+static void worker_thread(void *arg) {
+	worker_t *w = arg;
+	switch(w->role) {
+	case ROLE_TRAFFIC:
+		traffic(w);
+		break;
+	case ROLE_BAD_FD:
+		bad_fd(w);
+		break;
+	case ROLE_REFUSED:
+		refused(w);
+		break;
+	}
+}
+
+static int run(int count, bool traffic_only, uint64_t *ticks) {
+	trn_thread_t threads[THREADS];
+	worker_t workers[THREADS];
+	int started, failures = 0;
+	result_t r = RESULT_OK;
+
+	uint64_t start = svcGetSystemTick();
+	for(started = 0; started < count; started++) {
+		workers[started] = (worker_t) {
+			.index = started,
+			.role = traffic_only ? ROLE_TRAFFIC : (role_t) (started % 3),
+		};
+		if((r = trn_thread_create(&threads[started], worker_thread, &workers[started], -1, -2, 0x10000, NULL)) != RESULT_OK) {
+			break;
+		}
+		if((r = trn_thread_start(&threads[started])) != RESULT_OK) {
+			trn_thread_destroy(&threads[started]);
+			break;
+		}
+	}
+	for(int i = 0; i < started; i++) {
+		trn_thread_join(&threads[i], -1);
+		trn_thread_destroy(&threads[i]);
+		failures+= workers[i].failures;
+	}
+	*ticks = svcGetSystemTick() - start;
+	if(r != RESULT_OK) {
+		printf("failed to start thread: 0x%x\n", r);
+		return 1;
+	}
+	return failures != 0;
+}
+
+int main(int argc, char *argv[]) {
+	uint64_t one_ticks, many_ticks, ignored;
+	result_t r;
+
+	if((r = bsd_init()) != RESULT_OK) {
+		printf("failed to init bsd: 0x%x\n", r);
+		return 1;
+	}
+
+	if(run(1, true, &one_ticks) != 0 || run(THREADS, true, &many_ticks) != 0) {
+		bsd_finalize();
+		return 1;
+	}
+	printf("bsd_threads: 1 thread: %.2f us/round trip, %d threads: %.2f us/round trip\n",
+	       one_ticks / TICKS_PER_US / ITERATIONS, THREADS, many_ticks / TICKS_PER_US / (ITERATIONS * THREADS));
+
+	if(run(THREADS, false, &ignored) != 0) {
+		printf("bsd_threads: threads saw each other's errors\n");
+		bsd_finalize();
+		return 1;
+	}
+
+	bsd_finalize();
+	return 0;
+}
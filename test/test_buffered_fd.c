@@ -0,0 +1,215 @@
+#include<libtransistor/types.h>
+#include<libtransistor/svc.h>
+#include<libtransistor/err.h>
+#include<libtransistor/fd.h>
+#include<libtransistor/mutex.h>
+#include<libtransistor/buffered_fd.h>
+#include<libtransistor/ipc/bsd.h>
+#include<stdio.h>
+#include<string.h>
+#include<unistd.h>
+#include<sys/socket.h>
+#include<netinet/in.h>
+
+/*
+ * Buffers writes to a file that counts what gets written to it, and checks
+ * when the writes make it through. Then writes the same lines to a loopback
+ * socket directly and through a buffered fd, and reports how long each takes.
+ */
+#define PORT 5611
+#define LINES 1000
+#define TICKS_PER_US 19.2
+#define MS 1000000ull
+
+static trn_mutex_t sink_lock = TRN_MUTEX_STATIC_INITIALIZER;
+static char sink[0x4000];
+static size_t sink_length;
+static int sink_writes;
+
+static result_t sink_write(void *data, const void *buf, size_t size, size_t *bytes_written) {
+	trn_mutex_lock(&sink_lock);
+	if(sink_length + size > sizeof(sink)) {
+		size = sizeof(sink) - sink_length;
+	}
+	memcpy(sink + sink_length, buf, size);
+	sink_length+= size;
+	sink_writes++;
+	trn_mutex_unlock(&sink_lock);
+	*bytes_written = size;
+	return RESULT_OK;
+}
+
+static trn_file_ops_t sink_ops = {
+	.write = sink_write,
+};
+
+static size_t sink_take(int *writes) {
+	trn_mutex_lock(&sink_lock);
+	size_t length = sink_length;
+	if(writes != NULL) {
+		*writes = sink_writes;
+	}
+	sink_length = 0;
+	sink_writes = 0;
+	trn_mutex_unlock(&sink_lock);
+	return length;
+}
+
+static int test_triggers() {
+	trn_buffered_fd_config_t config = {
+		.buffer_size = 0x100,
+		.max_delay_us = 50000,
+		.newline_idle_us = 5000,
+	};
+	char line[16];
+	int writes;
+	int ret = 1;
+
+	int sink_fd = fd_create_file(&sink_ops, NULL);
+	if(sink_fd < 0) {
+		printf("buffered_fd: failed to create sink: %d\n", sink_fd);
+		return 1;
+	}
+	int fd = trn_buffered_fd_create(sink_fd, &config);
+	close(sink_fd);
+	if(fd < 0) {
+		printf("buffered_fd: failed to create buffered fd: %d\n", fd);
+		return 1;
+	}
+
+	// a burst of lines goes out in buffer-sized pieces, the rest shortly after
+	for(int i = 0; i < 100; i++) {
+		snprintf(line, sizeof(line), "line %02d\n", i);
+		write(fd, line, 8);
+	}
+	svcSleepThread(20 * MS);
+	if(sink_take(&writes) != 800 || writes > 4) {
+		printf("buffered_fd: burst came out as %d writes\n", writes);
+		goto done;
+	}
+
+	// a partial line waits for max_delay_us
+	write(fd, "partial", 7);
+	svcSleepThread(20 * MS);
+	if(sink_take(NULL) != 0) {
+		printf("buffered_fd: partial line went out early\n");
+		goto done;
+	}
+	svcSleepThread(60 * MS);
+	if(sink_take(NULL) != 7) {
+		printf("buffered_fd: partial line never went out\n");
+		goto done;
+	}
+
+	// fsync doesn't wait at all, and big writes go straight through
+	write(fd, "sync", 4);
+	if(fsync(fd) != 0 || sink_take(NULL) != 4) {
+		printf("buffered_fd: fsync didn't write out\n");
+		goto done;
+	}
+	static char big[0x200];
+	write(fd, "x", 1);
+	if(write(fd, big, sizeof(big)) != sizeof(big) || sink_take(&writes) != sizeof(big) + 1 || writes != 2) {
+		printf("buffered_fd: big write didn't go through\n");
+		goto done;
+	}
+
+	// closing writes out what's left
+	write(fd, "bye", 3);
+	close(fd);
+	fd = -1;
+	if(sink_take(NULL) != 3) {
+		printf("buffered_fd: close didn't write out\n");
+		goto done;
+	}
+	ret = 0;
+done:
+	if(fd >= 0) {
+		close(fd);
+	}
+	return ret;
+}
+
+static int bench(int fd, int drain, uint64_t *ticks) {
+	char line[32], buf[0x1000];
+	size_t total = 0;
+
+	uint64_t start = svcGetSystemTick();
+	for(int i = 0; i < LINES; i++) {
+		int len = snprintf(line, sizeof(line), "log line %04d\n", i);
+		if(write(fd, line, len) != len) {
+			perror("buffered_fd: write");
+			return 1;
+		}
+	}
+	if(fsync(fd) != 0) {
+		perror("buffered_fd: fsync");
+		return 1;
+	}
+	*ticks = svcGetSystemTick() - start;
+
+	while(total < LINES * 14) {
+		ssize_t r = recv(drain, buf, sizeof(buf), 0);
+		if(r <= 0) {
+			perror("buffered_fd: recv");
+			return 1;
+		}
+		total+= r;
+	}
+	return 0;
+}
+
+static int test_socket() {
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(PORT),
+		.sin_addr = {.s_addr = htonl(INADDR_LOOPBACK)},
+	};
+	trn_buffered_fd_config_t config = TRN_BUFFERED_FD_CONFIG_DEFAULT;
+	uint64_t direct_ticks, buffered_ticks;
+	int listener, client, server, buffered;
+	int ret = 1;
+
+	if((listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0 ||
+	   bind(listener, (struct sockaddr*) &addr, sizeof(addr)) != 0 ||
+	   listen(listener, 1) != 0 ||
+	   (client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0 ||
+	   connect(client, (struct sockaddr*) &addr, sizeof(addr)) != 0 ||
+	   (server = accept(listener, NULL, NULL)) < 0) {
+		perror("buffered_fd: connect");
+		return 1;
+	}
+	if((buffered = trn_buffered_fd_create(client, &config)) < 0) {
+		printf("buffered_fd: failed to buffer socket: %d\n", buffered);
+		goto done;
+	}
+	if(bench(client, server, &direct_ticks) != 0 || bench(buffered, server, &buffered_ticks) != 0) {
+		goto done_buffered;
+	}
+	printf("buffered_fd: %.2f us/line direct, %.2f us/line buffered\n",
+	       direct_ticks / TICKS_PER_US / LINES, buffered_ticks / TICKS_PER_US / LINES);
+	ret = 0;
+done_buffered:
+	close(buffered);
+done:
+	close(server);
+	close(client);
+	close(listener);
+	return ret;
+}
+
+int main(int argc, char *argv[]) {
+	result_t r;
+
+	if(test_triggers() != 0) {
+		return 1;
+	}
+
+	if((r = bsd_init()) != RESULT_OK) {
+		printf("failed to init bsd: 0x%x\n", r);
+		return 1;
+	}
+	int ret = test_socket();
+	bsd_finalize();
+	return ret;
+}
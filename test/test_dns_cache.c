@@ -0,0 +1,123 @@
+#include<libtransistor/types.h>
+#include<libtransistor/svc.h>
+#include<libtransistor/err.h>
+#include<libtransistor/ipc/bsd.h>
+#include<stdio.h>
+#include<string.h>
+
+/*
+ * Looks the same name up over and over, with the DNS cache and with it
+ * flushed before every lookup, and reports how long a lookup takes each way.
+ * Along the way, checks that cached chains are shared and survive a flush,
+ * and that names that don't resolve are remembered too.
+ */
+#define HOST "localhost"
+#define MISSING_HOST "nonexistent.invalid"
+#define ROUNDS 100
+#define TICKS_PER_US 19.2
+
+static struct addrinfo hints = {
+	.ai_family = AF_INET,
+	.ai_socktype = SOCK_STREAM,
+};
+
+static int bench(bool cached, uint64_t *ticks) {
+	struct addrinfo *ai;
+
+	uint64_t start = svcGetSystemTick();
+	for(int i = 0; i < ROUNDS; i++) {
+		if(!cached) {
+			bsd_dns_cache_flush();
+		}
+		int e = bsd_getaddrinfo(HOST, "80", &hints, &ai);
+		if(e != 0) {
+			printf("dns_cache: failed to look %s up: %d, 0x%x\n", HOST, e, bsd_result);
+			return 1;
+		}
+		bsd_freeaddrinfo(ai);
+	}
+	*ticks = svcGetSystemTick() - start;
+	return 0;
+}
+
+static int test_sharing() {
+	struct addrinfo *first, *second, *third;
+	struct addrinfo_fixed fixed[2];
+	int ret = 1;
+
+	if(bsd_getaddrinfo(HOST, "80", &hints, &first) != 0) {
+		printf("dns_cache: failed to look %s up: 0x%x\n", HOST, bsd_result);
+		return 1;
+	}
+	if(bsd_getaddrinfo(HOST, "80", &hints, &second) != 0) {
+		printf("dns_cache: second lookup failed: 0x%x\n", bsd_result);
+		goto done_first;
+	}
+	if(second != first) {
+		printf("dns_cache: second lookup wasn't served from the cache\n");
+		goto done_second;
+	}
+	if(bsd_getaddrinfo_fixed(HOST, "80", &hints, fixed, 2) != 0 ||
+	   fixed[0].ai.ai_addr != (struct sockaddr*) &fixed[0].addr ||
+	   memcmp(fixed[0].ai.ai_addr, first->ai_addr, first->ai_addrlen) != 0) {
+		printf("dns_cache: fixed lookup didn't match\n");
+		goto done_second;
+	}
+
+	// flushing mustn't pull the chains out from under whoever has them
+	bsd_dns_cache_flush();
+	if(bsd_getaddrinfo(HOST, "80", &hints, &third) != 0) {
+		printf("dns_cache: lookup after flush failed: 0x%x\n", bsd_result);
+		goto done_second;
+	}
+	if(third == first || first->ai_family != AF_INET ||
+	   memcmp(third->ai_addr, first->ai_addr, first->ai_addrlen) != 0) {
+		printf("dns_cache: lookup after flush didn't come out fresh\n");
+	} else {
+		ret = 0;
+	}
+	bsd_freeaddrinfo(third);
+done_second:
+	bsd_freeaddrinfo(second);
+done_first:
+	bsd_freeaddrinfo(first);
+	return ret;
+}
+
+static int test_negative() {
+	struct addrinfo *ai;
+
+	uint64_t start = svcGetSystemTick();
+	int first = bsd_getaddrinfo(MISSING_HOST, "80", &hints, &ai);
+	uint64_t middle = svcGetSystemTick();
+	int second = bsd_getaddrinfo(MISSING_HOST, "80", &hints, &ai);
+	uint64_t end = svcGetSystemTick();
+
+	if(first <= 0 || second != first) {
+		printf("dns_cache: %s resolved to %d, then %d\n", MISSING_HOST, first, second);
+		return 1;
+	}
+	printf("dns_cache: %s: %.2f us, then %.2f us from the cache\n", MISSING_HOST,
+	       (middle - start) / TICKS_PER_US, (end - middle) / TICKS_PER_US);
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	uint64_t cached_ticks, uncached_ticks;
+	result_t r;
+
+	if((r = bsd_init()) != RESULT_OK) {
+		printf("failed to init bsd: 0x%x\n", r);
+		return 1;
+	}
+	if(test_sharing() != 0 || test_negative() != 0 ||
+	   bench(false, &uncached_ticks) != 0 || bench(true, &cached_ticks) != 0) {
+		bsd_finalize();
+		return 1;
+	}
+	printf("dns_cache: %.2f us/lookup through sfdnsres, %.2f us/lookup cached\n",
+	       uncached_ticks / TICKS_PER_US / ROUNDS, cached_ticks / TICKS_PER_US / ROUNDS);
+
+	bsd_finalize();
+	return 0;
+}
@@ -1,6 +1,7 @@
 #include<libtransistor/err.h>
 #include<libtransistor/fs/inode.h>
 #include<libtransistor/fs/fs.h>
+#include<libtransistor/fs/dcache.h>
 
 #include<stdio.h>
 #include<string.h>
@@ -101,6 +102,8 @@ int main(int argc, char *argv[]) {
 	ASSERT_OK(fail, trn_fs_realpath("/foo/bar/../baz", &resolved_path));
 	printf("realpath -> %s\n", resolved_path);
 
+	// the dentry cache holds on to inodes until it's told to let go of them
+	trn_dcache_flush();
 	if(global_inode_count != 0) {
 		printf("resources were leaked\n");
 		return 2;
@@ -108,12 +111,14 @@ int main(int argc, char *argv[]) {
 	
 	ASSERT_OK(fail, trn_fs_chdir("/a/b/c/"));
 	printf("chdir'd\n");
+	trn_dcache_flush();
 	if(global_inode_count != 3) {
 		printf("resources were leaked\n");
 		return 2;
 	}
 	ASSERT_OK(fail, trn_fs_realpath("../c/foo/bar/../baz", &resolved_path));
 	printf("realpath -> %s\n", resolved_path);
+	trn_dcache_flush();
 	if(global_inode_count != 3) {
 		printf("resources were leaked\n");
 		return 2;
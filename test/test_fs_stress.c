@@ -3,6 +3,8 @@
 #include<libtransistor/fs/inode.h>
 #include<libtransistor/fs/squashfs.h>
 #include<libtransistor/fs/fs.h>
+#include<libtransistor/fs/dcache.h>
+#include<libtransistor/svc.h>
 #include<errno.h>
 #include<stdio.h>
 #include<dirent.h>
@@ -92,7 +94,81 @@ int listdir(const char *name, int indent)
 	return ret;
 }
 
+#define BENCH_ITERATIONS 1000
+#define TICKS_PER_US 19.2
+
+static uint64_t bench_stat(const char *path) {
+	struct stat st;
+	uint64_t start = svcGetSystemTick();
+	for (int i = 0; i < BENCH_ITERATIONS; i++) {
+		stat(path, &st);
+	}
+	return svcGetSystemTick() - start;
+}
+
+// Compare path resolution with and without the dentry cache.
+void bench_dcache(const char *path) {
+	trn_dcache_stats_t stats;
+
+	trn_dcache_set_limit(0);
+	uint64_t uncached = bench_stat(path);
+
+	trn_dcache_set_limit(TRN_DCACHE_DEFAULT_LIMIT);
+	trn_dcache_reset_stats();
+	uint64_t cached = bench_stat(path);
+	trn_dcache_get_stats(&stats);
+
+	uint64_t lookups = stats.hits + stats.negative_hits + stats.misses;
+	printf("dcache: stat(\"%s\") x%d: uncached %.2f us/op, cached %.2f us/op\n", path, BENCH_ITERATIONS,
+	       uncached / TICKS_PER_US / BENCH_ITERATIONS, cached / TICKS_PER_US / BENCH_ITERATIONS);
+	printf("dcache:   %lu hits, %lu negative hits, %lu misses (%.1f%% hit rate), %zu entries\n",
+	       stats.hits, stats.negative_hits, stats.misses,
+	       lookups ? 100.0 * (stats.hits + stats.negative_hits) / lookups : 0.0, stats.entries);
+}
+
+#define READDIR_BATCH 64
+
+// List a directory with readdir and with trn_fs_readdir_batch, and make sure
+// they agree.
+int bench_readdir(const char *path) {
+	static trn_dirent_t dirents[READDIR_BATCH];
+	trn_dir_t dir;
+	DIR *dirp;
+	size_t single = 0, batched = 0, read;
+	result_t r;
+
+	uint64_t start = svcGetSystemTick();
+	if (!(dirp = opendir(path)))
+		return 1;
+	while (readdir(dirp) != NULL)
+		single++;
+	closedir(dirp);
+	uint64_t single_ticks = svcGetSystemTick() - start;
+
+	start = svcGetSystemTick();
+	if (trn_fs_opendir(&dir, path) != RESULT_OK)
+		return 1;
+	while ((r = trn_fs_readdir_batch(&dir, dirents, READDIR_BATCH, &read)) == RESULT_OK && read > 0)
+		batched += read;
+	if (dir.ops->close != NULL)
+		dir.ops->close(dir.data);
+	uint64_t batched_ticks = svcGetSystemTick() - start;
+
+	printf("readdir(\"%s\"): %zu entries in %.2f us, batched %zu entries in %.2f us\n", path,
+	       single, single_ticks / TICKS_PER_US, batched, batched_ticks / TICKS_PER_US);
+	return r != RESULT_OK || single != batched;
+}
+
 // Read every file into a buffer.
 int main(int argc, char *argv[]) {
-	return listdir("/", 0);
+	int ret = listdir("/", 0);
+
+	bench_dcache("/squashfs/empty_file");
+	bench_dcache("/sd/test_file");
+	bench_dcache("/sd/does/not/exist");
+
+	ret|= bench_readdir("/sd");
+	ret|= bench_readdir("/squashfs");
+
+	return ret;
 }
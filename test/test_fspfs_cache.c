@@ -0,0 +1,160 @@
+#include<libtransistor/types.h>
+#include<libtransistor/svc.h>
+#include<libtransistor/fs/fspfs.h>
+#include<errno.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/stat.h>
+
+#define BENCH_FILE "/sd/fspfs_cache_bench"
+#define BENCH_FILE_SIZE (4 * 1024 * 1024)
+#define TICKS_PER_US 19.2
+
+static uint8_t pattern(size_t offset) {
+	return (uint8_t) ((offset * 31) ^ (offset >> 12));
+}
+
+static double mib_per_sec(uint64_t ticks) {
+	double secs = ticks / TICKS_PER_US / 1000000.0;
+	return (BENCH_FILE_SIZE / (1024.0 * 1024.0)) / secs;
+}
+
+// Writes the file sequentially in chunk-sized pieces, including the fsync.
+static int bench_write(uint8_t *buf, size_t chunk, uint64_t *ticks) {
+	int fd = open(BENCH_FILE, O_WRONLY | O_CREAT | O_TRUNC);
+	if (fd < 0) {
+		perror("open");
+		return 1;
+	}
+
+	uint64_t start = svcGetSystemTick();
+	for (size_t off = 0; off < BENCH_FILE_SIZE; off += chunk) {
+		for (size_t i = 0; i < chunk; i++) {
+			buf[i] = pattern(off + i);
+		}
+		if (write(fd, buf, chunk) != (ssize_t) chunk) {
+			perror("write");
+			close(fd);
+			return 1;
+		}
+	}
+	if (fsync(fd) != 0) {
+		perror("fsync");
+		close(fd);
+		return 1;
+	}
+	*ticks = svcGetSystemTick() - start;
+
+	close(fd);
+	return 0;
+}
+
+// stat, fstat and SEEK_END should all agree on the size we just wrote.
+static int check_size(int fd) {
+	struct stat st;
+
+	if (stat(BENCH_FILE, &st) != 0 || st.st_size != BENCH_FILE_SIZE) {
+		printf("stat: expected size %d, got %ld\n", BENCH_FILE_SIZE, (long) st.st_size);
+		return 1;
+	}
+	if (fstat(fd, &st) != 0 || st.st_size != BENCH_FILE_SIZE) {
+		printf("fstat: expected size %d, got %ld\n", BENCH_FILE_SIZE, (long) st.st_size);
+		return 1;
+	}
+	off_t end = lseek(fd, 0, SEEK_END);
+	if (end != BENCH_FILE_SIZE || lseek(fd, 0, SEEK_SET) != 0) {
+		printf("lseek: expected size %d, got %ld\n", BENCH_FILE_SIZE, (long) end);
+		return 1;
+	}
+	return 0;
+}
+
+// Reads the file back sequentially in chunk-sized pieces, and checks it.
+static int bench_read(uint8_t *buf, size_t chunk, uint64_t *ticks) {
+	uint64_t elapsed = 0;
+	int fd = open(BENCH_FILE, O_RDONLY);
+	if (fd < 0) {
+		perror("open");
+		return 1;
+	}
+
+	if (check_size(fd) != 0) {
+		close(fd);
+		return 1;
+	}
+
+	for (size_t off = 0; off < BENCH_FILE_SIZE; off += chunk) {
+		uint64_t start = svcGetSystemTick();
+		ssize_t r = read(fd, buf, chunk);
+		elapsed += svcGetSystemTick() - start;
+		if (r != (ssize_t) chunk) {
+			printf("read: expected %zu bytes, got %zd (errno %d)\n", chunk, r, errno);
+			close(fd);
+			return 1;
+		}
+		for (size_t i = 0; i < chunk; i++) {
+			if (buf[i] != pattern(off + i)) {
+				printf("read: mismatch at offset %zu\n", off + i);
+				close(fd);
+				return 1;
+			}
+		}
+	}
+	*ticks = elapsed;
+
+	close(fd);
+	return 0;
+}
+
+static int bench_chunk(uint8_t *buf, size_t chunk) {
+	trn_fspfs_cache_stats_t stats;
+	uint64_t write_ticks[2], read_ticks[2];
+	uint64_t read_ipcs[2], write_ipcs[2];
+
+	for (int cached = 0; cached < 2; cached++) {
+		trn_fspfs_set_cache_budget(cached ? TRN_FSPFS_DEFAULT_CACHE_BUDGET : 0);
+		trn_fspfs_reset_cache_stats();
+		if (bench_write(buf, chunk, &write_ticks[cached]) != 0 ||
+		    bench_read(buf, chunk, &read_ticks[cached]) != 0) {
+			return 1;
+		}
+		trn_fspfs_get_cache_stats(&stats);
+		read_ipcs[cached] = stats.read_ipcs;
+		write_ipcs[cached] = stats.write_ipcs;
+		if (stats.bytes_in_use != 0) {
+			printf("fspfs cache: %zu bytes still in use after close\n", stats.bytes_in_use);
+			return 1;
+		}
+	}
+
+	printf("fspfs cache: %7zu byte chunks: write %7.2f -> %7.2f MiB/s (%lu -> %lu IPCs), read %7.2f -> %7.2f MiB/s (%lu -> %lu IPCs)\n",
+	       chunk,
+	       mib_per_sec(write_ticks[0]), mib_per_sec(write_ticks[1]), write_ipcs[0], write_ipcs[1],
+	       mib_per_sec(read_ticks[0]), mib_per_sec(read_ticks[1]), read_ipcs[0], read_ipcs[1]);
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	static const size_t chunks[] = {4 * 1024, 64 * 1024, 1024 * 1024};
+	int ret = 0;
+
+	uint8_t *buf = malloc(1024 * 1024);
+	if (buf == NULL) {
+		printf("out of memory\n");
+		return 1;
+	}
+
+	for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+		if ((ret = bench_chunk(buf, chunks[i])) != 0) {
+			break;
+		}
+	}
+
+	trn_fspfs_set_cache_budget(TRN_FSPFS_DEFAULT_CACHE_BUDGET);
+	unlink(BENCH_FILE);
+	free(buf);
+	return ret;
+}
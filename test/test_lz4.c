@@ -0,0 +1,181 @@
+// LZ4 decompression benchmark. This runs as a libtransistor test under
+// Mephisto, and also builds natively on Linux against the same lz4.c:
+//
+//   cc -O2 -Iinclude -o test_lz4 test/test_lz4.c lib/lz4.c && ./test_lz4
+//
+// Build with -DLZ4_NEON=0 to compare against the portable decoder.
+
+#include<lz4.h>
+
+#include<stdbool.h>
+#include<stdint.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+
+#ifdef __linux__
+#include<time.h>
+
+static uint64_t now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+#else
+#include<libtransistor/svc.h>
+
+static uint64_t now_ns() {
+	return svcGetSystemTick() * 625 / 12; // 19.2 MHz
+}
+#endif
+
+#define BLOCK_SIZE (128 * 1024) // squashfs' default
+#define CORPUS_SIZE (4 * 1024 * 1024)
+#define ITERATIONS 8
+
+typedef struct {
+	const char *name;
+	void (*generate)(uint8_t *buf, size_t size);
+} corpus_t;
+
+static uint32_t seed;
+
+static uint32_t rand32() {
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+// dialogue scripts, level descriptions, JSON-ish config
+static void generate_text(uint8_t *buf, size_t size) {
+	static const char *words[] = {
+		"{\"id\": ", "\"name\": ", "\"position\": [", "], ", "\"flags\": ", "true", "false",
+		"the ", "player ", "enemy ", "door ", "opens ", "slowly ", "\n", "}, ", "0.5, ", "12, ",
+	};
+	size_t off = 0;
+	while(off < size) {
+		const char *w = words[rand32() % (sizeof(words) / sizeof(words[0]))];
+		size_t len = strlen(w);
+		if(len > size - off) {
+			len = size - off;
+		}
+		memcpy(buf + off, w, len);
+		off+= len;
+	}
+}
+
+// RGBA tiles: gradients with flat areas and a little noise
+static void generate_texture(uint8_t *buf, size_t size) {
+	for(size_t i = 0; i + 4 <= size; i+= 4) {
+		size_t px = i / 4;
+		uint8_t x = px % 256, y = (px / 256) % 256;
+		bool flat = ((x / 32) + (y / 32)) % 3 == 0;
+		buf[i + 0] = flat ? 0x40 : x;
+		buf[i + 1] = flat ? 0x80 : y;
+		buf[i + 2] = flat ? 0xc0 : (x ^ y) + (rand32() % 4);
+		buf[i + 3] = 0xff;
+	}
+}
+
+// vertex buffers: position/normal/uv floats on a smooth surface
+static void generate_mesh(uint8_t *buf, size_t size) {
+	float v[8];
+	for(size_t i = 0; i + sizeof(v) <= size; i+= sizeof(v)) {
+		size_t n = i / sizeof(v);
+		v[0] = (float) (n % 64) * 0.25f;
+		v[1] = (float) ((n / 64) % 64) * 0.25f;
+		v[2] = (float) (rand32() % 16) * 0.0625f;
+		v[3] = 0.0f;
+		v[4] = 1.0f;
+		v[5] = 0.0f;
+		v[6] = (float) (n % 64) / 64.0f;
+		v[7] = (float) ((n / 64) % 64) / 64.0f;
+		memcpy(buf + i, v, sizeof(v));
+	}
+}
+
+// 16-bit PCM: a looping waveform with noise, which barely compresses
+static void generate_audio(uint8_t *buf, size_t size) {
+	int16_t s;
+	for(size_t i = 0; i + 2 <= size; i+= 2) {
+		s = (int16_t) (((i / 2) % 200) * 300 - 30000 + (int) (rand32() % 2048) - 1024);
+		memcpy(buf + i, &s, 2);
+	}
+}
+
+static const corpus_t corpora[] = {
+	{"text", generate_text},
+	{"texture", generate_texture},
+	{"mesh", generate_mesh},
+	{"audio", generate_audio},
+};
+
+static int bench(const corpus_t *corpus, uint8_t *input, uint8_t *compressed, int *compressed_sizes, uint8_t *output) {
+	size_t blocks = CORPUS_SIZE / BLOCK_SIZE;
+	size_t total_compressed = 0;
+
+	seed = 0x12345678;
+	corpus->generate(input, CORPUS_SIZE);
+
+	for(size_t b = 0; b < blocks; b++) {
+		compressed_sizes[b] = LZ4_compress_default((const char*) input + b * BLOCK_SIZE,
+		                                           (char*) compressed + b * LZ4_COMPRESSBOUND(BLOCK_SIZE),
+		                                           BLOCK_SIZE, LZ4_COMPRESSBOUND(BLOCK_SIZE));
+		if(compressed_sizes[b] <= 0) {
+			printf("lz4: %s: failed to compress block %zu\n", corpus->name, b);
+			return 1;
+		}
+		total_compressed+= compressed_sizes[b];
+	}
+
+	uint64_t start = now_ns();
+	for(int it = 0; it < ITERATIONS; it++) {
+		for(size_t b = 0; b < blocks; b++) {
+			int r = LZ4_decompress_safe((const char*) compressed + b * LZ4_COMPRESSBOUND(BLOCK_SIZE),
+			                            (char*) output + b * BLOCK_SIZE,
+			                            compressed_sizes[b], BLOCK_SIZE);
+			if(r != BLOCK_SIZE) {
+				printf("lz4: %s: block %zu decompressed to %d bytes\n", corpus->name, b, r);
+				return 1;
+			}
+		}
+	}
+	uint64_t ns = now_ns() - start;
+
+	if(memcmp(input, output, CORPUS_SIZE) != 0) {
+		printf("lz4: %s: round trip mismatch\n", corpus->name);
+		return 1;
+	}
+
+	double mb = (double) CORPUS_SIZE * ITERATIONS / 1000000.0;
+	printf("lz4: %-8s ratio %5.2f: %8.1f MB/s\n", corpus->name,
+	       (double) CORPUS_SIZE / total_compressed, mb / (ns / 1000000000.0));
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	size_t blocks = CORPUS_SIZE / BLOCK_SIZE;
+	int ret = 0;
+
+	uint8_t *input = malloc(CORPUS_SIZE);
+	uint8_t *compressed = malloc(blocks * LZ4_COMPRESSBOUND(BLOCK_SIZE));
+	int *compressed_sizes = malloc(blocks * sizeof(int));
+	uint8_t *output = malloc(CORPUS_SIZE);
+	if(input == NULL || compressed == NULL || compressed_sizes == NULL || output == NULL) {
+		printf("out of memory\n");
+		ret = 1;
+		goto done;
+	}
+
+	for(size_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); i++) {
+		if((ret = bench(&corpora[i], input, compressed, compressed_sizes, output)) != 0) {
+			break;
+		}
+	}
+
+done:
+	free(input);
+	free(compressed);
+	free(compressed_sizes);
+	free(output);
+	return ret;
+}
@@ -0,0 +1,125 @@
+#include<libtransistor/types.h>
+#include<libtransistor/svc.h>
+#include<libtransistor/fd.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/stat.h>
+
+// generated by mk/tests.mk, with uncompressed data and no fragments, so the
+// whole file can be mapped straight out of the image
+#define ASSET_FILE "/squashfs/asset"
+#define TICKS_PER_US 19.2
+
+extern unsigned char _libtransistor_squashfs_image[];
+extern unsigned int _libtransistor_squashfs_image_end;
+
+static uint32_t hash(const uint8_t *buf, size_t size) {
+	uint32_t h = 2166136261u;
+	for(size_t i = 0; i < size; i++) {
+		h^= buf[i];
+		h*= 16777619u;
+	}
+	return h;
+}
+
+static bool in_image(const void *addr, size_t size) {
+	const uint8_t *image_end = (const uint8_t*) &_libtransistor_squashfs_image_end;
+	return (const uint8_t*) addr >= _libtransistor_squashfs_image && (const uint8_t*) addr + size <= image_end;
+}
+
+int main(int argc, char *argv[]) {
+	struct stat st;
+	int ret = 1;
+
+	int fd = open(ASSET_FILE, O_RDONLY);
+	if(fd < 0) {
+		perror("open");
+		return 1;
+	}
+	if(fstat(fd, &st) != 0) {
+		perror("fstat");
+		goto done_fd;
+	}
+	size_t size = st.st_size;
+
+	uint8_t *buf = malloc(size);
+	if(buf == NULL) {
+		printf("out of memory\n");
+		goto done_fd;
+	}
+	uint64_t start = svcGetSystemTick();
+	if(pread(fd, buf, size, 0) != (ssize_t) size) {
+		perror("pread");
+		goto done_buf;
+	}
+	uint32_t expected = hash(buf, size);
+	uint64_t read_ticks = svcGetSystemTick() - start;
+
+	start = svcGetSystemTick();
+	uint8_t *ro = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if(ro == MAP_FAILED) {
+		perror("mmap");
+		goto done_buf;
+	}
+	uint32_t ro_hash = hash(ro, size);
+	uint64_t ro_ticks = svcGetSystemTick() - start;
+
+	start = svcGetSystemTick();
+	uint8_t *rw = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if(rw == MAP_FAILED) {
+		perror("mmap");
+		goto done_ro;
+	}
+	uint32_t rw_hash = hash(rw, size);
+	uint64_t rw_ticks = svcGetSystemTick() - start;
+
+	printf("mmap: %zu bytes: read %.1f us, read-only mapping %.1f us, writable mapping %.1f us\n", size,
+	       read_ticks / TICKS_PER_US, ro_ticks / TICKS_PER_US, rw_ticks / TICKS_PER_US);
+
+	if(ro_hash != expected || rw_hash != expected) {
+		printf("mmap: mappings don't match the file\n");
+		goto done_rw;
+	}
+	if(!in_image(ro, size)) {
+		printf("mmap: read-only mapping at %p was copied out of the image\n", ro);
+		goto done_rw;
+	}
+	if(in_image(rw, size)) {
+		printf("mmap: writable mapping at %p points into the image\n", rw);
+		goto done_rw;
+	}
+
+	// private mappings are private
+	rw[0]^= 0xff;
+	if(ro[0] == rw[0] || pread(fd, buf, 1, 0) != 1 || buf[0] != ro[0]) {
+		printf("mmap: writing to a private mapping changed the file\n");
+		goto done_rw;
+	}
+
+	// offsets have to be page aligned, and only whole mappings can be unmapped
+	if(mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 1) != MAP_FAILED ||
+	   munmap(ro + 0x1000, 0x1000) == 0) {
+		printf("mmap: accepted a bad offset or a partial unmap\n");
+		goto done_rw;
+	}
+
+	ret = 0;
+done_rw:
+	if(munmap(rw, size) != 0) {
+		perror("munmap");
+		ret = 1;
+	}
+done_ro:
+	if(munmap(ro, size) != 0) {
+		perror("munmap");
+		ret = 1;
+	}
+done_buf:
+	free(buf);
+done_fd:
+	close(fd);
+	return ret;
+}
@@ -0,0 +1,137 @@
+#include<libtransistor/types.h>
+#include<libtransistor/svc.h>
+#include<libtransistor/err.h>
+#include<libtransistor/thread.h>
+#include<libtransistor/fs/inode.h>
+#include<libtransistor/fs/mountfs.h>
+#include<libtransistor/fs/tmpfs.h>
+#include<stdatomic.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+
+#define MOUNTS 64
+#define LATE_MOUNTS 64
+#define THREADS 3
+#define LOOKUPS 20000
+#define TICKS_PER_US 19.2
+
+static trn_inode_t root;
+static void *mounted_data[MOUNTS + LATE_MOUNTS];
+static char names[MOUNTS + LATE_MOUNTS][16];
+static _Atomic int mounted;
+static _Atomic int failures;
+
+static int mount_one(int i) {
+	trn_inode_t fs;
+	char name[32];
+	result_t r;
+
+	snprintf(names[i], sizeof(names[i]), "mount_%d", i);
+	snprintf(name, sizeof(name), "/%s", names[i]);
+	if((r = trn_tmpfs_create(&fs, 0)) != RESULT_OK) {
+		printf("failed to create tmpfs: 0x%x\n", r);
+		return 1;
+	}
+	mounted_data[i] = fs.data;
+	if((r = trn_mountfs_mount_fs(&root, name, fs)) != RESULT_OK) {
+		printf("failed to mount %s: 0x%x\n", name, r);
+		fs.ops->release(fs.data);
+		return 1;
+	}
+	atomic_store(&mounted, i + 1);
+	return 0;
+}
+
+// Looks up mountpoints at random, checking that every one that has been
+// mounted is found, and is the right one.
+static void lookup_thread(void *arg) {
+	uint32_t seed = (uint32_t) (uintptr_t) arg;
+	trn_inode_t out;
+
+	for(int i = 0; i < LOOKUPS; i++) {
+		seed = seed * 1103515245 + 12345;
+		int n = atomic_load(&mounted);
+		int which = (seed >> 8) % n;
+		if(root.ops->lookup(root.data, &out, names[which], strlen(names[which])) != RESULT_OK || out.data != mounted_data[which]) {
+			atomic_fetch_add(&failures, 1);
+		}
+	}
+}
+
+static int run_threads(int count, bool mount_meanwhile, uint64_t *ticks) {
+	trn_thread_t threads[THREADS];
+	result_t r = RESULT_OK;
+	int started;
+	int ret = 0;
+
+	uint64_t start = svcGetSystemTick();
+	for(started = 0; started < count; started++) {
+		if((r = trn_thread_create(&threads[started], lookup_thread, (void*) (uintptr_t) (started + 1), -1, -2, 0x10000, NULL)) != RESULT_OK) {
+			break;
+		}
+		if((r = trn_thread_start(&threads[started])) != RESULT_OK) {
+			trn_thread_destroy(&threads[started]);
+			break;
+		}
+	}
+	if(r != RESULT_OK) {
+		printf("failed to start thread: 0x%x\n", r);
+		ret = 1;
+	} else if(mount_meanwhile) {
+		for(int i = MOUNTS; i < MOUNTS + LATE_MOUNTS; i++) {
+			if(mount_one(i) != 0) {
+				ret = 1;
+				break;
+			}
+		}
+	}
+	for(int i = 0; i < started; i++) {
+		trn_thread_join(&threads[i], -1);
+		trn_thread_destroy(&threads[i]);
+	}
+	*ticks = svcGetSystemTick() - start;
+	return ret;
+}
+
+int main(int argc, char *argv[]) {
+	uint64_t one_ticks, many_ticks, ignored;
+	trn_inode_t out;
+	result_t r;
+
+	if((r = trn_mountfs_create(&root)) != RESULT_OK) {
+		printf("failed to create mountfs: 0x%x\n", r);
+		return 1;
+	}
+	for(int i = 0; i < MOUNTS; i++) {
+		if(mount_one(i) != 0) {
+			return 1;
+		}
+	}
+
+	// names only match in full
+	if(root.ops->lookup(root.data, &out, "mount_1", 7) != RESULT_OK || out.data != mounted_data[1] ||
+	   root.ops->lookup(root.data, &out, "mount_", 6) != LIBTRANSISTOR_ERR_FS_NOT_FOUND ||
+	   root.ops->lookup(root.data, &out, "mount_10", 8) != RESULT_OK || out.data != mounted_data[10]) {
+		printf("mountfs: lookups matched the wrong mountpoint\n");
+		return 1;
+	}
+
+	if(run_threads(1, false, &one_ticks) != 0 || run_threads(THREADS, false, &many_ticks) != 0) {
+		return 1;
+	}
+	printf("mountfs: %d mounts: 1 thread: %.3f us/lookup, %d threads: %.3f us/lookup\n", MOUNTS,
+	       one_ticks / TICKS_PER_US / LOOKUPS, THREADS, many_ticks / TICKS_PER_US / (LOOKUPS * THREADS));
+
+	// lookups keep working while the table grows underneath them
+	if(run_threads(THREADS, true, &ignored) != 0) {
+		return 1;
+	}
+	if(atomic_load(&failures) != 0) {
+		printf("mountfs: %d lookups failed\n", atomic_load(&failures));
+		return 1;
+	}
+
+	root.ops->release(root.data);
+	return 0;
+}
@@ -0,0 +1,314 @@
+#include<libtransistor/types.h>
+#include<libtransistor/svc.h>
+#include<libtransistor/err.h>
+#include<libtransistor/ipc/fs.h>
+#include<libtransistor/fs/fs.h>
+#include<libtransistor/fs/inode.h>
+#include<libtransistor/fs/squashfs.h>
+#include<libtransistor/fs/fspfs.h>
+#include<libtransistor/fs/tmpfs.h>
+#include<libtransistor/fs/overlayfs.h>
+#include<errno.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<fcntl.h>
+#include<unistd.h>
+#include<dirent.h>
+#include<sys/stat.h>
+
+#include"../lib/squashfs/squashfuse.h"
+
+// The image (see mk/tests.mk) has a.txt, b.txt and sub/c.txt, each holding
+// "lower <name>\n", and asset_N for N < ASSETS.
+#define ASSETS 64
+#define LOOKUP_ROUNDS 16
+#define TMPFS_SIZE (256 * 1024)
+#define TICKS_PER_US 19.2
+
+extern unsigned char _libtransistor_squashfs_image[];
+extern unsigned int _libtransistor_squashfs_image_end;
+
+static sqfs lower_fs;
+
+static int check_contents(const char *path, const char *expected) {
+	char buf[64];
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		printf("overlayfs: failed to open %s: %s\n", path, strerror(errno));
+		return 1;
+	}
+	ssize_t n = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if(n < 0) {
+		perror("read");
+		return 1;
+	}
+	buf[n] = 0;
+	if(strcmp(buf, expected) != 0) {
+		printf("overlayfs: %s holds \"%s\", expected \"%s\"\n", path, buf, expected);
+		return 1;
+	}
+	return 0;
+}
+
+static int write_file(const char *path, int flags, const char *contents) {
+	int fd = open(path, O_WRONLY | flags, 0666);
+	if(fd < 0) {
+		printf("overlayfs: failed to open %s for writing: %s\n", path, strerror(errno));
+		return 1;
+	}
+	if(write(fd, contents, strlen(contents)) != (ssize_t) strlen(contents)) {
+		perror("write");
+		close(fd);
+		return 1;
+	}
+	close(fd);
+	return 0;
+}
+
+static int count_entries(const char *path, const char *name, int *found) {
+	DIR *dir = opendir(path);
+	struct dirent *ent;
+	int count = 0;
+
+	if(dir == NULL) {
+		perror("opendir");
+		return -1;
+	}
+	*found = 0;
+	while((ent = readdir(dir)) != NULL) {
+		if(strncmp(ent->d_name, ".wh.", 4) == 0) {
+			printf("overlayfs: readdir showed whiteout %s\n", ent->d_name);
+			closedir(dir);
+			return -1;
+		}
+		if(strcmp(ent->d_name, name) == 0) {
+			*found = 1;
+		}
+		count++;
+	}
+	closedir(dir);
+	return count;
+}
+
+static int open_lower(trn_inode_t *out) {
+	static bool initialized = false;
+	if(!initialized) {
+		size_t image_size = ((uint8_t*) &_libtransistor_squashfs_image_end) - _libtransistor_squashfs_image;
+		sqfs_err err = sqfs_init_memory(&lower_fs, _libtransistor_squashfs_image, image_size, 0);
+		if(err != SQFS_OK) {
+			printf("failed to open squashfs image: %d\n", err);
+			return 1;
+		}
+		initialized = true;
+	}
+	if(trn_sqfs_open_root(out, &lower_fs) != RESULT_OK) {
+		printf("failed to open squashfs root\n");
+		return 1;
+	}
+	return 0;
+}
+
+static int check_semantics() {
+	struct stat st;
+	int found;
+
+	// lower files show through until they're written to
+	if(check_contents("/ov/a.txt", "lower a\n") != 0 ||
+	   check_contents("/ov/sub/c.txt", "lower c\n") != 0) {
+		return 1;
+	}
+	if(write_file("/ov/a.txt", O_APPEND, "upper a\n") != 0 ||
+	   check_contents("/ov/a.txt", "lower a\nupper a\n") != 0) {
+		return 1;
+	}
+	if(write_file("/ov/sub/c.txt", O_TRUNC, "upper c\n") != 0 ||
+	   check_contents("/ov/sub/c.txt", "upper c\n") != 0) {
+		return 1;
+	}
+	if(check_contents("/squashfs/a.txt", "lower a\n") != 0) {
+		printf("overlayfs: a write went through to the lower layer\n");
+		return 1;
+	}
+
+	// removing a lower file hides it, and a new file can take its place
+	if(unlink("/ov/b.txt") != 0) {
+		perror("unlink");
+		return 1;
+	}
+	if(stat("/ov/b.txt", &st) == 0 || errno != ENOENT) {
+		printf("overlayfs: b.txt is still there after unlink\n");
+		return 1;
+	}
+	int entries = count_entries("/ov", "b.txt", &found);
+	if(entries < 0 || found || entries != ASSETS + 2) {
+		printf("overlayfs: readdir after unlink gave %d entries\n", entries);
+		return 1;
+	}
+	if(write_file("/ov/b.txt", O_CREAT | O_EXCL, "new b\n") != 0 ||
+	   check_contents("/ov/b.txt", "new b\n") != 0) {
+		return 1;
+	}
+
+	// a directory with lower contents isn't empty, and comes back empty
+	if(rmdir("/ov/sub") == 0 || errno != ENOTEMPTY) {
+		printf("overlayfs: rmdir of a non-empty merged directory didn't fail with ENOTEMPTY\n");
+		return 1;
+	}
+	if(unlink("/ov/sub/c.txt") != 0 || rmdir("/ov/sub") != 0) {
+		perror("remove");
+		return 1;
+	}
+	if(mkdir("/ov/sub", 0777) != 0) {
+		perror("mkdir");
+		return 1;
+	}
+	if(count_entries("/ov/sub", "c.txt", &found) != 0) {
+		printf("overlayfs: recreated directory shows lower contents\n");
+		return 1;
+	}
+
+	// renames work on lower files
+	if(rename("/ov/asset_0", "/ov/sub/moved") != 0) {
+		perror("rename");
+		return 1;
+	}
+	if(stat("/ov/asset_0", &st) == 0 || check_contents("/ov/sub/moved", "asset 0\n") != 0) {
+		printf("overlayfs: rename didn't move the file\n");
+		return 1;
+	}
+	return 0;
+}
+
+// what opening asset_N costs the overlay: one lookup, then letting go
+static int lookup_assets(trn_inode_t *root, uint64_t *ticks) {
+	trn_inode_t file;
+	char name[32];
+
+	uint64_t start = svcGetSystemTick();
+	for(int round = 0; round < LOOKUP_ROUNDS; round++) {
+		for(int i = 1; i < ASSETS; i++) {
+			snprintf(name, sizeof(name), "asset_%d", i);
+			if(root->ops->lookup(root->data, &file, name, strlen(name)) != RESULT_OK) {
+				printf("overlayfs: failed to look up %s\n", name);
+				return 1;
+			}
+			file.ops->release(file.data);
+		}
+	}
+	*ticks = svcGetSystemTick() - start;
+	return 0;
+}
+
+static int bench_lookups(const char *label, trn_inode_t *root) {
+	trn_overlayfs_stats_t before, after;
+	uint64_t cold_ticks, warm_ticks;
+	int lookups = LOOKUP_ROUNDS * (ASSETS - 1);
+
+	trn_overlayfs_set_negative_cache_size(root, 0);
+	trn_overlayfs_get_stats(root, &before);
+	if(lookup_assets(root, &cold_ticks) != 0) {
+		return 1;
+	}
+	trn_overlayfs_get_stats(root, &after);
+	printf("overlayfs %s: uncached: %6.2f us/lookup (%lu upper lookups)\n", label,
+	       cold_ticks / TICKS_PER_US / lookups, after.upper_lookups - before.upper_lookups);
+
+	trn_overlayfs_set_negative_cache_size(root, TRN_OVERLAYFS_DEFAULT_NEGATIVE_CACHE_SIZE);
+	trn_overlayfs_get_stats(root, &before);
+	if(lookup_assets(root, &warm_ticks) != 0) {
+		return 1;
+	}
+	trn_overlayfs_get_stats(root, &after);
+	printf("overlayfs %s: cached:   %6.2f us/lookup (%lu upper lookups, %.1fx)\n", label,
+	       warm_ticks / TICKS_PER_US / lookups, after.upper_lookups - before.upper_lookups, (double) cold_ticks / warm_ticks);
+
+	// only the first round should have had to ask the upper layer, twice per
+	// name: once for the name and once for its whiteout
+	if(after.upper_lookups - before.upper_lookups > 2 * (ASSETS - 1)) {
+		printf("overlayfs %s: negative cache didn't stop upper lookups\n", label);
+		return 1;
+	}
+	return 0;
+}
+
+static int bench_sd() {
+	ifilesystem_t sdcard_ifs;
+	trn_inode_t sdcard, upper, lower, overlay;
+	result_t r;
+	int ret = 1;
+
+	if(fsp_srv_init(0) != RESULT_OK) {
+		return -1;
+	}
+	if(fsp_srv_mount_sd_card(&sdcard_ifs) != RESULT_OK) {
+		fsp_srv_finalize();
+		return -1;
+	}
+	if(trn_fspfs_create(&sdcard, sdcard_ifs) != RESULT_OK) {
+		ipc_close(sdcard_ifs);
+		fsp_srv_finalize();
+		return -1;
+	}
+	r = sdcard.ops->create_directory(sdcard.data, "overlayfs_upper");
+	if(r != RESULT_OK && r != LIBTRANSISTOR_ERR_FS_PATH_EXISTS) {
+		sdcard.ops->release(sdcard.data);
+		fsp_srv_finalize();
+		return -1;
+	}
+	r = sdcard.ops->lookup(sdcard.data, &upper, "overlayfs_upper", 15);
+	sdcard.ops->release(sdcard.data);
+	fsp_srv_finalize();
+	if(r != RESULT_OK) {
+		return -1;
+	}
+
+	if(open_lower(&lower) != 0) {
+		upper.ops->release(upper.data);
+		return 1;
+	}
+	if((r = trn_overlayfs_create(&overlay, upper, "/overlayfs_upper", lower)) != RESULT_OK) {
+		printf("failed to create overlay: 0x%x\n", r);
+		upper.ops->release(upper.data);
+		lower.ops->release(lower.data);
+		return 1;
+	}
+	ret = bench_lookups("sd", &overlay);
+	overlay.ops->release(overlay.data);
+	return ret;
+}
+
+int main(int argc, char *argv[]) {
+	trn_inode_t upper, lower, overlay;
+	result_t r;
+
+	if((r = trn_tmpfs_create(&upper, TMPFS_SIZE)) != RESULT_OK) {
+		printf("failed to create tmpfs: 0x%x\n", r);
+		return 1;
+	}
+	if(open_lower(&lower) != 0) {
+		return 1;
+	}
+	if((r = trn_overlayfs_create(&overlay, upper, "", lower)) != RESULT_OK) {
+		printf("failed to create overlay: 0x%x\n", r);
+		return 1;
+	}
+	if(bench_lookups("tmpfs", &overlay) != 0) {
+		return 1;
+	}
+	if((r = trn_fs_mount("/ov", overlay)) != RESULT_OK) {
+		printf("failed to mount overlay: 0x%x\n", r);
+		return 1;
+	}
+	if(check_semantics() != 0) {
+		return 1;
+	}
+
+	int sd = bench_sd();
+	if(sd < 0) {
+		printf("overlayfs: no sd card, skipping\n");
+		return 0;
+	}
+	return sd;
+}
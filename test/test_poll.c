@@ -0,0 +1,300 @@
+#include<libtransistor/types.h>
+#include<libtransistor/svc.h>
+#include<libtransistor/err.h>
+#include<libtransistor/fd.h>
+#include<libtransistor/ipc/bsd.h>
+#include<libtransistor/fs/blobfd.h>
+#include<errno.h>
+#include<fcntl.h>
+#include<poll.h>
+#include<stdio.h>
+#include<string.h>
+#include<unistd.h>
+#include<sys/select.h>
+#include<sys/socket.h>
+#include<netinet/in.h>
+
+#define PORT 5610
+#define CONNS 32
+#define ROUNDS 1000
+#define TICKS_PER_US 19.2
+
+static int clients[CONNS], servers[CONNS];
+
+static int connect_pair(int listener, int *client, int *server) {
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(PORT),
+		.sin_addr = {.s_addr = htonl(INADDR_LOOPBACK)},
+	};
+
+	if((*client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0 ||
+	   connect(*client, (struct sockaddr*) &addr, sizeof(addr)) != 0 ||
+	   (*server = accept(listener, NULL, NULL)) < 0) {
+		perror("connect");
+		return 1;
+	}
+	return 0;
+}
+
+// poll and select on a socket pair, a file that isn't a socket, and an fd
+// that isn't open
+static int test_readiness() {
+	static uint8_t blob[16];
+	blob_file file;
+	char c;
+
+	int regular = blobfd_create(&file, blob, sizeof(blob));
+	if(regular < 0) {
+		printf("poll: failed to create blobfd\n");
+		return 1;
+	}
+	struct pollfd fds[] = {
+		{.fd = servers[0], .events = POLLIN},
+		{.fd = clients[0], .events = POLLOUT},
+		{.fd = regular, .events = POLLIN},
+		{.fd = -1, .events = POLLIN},
+		{.fd = 900, .events = POLLIN},
+	};
+	int ready = poll(fds, 5, 0);
+	if(ready != 3 || fds[0].revents != 0 || !(fds[1].revents & POLLOUT) || fds[2].revents != POLLIN ||
+	   fds[3].revents != 0 || fds[4].revents != POLLNVAL) {
+		printf("poll: %d ready, revents 0x%x 0x%x 0x%x 0x%x 0x%x\n", ready,
+		       fds[0].revents, fds[1].revents, fds[2].revents, fds[3].revents, fds[4].revents);
+		return 1;
+	}
+
+	uint64_t start = svcGetSystemTick();
+	if(poll(fds, 1, 50) != 0) {
+		printf("poll: idle socket was ready\n");
+		return 1;
+	}
+	double waited = (svcGetSystemTick() - start) / TICKS_PER_US / 1000.0;
+	if(waited < 45) {
+		printf("poll: 50 ms timeout returned after %.1f ms\n", waited);
+		return 1;
+	}
+
+	send(clients[0], "x", 1, 0);
+	if(poll(fds, 1, 1000) != 1 || !(fds[0].revents & POLLIN)) {
+		printf("poll: sent to socket wasn't readable\n");
+		return 1;
+	}
+
+	fd_set readfds, writefds;
+	struct timeval timeout = {.tv_sec = 1};
+	FD_ZERO(&readfds);
+	FD_ZERO(&writefds);
+	FD_SET(servers[0], &readfds);
+	FD_SET(servers[1], &readfds);
+	FD_SET(regular, &writefds);
+	int nfds = (servers[0] > servers[1] ? servers[0] : servers[1]) + 1;
+	if(nfds <= regular) {
+		nfds = regular + 1;
+	}
+	if(select(nfds, &readfds, &writefds, NULL, &timeout) != 2 ||
+	   !FD_ISSET(servers[0], &readfds) || FD_ISSET(servers[1], &readfds) || !FD_ISSET(regular, &writefds)) {
+		printf("select: wrong fds ready\n");
+		return 1;
+	}
+	recv(servers[0], &c, 1, 0);
+	close(regular);
+	return 0;
+}
+
+static int test_nonblocking() {
+	char c;
+
+	int flags = fcntl(servers[0], F_GETFL, 0);
+	if(flags < 0 || fcntl(servers[0], F_SETFL, flags | O_NONBLOCK) != 0) {
+		perror("fcntl");
+		return 1;
+	}
+	if(!(fcntl(servers[0], F_GETFL, 0) & O_NONBLOCK)) {
+		printf("fcntl: O_NONBLOCK didn't stick\n");
+		return 1;
+	}
+	if(recv(servers[0], &c, 1, 0) != -1 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+		printf("fcntl: recv on an empty non-blocking socket gave errno %d\n", errno);
+		return 1;
+	}
+	if(fcntl(servers[0], F_SETFL, flags) != 0) {
+		perror("fcntl");
+		return 1;
+	}
+	return 0;
+}
+
+// Every round one connection out of CONNS gets a byte, and the server side
+// waits for it, like a server with mostly idle connections would.
+static int bench(bool use_epoll, uint64_t *ticks) {
+	struct epoll_event events[8];
+	struct pollfd fds[CONNS];
+	uint32_t seed = 1;
+	char c;
+	int ep = -1;
+
+	if(use_epoll) {
+		if((ep = epoll_create1(0)) < 0) {
+			perror("epoll_create1");
+			return 1;
+		}
+		for(int i = 0; i < CONNS; i++) {
+			struct epoll_event ev = {.events = EPOLLIN, .data = {.u32 = i}};
+			if(epoll_ctl(ep, EPOLL_CTL_ADD, servers[i], &ev) != 0) {
+				perror("epoll_ctl");
+				close(ep);
+				return 1;
+			}
+		}
+	}
+
+	uint64_t start = svcGetSystemTick();
+	for(int round = 0; round < ROUNDS; round++) {
+		seed = seed * 1103515245 + 12345;
+		int which = (seed >> 8) % CONNS, got = -1;
+		send(clients[which], "x", 1, 0);
+		if(use_epoll) {
+			if(epoll_wait(ep, events, 8, 1000) == 1) {
+				got = events[0].data.u32;
+			}
+		} else {
+			// what a server without epoll does: put the set together every time
+			for(int i = 0; i < CONNS; i++) {
+				fds[i] = (struct pollfd) {.fd = servers[i], .events = POLLIN};
+			}
+			if(poll(fds, CONNS, 1000) == 1) {
+				for(int i = 0; i < CONNS; i++) {
+					if(fds[i].revents & POLLIN) {
+						got = i;
+					}
+				}
+			}
+		}
+		if(got != which) {
+			printf("poll: sent to connection %d, %d was ready\n", which, got);
+			return 1;
+		}
+		recv(servers[which], &c, 1, 0);
+	}
+	*ticks = svcGetSystemTick() - start;
+
+	if(ep >= 0) {
+		close(ep);
+	}
+	return 0;
+}
+
+static int test_epoll() {
+	struct epoll_event ev = {.events = EPOLLIN | EPOLLONESHOT, .data = {.u32 = 42}}, out[4];
+
+	int ep = epoll_create1(0);
+	if(ep < 0 || epoll_ctl(ep, EPOLL_CTL_ADD, servers[0], &ev) != 0) {
+		perror("epoll");
+		return 1;
+	}
+	if(epoll_ctl(ep, EPOLL_CTL_ADD, servers[0], &ev) != -1 || errno != EEXIST) {
+		printf("epoll: added the same fd twice\n");
+		return 1;
+	}
+	send(clients[0], "x", 1, 0);
+	if(epoll_wait(ep, out, 4, 1000) != 1 || out[0].data.u32 != 42 || !(out[0].events & EPOLLIN)) {
+		printf("epoll: readable socket wasn't reported\n");
+		return 1;
+	}
+	// oneshot: not again until it's rearmed
+	if(epoll_wait(ep, out, 4, 10) != 0) {
+		printf("epoll: oneshot fd was reported twice\n");
+		return 1;
+	}
+	ev.events = EPOLLIN;
+	if(epoll_ctl(ep, EPOLL_CTL_MOD, servers[0], &ev) != 0 || epoll_wait(ep, out, 4, 1000) != 1) {
+		printf("epoll: rearmed fd wasn't reported\n");
+		return 1;
+	}
+	char c;
+	recv(servers[0], &c, 1, 0);
+	if(epoll_ctl(ep, EPOLL_CTL_DEL, servers[0], NULL) != 0 || epoll_ctl(ep, EPOLL_CTL_DEL, servers[0], NULL) != -1) {
+		printf("epoll: delete didn't\n");
+		return 1;
+	}
+	close(ep);
+	return 0;
+}
+
+// a connection closed while in the set, and a new one that gets its fd
+static int test_epoll_reuse(int listener) {
+	struct epoll_event ev = {.events = EPOLLIN, .data = {.u32 = 1}}, out[4];
+
+	int ep = epoll_create1(0);
+	if(ep < 0 || epoll_ctl(ep, EPOLL_CTL_ADD, servers[0], &ev) != 0) {
+		perror("epoll");
+		return 1;
+	}
+	int old_fd = servers[0];
+	close(clients[0]);
+	close(servers[0]);
+	if(connect_pair(listener, &clients[0], &servers[0]) != 0) {
+		return 1;
+	}
+	if(servers[0] != old_fd) {
+		printf("epoll: fd %d wasn't reused, got %d\n", old_fd, servers[0]);
+	}
+	ev.data.u32 = 2;
+	if(epoll_ctl(ep, EPOLL_CTL_ADD, servers[0], &ev) != 0) {
+		perror("epoll: adding the new connection");
+		return 1;
+	}
+	send(clients[0], "x", 1, 0);
+	if(epoll_wait(ep, out, 4, 1000) != 1 || out[0].data.u32 != 2) {
+		printf("epoll: new connection was reported as the old one\n");
+		return 1;
+	}
+	char c;
+	recv(servers[0], &c, 1, 0);
+	close(ep);
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(PORT),
+		.sin_addr = {.s_addr = htonl(INADDR_ANY)},
+	};
+	uint64_t poll_ticks, epoll_ticks;
+	result_t r;
+
+	if((r = bsd_init()) != RESULT_OK) {
+		printf("failed to init bsd: 0x%x\n", r);
+		return 1;
+	}
+	int listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if(listener < 0 || bind(listener, (struct sockaddr*) &addr, sizeof(addr)) != 0 || listen(listener, CONNS) != 0) {
+		perror("listen");
+		return 1;
+	}
+	for(int i = 0; i < CONNS; i++) {
+		if(connect_pair(listener, &clients[i], &servers[i]) != 0) {
+			return 1;
+		}
+	}
+
+	if(test_readiness() != 0 || test_nonblocking() != 0 || test_epoll() != 0 ||
+	   test_epoll_reuse(listener) != 0) {
+		return 1;
+	}
+	if(bench(false, &poll_ticks) != 0 || bench(true, &epoll_ticks) != 0) {
+		return 1;
+	}
+	printf("poll: %d connections: poll: %.2f us/event, epoll: %.2f us/event\n", CONNS,
+	       poll_ticks / TICKS_PER_US / ROUNDS, epoll_ticks / TICKS_PER_US / ROUNDS);
+
+	for(int i = 0; i < CONNS; i++) {
+		close(clients[i]);
+		close(servers[i]);
+	}
+	close(listener);
+	bsd_finalize();
+	return 0;
+}
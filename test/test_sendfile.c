@@ -0,0 +1,290 @@
+#include<libtransistor/types.h>
+#include<libtransistor/svc.h>
+#include<libtransistor/err.h>
+#include<libtransistor/thread.h>
+#include<libtransistor/fd.h>
+#include<libtransistor/ipc/bsd.h>
+#include<libtransistor/fs/blobfd.h>
+#include<errno.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/socket.h>
+#include<netinet/in.h>
+
+// The image (see mk/tests.mk) holds one BENCH_SIZE file, "stream".
+#define SQFS_FILE "/squashfs/stream"
+#define SD_SRC_FILE "/sd/sendfile_src"
+#define SD_DST_FILE "/sd/sendfile_dst"
+#define BENCH_SIZE (8 * 1024 * 1024)
+#define LOOP_CHUNK_SIZE (64 * 1024)
+#define PORT 5556
+#define TICKS_PER_US 19.2
+
+typedef struct {
+	int listener;
+	size_t received;
+	uint32_t hash;
+	int error;
+} drain_t;
+
+static uint8_t contents[BENCH_SIZE];
+static uint8_t loop_buf[LOOP_CHUNK_SIZE];
+
+static uint32_t fnv(const uint8_t *buf, size_t size, uint32_t hash) {
+	for(size_t i = 0; i < size; i++) {
+		hash^= buf[i];
+		hash*= 16777619u;
+	}
+	return hash;
+}
+
+static double mib_per_sec(uint64_t ticks) {
+	double secs = ticks / TICKS_PER_US / 1000000.0;
+	return (BENCH_SIZE / (1024.0 * 1024.0)) / secs;
+}
+
+// The other end of the socket: takes one connection and reads it to the end.
+static void drain_thread(void *arg) {
+	drain_t *drain = arg;
+	static uint8_t buf[LOOP_CHUNK_SIZE];
+	ssize_t r;
+
+	int fd = accept(drain->listener, NULL, NULL);
+	if(fd < 0) {
+		drain->error = errno;
+		return;
+	}
+	drain->hash = 2166136261u;
+	while((r = recv(fd, buf, sizeof(buf), 0)) > 0) {
+		drain->hash = fnv(buf, r, drain->hash);
+		drain->received+= r;
+	}
+	if(r < 0) {
+		drain->error = errno;
+	}
+	close(fd);
+}
+
+// How sending a file used to go: read it into a buffer, write that out.
+static ssize_t copy_loop(int out, int in, off_t offset, size_t count) {
+	size_t total = 0;
+	while(total < count) {
+		size_t n = count - total < LOOP_CHUNK_SIZE ? count - total : LOOP_CHUNK_SIZE;
+		ssize_t r = pread(in, loop_buf, n, offset + total);
+		if(r <= 0) {
+			return r < 0 ? -1 : (ssize_t) total;
+		}
+		for(ssize_t done = 0; done < r; ) {
+			ssize_t w = write(out, loop_buf + done, r - done);
+			if(w <= 0) {
+				return -1;
+			}
+			done+= w;
+		}
+		total+= r;
+	}
+	return total;
+}
+
+// Sends the file over a loopback connection, with sendfile or without.
+static int send_once(int listener, int in, bool use_sendfile, uint64_t *ticks) {
+	drain_t drain = {.listener = listener};
+	trn_thread_t thread;
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(PORT),
+		.sin_addr = {.s_addr = htonl(INADDR_LOOPBACK)},
+	};
+	ssize_t sent;
+	int ret = 1;
+
+	if(trn_thread_create(&thread, drain_thread, &drain, -1, -2, 0x10000, NULL) != RESULT_OK) {
+		printf("failed to create drain thread\n");
+		return 1;
+	}
+	if(trn_thread_start(&thread) != RESULT_OK) {
+		printf("failed to start drain thread\n");
+		trn_thread_destroy(&thread);
+		return 1;
+	}
+
+	int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if(fd < 0 || connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+		perror("connect");
+		goto done;
+	}
+	uint64_t start = svcGetSystemTick();
+	if(use_sendfile) {
+		off_t offset = 0;
+		sent = sendfile(fd, in, &offset, BENCH_SIZE);
+	} else {
+		sent = copy_loop(fd, in, 0, BENCH_SIZE);
+	}
+	*ticks = svcGetSystemTick() - start;
+	if(sent != BENCH_SIZE) {
+		printf("sendfile: sent %zd bytes: %s\n", sent, strerror(errno));
+		goto done;
+	}
+	ret = 0;
+
+done:
+	if(fd >= 0) {
+		close(fd);
+	}
+	trn_thread_join(&thread, -1);
+	trn_thread_destroy(&thread);
+	if(ret == 0 && (drain.error != 0 || drain.received != BENCH_SIZE || drain.hash != fnv(contents, BENCH_SIZE, 2166136261u))) {
+		printf("sendfile: other end got %zu bytes (error %d), not what was sent\n", drain.received, drain.error);
+		ret = 1;
+	}
+	return ret;
+}
+
+static int bench_socket(int listener, const char *label, int in) {
+	uint64_t loop_ticks, sendfile_ticks;
+
+	if(send_once(listener, in, false, &loop_ticks) != 0 || send_once(listener, in, true, &sendfile_ticks) != 0) {
+		printf("sendfile %s: failed\n", label);
+		return 1;
+	}
+	printf("sendfile %s: read/write: %7.2f MiB/s, sendfile: %7.2f MiB/s (%.2fx)\n", label,
+	       mib_per_sec(loop_ticks), mib_per_sec(sendfile_ticks), (double) loop_ticks / sendfile_ticks);
+	return 0;
+}
+
+static int check_file(const char *path) {
+	int fd = open(path, O_RDONLY);
+	uint32_t hash = 2166136261u;
+	size_t total = 0;
+	ssize_t r;
+
+	if(fd < 0) {
+		perror("open");
+		return 1;
+	}
+	while((r = read(fd, loop_buf, sizeof(loop_buf))) > 0) {
+		hash = fnv(loop_buf, r, hash);
+		total+= r;
+	}
+	close(fd);
+	if(r < 0 || total != BENCH_SIZE || hash != fnv(contents, BENCH_SIZE, 2166136261u)) {
+		printf("sendfile: %s doesn't hold what was copied into it\n", path);
+		return 1;
+	}
+	return 0;
+}
+
+static int copy_once(const char *src, bool use_copy_file_range, uint64_t *ticks) {
+	ssize_t copied;
+
+	int in = open(src, O_RDONLY);
+	if(in < 0) {
+		perror("open");
+		return 1;
+	}
+	int out = open(SD_DST_FILE, O_WRONLY | O_CREAT | O_TRUNC);
+	if(out < 0) {
+		perror("open");
+		close(in);
+		return 1;
+	}
+	uint64_t start = svcGetSystemTick();
+	if(use_copy_file_range) {
+		off_t in_off = 0, out_off = 0;
+		copied = copy_file_range(in, &in_off, out, &out_off, BENCH_SIZE, 0);
+	} else {
+		copied = copy_loop(out, in, 0, BENCH_SIZE);
+	}
+	*ticks = svcGetSystemTick() - start;
+	close(in);
+	close(out);
+	if(copied != BENCH_SIZE) {
+		printf("sendfile: copied %zd bytes: %s\n", copied, strerror(errno));
+		return 1;
+	}
+	return check_file(SD_DST_FILE);
+}
+
+static int bench_copy(const char *label, const char *src) {
+	uint64_t loop_ticks, copy_ticks;
+
+	if(copy_once(src, false, &loop_ticks) != 0 || copy_once(src, true, &copy_ticks) != 0) {
+		printf("sendfile %s: failed\n", label);
+		return 1;
+	}
+	printf("sendfile %s: read/write: %7.2f MiB/s, copy_file_range: %7.2f MiB/s (%.2fx)\n", label,
+	       mib_per_sec(loop_ticks), mib_per_sec(copy_ticks), (double) loop_ticks / copy_ticks);
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(PORT),
+		.sin_addr = {.s_addr = htonl(INADDR_ANY)},
+	};
+	blob_file blob;
+	result_t r;
+
+	int fd = open(SQFS_FILE, O_RDONLY);
+	if(fd < 0 || read(fd, contents, BENCH_SIZE) != BENCH_SIZE) {
+		printf("sendfile: failed to read %s\n", SQFS_FILE);
+		return 1;
+	}
+	close(fd);
+
+	if((r = bsd_init()) != RESULT_OK) {
+		printf("failed to init bsd: 0x%x\n", r);
+		return 1;
+	}
+	int listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if(listener < 0 || bind(listener, (struct sockaddr*) &addr, sizeof(addr)) != 0 || listen(listener, 1) != 0) {
+		perror("listen");
+		return 1;
+	}
+
+	// squashfs -> socket, through a bounce buffer unless the image stores it as-is
+	if((fd = open(SQFS_FILE, O_RDONLY)) < 0) {
+		perror("open");
+		return 1;
+	}
+	if(bench_socket(listener, "squashfs->socket", fd) != 0) {
+		return 1;
+	}
+	close(fd);
+
+	// blobfd -> socket, straight out of the blob
+	if((fd = blobfd_create(&blob, contents, BENCH_SIZE)) < 0) {
+		printf("failed to create blobfd\n");
+		return 1;
+	}
+	if(bench_socket(listener, "blobfd->socket", fd) != 0) {
+		return 1;
+	}
+	close(fd);
+	close(listener);
+	bsd_finalize();
+
+	// squashfs -> fspfs, then fspfs -> fspfs in big aligned chunks
+	if((fd = open(SD_SRC_FILE, O_WRONLY | O_CREAT | O_TRUNC)) < 0) {
+		printf("sendfile: no sd card, skipping\n");
+		return 0;
+	}
+	close(fd);
+	if(bench_copy("squashfs->fspfs", SQFS_FILE) != 0) {
+		return 1;
+	}
+	if(rename(SD_DST_FILE, SD_SRC_FILE) != 0 && (unlink(SD_SRC_FILE) != 0 || rename(SD_DST_FILE, SD_SRC_FILE) != 0)) {
+		perror("rename");
+		return 1;
+	}
+	if(bench_copy("fspfs->fspfs", SD_SRC_FILE) != 0) {
+		return 1;
+	}
+	unlink(SD_SRC_FILE);
+	unlink(SD_DST_FILE);
+	return 0;
+}
@@ -0,0 +1,186 @@
+#include<libtransistor/types.h>
+#include<libtransistor/svc.h>
+#include<libtransistor/fs/squashfs.h>
+#include<libtransistor/fs/blobfd.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<unistd.h>
+
+#include"../lib/squashfs/squashfuse.h"
+
+// The image for this test is generated by mk/tests.mk: dir/file_N holds
+// "file N\n" for N < SMALL_FILES, and big holds the output of `seq`.
+#define SMALL_FILES 512
+#define HOT_FILES 16
+#define STREAM_CHUNK (16 * 1024)
+#define TRACE_LENGTH 4000
+#define TICKS_PER_US 19.2
+
+extern unsigned char _libtransistor_squashfs_image[];
+extern unsigned int _libtransistor_squashfs_image_end;
+
+typedef enum {
+	TRACE_HOT_LOOKUP,
+	TRACE_COLD_LOOKUP,
+	TRACE_STREAM,
+} trace_op_t;
+
+typedef struct {
+	const char *name;
+	size_t md, data, frag;
+} cache_config_t;
+
+static const cache_config_t configs[] = {
+	{"old defaults", 8, 1, 3},
+	{"new defaults", 32, 2, 4},
+	{"large", 128, 4, 16},
+};
+
+static trace_op_t trace[TRACE_LENGTH];
+static int trace_arg[TRACE_LENGTH];
+static uint8_t stream_buf[STREAM_CHUNK];
+
+// A mixed workload: mostly re-opening a small set of hot files, some cold
+// files, and a big file being streamed in the background.
+static void build_trace() {
+	uint32_t seed = 0x12345678;
+	for (int i = 0; i < TRACE_LENGTH; i++) {
+		seed = seed * 1103515245 + 12345;
+		uint32_t roll = (seed >> 16) % 100;
+		seed = seed * 1103515245 + 12345;
+		if (roll < 60) {
+			trace[i] = TRACE_HOT_LOOKUP;
+			trace_arg[i] = (seed >> 16) % HOT_FILES;
+		} else if (roll < 75) {
+			trace[i] = TRACE_COLD_LOOKUP;
+			trace_arg[i] = (seed >> 16) % SMALL_FILES;
+		} else {
+			trace[i] = TRACE_STREAM;
+		}
+	}
+}
+
+static int read_small_file(sqfs *fs, int n) {
+	char path[64], expected[32], buf[32];
+	sqfs_inode inode;
+	bool found;
+
+	snprintf(path, sizeof(path), "dir/file_%d", n);
+	int expected_len = snprintf(expected, sizeof(expected), "file %d\n", n);
+
+	if (sqfs_inode_get(fs, &inode, sqfs_inode_root(fs)) != SQFS_OK ||
+	    sqfs_lookup_path(fs, &inode, path, &found) != SQFS_OK || !found) {
+		printf("failed to look up %s\n", path);
+		return 1;
+	}
+
+	sqfs_off_t size = inode.xtra.reg.file_size;
+	if (size != expected_len || sqfs_read_range(fs, &inode, 0, &size, buf) != SQFS_OK ||
+	    memcmp(buf, expected, expected_len) != 0) {
+		printf("%s has the wrong contents\n", path);
+		return 1;
+	}
+	return 0;
+}
+
+static int replay(sqfs *fs, const char *source, const cache_config_t *config) {
+	sqfs_inode big;
+	sqfs_off_t stream_pos = 0;
+	bool found;
+
+	if (trn_sqfs_set_cache_size(fs, TRN_SQFS_CACHE_METADATA, config->md) != RESULT_OK ||
+	    trn_sqfs_set_cache_size(fs, TRN_SQFS_CACHE_DATA, config->data) != RESULT_OK ||
+	    trn_sqfs_set_cache_size(fs, TRN_SQFS_CACHE_FRAGMENT, config->frag) != RESULT_OK) {
+		printf("failed to resize caches\n");
+		return 1;
+	}
+	trn_sqfs_reset_cache_stats(fs);
+	uint64_t allocs = fs->hdr_pool.allocs + fs->md_pool.allocs + fs->data_pool.allocs;
+
+	if (sqfs_inode_get(fs, &big, sqfs_inode_root(fs)) != SQFS_OK ||
+	    sqfs_lookup_path(fs, &big, "big", &found) != SQFS_OK || !found) {
+		printf("failed to look up big\n");
+		return 1;
+	}
+
+	uint64_t start = svcGetSystemTick();
+	for (int i = 0; i < TRACE_LENGTH; i++) {
+		switch (trace[i]) {
+		case TRACE_HOT_LOOKUP:
+		case TRACE_COLD_LOOKUP:
+			if (read_small_file(fs, trace_arg[i]) != 0)
+				return 1;
+			break;
+		case TRACE_STREAM: {
+			sqfs_off_t size = STREAM_CHUNK;
+			if ((uint64_t) stream_pos + size > big.xtra.reg.file_size)
+				stream_pos = 0;
+			if (sqfs_read_range(fs, &big, stream_pos, &size, stream_buf) != SQFS_OK) {
+				printf("failed to read big at %ld\n", (long) stream_pos);
+				return 1;
+			}
+			stream_pos += size;
+			break;
+		}
+		}
+	}
+	uint64_t ticks = svcGetSystemTick() - start;
+	allocs = fs->hdr_pool.allocs + fs->md_pool.allocs + fs->data_pool.allocs - allocs;
+
+	printf("sqfs cache: %s, %s (%zu/%zu/%zu blocks): %.2f us/op\n", source, config->name,
+	       config->md, config->data, config->frag, ticks / TICKS_PER_US / TRACE_LENGTH);
+
+	static const char *names[] = {"metadata", "data", "fragment"};
+	for (int c = TRN_SQFS_CACHE_METADATA; c <= TRN_SQFS_CACHE_FRAGMENT; c++) {
+		trn_sqfs_cache_stats_t stats;
+		trn_sqfs_get_cache_stats(fs, c, &stats);
+		uint64_t total = stats.hits + stats.misses;
+		printf("sqfs cache:   %-8s %8lu hits %8lu misses %8lu evictions (%.1f%% hit rate)\n", names[c],
+		       stats.hits, stats.misses, stats.evictions, total ? 100.0 * stats.hits / total : 0.0);
+	}
+
+	// once the caches are full, misses should be recycling evicted buffers
+	size_t slots = config->md + config->data + config->frag;
+	printf("sqfs cache:   %lu block buffers allocated\n", allocs);
+	if (allocs > 2 * slots + 3) {
+		printf("sqfs cache: expected at most %zu block buffer allocations\n", 2 * slots + 3);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	static blob_file blob;
+	static sqfs fs;
+	int ret = 0;
+
+	size_t image_size = ((uint8_t*) &_libtransistor_squashfs_image_end) - _libtransistor_squashfs_image;
+	int fd = blobfd_create(&blob, _libtransistor_squashfs_image, image_size);
+	if (fd < 0) {
+		printf("failed to create blobfd\n");
+		return 1;
+	}
+
+	build_trace();
+
+	// the same trace through a blobfd and straight out of memory
+	for (int memory = 0; memory < 2 && ret == 0; memory++) {
+		sqfs_err err = memory ?
+			sqfs_init_memory(&fs, _libtransistor_squashfs_image, image_size, 0) :
+			sqfs_init(&fs, fd, 0);
+		if (err != SQFS_OK) {
+			printf("failed to open squashfs image: %d\n", err);
+			ret = 1;
+			break;
+		}
+		for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+			if ((ret = replay(&fs, memory ? "memory" : "blobfd", &configs[i])) != 0)
+				break;
+		}
+		sqfs_destroy(&fs);
+	}
+
+	close(fd);
+	return ret;
+}
@@ -0,0 +1,113 @@
+#include<libtransistor/types.h>
+#include<libtransistor/svc.h>
+#include<libtransistor/err.h>
+#include<libtransistor/fs/inode.h>
+#include<libtransistor/fs/squashfs.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+
+#include"../lib/squashfs/squashfuse.h"
+
+// This uses the same image as test_sqfs_cache (see mk/tests.mk), where
+// dir/file_N exists for N < SMALL_FILES.
+#define SMALL_FILES 512
+#define CACHE_SIZE 64
+#define LOOKUPS 4000
+#define TICKS_PER_US 19.2
+
+extern unsigned char _libtransistor_squashfs_image[];
+extern unsigned int _libtransistor_squashfs_image_end;
+
+// what opening dir/file_N costs the filesystem: two lookups, then letting go
+static int open_file(trn_inode_t *root, int n) {
+	trn_inode_t dir, file;
+	char name[32];
+	int ret = 1;
+
+	snprintf(name, sizeof(name), "file_%d", n);
+	if(root->ops->lookup(root->data, &dir, "dir", 3) != RESULT_OK) {
+		printf("failed to look up dir\n");
+		return 1;
+	}
+	if(dir.ops->lookup(dir.data, &file, name, strlen(name)) != RESULT_OK) {
+		printf("failed to look up %s\n", name);
+		goto done;
+	}
+	file.ops->release(file.data);
+	ret = 0;
+done:
+	dir.ops->release(dir.data);
+	return ret;
+}
+
+static int run(sqfs *fs, trn_inode_t *root, size_t cache_size, int spread) {
+	trn_sqfs_inode_cache_stats_t stats;
+
+	trn_sqfs_set_inode_cache_size(fs, cache_size);
+	trn_sqfs_reset_inode_cache_stats(fs);
+
+	uint32_t seed = 0x12345678;
+	uint64_t start = svcGetSystemTick();
+	for(int i = 0; i < LOOKUPS; i++) {
+		seed = seed * 1103515245 + 12345;
+		if(open_file(root, (seed >> 8) % spread) != 0) {
+			return 1;
+		}
+	}
+	uint64_t ticks = svcGetSystemTick() - start;
+
+	trn_sqfs_get_inode_cache_stats(fs, &stats);
+	printf("sqfs inode cache: %3zu inodes, %3d files: %6.2f us/open (%lu hits, %lu misses, %lu evictions)\n",
+	       cache_size, spread, ticks / TICKS_PER_US / LOOKUPS, stats.hits, stats.misses, stats.evictions);
+
+	// only the root is still referenced, so everything else has to fit in the limit
+	if(stats.unused > cache_size || stats.cached != stats.unused + 1) {
+		printf("sqfs inode cache: %zu cached, %zu unused, with a limit of %zu\n", stats.cached, stats.unused, cache_size);
+		return 1;
+	}
+	// with the working set in the cache, only the first touch of each inode decodes it
+	if(cache_size > (size_t) spread && stats.misses > (uint64_t) spread + 1) {
+		printf("sqfs inode cache: expected at most %d misses\n", spread + 1);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	static sqfs fs;
+	trn_inode_t root, again;
+	int ret = 0;
+
+	size_t image_size = ((uint8_t*) &_libtransistor_squashfs_image_end) - _libtransistor_squashfs_image;
+	sqfs_err err = sqfs_init_memory(&fs, _libtransistor_squashfs_image, image_size, 0);
+	if(err != SQFS_OK) {
+		printf("failed to open squashfs image: %d\n", err);
+		return 1;
+	}
+	if(trn_sqfs_open_root(&root, &fs) != RESULT_OK) {
+		printf("failed to open root\n");
+		sqfs_destroy(&fs);
+		return 1;
+	}
+
+	// an inode that is still referenced is shared, not decoded again
+	if(trn_sqfs_open_root(&again, &fs) != RESULT_OK || again.data != root.data) {
+		printf("sqfs inode cache: root was decoded twice\n");
+		ret = 1;
+		goto done;
+	}
+	again.ops->release(again.data);
+
+	if((ret = run(&fs, &root, 0, 16)) != 0 ||
+	   (ret = run(&fs, &root, CACHE_SIZE, 16)) != 0 ||
+	   (ret = run(&fs, &root, CACHE_SIZE, SMALL_FILES)) != 0) {
+		goto done;
+	}
+
+done:
+	trn_sqfs_set_inode_cache_size(&fs, TRN_SQFS_DEFAULT_INODE_CACHE_SIZE);
+	root.ops->release(root.data);
+	sqfs_destroy(&fs);
+	return ret;
+}
@@ -0,0 +1,126 @@
+#include<libtransistor/types.h>
+#include<libtransistor/svc.h>
+#include<libtransistor/err.h>
+#include<libtransistor/fs/inode.h>
+#include<libtransistor/fs/squashfs.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+
+#include"../lib/squashfs/squashfuse.h"
+
+// The image for this test is generated by mk/tests.mk: big/entry_N for
+// N < BIG_ENTRIES, and small/entry_N for N < SMALL_ENTRIES.
+#define BIG_ENTRIES 20000
+#define SMALL_ENTRIES 16
+#define LOOKUPS 2000
+#define TICKS_PER_US 19.2
+
+extern unsigned char _libtransistor_squashfs_image[];
+extern unsigned int _libtransistor_squashfs_image_end;
+
+typedef struct {
+	const char *name;
+	size_t max_bytes;
+	bool expect_index;
+} config_t;
+
+static const config_t configs[] = {
+	{"disabled", 0, false},
+	{"default", TRN_SQFS_DEFAULT_LOOKUP_INDEX_BYTES, true},
+	{"too small", 64 * 1024, false},
+};
+
+static int lookup(trn_inode_t *dir, const char *name, bool expect_found) {
+	trn_inode_t child;
+	result_t r = dir->ops->lookup(dir->data, &child, name, strlen(name));
+	if(r == RESULT_OK) {
+		child.ops->release(child.data);
+	}
+	if(expect_found ? r != RESULT_OK : r != LIBTRANSISTOR_ERR_FS_NOT_FOUND) {
+		printf("looking up %s: got 0x%x\n", name, r);
+		return 1;
+	}
+	return 0;
+}
+
+static int run(sqfs *fs, trn_inode_t *root, const config_t *config) {
+	trn_sqfs_lookup_index_stats_t stats;
+	trn_inode_t big, small;
+	char name[32];
+
+	trn_sqfs_set_lookup_index(fs, config->max_bytes, TRN_SQFS_DEFAULT_LOOKUP_INDEX_DIR_SIZE);
+	trn_sqfs_reset_lookup_index_stats(fs);
+
+	if(root->ops->lookup(root->data, &big, "big", 3) != RESULT_OK ||
+	   root->ops->lookup(root->data, &small, "small", 5) != RESULT_OK) {
+		printf("failed to look up directories\n");
+		return 1;
+	}
+
+	uint32_t seed = 0x12345678;
+	uint64_t start = svcGetSystemTick();
+	for(int i = 0; i < LOOKUPS; i++) {
+		seed = seed * 1103515245 + 12345;
+		snprintf(name, sizeof(name), "entry_%u", (seed >> 8) % BIG_ENTRIES);
+		if(lookup(&big, name, true) != 0) {
+			return 1;
+		}
+	}
+	uint64_t ticks = svcGetSystemTick() - start;
+
+	// names just outside the directory, and a short directory that never gets an index
+	if(lookup(&big, "entry_", false) != 0 ||
+	   lookup(&big, "entry_20000", false) != 0 ||
+	   lookup(&big, "entry_19999", true) != 0 ||
+	   lookup(&small, "entry_3", true) != 0 ||
+	   lookup(&small, "entry_30", false) != 0) {
+		return 1;
+	}
+
+	trn_sqfs_get_lookup_index_stats(fs, &stats);
+	printf("sqfs lookup index: %-9s %8.2f us/lookup (%lu hits, %lu misses, %lu builds, %zu dirs, %zu bytes)\n",
+	       config->name, ticks / TICKS_PER_US / LOOKUPS,
+	       stats.hits, stats.misses, stats.builds, stats.directories, stats.bytes);
+
+	if(stats.bytes > config->max_bytes) {
+		printf("sqfs lookup index: using %zu bytes, over the %zu byte limit\n", stats.bytes, config->max_bytes);
+		return 1;
+	}
+	if(config->expect_index ? stats.hits < LOOKUPS : stats.hits != 0) {
+		printf("sqfs lookup index: unexpected %lu hits\n", stats.hits);
+		return 1;
+	}
+
+	big.ops->release(big.data);
+	small.ops->release(small.data);
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	static sqfs fs;
+	trn_inode_t root;
+	int ret = 0;
+
+	size_t image_size = ((uint8_t*) &_libtransistor_squashfs_image_end) - _libtransistor_squashfs_image;
+	sqfs_err err = sqfs_init_memory(&fs, _libtransistor_squashfs_image, image_size, 0);
+	if(err != SQFS_OK) {
+		printf("failed to open squashfs image: %d\n", err);
+		return 1;
+	}
+	if(trn_sqfs_open_root(&root, &fs) != RESULT_OK) {
+		printf("failed to open root\n");
+		sqfs_destroy(&fs);
+		return 1;
+	}
+
+	for(size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+		if((ret = run(&fs, &root, &configs[i])) != 0) {
+			break;
+		}
+	}
+
+	root.ops->release(root.data);
+	sqfs_destroy(&fs);
+	return ret;
+}
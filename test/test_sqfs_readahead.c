@@ -0,0 +1,96 @@
+#include<libtransistor/types.h>
+#include<libtransistor/svc.h>
+#include<libtransistor/fs/squashfs.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<fcntl.h>
+#include<unistd.h>
+
+// generated by mk/tests.mk
+#define STREAM_FILE "/squashfs/stream"
+#define STREAM_SIZE (64 * 1024 * 1024)
+#define CHUNK_SIZE (64 * 1024)
+#define TICKS_PER_US 19.2
+
+// stands in for whatever the application does with the data it streams in,
+// which is what read-ahead lets decompression overlap with
+static uint32_t process(const uint8_t *buf, size_t size, uint32_t hash) {
+	for(size_t i = 0; i < size; i++) {
+		hash^= buf[i];
+		hash*= 16777619u;
+	}
+	return hash;
+}
+
+static int stream(uint8_t *buf, size_t readahead, uint32_t *hash) {
+	trn_sqfs_readahead_stats_t stats;
+	size_t total = 0;
+	ssize_t r;
+
+	if(trn_sqfs_set_readahead(readahead, -2) != RESULT_OK) {
+		printf("failed to set read-ahead\n");
+		return 1;
+	}
+	trn_sqfs_reset_readahead_stats();
+
+	int fd = open(STREAM_FILE, O_RDONLY);
+	if(fd < 0) {
+		perror("open");
+		return 1;
+	}
+
+	*hash = 2166136261u;
+	uint64_t start = svcGetSystemTick();
+	while((r = read(fd, buf, CHUNK_SIZE)) > 0) {
+		*hash = process(buf, r, *hash);
+		total+= r;
+	}
+	uint64_t ticks = svcGetSystemTick() - start;
+	close(fd);
+
+	if(r < 0) {
+		perror("read");
+		return 1;
+	}
+	if(total != STREAM_SIZE) {
+		printf("expected %d bytes, read %zu\n", STREAM_SIZE, total);
+		return 1;
+	}
+
+	trn_sqfs_get_readahead_stats(&stats);
+	double secs = ticks / TICKS_PER_US / 1000000.0;
+	printf("sqfs read-ahead: %2zu blocks: %7.2f MiB/s (%lu issued, %lu ready, %lu waited, %lu discarded)\n",
+	       readahead, (STREAM_SIZE / (1024.0 * 1024.0)) / secs,
+	       stats.issued, stats.hits, stats.waits, stats.discarded);
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	static const size_t windows[] = {0, 2, TRN_SQFS_DEFAULT_READAHEAD, 8};
+	uint32_t expected = 0, hash;
+	int ret = 0;
+
+	uint8_t *buf = malloc(CHUNK_SIZE);
+	if(buf == NULL) {
+		printf("out of memory\n");
+		return 1;
+	}
+
+	for(size_t i = 0; i < sizeof(windows) / sizeof(windows[0]); i++) {
+		if((ret = stream(buf, windows[i], &hash)) != 0) {
+			break;
+		}
+		if(i == 0) {
+			expected = hash;
+		} else if(hash != expected) {
+			printf("read-ahead of %zu blocks read different data\n", windows[i]);
+			ret = 1;
+			break;
+		}
+	}
+
+	trn_sqfs_set_readahead(TRN_SQFS_DEFAULT_READAHEAD, -2);
+	free(buf);
+	return ret;
+}
@@ -0,0 +1,207 @@
+#include<libtransistor/types.h>
+#include<libtransistor/svc.h>
+#include<libtransistor/err.h>
+#include<libtransistor/fs/fs.h>
+#include<libtransistor/fs/tmpfs.h>
+#include<errno.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<fcntl.h>
+#include<unistd.h>
+#include<dirent.h>
+#include<sys/stat.h>
+
+#define TMPFS_SIZE (1024 * 1024)
+#define CHURN_FILES 64
+#define CHURN_ROUNDS 4
+#define CHURN_FILE_SIZE 1000
+#define TICKS_PER_US 19.2
+
+static trn_inode_t tmp_root;
+
+static int check_basics() {
+	static char buf[TMPFS_SIZE];
+	struct stat st;
+
+	if(mkdir("/tmp/dir", 0777) != 0) {
+		perror("mkdir");
+		return 1;
+	}
+	int fd = open("/tmp/dir/file", O_RDWR | O_CREAT | O_EXCL);
+	if(fd < 0) {
+		perror("open");
+		return 1;
+	}
+	// a hole, then some data
+	if(pwrite(fd, "hello", 5, 10000) != 5) {
+		perror("pwrite");
+		goto fail;
+	}
+	if(fstat(fd, &st) != 0 || st.st_size != 10005) {
+		printf("tmpfs: expected size 10005, got %ld\n", (long) st.st_size);
+		goto fail;
+	}
+	if(pread(fd, buf, sizeof(buf), 0) != 10005 || buf[0] != 0 || buf[9999] != 0 || memcmp(buf + 10000, "hello", 5) != 0) {
+		printf("tmpfs: read back the wrong data\n");
+		goto fail;
+	}
+	if(trn_tmpfs_get_used_bytes(&tmp_root) != TRN_TMPFS_PAGE_SIZE) {
+		printf("tmpfs: the hole took up memory\n");
+		goto fail;
+	}
+
+	// the size limit holds, and a failed write doesn't leave anything behind
+	memset(buf, 'x', sizeof(buf));
+	if(pwrite(fd, buf, sizeof(buf), TRN_TMPFS_PAGE_SIZE) != -1 || errno != ENOSPC) {
+		printf("tmpfs: writing past the size limit didn't fail with ENOSPC\n");
+		goto fail;
+	}
+	if(trn_tmpfs_get_used_bytes(&tmp_root) != TRN_TMPFS_PAGE_SIZE) {
+		printf("tmpfs: failed write used memory\n");
+		goto fail;
+	}
+	close(fd);
+
+	if(rename("/tmp/dir/file", "/tmp/moved") != 0) {
+		perror("rename");
+		return 1;
+	}
+	if(stat("/tmp/dir/file", &st) == 0 || stat("/tmp/moved", &st) != 0 || st.st_size != 10005) {
+		printf("tmpfs: rename didn't move the file\n");
+		return 1;
+	}
+	if(rmdir("/tmp/dir") != 0 || unlink("/tmp/moved") != 0) {
+		perror("remove");
+		return 1;
+	}
+	if(trn_tmpfs_get_used_bytes(&tmp_root) != 0) {
+		printf("tmpfs: removing everything left %zu bytes in use\n", trn_tmpfs_get_used_bytes(&tmp_root));
+		return 1;
+	}
+	return 0;
+
+fail:
+	close(fd);
+	return 1;
+}
+
+// Growing a file with ftruncate only makes a hole, which reads back as zeros,
+// and shrinking it again clears what was cut off.
+static int check_truncate() {
+	static char buf[3 * TRN_TMPFS_PAGE_SIZE];
+	struct stat st;
+
+	int fd = open("/tmp/grown", O_RDWR | O_CREAT | O_EXCL);
+	if(fd < 0) {
+		perror("open");
+		return 1;
+	}
+	memset(buf, 'x', sizeof(buf));
+	if(ftruncate(fd, 2 * TRN_TMPFS_PAGE_SIZE) != 0 ||
+	   pread(fd, buf, sizeof(buf), 0) != 2 * TRN_TMPFS_PAGE_SIZE || buf[0] != 0 || buf[2 * TRN_TMPFS_PAGE_SIZE - 1] != 0) {
+		printf("tmpfs: file grown with ftruncate didn't read back as zeros\n");
+		goto fail;
+	}
+	if(trn_tmpfs_get_used_bytes(&tmp_root) != 0) {
+		printf("tmpfs: growing a file with ftruncate used memory\n");
+		goto fail;
+	}
+	if(ftruncate(fd, TRN_TMPFS_PAGE_SIZE + 10) != 0 || fstat(fd, &st) != 0 || st.st_size != TRN_TMPFS_PAGE_SIZE + 10) {
+		printf("tmpfs: shrinking a hole with ftruncate failed\n");
+		goto fail;
+	}
+	if(pwrite(fd, "hello", 5, 100) != 5 || ftruncate(fd, 102) != 0 || ftruncate(fd, 3 * TRN_TMPFS_PAGE_SIZE) != 0 ||
+	   pread(fd, buf, sizeof(buf), 0) != sizeof(buf) || memcmp(buf + 100, "he\0\0\0", 5) != 0 || buf[sizeof(buf) - 1] != 0) {
+		printf("tmpfs: data cut off by ftruncate came back\n");
+		goto fail;
+	}
+	close(fd);
+
+	if(unlink("/tmp/grown") != 0) {
+		perror("unlink");
+		return 1;
+	}
+	return 0;
+
+fail:
+	close(fd);
+	return 1;
+}
+
+// Creates, writes and closes a directory full of small files, then deletes
+// them all, a few times over.
+static int churn(const char *dir, uint64_t *ticks) {
+	static char buf[CHURN_FILE_SIZE];
+	char path[64];
+
+	memset(buf, 'c', sizeof(buf));
+	if(mkdir(dir, 0777) != 0 && errno != EEXIST) {
+		perror("mkdir");
+		return 1;
+	}
+
+	uint64_t start = svcGetSystemTick();
+	for(int round = 0; round < CHURN_ROUNDS; round++) {
+		for(int i = 0; i < CHURN_FILES; i++) {
+			snprintf(path, sizeof(path), "%s/f%d", dir, i);
+			int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC);
+			if(fd < 0) {
+				perror("open");
+				return 1;
+			}
+			if(write(fd, buf, sizeof(buf)) != sizeof(buf)) {
+				perror("write");
+				close(fd);
+				return 1;
+			}
+			close(fd);
+		}
+		for(int i = 0; i < CHURN_FILES; i++) {
+			snprintf(path, sizeof(path), "%s/f%d", dir, i);
+			if(unlink(path) != 0) {
+				perror("unlink");
+				return 1;
+			}
+		}
+	}
+	*ticks = svcGetSystemTick() - start;
+
+	rmdir(dir);
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	uint64_t tmp_ticks, sd_ticks;
+	result_t r;
+
+	if((r = trn_tmpfs_create(&tmp_root, TMPFS_SIZE)) != RESULT_OK) {
+		printf("failed to create tmpfs: 0x%x\n", r);
+		return 1;
+	}
+	if((r = trn_fs_mount("/tmp", tmp_root)) != RESULT_OK) {
+		printf("failed to mount tmpfs: 0x%x\n", r);
+		return 1;
+	}
+
+	if(check_basics() != 0 || check_truncate() != 0) {
+		return 1;
+	}
+
+	if(churn("/tmp/churn", &tmp_ticks) != 0) {
+		return 1;
+	}
+	if(trn_tmpfs_get_used_bytes(&tmp_root) != 0) {
+		printf("tmpfs: churn left %zu bytes in use\n", trn_tmpfs_get_used_bytes(&tmp_root));
+		return 1;
+	}
+	printf("tmpfs: %d files: %.1f us/file\n", CHURN_FILES * CHURN_ROUNDS, tmp_ticks / TICKS_PER_US / (CHURN_FILES * CHURN_ROUNDS));
+
+	if(churn("/sd/tmpfs_churn", &sd_ticks) != 0) {
+		printf("fspfs: no sd card, skipping\n");
+		return 0;
+	}
+	printf("fspfs: %d files: %.1f us/file (%.1fx)\n", CHURN_FILES * CHURN_ROUNDS, sd_ticks / TICKS_PER_US / (CHURN_FILES * CHURN_ROUNDS),
+	       (double) sd_ticks / tmp_ticks);
+	return 0;
+}